@@ -24,9 +24,40 @@
 #include <array>
 #include <map>
 #include <string>
+#include <vector>
 
 namespace mfmg
 {
+/**
+ * Build the sparsity pattern of the restriction matrix: the rows are the
+ * eigenvectors, numbered contiguously across the processors, and the columns
+ * of the rows associated with the i-th agglomerate are given by
+ * \p dof_indices_maps[i].
+ */
+dealii::TrilinosWrappers::SparsityPattern build_restriction_sparsity_pattern(
+    MPI_Comm comm, dealii::IndexSet const &locally_owned_dofs,
+    std::vector<dealii::Vector<double>> const &eigenvectors,
+    std::vector<std::vector<dealii::types::global_dof_index>> const
+        &dof_indices_maps,
+    std::vector<unsigned int> const &n_local_eigenvectors);
+
+/**
+ * Assemble the restriction matrix from the local eigenvectors. The entries are
+ * weighted by the ratio of the local and the global diagonal entries so that
+ * the contributions of the agglomerates sharing a degree of freedom add up.
+ * This does not depend on how the agglomerates were built.
+ */
+void assemble_restriction_sparse_matrix(
+    MPI_Comm comm, dealii::IndexSet const &locally_owned_dofs,
+    std::vector<dealii::Vector<double>> const &eigenvectors,
+    std::vector<std::vector<double>> const &diag_elements,
+    std::vector<std::vector<dealii::types::global_dof_index>> const
+        &dof_indices_maps,
+    std::vector<unsigned int> const &n_local_eigenvectors,
+    dealii::LinearAlgebra::distributed::Vector<double> const
+        &locally_relevant_global_diag,
+    dealii::TrilinosWrappers::SparseMatrix &restriction_sparse_matrix);
+
 template <int dim, typename VectorType>
 class AMGe
 {
@@ -36,10 +67,65 @@ public:
   /**
    * Flag cells to create agglomerates. This function returns the local number
    * of agglomerates that have been created.
+   *
+   * If "across_ranks" is set to true in \p ptree, the agglomerates that are
+   * smaller than half the largest local agglomerate and that touch the
+   * boundary with another processor are merged into the larger agglomerate of
+   * that processor with which they share the most faces. The processor that
+   * owns the merged agglomerate gets the cells that are its ghost cells, i.e.,
+   * the cells of an agglomerate are not necessarily locally owned. The other
+   * cells of the small agglomerate are merged with the local agglomerate with
+   * which they share the most faces. A locally owned cell that belongs to an
+   * agglomerate of another processor has a user_index of zero. This is not
+   * supported by fast_ap or by the agglomerate smoother.
+   *
+   * The coarse DoFs follow the order of the agglomerates. If
+   * "coarse_ordering" is set to hilbert or morton in \p ptree, the
+   * agglomerates are renumbered along the corresponding space-filling curve
+   * going through their centroids so that the coarse operators are banded.
+   * The default is "none", which keeps the order of the partitioner.
+   *
+   * If "partitioner" is "file", the agglomerates are read from the file
+   * "filename" written by save_agglomerates() instead of being computed. If
+   * "export_filename" is set in \p ptree, the agglomerates given by the
+   * partitioner are written to this file. In both cases, "across_ranks" and
+   * "coarse_ordering" are applied after the file has been read, respectively
+   * written.
    */
   unsigned int
   build_agglomerates(boost::property_tree::ptree const &ptree) const;
 
+  /**
+   * Flag cells using agglomerates computed outside of mfmg, e.g., by the mesh
+   * generator. \p agglomerate_ids[i] is the agglomerate of the i-th locally
+   * owned active cell, in the order of the active cell iterators. The IDs do
+   * not need to be contiguous. They are renumbered from one while keeping
+   * their relative order. This function returns the local number of
+   * agglomerates.
+   */
+  unsigned int
+  set_agglomerates(std::vector<unsigned int> const &agglomerate_ids) const;
+
+  /**
+   * Return the agglomerate of each locally owned active cell in the format
+   * expected by set_agglomerates().
+   */
+  std::vector<unsigned int> get_agglomerates() const;
+
+  /**
+   * Write the agglomerates of the locally owned cells to \p filename.<rank>
+   * in binary format. The file contains the number of processors and the
+   * agglomerate ID of every locally owned cell as 32-bit integers.
+   */
+  void save_agglomerates(std::string const &filename) const;
+
+  /**
+   * Read the agglomerates written by save_agglomerates(). The mesh and the
+   * number of processors must be the same as when the file was written. This
+   * function returns the local number of agglomerates.
+   */
+  unsigned int load_agglomerates(std::string const &filename) const;
+
   /**
    * Return the interior agglomerates (agglomerates made of cells at the
    * boundary of the base agglomerates) and the halo agglomerates (agglomerates
@@ -85,6 +171,17 @@ public:
           &patch_to_global_map,
       dealii::DoFHandler<dim> const &agglomerate_dof_handler) const;
 
+  /**
+   * Return, for each agglomerate, the sorted global indices of the locally
+   * owned DoFs of its cells. If \p halo_agglomerates is not empty, the locally
+   * owned DoFs of the halo cells of each agglomerate (see
+   * build_boundary_agglomerates()) are added, which creates overlapping sets.
+   */
+  std::vector<std::vector<dealii::types::global_dof_index>>
+  compute_agglomerate_dof_indices(
+      std::vector<std::vector<unsigned int>> const &halo_agglomerates =
+          std::vector<std::vector<unsigned int>>()) const;
+
   /**
    * Output the mesh and the agglomerate ids.
    */
@@ -144,6 +241,31 @@ private:
   build_agglomerates_partitioner(std::string const &partitioner_type,
                                  unsigned int n_agglomerates) const;
 
+  /**
+   * Flag cells to create agglomerates. The locally owned cells are sorted
+   * along a space-filling curve, \p curve_type is hilbert or morton, going
+   * through their centers and the curve is cut in pieces of
+   * \p agglomerate_size cells. This does not require an external partitioner.
+   * This function returns the local number of agglomerates that have been
+   * created.
+   */
+  unsigned int
+  build_agglomerates_space_filling_curve(std::string const &curve_type,
+                                         unsigned int agglomerate_size) const;
+
+  /**
+   * Merge the small agglomerates at the boundary of the subdomain into the
+   * agglomerates of the neighboring processors. The agglomerate IDs and the
+   * merge decisions are sent to the ghost cells on the other processors.
+   */
+  void merge_agglomerates_across_ranks() const;
+
+  /**
+   * Renumber the agglomerates along the space-filling curve \p curve_type,
+   * hilbert or morton, going through their centroids.
+   */
+  void renumber_agglomerates(std::string const &curve_type) const;
+
   dealii::TrilinosWrappers::SparsityPattern
   compute_restriction_sparsity_pattern(
       std::vector<dealii::Vector<double>> const &eigenvectors,
@@ -165,6 +287,7 @@ private:
           &agglomerate_to_global_tria_map) const;
 
   mutable unsigned int _n_agglomerates;
+  mutable bool _across_ranks = false;
 };
 } // namespace mfmg
 
@@ -16,17 +16,25 @@
 #include <mfmg/common/exceptions.hpp>
 #include <mfmg/common/utils.hpp>
 
+#include <deal.II/base/parallel.h>
 #include <deal.II/distributed/tria.h>
 #include <deal.II/dofs/dof_accessor.h>
+#include <deal.II/dofs/dof_tools.h>
+#include <deal.II/fe/fe_dgq.h>
 #include <deal.II/grid/filtered_iterator.h>
 #include <deal.II/grid/grid_tools.h>
+#include <deal.II/lac/la_parallel_vector.h>
 #include <deal.II/lac/sparsity_tools.h>
 #include <deal.II/numerics/data_out.h>
 
 #include <algorithm>
+#include <array>
+#include <cstdint>
 #include <fstream>
+#include <limits>
 #include <map>
-#include <unordered_map>
+#include <numeric>
+#include <set>
 
 #ifdef DEAL_II_TRILINOS_WITH_ZOLTAN
 // Zoltan random seed control is in an internal zz_rand.h file which is not
@@ -52,6 +60,12 @@ template <int dim, typename VectorType>
 unsigned int AMGe<dim, VectorType>::build_agglomerates(
     boost::property_tree::ptree const &ptree) const
 {
+  // Clear the agglomerates of a previous call, including the ghost cells that
+  // were merged with a local agglomerate
+  for (auto cell : _dof_handler.active_cell_iterators())
+    cell->set_user_index(0);
+  _across_ranks = false;
+
   std::string partitioner_type = ptree.get<std::string>("partitioner");
   std::transform(partitioner_type.begin(), partitioner_type.end(),
                  partitioner_type.begin(), ::tolower);
@@ -64,8 +78,7 @@ unsigned int AMGe<dim, VectorType>::build_agglomerates(
     unsigned int const n_desired_agglomerates =
         ptree.get<unsigned int>("n_agglomerates");
 
-    return build_agglomerates_partitioner(partitioner_type,
-                                          n_desired_agglomerates);
+    build_agglomerates_partitioner(partitioner_type, n_desired_agglomerates);
   }
   else if (partitioner_type == "block")
   {
@@ -75,13 +88,422 @@ unsigned int AMGe<dim, VectorType>::build_agglomerates(
     if (dim == 3)
       agglomerate_dim[2] = ptree.get<unsigned int>("nz");
 
-    return build_agglomerates_block(agglomerate_dim);
+    build_agglomerates_block(agglomerate_dim);
+  }
+  else if ((partitioner_type == "hilbert") || (partitioner_type == "morton"))
+  {
+    unsigned int const agglomerate_size = ptree.get<unsigned int>("size");
+
+    build_agglomerates_space_filling_curve(partitioner_type, agglomerate_size);
+  }
+  else if (partitioner_type == "file")
+  {
+    load_agglomerates(ptree.get<std::string>("filename"));
   }
   else
     ASSERT_THROW(false, partitioner_type +
                             " is not a valid choice for the partitioner. The "
-                            "acceptable values are zoltan, metis, and block.");
-  return 0;
+                            "acceptable values are zoltan, metis, block, "
+                            "hilbert, morton, and file.");
+
+  // Save the agglomerates before they are modified so that reading the file
+  // with the same parameters gives back the same agglomerates
+  auto const export_filename =
+      ptree.get_optional<std::string>("export_filename");
+  if (export_filename)
+    save_agglomerates(*export_filename);
+
+  _across_ranks = ptree.get("across_ranks", false);
+  if (_across_ranks)
+    merge_agglomerates_across_ranks();
+
+  // The coarse DoFs are numbered by agglomerate so renumbering the
+  // agglomerates also renumbers the coarse DoFs
+  std::string coarse_ordering = ptree.get("coarse_ordering", "none");
+  std::transform(coarse_ordering.begin(), coarse_ordering.end(),
+                 coarse_ordering.begin(), ::tolower);
+  if (coarse_ordering != "none")
+    renumber_agglomerates(coarse_ordering);
+
+  return _n_agglomerates;
+}
+
+template <int dim, typename VectorType>
+unsigned int AMGe<dim, VectorType>::set_agglomerates(
+    std::vector<unsigned int> const &agglomerate_ids) const
+{
+  unsigned int const n_locally_owned_cells =
+      _dof_handler.get_triangulation().n_locally_owned_active_cells();
+  ASSERT_THROW(agglomerate_ids.size() == n_locally_owned_cells,
+               "There are " + std::to_string(agglomerate_ids.size()) +
+                   " agglomerate IDs but " +
+                   std::to_string(n_locally_owned_cells) +
+                   " locally owned cells");
+
+  // Renumber the IDs contiguously from one while keeping their order
+  std::vector<unsigned int> sorted_ids(agglomerate_ids);
+  std::sort(sorted_ids.begin(), sorted_ids.end());
+  sorted_ids.erase(std::unique(sorted_ids.begin(), sorted_ids.end()),
+                   sorted_ids.end());
+
+  for (auto cell : _dof_handler.active_cell_iterators())
+    cell->set_user_index(0);
+  unsigned int i = 0;
+  for (auto cell : dealii::filter_iterators(
+           _dof_handler.active_cell_iterators(),
+           dealii::IteratorFilters::LocallyOwnedCell()))
+  {
+    auto const id = std::lower_bound(sorted_ids.begin(), sorted_ids.end(),
+                                     agglomerate_ids[i]);
+    cell->set_user_index(std::distance(sorted_ids.begin(), id) + 1);
+    ++i;
+  }
+  _n_agglomerates = sorted_ids.size();
+  _across_ranks = false;
+
+  return _n_agglomerates;
+}
+
+template <int dim, typename VectorType>
+std::vector<unsigned int> AMGe<dim, VectorType>::get_agglomerates() const
+{
+  std::vector<unsigned int> agglomerate_ids;
+  agglomerate_ids.reserve(
+      _dof_handler.get_triangulation().n_locally_owned_active_cells());
+  for (auto cell : dealii::filter_iterators(
+           _dof_handler.active_cell_iterators(),
+           dealii::IteratorFilters::LocallyOwnedCell()))
+    agglomerate_ids.push_back(cell->user_index());
+
+  return agglomerate_ids;
+}
+
+template <int dim, typename VectorType>
+void AMGe<dim, VectorType>::save_agglomerates(
+    std::string const &filename) const
+{
+  ASSERT_THROW(_across_ranks == false,
+               "Agglomerates across ranks cannot be saved");
+  auto const ids = get_agglomerates();
+  std::vector<std::uint32_t> const agglomerate_ids(ids.begin(), ids.end());
+  std::uint32_t const header[2] = {
+      dealii::Utilities::MPI::n_mpi_processes(_comm),
+      static_cast<std::uint32_t>(agglomerate_ids.size())};
+
+  // The setup continues with collective operations so every processor must
+  // throw if one of them fails
+  collective_check(_comm, [&]() {
+    std::string const rank_filename =
+        filename + "." +
+        std::to_string(dealii::Utilities::MPI::this_mpi_process(_comm));
+    std::ofstream out(rank_filename, std::ios::binary);
+    ASSERT_THROW(out.good(), "Cannot open file " + rank_filename);
+    out.write(reinterpret_cast<char const *>(header), sizeof(header));
+    out.write(reinterpret_cast<char const *>(agglomerate_ids.data()),
+              agglomerate_ids.size() * sizeof(std::uint32_t));
+    ASSERT_THROW(out.good(), "Error while writing file " + rank_filename);
+  });
+}
+
+template <int dim, typename VectorType>
+unsigned int
+AMGe<dim, VectorType>::load_agglomerates(std::string const &filename) const
+{
+  // The setup continues with collective operations so every processor must
+  // throw if one of them fails
+  std::vector<unsigned int> agglomerate_ids;
+  collective_check(_comm, [&]() {
+    std::string const rank_filename =
+        filename + "." +
+        std::to_string(dealii::Utilities::MPI::this_mpi_process(_comm));
+    std::ifstream in(rank_filename, std::ios::binary);
+    ASSERT_THROW(in.good(), "Cannot open file " + rank_filename);
+    std::uint32_t header[2] = {0, 0};
+    in.read(reinterpret_cast<char *>(header), sizeof(header));
+    ASSERT_THROW(in.good(), "Error while reading file " + rank_filename);
+    ASSERT_THROW(header[0] == dealii::Utilities::MPI::n_mpi_processes(_comm),
+                 "The file " + rank_filename + " was written by " +
+                     std::to_string(header[0]) + " processors");
+    std::vector<std::uint32_t> ids(header[1]);
+    in.read(reinterpret_cast<char *>(ids.data()),
+            ids.size() * sizeof(std::uint32_t));
+    ASSERT_THROW(in.good(), "Error while reading file " + rank_filename);
+    agglomerate_ids.assign(ids.begin(), ids.end());
+    // The number of cells is checked here since set_agglomerates() only
+    // throws on the processors where it does not match
+    unsigned int const n_locally_owned_cells =
+        _dof_handler.get_triangulation().n_locally_owned_active_cells();
+    ASSERT_THROW(agglomerate_ids.size() == n_locally_owned_cells,
+                 "The file " + rank_filename + " contains " +
+                     std::to_string(agglomerate_ids.size()) +
+                     " agglomerate IDs but there are " +
+                     std::to_string(n_locally_owned_cells) +
+                     " locally owned cells");
+  });
+
+  return set_agglomerates(agglomerate_ids);
+}
+
+template <int dim, typename VectorType>
+void AMGe<dim, VectorType>::renumber_agglomerates(
+    std::string const &curve_type) const
+{
+  // Compute the centroids of the agglomerates. The lowest agglomerate ID is
+  // one because zero is reserved for the cells that are not part of a local
+  // agglomerate.
+  std::vector<dealii::Point<dim>> centroids(_n_agglomerates);
+  std::vector<unsigned int> n_cells(_n_agglomerates, 0);
+  for (auto cell : _dof_handler.active_cell_iterators())
+  {
+    if (cell->user_index() > 0)
+    {
+      unsigned int const i = cell->user_index() - 1;
+      centroids[i] += cell->center();
+      ++n_cells[i];
+    }
+  }
+  for (unsigned int i = 0; i < _n_agglomerates; ++i)
+    if (n_cells[i] > 0)
+      centroids[i] /= n_cells[i];
+
+  std::vector<unsigned int> const order =
+      space_filling_curve_order(curve_type, centroids);
+  std::vector<unsigned int> new_ids(_n_agglomerates);
+  for (unsigned int i = 0; i < _n_agglomerates; ++i)
+    new_ids[order[i]] = i + 1;
+  for (auto cell : _dof_handler.active_cell_iterators())
+    if (cell->user_index() > 0)
+      cell->set_user_index(new_ids[cell->user_index() - 1]);
+}
+
+template <int dim, typename VectorType>
+void AMGe<dim, VectorType>::merge_agglomerates_across_ranks() const
+{
+  auto const &triangulation = _dof_handler.get_triangulation();
+  auto const *distributed_triangulation =
+      dynamic_cast<dealii::parallel::distributed::Triangulation<dim> const *>(
+          &triangulation);
+  if (distributed_triangulation == nullptr)
+    return;
+  MPI_Comm comm = distributed_triangulation->get_communicator();
+  if (dealii::Utilities::MPI::n_mpi_processes(comm) == 1)
+    return;
+
+  // The data of the cells is sent to the ghost cells using a vector with one
+  // DoF per cell
+  dealii::FE_DGQ<dim> fe(0);
+  dealii::DoFHandler<dim> cell_dof_handler(triangulation);
+  cell_dof_handler.distribute_dofs(fe);
+  dealii::IndexSet locally_relevant_cells;
+  dealii::DoFTools::extract_locally_relevant_dofs(cell_dof_handler,
+                                                  locally_relevant_cells);
+  dealii::LinearAlgebra::distributed::Vector<double> cell_vector(
+      cell_dof_handler.locally_owned_dofs(), locally_relevant_cells, comm);
+  unsigned int const n_active_cells = triangulation.n_active_cells();
+  std::vector<dealii::types::global_dof_index> cell_dofs(n_active_cells);
+  std::vector<dealii::types::global_dof_index> dof_index(1);
+  for (auto cell : cell_dof_handler.active_cell_iterators())
+  {
+    if (cell->is_artificial() == false)
+    {
+      cell->get_dof_indices(dof_index);
+      cell_dofs[cell->active_cell_index()] = dof_index[0];
+    }
+  }
+  auto exchange = [&](std::vector<unsigned int> &cell_values) {
+    cell_vector.zero_out_ghosts();
+    for (auto cell : cell_dof_handler.active_cell_iterators())
+      if (cell->is_locally_owned())
+        cell_vector[cell_dofs[cell->active_cell_index()]] =
+            cell_values[cell->active_cell_index()];
+    cell_vector.update_ghost_values();
+    for (auto cell : cell_dof_handler.active_cell_iterators())
+      if (cell->is_ghost())
+        cell_values[cell->active_cell_index()] = static_cast<unsigned int>(
+            cell_vector[cell_dofs[cell->active_cell_index()]]);
+  };
+
+  // Send the agglomerate of every cell and the size of this agglomerate to the
+  // ghost cells. The sizes are indexed by agglomerate ID.
+  std::vector<unsigned int> agglomerate_sizes(_n_agglomerates + 1, 0);
+  std::vector<unsigned int> cell_agglomerate(n_active_cells, 0);
+  for (auto cell : _dof_handler.active_cell_iterators())
+  {
+    if (cell->is_locally_owned())
+    {
+      cell_agglomerate[cell->active_cell_index()] = cell->user_index();
+      ++agglomerate_sizes[cell->user_index()];
+    }
+  }
+  std::vector<unsigned int> cell_agglomerate_size(n_active_cells, 0);
+  for (auto cell : _dof_handler.active_cell_iterators())
+    if (cell->is_locally_owned())
+      cell_agglomerate_size[cell->active_cell_index()] =
+          agglomerate_sizes[cell->user_index()];
+  exchange(cell_agglomerate);
+  exchange(cell_agglomerate_size);
+
+  // List the faces shared by the small agglomerates and the ghost cells. A
+  // contact is (agglomerate, neighbor rank, neighbor agglomerate, size of the
+  // neighbor agglomerate, cell).
+  unsigned int const max_size =
+      *std::max_element(agglomerate_sizes.begin(), agglomerate_sizes.end());
+  using Contact = std::array<unsigned int, 5>;
+  std::vector<Contact> contacts;
+  auto add_contact = [&](auto const &cell, auto const &neighbor) {
+    if ((neighbor->has_children() == false) && (neighbor->is_ghost() == true))
+    {
+      unsigned int const neighbor_index = neighbor->active_cell_index();
+      contacts.push_back({{cell->user_index(), neighbor->subdomain_id(),
+                           cell_agglomerate[neighbor_index],
+                           cell_agglomerate_size[neighbor_index],
+                           cell->active_cell_index()}});
+    }
+  };
+  for (auto cell : _dof_handler.active_cell_iterators())
+  {
+    if ((cell->is_locally_owned() == false) ||
+        (2 * agglomerate_sizes[cell->user_index()] >= max_size))
+      continue;
+    for (unsigned int f = 0; f < dealii::GeometryInfo<dim>::faces_per_cell;
+         ++f)
+    {
+      if (cell->at_boundary(f) == true)
+        continue;
+      if (cell->neighbor(f)->has_children() == true)
+      {
+        for (unsigned int c = 0; c < cell->face(f)->n_children(); ++c)
+          add_contact(cell, cell->neighbor_child_on_subface(f, c));
+      }
+      else
+        add_contact(cell, cell->neighbor(f));
+    }
+  }
+  std::sort(contacts.begin(), contacts.end());
+
+  // A small agglomerate is merged with the larger agglomerate of another
+  // processor with which it shares the most faces. The target rank is shifted
+  // by one so that zero means that the agglomerate is not merged.
+  std::vector<unsigned int> target_ranks(_n_agglomerates + 1, 0);
+  std::vector<unsigned int> target_agglomerates(_n_agglomerates + 1, 0);
+  std::vector<unsigned int> target_n_faces(_n_agglomerates + 1, 0);
+  auto same_target = [](Contact const &a, Contact const &b) {
+    return (a[0] == b[0]) && (a[1] == b[1]) && (a[2] == b[2]);
+  };
+  for (auto target_begin = contacts.begin(); target_begin != contacts.end();)
+  {
+    auto target_end = target_begin;
+    while ((target_end != contacts.end()) &&
+           same_target(*target_begin, *target_end))
+      ++target_end;
+    unsigned int const agglomerate = (*target_begin)[0];
+    unsigned int const n_faces = target_end - target_begin;
+    if (((*target_begin)[3] > agglomerate_sizes[agglomerate]) &&
+        (n_faces > target_n_faces[agglomerate]))
+    {
+      target_ranks[agglomerate] = (*target_begin)[1] + 1;
+      target_agglomerates[agglomerate] = (*target_begin)[2];
+      target_n_faces[agglomerate] = n_faces;
+    }
+    target_begin = target_end;
+  }
+
+  // The target processor only knows the cells of the agglomerate that are its
+  // ghost cells, i.e., the cells that share a vertex with one of its cells.
+  // These cells are given to the target agglomerate. The other cells of the
+  // agglomerate are merged with the local agglomerate with which they share
+  // the most faces so that no small piece of the agglomerate is left.
+  std::vector<std::vector<unsigned int>> vertex_ranks(
+      triangulation.n_vertices());
+  for (auto cell : _dof_handler.active_cell_iterators())
+    if (cell->is_ghost())
+      for (unsigned int v = 0; v < dealii::GeometryInfo<dim>::vertices_per_cell;
+           ++v)
+        vertex_ranks[cell->vertex_index(v)].push_back(cell->subdomain_id());
+  auto is_visible = [&](auto const &cell, unsigned int const target_rank) {
+    for (unsigned int v = 0; v < dealii::GeometryInfo<dim>::vertices_per_cell;
+         ++v)
+    {
+      auto const &ranks = vertex_ranks[cell->vertex_index(v)];
+      if (std::find(ranks.begin(), ranks.end(), target_rank) != ranks.end())
+        return true;
+    }
+    return false;
+  };
+  std::vector<unsigned int> cell_target_rank(n_active_cells, 0);
+  std::vector<unsigned int> cell_target_agglomerate(n_active_cells, 0);
+  std::vector<bool> is_remainder(n_active_cells, false);
+  std::vector<std::map<unsigned int, unsigned int>> remainder_n_faces(
+      _n_agglomerates + 1);
+  for (auto cell : _dof_handler.active_cell_iterators())
+  {
+    if ((cell->is_locally_owned() == false) ||
+        (target_ranks[cell->user_index()] == 0))
+      continue;
+    unsigned int const agglomerate = cell->user_index();
+    unsigned int const i = cell->active_cell_index();
+    if (is_visible(cell, target_ranks[agglomerate] - 1))
+    {
+      cell_target_rank[i] = target_ranks[agglomerate];
+      cell_target_agglomerate[i] = target_agglomerates[agglomerate];
+      continue;
+    }
+    is_remainder[i] = true;
+    for (unsigned int f = 0; f < dealii::GeometryInfo<dim>::faces_per_cell;
+         ++f)
+    {
+      if ((cell->at_boundary(f) == true) ||
+          (cell->neighbor(f)->has_children() == true))
+        continue;
+      auto const neighbor = cell->neighbor(f);
+      if (neighbor->is_locally_owned() &&
+          (target_ranks[neighbor->user_index()] == 0))
+        ++remainder_n_faces[agglomerate][neighbor->user_index()];
+    }
+  }
+  std::vector<unsigned int> remainder_agglomerates(_n_agglomerates + 1, 0);
+  for (unsigned int agglomerate = 1; agglomerate <= _n_agglomerates;
+       ++agglomerate)
+  {
+    unsigned int max_n_faces = 0;
+    for (auto const &n_faces : remainder_n_faces[agglomerate])
+      if (n_faces.second > max_n_faces)
+      {
+        remainder_agglomerates[agglomerate] = n_faces.first;
+        max_n_faces = n_faces.second;
+      }
+  }
+
+  // Send the decisions to the ghost cells. The cells that are given to another
+  // processor get a user_index of zero and the ghost cells that are received
+  // get the ID of the agglomerate they are merged with. The remaining cells of
+  // a merged agglomerate keep their agglomerate if it has no local neighbor.
+  exchange(cell_target_rank);
+  exchange(cell_target_agglomerate);
+  unsigned int const rank = dealii::Utilities::MPI::this_mpi_process(comm);
+  for (auto cell : _dof_handler.active_cell_iterators())
+  {
+    unsigned int const i = cell->active_cell_index();
+    if (cell->is_locally_owned() && (cell_target_rank[i] != 0))
+      cell->set_user_index(0);
+    else if (is_remainder[i] &&
+             (remainder_agglomerates[cell->user_index()] != 0))
+      cell->set_user_index(remainder_agglomerates[cell->user_index()]);
+    else if (cell->is_ghost() && (cell_target_rank[i] == rank + 1))
+      cell->set_user_index(cell_target_agglomerate[i]);
+  }
+
+  // The agglomerates that have been merged are now empty so the IDs are made
+  // consecutive again
+  std::vector<unsigned int> new_ids(_n_agglomerates + 1, 0);
+  for (auto cell : _dof_handler.active_cell_iterators())
+    new_ids[cell->user_index()] = 1;
+  new_ids[0] = 0;
+  std::partial_sum(new_ids.begin(), new_ids.end(), new_ids.begin());
+  for (auto cell : _dof_handler.active_cell_iterators())
+    if (cell->user_index() > 0)
+      cell->set_user_index(new_ids[cell->user_index()]);
+  _n_agglomerates = new_ids.back();
 }
 
 template <int dim, typename VectorType>
@@ -89,63 +511,118 @@ std::pair<std::vector<std::vector<unsigned int>>,
           std::vector<std::vector<unsigned int>>>
 AMGe<dim, VectorType>::build_boundary_agglomerates() const
 {
-  auto filtered_iterators_range =
-      filter_iterators(_dof_handler.active_cell_iterators(),
-                       dealii::IteratorFilters::LocallyOwnedCell());
-  std::vector<std::set<unsigned int>> agg_cell_set(_n_agglomerates);
-  for (auto cell : filtered_iterators_range)
+  ASSERT_THROW(_across_ranks == false,
+               "Boundary agglomerates are not supported when the "
+               "agglomerates span several processors");
+
+  unsigned int constexpr vertices_per_cell =
+      dealii::GeometryInfo<dim>::vertices_per_cell;
+  auto const &triangulation = _dof_handler.get_triangulation();
+  unsigned int const n_active_cells = triangulation.n_active_cells();
+  unsigned int const n_vertices = triangulation.n_vertices();
+
+  // Store the agglomerate and the vertices of every active cell. The
+  // user_index 0 is reserved for ghost and artificial cells so the cells of
+  // the i-th agglomerate are in [agglomerate_offsets[i],
+  // agglomerate_offsets[i+1]) of agglomerate_cells.
+  std::vector<unsigned int> cell_agglomerate(n_active_cells, 0);
+  std::vector<unsigned int> cell_vertices(n_active_cells * vertices_per_cell);
+  std::vector<unsigned int> agglomerate_offsets(_n_agglomerates + 1, 0);
+  for (auto cell : _dof_handler.active_cell_iterators())
   {
-    // The cell used_index 0 is reserved for artificial cell however to fill in
-    // the vector we need to decrease the user_index by one to make sure that we
-    // start filling the vector from the beginning.
-    unsigned int const agg_index = cell->user_index() - 1;
     unsigned int const active_cell_index = cell->active_cell_index();
-    agg_cell_set[agg_index].insert(active_cell_index);
+    if (cell->is_locally_owned())
+    {
+      cell_agglomerate[active_cell_index] = cell->user_index();
+      ++agglomerate_offsets[cell->user_index()];
+    }
+    for (unsigned int v = 0; v < vertices_per_cell; ++v)
+      cell_vertices[active_cell_index * vertices_per_cell + v] =
+          cell->vertex_index(v);
   }
+  std::partial_sum(agglomerate_offsets.begin(), agglomerate_offsets.end(),
+                   agglomerate_offsets.begin());
+  std::vector<unsigned int> agglomerate_cells(agglomerate_offsets.back());
+  std::vector<unsigned int> agglomerate_position(agglomerate_offsets);
+  for (unsigned int i = 0; i < n_active_cells; ++i)
+    if (cell_agglomerate[i] > 0)
+    {
+      agglomerate_cells[agglomerate_position[cell_agglomerate[i] - 1]] = i;
+      ++agglomerate_position[cell_agglomerate[i] - 1];
+    }
 
-  dealii::DynamicSparsityPattern connectivity;
-  dealii::GridTools::get_vertex_connectivity_of_cells(
-      _dof_handler.get_triangulation(), connectivity);
+  // Build the vertex to cells map in compressed row storage. Two cells are
+  // connected if they share a vertex.
+  std::vector<unsigned int> vertex_offsets(n_vertices + 1, 0);
+  for (auto const vertex : cell_vertices)
+    ++vertex_offsets[vertex + 1];
+  std::partial_sum(vertex_offsets.begin(), vertex_offsets.end(),
+                   vertex_offsets.begin());
+  std::vector<unsigned int> vertex_cells(vertex_offsets.back());
+  std::vector<unsigned int> vertex_position(vertex_offsets);
+  for (unsigned int i = 0; i < n_active_cells; ++i)
+    for (unsigned int v = 0; v < vertices_per_cell; ++v)
+    {
+      unsigned int const vertex = cell_vertices[i * vertices_per_cell + v];
+      vertex_cells[vertex_position[vertex]] = i;
+      ++vertex_position[vertex];
+    }
+
+  // A vertex is on the boundary of an agglomerate if the cells that share it
+  // do not all belong to the same agglomerate. Only the cells that touch such
+  // a vertex need to look at their neighbors.
+  std::vector<bool> boundary_vertex(n_vertices, false);
+  for (unsigned int vertex = 0; vertex < n_vertices; ++vertex)
+    for (unsigned int j = vertex_offsets[vertex] + 1;
+         j < vertex_offsets[vertex + 1]; ++j)
+      if (cell_agglomerate[vertex_cells[j]] !=
+          cell_agglomerate[vertex_cells[vertex_offsets[vertex]]])
+      {
+        boundary_vertex[vertex] = true;
+        break;
+      }
 
-  // TODO do this using multithreading. Maybe it's better to do everything in
-  // the following for loop
   // Each agglomerate will create two new agglomerates: one composed of the
   // cells of the agglomerate which are on the boundary with another agglomerate
   // and another one composed of cells on other agglomerates that share a
-  // boundary with the current agglomerate
-  std::vector<std::vector<unsigned int>> interior_agglomerates;
-  std::vector<std::vector<unsigned int>> halo_agglomerates;
-  for (auto const &agg_cell : agg_cell_set)
-  {
-    std::vector<unsigned int> interior_boundary_cells;
-    std::set<unsigned int> halo_cells_in_agg;
-    for (auto const &agg_cell_it : agg_cell)
-    {
-      bool cell_in_agg = false;
-      // Get the connectivity for the current cell
-      auto connectivity_begin = connectivity.begin(agg_cell_it);
-      auto connectivity_end = connectivity.end(agg_cell_it);
-      for (auto connectivity_it = connectivity_begin;
-           connectivity_it != connectivity_end; ++connectivity_it)
-      {
-        // Cells that are on the boundary of agglomerates and have in their
-        // connectivity cells that are not part of the agglomerates
-        if (agg_cell.count(connectivity_it->column()) == 0)
+  // boundary with the current agglomerate. The agglomerates are independent
+  // so this is done in parallel.
+  std::vector<std::vector<unsigned int>> interior_agglomerates(_n_agglomerates);
+  std::vector<std::vector<unsigned int>> halo_agglomerates(_n_agglomerates);
+  dealii::parallel::apply_to_subranges(
+      0U, _n_agglomerates,
+      [&](unsigned int const begin, unsigned int const end) {
+        for (unsigned int i = begin; i < end; ++i)
         {
-          if (cell_in_agg == false)
+          unsigned int const agglomerate_id = i + 1;
+          auto &interior_boundary_cells = interior_agglomerates[i];
+          auto &halo_cells = halo_agglomerates[i];
+          for (unsigned int k = agglomerate_offsets[i];
+               k < agglomerate_offsets[i + 1]; ++k)
           {
-            interior_boundary_cells.push_back(agg_cell_it);
-            cell_in_agg = true;
+            unsigned int const cell = agglomerate_cells[k];
+            bool cell_on_boundary = false;
+            for (unsigned int v = 0; v < vertices_per_cell; ++v)
+            {
+              unsigned int const vertex =
+                  cell_vertices[cell * vertices_per_cell + v];
+              if (boundary_vertex[vertex] == false)
+                continue;
+              cell_on_boundary = true;
+              for (unsigned int j = vertex_offsets[vertex];
+                   j < vertex_offsets[vertex + 1]; ++j)
+                if (cell_agglomerate[vertex_cells[j]] != agglomerate_id)
+                  halo_cells.push_back(vertex_cells[j]);
+            }
+            if (cell_on_boundary == true)
+              interior_boundary_cells.push_back(cell);
           }
-          halo_cells_in_agg.insert(connectivity_it->column());
+          std::sort(halo_cells.begin(), halo_cells.end());
+          halo_cells.erase(std::unique(halo_cells.begin(), halo_cells.end()),
+                           halo_cells.end());
         }
-      }
-    }
-
-    interior_agglomerates.emplace_back(interior_boundary_cells);
-    halo_agglomerates.emplace_back(halo_cells_in_agg.begin(),
-                                   halo_cells_in_agg.end());
-  }
+      },
+      1);
 
   return {interior_agglomerates, halo_agglomerates};
 }
@@ -224,6 +701,68 @@ AMGe<dim, VectorType>::compute_dof_index_map(
   return dof_indices;
 }
 
+template <int dim, typename VectorType>
+std::vector<std::vector<dealii::types::global_dof_index>>
+AMGe<dim, VectorType>::compute_agglomerate_dof_indices(
+    std::vector<std::vector<unsigned int>> const &halo_agglomerates) const
+{
+  ASSERT_THROW(_across_ranks == false,
+               "The agglomerate smoother is not supported when the "
+               "agglomerates span several processors");
+
+  dealii::IndexSet const &locally_owned_dofs =
+      _dof_handler.locally_owned_dofs();
+  unsigned int const dofs_per_cell = _dof_handler.get_fe().dofs_per_cell;
+  std::vector<dealii::types::global_dof_index> cell_dof_indices(dofs_per_cell);
+  std::vector<std::set<dealii::types::global_dof_index>> agg_dof_set(
+      _n_agglomerates);
+
+  auto filtered_iterators_range =
+      filter_iterators(_dof_handler.active_cell_iterators(),
+                       dealii::IteratorFilters::LocallyOwnedCell());
+  for (auto cell : filtered_iterators_range)
+  {
+    cell->get_dof_indices(cell_dof_indices);
+    auto &dof_set = agg_dof_set[cell->user_index() - 1];
+    for (auto const dof : cell_dof_indices)
+      if (locally_owned_dofs.is_element(dof))
+        dof_set.insert(dof);
+  }
+
+  // The halo cells are given by their active cell indices so the iterators
+  // are looked up directly instead of walking the cells for every agglomerate
+  std::vector<typename dealii::DoFHandler<dim>::active_cell_iterator>
+      active_cells;
+  if (!halo_agglomerates.empty())
+  {
+    active_cells.resize(_dof_handler.get_triangulation().n_active_cells());
+    for (auto cell : _dof_handler.active_cell_iterators())
+      active_cells[cell->active_cell_index()] = cell;
+  }
+  for (unsigned int i = 0; i < halo_agglomerates.size(); ++i)
+  {
+    for (auto const cell_index : halo_agglomerates[i])
+    {
+      auto const &cell = active_cells[cell_index];
+      // The halo cells may be owned by other processors. We can only get the
+      // DoFs of the ghost cells.
+      if (cell->is_artificial())
+        continue;
+      cell->get_dof_indices(cell_dof_indices);
+      for (auto const dof : cell_dof_indices)
+        if (locally_owned_dofs.is_element(dof))
+          agg_dof_set[i].insert(dof);
+    }
+  }
+
+  std::vector<std::vector<dealii::types::global_dof_index>> agg_dof_indices;
+  agg_dof_indices.reserve(_n_agglomerates);
+  for (auto const &dof_set : agg_dof_set)
+    agg_dof_indices.emplace_back(dof_set.begin(), dof_set.end());
+
+  return agg_dof_indices;
+}
+
 template <int dim, typename VectorType>
 void AMGe<dim, VectorType>::output(std::string const &filename) const
 {
@@ -281,47 +820,10 @@ void AMGe<dim, VectorType>::compute_restriction_sparse_matrix(
         typename VectorType::value_type> const &locally_relevant_global_diag,
     dealii::TrilinosWrappers::SparseMatrix &restriction_sparse_matrix) const
 {
-  // Compute the sparsity pattern (Epetra_FECrsGraph)
-  dealii::TrilinosWrappers::SparsityPattern restriction_sp =
-      compute_restriction_sparsity_pattern(eigenvectors, dof_indices_maps,
-                                           n_local_eigenvectors);
-
-  // Build the restriction sparse matrix
-  restriction_sparse_matrix.reinit(restriction_sp);
-  std::pair<dealii::types::global_dof_index,
-            dealii::types::global_dof_index> const local_range =
-      restriction_sp.local_range();
-  unsigned int const n_agglomerates = n_local_eigenvectors.size();
-  unsigned int pos = 0;
-  ASSERT(n_agglomerates == dof_indices_maps.size(),
-         "dof_indices_maps has the wrong size: " +
-             std::to_string(dof_indices_maps.size()) + " instead of " +
-             std::to_string(n_agglomerates));
-  for (unsigned int i = 0; i < n_agglomerates; ++i)
-  {
-    unsigned int const n_local_eig = n_local_eigenvectors[i];
-    for (unsigned int k = 0; k < n_local_eig; ++k)
-    {
-      unsigned int const n_elem = eigenvectors[pos].size();
-      ASSERT(n_elem == dof_indices_maps[i].size(),
-             "dof_indices_maps[i] has the wrong size: " +
-                 std::to_string(dof_indices_maps[i].size()) + " instead of " +
-                 std::to_string(n_elem));
-      for (unsigned int j = 0; j < n_elem; ++j)
-      {
-        dealii::types::global_dof_index const global_pos =
-            dof_indices_maps[i][j];
-        restriction_sparse_matrix.add(
-            local_range.first + pos, global_pos,
-            diag_elements[i][j] / locally_relevant_global_diag[global_pos] *
-                eigenvectors[pos][j]);
-      }
-      ++pos;
-    }
-  }
-
-  // Compress the matrix
-  restriction_sparse_matrix.compress(dealii::VectorOperation::add);
+  assemble_restriction_sparse_matrix(
+      _comm, _dof_handler.locally_owned_dofs(), eigenvectors, diag_elements,
+      dof_indices_maps, n_local_eigenvectors, locally_relevant_global_diag,
+      restriction_sparse_matrix);
 }
 
 template <int dim, typename VectorType>
@@ -498,6 +1000,50 @@ unsigned int AMGe<dim, VectorType>::build_agglomerates_block(
   return _n_agglomerates;
 }
 
+template <int dim, typename VectorType>
+unsigned int AMGe<dim, VectorType>::build_agglomerates_space_filling_curve(
+    std::string const &curve_type, unsigned int agglomerate_size) const
+{
+  ASSERT_THROW(agglomerate_size > 0,
+               "The size of the agglomerates must be positive");
+
+  std::vector<typename dealii::DoFHandler<dim>::active_cell_iterator> cells;
+  std::vector<dealii::Point<dim>> centers;
+  for (auto cell :
+       dealii::filter_iterators(_dof_handler.active_cell_iterators(),
+                                dealii::IteratorFilters::LocallyOwnedCell()))
+  {
+    cells.push_back(cell);
+    centers.push_back(cell->center());
+  }
+  unsigned int const n_cells = cells.size();
+  if (n_cells == 0)
+  {
+    _n_agglomerates = 0;
+    return _n_agglomerates;
+  }
+
+  std::vector<unsigned int> const order =
+      space_filling_curve_order(curve_type, centers);
+
+  // Cut the curve in pieces. If the last piece is less than half the desired
+  // size, it is merged with the previous one. The lowest agglomerate ID is one
+  // because zero is reserved for ghost and artificial cells.
+  unsigned int n_agglomerates =
+      (n_cells + agglomerate_size - 1) / agglomerate_size;
+  unsigned int const remainder = n_cells % agglomerate_size;
+  if ((n_agglomerates > 1) && (remainder != 0) &&
+      (remainder < agglomerate_size / 2))
+    --n_agglomerates;
+  for (unsigned int i = 0; i < n_cells; ++i)
+    cells[order[i]]->set_user_index(
+        std::min(i / agglomerate_size, n_agglomerates - 1) + 1);
+
+  _n_agglomerates = n_agglomerates;
+
+  return _n_agglomerates;
+}
+
 template <int dim, typename VectorType>
 unsigned int AMGe<dim, VectorType>::build_agglomerates_partitioner(
     std::string const &partitioner_type, unsigned int n_agglomerates) const
@@ -508,50 +1054,70 @@ unsigned int AMGe<dim, VectorType>::build_agglomerates_partitioner(
   // Instead, we create the connectivity graph ourselves and then, we do the
   // partitioning.
 
-  unsigned int const n_local_cells =
-      _dof_handler.get_triangulation().n_active_cells();
-
-  // Create the DynamicSparsityPattern
-  dealii::DynamicSparsityPattern connectivity(n_local_cells);
-
-  // Associate a local index to each cell
-  unsigned int local_index = 0;
-  std::map<std::pair<unsigned int, unsigned int>, unsigned int> index_map;
+  // Associate a local index to each locally owned cell. The ghost and
+  // artificial cells keep an invalid index.
+  unsigned int const invalid_index = std::numeric_limits<unsigned int>::max();
+  std::vector<unsigned int> local_index(
+      _dof_handler.get_triangulation().n_active_cells(), invalid_index);
+  unsigned int n_local_cells = 0;
   for (auto cell : _dof_handler.active_cell_iterators())
   {
     if (cell->is_locally_owned())
     {
-      index_map[std::make_pair(cell->level(), cell->index())] = local_index;
-      ++local_index;
+      local_index[cell->active_cell_index()] = n_local_cells;
+      ++n_local_cells;
     }
   }
 
-  // Fill the dynamic connectivity sparsity pattern
+  // Build the connectivity graph in compressed row storage. Every row lists
+  // the cell itself and the locally owned cells that share a face with it. If
+  // the neighbor is refined, the cell is connected to the children adjacent to
+  // the face so that the graph is symmetric without adding the entries of
+  // other rows. Faces between cells whose levels differ by more than one are
+  // ignored.
+  std::vector<unsigned int> row_lengths(n_local_cells, 0);
+  std::vector<unsigned int> column_indices;
+  column_indices.reserve(n_local_cells *
+                         (dealii::GeometryInfo<dim>::faces_per_cell + 1));
+  auto add_neighbor = [&](auto const &neighbor) {
+    if ((neighbor->has_children() == false) &&
+        (neighbor->is_locally_owned() == true))
+      column_indices.push_back(local_index[neighbor->active_cell_index()]);
+  };
   for (auto cell : _dof_handler.active_cell_iterators())
   {
     if (cell->is_locally_owned())
     {
-      unsigned int const index =
-          index_map.at(std::make_pair(cell->level(), cell->index()));
-      connectivity.add(index, index);
+      unsigned int const index = local_index[cell->active_cell_index()];
+      unsigned int const row_begin = column_indices.size();
+      column_indices.push_back(index);
       for (unsigned int f = 0; f < dealii::GeometryInfo<dim>::faces_per_cell;
            ++f)
       {
-        if ((cell->at_boundary(f) == false) &&
-            (cell->neighbor(f)->is_locally_owned() == true) &&
-            (cell->neighbor(f)->has_children() == false))
+        if (cell->at_boundary(f) == true)
+          continue;
+        auto const neighbor = cell->neighbor(f);
+        if (neighbor->has_children() == true)
         {
-          unsigned int const neighbor_index = index_map.at(std::make_pair(
-              cell->neighbor(f)->level(), cell->neighbor(f)->index()));
-          connectivity.add(index, neighbor_index);
-          connectivity.add(neighbor_index, index);
+          for (unsigned int c = 0; c < cell->face(f)->n_children(); ++c)
+            add_neighbor(cell->neighbor_child_on_subface(f, c));
         }
+        else if (neighbor->level() + 1 >= cell->level())
+          add_neighbor(neighbor);
       }
+      row_lengths[index] = column_indices.size() - row_begin;
     }
   }
 
-  dealii::SparsityPattern cell_connectivity;
-  cell_connectivity.copy_from(connectivity);
+  dealii::SparsityPattern cell_connectivity(n_local_cells, n_local_cells,
+                                            row_lengths);
+  auto row_begin = column_indices.cbegin();
+  for (unsigned int i = 0; i < n_local_cells; ++i)
+  {
+    cell_connectivity.add_entries(i, row_begin, row_begin + row_lengths[i]);
+    row_begin += row_lengths[i];
+  }
+  cell_connectivity.compress();
 
   // Partition the connection graph
   dealii::SparsityTools::Partitioner partitioner;
@@ -565,29 +1131,27 @@ unsigned int AMGe<dim, VectorType>::build_agglomerates_partitioner(
 
   // Assign the agglomerate ID to all the locally owned cells. Zoltan does not
   // guarantee that the agglomerate IDs will consecutive so we need to
-  // renumber them. The lowest agglomerate ID is one because zero is reserved
-  // for ghost and artificial cells.
+  // renumber them in the order in which they are first encountered. The
+  // lowest agglomerate ID is one because zero is reserved for ghost and
+  // artificial cells, so zero also marks the partitions not encountered yet.
   unsigned int n_zoltan_agglomerates = 0;
-  std::unordered_map<unsigned int, unsigned int> agglomerate_renumbering;
+  std::vector<unsigned int> agglomerate_renumbering(n_agglomerates, 0);
   for (auto cell : _dof_handler.active_cell_iterators())
   {
     if (cell->is_locally_owned())
     {
-      unsigned int const index =
-          index_map.at(std::make_pair(cell->level(), cell->index()));
-      auto agg_id = agglomerate_renumbering.find(partition_indices[index]);
-      if (agg_id == agglomerate_renumbering.end())
+      unsigned int const partition =
+          partition_indices[local_index[cell->active_cell_index()]];
+      ASSERT(partition < n_agglomerates,
+             "Partition " + std::to_string(partition) + " is out of range");
+      if (agglomerate_renumbering[partition] == 0)
       {
         ++n_zoltan_agglomerates;
-        agglomerate_renumbering[partition_indices[index]] =
-            n_zoltan_agglomerates;
-        cell->set_user_index(n_zoltan_agglomerates);
+        agglomerate_renumbering[partition] = n_zoltan_agglomerates;
       }
-      else
-        cell->set_user_index(agg_id->second);
+      cell->set_user_index(agglomerate_renumbering[partition]);
     }
   }
-
   _n_agglomerates = n_zoltan_agglomerates;
 
   return _n_agglomerates;
@@ -601,45 +1165,9 @@ AMGe<dim, VectorType>::compute_restriction_sparsity_pattern(
         &dof_indices_maps,
     std::vector<unsigned int> const &n_local_eigenvectors) const
 {
-  // Compute the row IndexSet
-  int const n_procs = dealii::Utilities::MPI::n_mpi_processes(this->_comm);
-  int const rank = dealii::Utilities::MPI::this_mpi_process(this->_comm);
-  unsigned int const n_local_rows(eigenvectors.size());
-  std::vector<unsigned int> n_rows_per_proc(n_procs);
-  n_rows_per_proc[rank] = n_local_rows;
-  MPI_Allgather(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, &n_rows_per_proc[0], 1,
-                MPI_UNSIGNED, this->_comm);
-
-  dealii::types::global_dof_index n_total_rows =
-      std::accumulate(n_rows_per_proc.begin(), n_rows_per_proc.end(),
-                      static_cast<dealii::types::global_dof_index>(0));
-  dealii::types::global_dof_index n_rows_before =
-      std::accumulate(n_rows_per_proc.begin(), n_rows_per_proc.begin() + rank,
-                      static_cast<dealii::types::global_dof_index>(0));
-  dealii::IndexSet row_indexset(n_total_rows);
-  row_indexset.add_range(n_rows_before, n_rows_before + n_local_rows);
-  row_indexset.compress();
-
-  // Build the sparsity pattern
-  dealii::TrilinosWrappers::SparsityPattern sp(
-      row_indexset, this->_dof_handler.locally_owned_dofs(), this->_comm);
-
-  unsigned int const n_agglomerates = n_local_eigenvectors.size();
-  unsigned int row = 0;
-  for (unsigned int i = 0; i < n_agglomerates; ++i)
-  {
-    unsigned int const n_local_eig = n_local_eigenvectors[i];
-    for (unsigned int j = 0; j < n_local_eig; ++j)
-    {
-      sp.add_entries(n_rows_before + row, dof_indices_maps[i].begin(),
-                     dof_indices_maps[i].end());
-      ++row;
-    }
-  }
-
-  sp.compress();
-
-  return sp;
+  return build_restriction_sparsity_pattern(
+      _comm, _dof_handler.locally_owned_dofs(), eigenvectors, dof_indices_maps,
+      n_local_eigenvectors);
 }
 
 template <int dim, typename VectorType>
@@ -0,0 +1,104 @@
+/**************************************************************************
+ * Copyright (c) 2017-2019 by the mfmg authors                            *
+ * All rights reserved.                                                   *
+ *                                                                        *
+ * This file is part of the mfmg library. mfmg is distributed under a BSD *
+ * 3-clause license. For the licensing terms see the LICENSE file in the  *
+ * top-level directory                                                    *
+ *                                                                        *
+ * SPDX-License-Identifier: BSD-3-Clause                                  *
+ *************************************************************************/
+
+#ifndef MFMG_EIGENSOLVER_STATISTICS_HPP
+#define MFMG_EIGENSOLVER_STATISTICS_HPP
+
+#include <boost/property_tree/ptree.hpp>
+
+#include <mpi.h>
+
+#include <string>
+#include <vector>
+
+namespace mfmg
+{
+/**
+ * Statistics of the eigensolve of one agglomerate.
+ */
+struct AgglomerateStatistics
+{
+  unsigned int agglomerate_id = 0;
+  unsigned int n_dofs = 0;
+  /**
+   * Number of eigenvectors kept for the agglomerate, i.e., number of coarse
+   * DoFs associated with the agglomerate.
+   */
+  unsigned int n_eigenvectors = 0;
+  /**
+   * Number of iterations of the eigensolver. For the deflated Lanczos, this is
+   * the sum over all the cycles.
+   */
+  unsigned int n_iterations = 0;
+  /**
+   * Number of vectors the agglomerate operator was applied to. For ARPACK,
+   * this is the number of applications of the inverse of the operator.
+   */
+  unsigned int n_operator_applies = 0;
+  /**
+   * Wall time in seconds spent on the agglomerate, including the construction
+   * of its triangulation and the evaluation of its operator.
+   */
+  double wall_time = 0.;
+  /**
+   * Largest residual norm \f$\|A v - \lambda v\| / \|v\|\f$ of the computed
+   * eigenpairs.
+   */
+  double residual = 0.;
+  double min_eigenvalue = 0.;
+  double max_eigenvalue = 0.;
+};
+
+/**
+ * Utilization of the threads that computed the eigenvectors of the
+ * agglomerates of one processor.
+ */
+struct ThreadUtilization
+{
+  unsigned int n_threads = 0;
+  /**
+   * Wall time in seconds between the start of the first eigensolve and the
+   * end of the last one.
+   */
+  double wall_time = 0.;
+  /**
+   * Sum over the threads of the time spent working on agglomerates.
+   */
+  double busy_time = 0.;
+};
+
+/**
+ * Reduce the statistics of the agglomerates of all the processors of \p comm.
+ * For each quantity of AgglomerateStatistics, the summary contains the
+ * minimum, the maximum, the mean, the 50th, 90th, and 99th percentiles, and a
+ * histogram with \p n_bins bins. The summary also contains the distribution of
+ * the total wall time per processor which shows the load imbalance. The
+ * percentiles are estimated from a fine histogram so that the values of the
+ * agglomerates never need to be gathered. This function is collective and
+ * returns the same summary on all the processors.
+ */
+boost::property_tree::ptree summarize_agglomerate_statistics(
+    MPI_Comm comm, std::string const &eigensolver_type,
+    std::vector<AgglomerateStatistics> const &statistics,
+    unsigned int n_bins = 10);
+
+/**
+ * Reduce the ThreadUtilization of all the processors of \p comm. The summary
+ * contains the number of threads, and the distributions over the processors of
+ * the wall time and of the utilization, i.e., the fraction of the wall time
+ * during which the threads were busy. This function is collective.
+ */
+boost::property_tree::ptree
+summarize_thread_utilization(MPI_Comm comm,
+                             ThreadUtilization const &thread_utilization);
+} // namespace mfmg
+
+#endif
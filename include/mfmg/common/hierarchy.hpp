@@ -14,8 +14,11 @@
 
 #include <mfmg/common/exceptions.hpp>
 #include <mfmg/common/level.hpp>
+#include <mfmg/common/memory.hpp>
 #include <mfmg/common/mesh_evaluator.hpp>
+#include <mfmg/common/tracer.hpp>
 #include <mfmg/common/utils.hpp>
+#include <mfmg/dealii/algebraic_hierarchy_helpers.hpp>
 #include <mfmg/dealii/dealii_hierarchy_helpers.hpp>
 #include <mfmg/dealii/dealii_matrix_free_hierarchy_helpers.hpp>
 #ifdef MFMG_WITH_CUDA
@@ -24,11 +27,14 @@
 #include <mfmg/cuda/cuda_mesh_evaluator.cuh>
 #endif
 
+#include <deal.II/base/mpi.h>
 #include <deal.II/base/timer.h>
 
+#include <boost/property_tree/info_parser.hpp>
 #include <boost/property_tree/ptree.hpp>
 
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace mfmg
@@ -36,6 +42,7 @@ namespace mfmg
 void timer_enter_subsection(std::shared_ptr<dealii::TimerOutput> const &timer,
                             std::string const &section)
 {
+  Tracer::begin(section);
   if (timer)
     timer->enter_subsection(section);
 }
@@ -44,17 +51,22 @@ void timer_leave_subsection(std::shared_ptr<dealii::TimerOutput> const &timer)
 {
   if (timer)
     timer->leave_subsection();
+  Tracer::end();
 }
 
+/**
+ * Create the helpers associated with a mesh evaluator type. This version does
+ * not require a mesh evaluator so it only supports the evaluators which do not
+ * carry any state needed by the helpers. \p dim is ignored by the algebraic
+ * evaluator.
+ */
 template <typename VectorType>
 std::unique_ptr<HierarchyHelpers<VectorType>>
-create_hierarchy_helpers(std::shared_ptr<MeshEvaluator const> evaluator)
+create_hierarchy_helpers(std::string const &evaluator_type, int dim)
 {
   std::unique_ptr<HierarchyHelpers<VectorType>> hierarchy_helpers;
-  std::string evaluator_type = evaluator->get_mesh_evaluator_type();
   if (evaluator_type == "DealIIMeshEvaluator")
   {
-    int const dim = evaluator->get_dim();
     if (dim == 2)
       hierarchy_helpers.reset(new DealIIHierarchyHelpers<2, VectorType>());
     else if (dim == 3)
@@ -64,7 +76,6 @@ create_hierarchy_helpers(std::shared_ptr<MeshEvaluator const> evaluator)
   }
   else if (evaluator_type == "DealIIMatrixFreeMeshEvaluator")
   {
-    int const dim = evaluator->get_dim();
     if (dim == 2)
       hierarchy_helpers.reset(
           new DealIIMatrixFreeHierarchyHelpers<2, VectorType>());
@@ -74,6 +85,30 @@ create_hierarchy_helpers(std::shared_ptr<MeshEvaluator const> evaluator)
     else
       ASSERT_THROW_NOT_IMPLEMENTED();
   }
+  else if (evaluator_type == "AlgebraicMeshEvaluator")
+  {
+    hierarchy_helpers.reset(new AlgebraicHierarchyHelpers<VectorType>());
+  }
+  else
+  {
+    ASSERT_THROW_NOT_IMPLEMENTED();
+  }
+  return hierarchy_helpers;
+}
+
+template <typename VectorType>
+std::unique_ptr<HierarchyHelpers<VectorType>>
+create_hierarchy_helpers(std::shared_ptr<MeshEvaluator const> evaluator)
+{
+  std::unique_ptr<HierarchyHelpers<VectorType>> hierarchy_helpers;
+  std::string evaluator_type = evaluator->get_mesh_evaluator_type();
+  if ((evaluator_type == "DealIIMeshEvaluator") ||
+      (evaluator_type == "DealIIMatrixFreeMeshEvaluator") ||
+      (evaluator_type == "AlgebraicMeshEvaluator"))
+  {
+    hierarchy_helpers = create_hierarchy_helpers<VectorType>(
+        evaluator_type, evaluator->get_dim());
+  }
 #ifdef MFMG_WITH_CUDA
   else if (evaluator_type == "CudaMeshEvaluator")
   {
@@ -159,11 +194,14 @@ public:
   Hierarchy(MPI_Comm comm, std::shared_ptr<MeshEvaluator> evaluator,
             std::shared_ptr<boost::property_tree::ptree> params = nullptr,
             std::shared_ptr<dealii::TimerOutput> timer = nullptr)
-      : _timer(timer)
+      : _comm(comm), _timer(timer), _params(params),
+        _mesh_evaluator_type(evaluator->get_mesh_evaluator_type()),
+        _dim(evaluator->get_dim())
   {
     timer_enter_subsection(_timer, "Setup");
-    // Replace by a factory
-    auto hierarchy_helpers = create_hierarchy_helpers<VectorType>(evaluator);
+    // Replace by a factory. The helpers are kept for rebuild().
+    _hierarchy_helpers = create_hierarchy_helpers<VectorType>(evaluator);
+    auto &hierarchy_helpers = _hierarchy_helpers;
 
     _is_preconditioner = params->get("is preconditioner", true);
     _n_smoothing_steps = params->get("smoother.n_smoothing_steps", 1);
@@ -174,12 +212,35 @@ public:
                            "parameter must be positive");
     _levels.resize(num_levels);
 
+    // Mixed precision: starting from "mixed precision.first level", the
+    // restrictors and the multicolor and agglomerate block Jacobi smoothers
+    // store their data in single precision and so do the level operators used
+    // with these smoothers. The Trilinos and the Chebyshev smoothers keep
+    // referencing the double precision matrix so their level operator stays in
+    // double precision. The vectors are in double precision so the conversion
+    // happens when the data is loaded. The finest level is always in double
+    // precision and so is the operator of the coarsest level which is used by
+    // the coarse solver.
+    int const first_single_precision_level =
+        params->get("mixed precision.first level", num_levels);
+    ASSERT_THROW(first_single_precision_level > 0,
+                 "The finest level cannot use single precision");
+    auto single_precision_params =
+        std::make_shared<boost::property_tree::ptree>(*params);
+    single_precision_params->put("smoother.precision", "single");
+
     _levels[0].set_operator(hierarchy_helpers->get_global_operator(evaluator));
+    // If the high-water mark cannot be reset, the peaks of the phases are the
+    // peaks since the start of the process
+    _statistics.put("peak_memory_per_phase_available",
+                    reset_peak_memory_usage());
     for (int level_index = 0; level_index < num_levels; level_index++)
     {
+      TraceScope level_scope("Setup: level", {{"level", level_index}});
       auto &level_fine = _levels[level_index];
 
       auto a = level_fine.get_operator();
+      level_scope.add_argument("n_rows", a->grid_complexity());
 
       if (level_index == num_levels - 1)
       {
@@ -194,22 +255,36 @@ public:
         auto coarse_solver = hierarchy_helpers->build_coarse_solver(a, params);
         level_fine.set_solver(coarse_solver);
         timer_leave_subsection(_timer);
+        record_peak_memory(level_index, "build_coarse_solver");
 
         break;
       }
 
       auto &level_coarse = _levels[level_index + 1];
 
-      timer_enter_subsection(_timer, "Setup: build smoother");
-      auto smoother = hierarchy_helpers->build_smoother(a, params);
-      level_fine.set_smoother(smoother);
-      timer_leave_subsection(_timer);
-
       timer_enter_subsection(_timer, "Setup: build restrictor");
       auto restrictor =
           hierarchy_helpers->build_restrictor(comm, evaluator, params);
       level_coarse.set_restrictor(restrictor);
+      auto const restrictor_statistics =
+          hierarchy_helpers->get_restrictor_statistics();
+      if (!restrictor_statistics.empty())
+        _statistics.put_child("level_" + std::to_string(level_index) +
+                                  ".restrictor",
+                              restrictor_statistics);
       timer_leave_subsection(_timer);
+      record_peak_memory(level_index, "build_restrictor");
+
+      // The smoother is built after the restrictor because some smoothers
+      // reuse the agglomerates
+      timer_enter_subsection(_timer, "Setup: build smoother");
+      auto smoother = hierarchy_helpers->build_smoother(
+          a, level_index >= first_single_precision_level
+                 ? single_precision_params
+                 : params);
+      level_fine.set_smoother(smoother);
+      timer_leave_subsection(_timer);
+      record_peak_memory(level_index, "build_smoother");
 
       std::shared_ptr<Operator<VectorType>> ap;
       bool fast_ap = params->get("fast_ap", false);
@@ -218,94 +293,280 @@ public:
         timer_enter_subsection(_timer, "Setup: fast_ap");
         ap = hierarchy_helpers->fast_multiply_transpose();
         timer_leave_subsection(_timer);
+        record_peak_memory(level_index, "fast_ap");
       }
       else
       {
         timer_enter_subsection(_timer, "Setup: ap");
         ap = a->multiply_transpose(restrictor);
         timer_leave_subsection(_timer);
+        record_peak_memory(level_index, "ap");
       }
 
       timer_enter_subsection(_timer, "Setup: build coarse matrix");
       auto a_coarse = restrictor->multiply(ap);
       timer_leave_subsection(_timer);
+      record_peak_memory(level_index, "build_coarse_matrix");
 
       level_coarse.set_operator(a_coarse);
+
+      // The matrix-matrix products are done so the operators can now be
+      // converted
+      if (level_index + 1 >= first_single_precision_level)
+      {
+        timer_enter_subsection(_timer, "Setup: convert to single precision");
+        level_coarse.set_restrictor(
+            hierarchy_helpers->build_single_precision_operator(restrictor));
+        // The double precision operator can only be released if the smoother
+        // does not reference it anymore. Otherwise, converting the operator
+        // would only add a copy.
+        if (level_index >= first_single_precision_level)
+        {
+          auto single_precision_a =
+              hierarchy_helpers->build_single_precision_operator(a);
+          if (smoother->replace_operator(single_precision_a))
+            level_fine.set_operator(single_precision_a);
+        }
+        timer_leave_subsection(_timer);
+        record_peak_memory(level_index, "convert_to_single_precision");
+      }
     }
+    record_memory_consumption();
     timer_leave_subsection(_timer);
   }
 
-  void vmult(VectorType &x, VectorType const &b) const
+  /**
+   * Rebuild the hierarchy after the operator changed on the locally owned
+   * cells whose active cell indices are \p changed_cells, e.g., when the
+   * coefficients of a few cells change between two time steps. \p evaluator
+   * must use the same mesh and the same DoFs as the evaluator used to build
+   * the hierarchy. The agglomerates are kept and only the agglomerates that
+   * contain a changed cell are solved again, which skips most of the
+   * eigensolves. Everything else is rebuilt as in the constructor: the fine
+   * operator is assembled again, the restrictor is rescaled, and the smoother,
+   * the coarse operator, and the coarse solver are recomputed, so the cost of
+   * these steps does not depend on the number of changed cells. If no cell
+   * changed on any processor, the hierarchy is left untouched. The hierarchy
+   * needs to be built again instead if the mesh is refined or if an
+   * agglomerate keeps a different number of eigenvectors. Only two-level
+   * hierarchies in double precision built from a DealIIMeshEvaluator can be
+   * rebuilt.
+   */
+  void rebuild(std::shared_ptr<MeshEvaluator> evaluator,
+               std::vector<unsigned int> const &changed_cells)
   {
-    // Apply calls itself recursively which trips the timer so put it here
-    timer_enter_subsection(_timer, "Apply");
-    apply(b, x, 0);
+    ASSERT_THROW(_hierarchy_helpers != nullptr,
+                 "A hierarchy read by load() cannot be rebuilt");
+    ASSERT_THROW(_levels.size() == 2,
+                 "Only two-level hierarchies can be rebuilt");
+    ASSERT_THROW(_params->get("mixed precision.first level", 2) >= 2,
+                 "Mixed-precision hierarchies cannot be rebuilt");
+    if (dealii::Utilities::MPI::max(changed_cells.empty() ? 0 : 1, _comm) == 0)
+      return;
+
+    timer_enter_subsection(_timer, "Rebuild");
+    auto &level_fine = _levels[0];
+    auto &level_coarse = _levels[1];
+
+    timer_enter_subsection(_timer, "Rebuild: operator");
+    level_fine.set_operator(_hierarchy_helpers->get_global_operator(evaluator));
+    auto a = level_fine.get_operator();
+    timer_leave_subsection(_timer);
+
+    timer_enter_subsection(_timer, "Rebuild: restrictor");
+    auto restrictor = level_coarse.get_restrictor();
+    _hierarchy_helpers->update_restrictor(_comm, evaluator, _params,
+                                          changed_cells);
+    auto const restrictor_statistics =
+        _hierarchy_helpers->get_restrictor_statistics();
+    if (!restrictor_statistics.empty())
+      _statistics.put_child("level_0.restrictor_rebuild",
+                            restrictor_statistics);
+    timer_leave_subsection(_timer);
+
+    timer_enter_subsection(_timer, "Rebuild: build smoother");
+    level_fine.set_smoother(_hierarchy_helpers->build_smoother(a, _params));
+    timer_leave_subsection(_timer);
+
+    timer_enter_subsection(_timer, "Rebuild: build coarse matrix");
+    auto a_coarse = restrictor->multiply(a->multiply_transpose(restrictor));
+    level_coarse.set_operator(a_coarse);
+    timer_leave_subsection(_timer);
+
+    timer_enter_subsection(_timer, "Rebuild: build coarse solver");
+    level_coarse.set_solver(
+        _hierarchy_helpers->build_coarse_solver(a_coarse, _params));
+    timer_leave_subsection(_timer);
+
+    record_memory_consumption();
     timer_leave_subsection(_timer);
   }
 
-  void apply(VectorType const &b, VectorType &x, int level_index = 0) const
+  /**
+   * Write the hierarchy to \p directory, which must exist, so that it can be
+   * reloaded with load() instead of being rebuilt. Every processor writes the
+   * locally owned rows of the level operators and of the restrictors, and the
+   * data of its smoothers that cannot be cheaply recomputed. The coarse solver
+   * is not saved. Only the operators assembled by the helpers of a
+   * DealIIMeshEvaluator can be saved, so mixed-precision hierarchies cannot.
+   */
+  void save(std::string const &directory) const
   {
-    auto const num_levels = _levels.size();
+    timer_enter_subsection(_timer, "Save");
+    auto hierarchy_helpers =
+        create_hierarchy_helpers<VectorType>(_mesh_evaluator_type, _dim);
 
-    auto &level_fine = _levels[level_index];
-    auto a = level_fine.get_operator();
-
-    if (level_index > 0 || _is_preconditioner)
+    int const num_levels = _levels.size();
+    unsigned int const rank = dealii::Utilities::MPI::this_mpi_process(_comm);
+    if (rank == 0)
     {
-      // Zero out any garbage in x.
-      // The only exception is when it's the finest level in a standalone
-      // mode.
-      x = 0.;
+      boost::property_tree::ptree info;
+      info.put("n_processes", dealii::Utilities::MPI::n_mpi_processes(_comm));
+      info.put("n_levels", num_levels);
+      info.put("mesh_evaluator_type", _mesh_evaluator_type);
+      info.put("dim", _dim);
+      info.put_child("params", *_params);
+      boost::property_tree::info_parser::write_info(
+          directory + "/hierarchy.info", info);
     }
 
-    if (level_index == num_levels - 1)
+    for (int level_index = 0; level_index < num_levels; ++level_index)
     {
-      timer_enter_subsection(_timer, "Apply: coarsest level");
-      // Coarsest level
-      auto coarse_solver = level_fine.get_solver();
-      coarse_solver->apply(b, x);
-      timer_leave_subsection(_timer);
+      auto const &level = _levels[level_index];
+      std::string const prefix =
+          directory + "/level_" + std::to_string(level_index);
+      hierarchy_helpers->save_operator(level.get_operator(),
+                                       prefix + "_operator");
+      if (level_index > 0)
+        hierarchy_helpers->save_operator(level.get_restrictor(),
+                                         prefix + "_restrictor");
+      if (level_index < num_levels - 1)
+        hierarchy_helpers->save_smoother(
+            level.get_smoother(), prefix + "_smoother." + std::to_string(rank));
     }
-    else
-    {
-      timer_enter_subsection(_timer, "Apply: fine levels");
-      auto &level_coarse = _levels[level_index + 1];
+    timer_leave_subsection(_timer);
+  }
 
-      auto restrictor = level_coarse.get_restrictor();
+  /**
+   * Read a hierarchy written by save(). The operators, the restrictors, and
+   * the expensive part of the smoothers are read from the files while the
+   * coarse solver is rebuilt. The number of processors and the partition of
+   * the operators must be the same as when the hierarchy was saved, otherwise
+   * an exception is thrown.
+   */
+  static Hierarchy<VectorType>
+  load(MPI_Comm comm, std::string const &directory,
+       std::shared_ptr<dealii::TimerOutput> timer = nullptr)
+  {
+    Hierarchy<VectorType> hierarchy;
+    hierarchy._comm = comm;
+    hierarchy._timer = timer;
+    timer_enter_subsection(timer, "Load");
+
+    boost::property_tree::ptree info;
+    boost::property_tree::info_parser::read_info(directory + "/hierarchy.info",
+                                                 info);
+    unsigned int const n_processes = info.get<unsigned int>("n_processes");
+    ASSERT_THROW(n_processes == dealii::Utilities::MPI::n_mpi_processes(comm),
+                 "The hierarchy was saved using " +
+                     std::to_string(n_processes) +
+                     " processors but it is loaded using " +
+                     std::to_string(
+                         dealii::Utilities::MPI::n_mpi_processes(comm)));
+    hierarchy._mesh_evaluator_type =
+        info.get<std::string>("mesh_evaluator_type");
+    hierarchy._dim = info.get<int>("dim");
+    hierarchy._params = std::make_shared<boost::property_tree::ptree>(
+        info.get_child("params"));
+    auto params = hierarchy._params;
+    hierarchy._is_preconditioner = params->get("is preconditioner", true);
+    hierarchy._n_smoothing_steps = params->get("smoother.n_smoothing_steps", 1);
+
+    auto hierarchy_helpers = create_hierarchy_helpers<VectorType>(
+        hierarchy._mesh_evaluator_type, hierarchy._dim);
+
+    int const num_levels = info.get<int>("n_levels");
+    unsigned int const rank = dealii::Utilities::MPI::this_mpi_process(comm);
+    hierarchy._levels.resize(num_levels);
+    for (int level_index = 0; level_index < num_levels; ++level_index)
+    {
+      auto &level = hierarchy._levels[level_index];
+      std::string const prefix =
+          directory + "/level_" + std::to_string(level_index);
+      auto a = hierarchy_helpers->load_operator(comm, prefix + "_operator");
+      level.set_operator(a);
 
-      // apply pre-smoother
-      auto smoother = level_fine.get_smoother();
-      for (unsigned int i = 0; i < _n_smoothing_steps; ++i)
-        smoother->apply(b, x);
+      if (level_index > 0)
+      {
+        auto restrictor =
+            hierarchy_helpers->load_operator(comm, prefix + "_restrictor");
+        // The restrictor maps the fine level to this level so its partition
+        // must match the ones of the operators. The partitions may only
+        // differ on some processors so they agree on the error.
+        auto fine_vector = hierarchy._levels[level_index - 1].build_vector();
+        auto restrictor_domain_vector = restrictor->build_domain_vector();
+        auto restrictor_range_vector = restrictor->build_range_vector();
+        auto range_vector = a->build_range_vector();
+        collective_check(comm, [&]() {
+          ASSERT_THROW(
+              restrictor_domain_vector->locally_owned_elements() ==
+                      fine_vector->locally_owned_elements() &&
+                  restrictor_range_vector->locally_owned_elements() ==
+                      range_vector->locally_owned_elements(),
+              "The partition of the restrictor of level " +
+                  std::to_string(level_index) +
+                  " does not match the partition of the operators");
+        });
+        level.set_restrictor(restrictor);
+      }
 
-      // compute residual
-      // NOTE: we compute negative residual -r = Ax-b, so that we can avoid
-      // using sadd and can just use add
-      auto res = level_fine.build_vector();
-      a->apply(x, *res);
-      res->add(-1., b);
+      if (level_index == num_levels - 1)
+      {
+        timer_enter_subsection(timer, "Load: build coarse solver");
+        level.set_solver(hierarchy_helpers->build_coarse_solver(a, params));
+        timer_leave_subsection(timer);
+      }
+      else
+      {
+        level.set_smoother(hierarchy_helpers->load_smoother(
+            a, params, prefix + "_smoother." + std::to_string(rank)));
+      }
+    }
+    timer_leave_subsection(timer);
 
-      // restrict residual
-      auto b_coarse = level_coarse.build_vector();
-      restrictor->apply(*res, *b_coarse);
+    return hierarchy;
+  }
 
-      // compute coarse grid correction
-      auto x_coarse = level_coarse.build_vector();
-      apply(*b_coarse, *x_coarse, level_index + 1);
+  void vmult(VectorType &x, VectorType const &b) const
+  {
+    // Apply calls itself recursively which trips the timer so put it here
+    timer_enter_subsection(_timer, "Apply");
+    apply(b, x, 0);
+    timer_leave_subsection(_timer);
+  }
 
-      // update solution
-      auto x_correction = level_fine.build_vector();
-      restrictor->apply(*x_coarse, *x_correction, OperatorMode::TRANS);
+  void apply(VectorType const &b, VectorType &x, int level_index = 0) const
+  {
+    cycle(b, x, level_index);
+  }
 
-      // NOTE: as we used negative residual, we subtract instead of adding
-      // here
-      x.add(-1., *x_correction);
+  /**
+   * Apply the hierarchy to several right-hand sides at once. All the
+   * right-hand sides go through the cycle together so that the operators, the
+   * restrictors, and the coarse factorization are read once per cycle instead
+   * of once per right-hand side.
+   */
+  void vmult(MultiVector<VectorType> &x, MultiVector<VectorType> const &b) const
+  {
+    timer_enter_subsection(_timer, "Apply");
+    apply_multivector(b, x, 0);
+    timer_leave_subsection(_timer);
+  }
 
-      // apply post-smoother
-      for (unsigned int i = 0; i < _n_smoothing_steps; ++i)
-        smoother->apply(b, x);
-      timer_leave_subsection(_timer);
-    }
+  void apply_multivector(MultiVector<VectorType> const &b,
+                         MultiVector<VectorType> &x, int level_index = 0) const
+  {
+    cycle(b, x, level_index);
   }
 
   double grid_complexity() const
@@ -365,11 +626,237 @@ public:
     return 0;
   }
 
+  /**
+   * Return the statistics collected during the setup. For instance,
+   * level_<i>.restrictor.eigensolver contains the statistics of the
+   * eigensolves of the agglomerates used to build the restrictor of level i,
+   * level_<i>.restrictor.threads the utilization of the threads during these
+   * eigensolves, level_<i>.memory the memory used by the operator, the
+   * restrictor, the smoother, and the solver of level i, and
+   * level_<i>.peak_memory the peak resident set size reached during each
+   * phase of the setup of level i. peak_memory_per_phase_available is false if
+   * the operating system cannot reset the high-water mark, in which case the
+   * peaks are the peaks since the start of the process. If the size of the
+   * data of the coarse solver is unknown, level_<i>.memory.solver_rss_delta
+   * replaces level_<i>.memory.solver and contains the growth of the resident
+   * set size during the setup of the solver. The memory is in bytes and is
+   * summarized over the processors. After rebuild(),
+   * level_0.restrictor_rebuild contains the statistics of the agglomerates
+   * which have been solved again.
+   */
+  boost::property_tree::ptree const &get_statistics() const
+  {
+    return _statistics;
+  }
+
 private:
+  /**
+   * Constructor used by load().
+   */
+  Hierarchy() = default;
+
+  /**
+   * V-cycle shared by apply() and apply_multivector(). \p V is either
+   * VectorType or MultiVector<VectorType>, the overloads below select the
+   * corresponding operations.
+   */
+  template <typename V>
+  void cycle(V const &b, V &x, int level_index) const
+  {
+    auto const num_levels = _levels.size();
+    int const n_b = n_vectors(b);
+    TraceScope level_scope("Apply: level",
+                           {{"level", level_index}, {"n_vectors", n_b}});
+
+    auto &level_fine = _levels[level_index];
+    auto a = level_fine.get_operator();
+
+    bool const zero_initial_guess = (level_index > 0 || _is_preconditioner);
+    if (zero_initial_guess)
+    {
+      // Zero out any garbage in x.
+      // The only exception is when it's the finest level in a standalone
+      // mode.
+      set_zero(x);
+    }
+
+    if (level_index == num_levels - 1)
+    {
+      timer_enter_subsection(_timer, "Apply: coarsest level");
+      // Coarsest level
+      auto coarse_solver = level_fine.get_solver();
+      apply_to(*coarse_solver, b, x);
+      timer_leave_subsection(_timer);
+    }
+    else
+    {
+      timer_enter_subsection(_timer, "Apply: fine levels");
+      auto &level_coarse = _levels[level_index + 1];
+
+      auto restrictor = level_coarse.get_restrictor();
+
+      // apply pre-smoother. When x is known to be zero, the first sweep does
+      // not need to compute the residual.
+      auto smoother = level_fine.get_smoother();
+      {
+        TraceScope scope("Apply: pre-smoothing");
+        for (unsigned int i = 0; i < _n_smoothing_steps; ++i)
+          apply_to(*smoother, b, x, zero_initial_guess && (i == 0));
+      }
+
+      // compute residual
+      // NOTE: we compute negative residual -r = Ax-b, so that we can avoid
+      // using sadd and can just use add
+      auto res = build(level_fine, b);
+      {
+        TraceScope scope("Apply: residual");
+        apply_to(*a, x, *res);
+        subtract(*res, b);
+      }
+
+      // restrict residual
+      auto b_coarse = build(level_coarse, b);
+      {
+        TraceScope scope("Apply: restriction");
+        apply_to(*restrictor, *res, *b_coarse);
+      }
+
+      // compute coarse grid correction
+      auto x_coarse = build(level_coarse, b);
+      cycle(*b_coarse, *x_coarse, level_index + 1);
+
+      // update solution
+      auto x_correction = build(level_fine, b);
+      {
+        TraceScope scope("Apply: prolongation");
+        apply_to(*restrictor, *x_coarse, *x_correction, OperatorMode::TRANS);
+      }
+
+      // NOTE: as we used negative residual, we subtract instead of adding
+      // here
+      subtract(x, *x_correction);
+
+      // apply post-smoother
+      {
+        TraceScope scope("Apply: post-smoothing");
+        for (unsigned int i = 0; i < _n_smoothing_steps; ++i)
+          apply_to(*smoother, b, x);
+      }
+      timer_leave_subsection(_timer);
+    }
+  }
+
+  static int n_vectors(VectorType const &) { return 1; }
+
+  static int n_vectors(MultiVector<VectorType> const &b)
+  {
+    return b.n_vectors();
+  }
+
+  static void set_zero(VectorType &x) { x = 0.; }
+
+  static void set_zero(MultiVector<VectorType> &x)
+  {
+    for (int i = 0; i < x.n_vectors(); ++i)
+      *x[i] = 0.;
+  }
+
+  static void subtract(VectorType &x, VectorType const &y) { x.add(-1., y); }
+
+  static void subtract(MultiVector<VectorType> &x,
+                       MultiVector<VectorType> const &y)
+  {
+    for (int i = 0; i < x.n_vectors(); ++i)
+      x[i]->add(-1., *y[i]);
+  }
+
+  static std::shared_ptr<VectorType> build(Level<VectorType> const &level,
+                                           VectorType const &)
+  {
+    return level.build_vector();
+  }
+
+  static std::shared_ptr<MultiVector<VectorType>>
+  build(Level<VectorType> const &level, MultiVector<VectorType> const &b)
+  {
+    return level.build_multivector(b.n_vectors());
+  }
+
+  template <typename Op, typename... Args>
+  static void apply_to(Op const &op, VectorType const &x, VectorType &y,
+                       Args... args)
+  {
+    op.apply(x, y, args...);
+  }
+
+  template <typename Op, typename... Args>
+  static void apply_to(Op const &op, MultiVector<VectorType> const &x,
+                       MultiVector<VectorType> &y, Args... args)
+  {
+    op.apply_multivector(x, y, args...);
+  }
+
+  /**
+   * Record the high-water mark of the resident set size reached during \p
+   * phase of the setup of level \p level_index and reset it for the next
+   * phase.
+   */
+  void record_peak_memory(int level_index, std::string const &phase)
+  {
+    _statistics.put_child("level_" + std::to_string(level_index) +
+                              ".peak_memory." + phase,
+                          summarize_memory(_comm, get_memory_usage().peak));
+    reset_peak_memory_usage();
+  }
+
+  /**
+   * Record the memory used by the operators, the smoothers, and the solver of
+   * every level.
+   */
+  void record_memory_consumption()
+  {
+    for (unsigned int i = 0; i < _levels.size(); ++i)
+    {
+      auto const &level = _levels[i];
+      std::string const prefix = "level_" + std::to_string(i) + ".memory.";
+      if (auto const a = level.get_operator())
+        _statistics.put_child(prefix + "operator",
+                              summarize_memory(_comm, a->memory_consumption()));
+      if (auto const restrictor = level.get_restrictor())
+        _statistics.put_child(
+            prefix + "restrictor",
+            summarize_memory(_comm, restrictor->memory_consumption()));
+      if (auto const smoother = level.get_smoother())
+        _statistics.put_child(
+            prefix + "smoother",
+            summarize_memory(_comm, smoother->memory_consumption()));
+      if (auto const solver = level.get_solver())
+        _statistics.put_child(
+            prefix + (solver->memory_consumption_is_rss_delta()
+                          ? "solver_rss_delta"
+                          : "solver"),
+            summarize_memory(_comm, solver->memory_consumption()));
+    }
+  }
+
+  MPI_Comm _comm;
   std::shared_ptr<dealii::TimerOutput> _timer;
+  std::shared_ptr<boost::property_tree::ptree> _params;
+  /**
+   * Type and dimension of the mesh evaluator used to create the hierarchy
+   * helpers in save() and load().
+   */
+  std::string _mesh_evaluator_type;
+  int _dim;
+  /**
+   * Helpers used to build the hierarchy. They keep the data of the restrictor
+   * needed by rebuild(). They are not set by load().
+   */
+  std::shared_ptr<HierarchyHelpers<VectorType>> _hierarchy_helpers;
   std::vector<Level<VectorType>> _levels;
   bool _is_preconditioner = true;
   unsigned int _n_smoothing_steps;
+  boost::property_tree::ptree _statistics;
 };
 } // namespace mfmg
 
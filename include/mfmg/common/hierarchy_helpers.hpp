@@ -21,6 +21,8 @@
 #include <boost/property_tree/ptree.hpp>
 
 #include <memory>
+#include <string>
+#include <vector>
 
 #include <mpi.h>
 
@@ -41,6 +43,36 @@ public:
       MPI_Comm comm, std::shared_ptr<MeshEvaluator> mesh_evaluator,
       std::shared_ptr<boost::property_tree::ptree const> params) = 0;
 
+  /**
+   * Return the statistics collected by the last call to build_restrictor(),
+   * e.g., the statistics of the eigensolves of the agglomerates. The default
+   * implementation does not collect any statistics.
+   */
+  virtual boost::property_tree::ptree get_restrictor_statistics() const
+  {
+    return boost::property_tree::ptree();
+  }
+
+  /**
+   * Update in place the restrictor built by the last call to
+   * build_restrictor() after the operator changed on the locally owned cells
+   * whose active cell indices are \p changed_cells. The mesh and the
+   * agglomerates must be unchanged. The statistics of the update replace the
+   * ones returned by get_restrictor_statistics().
+   */
+  virtual void update_restrictor(
+      MPI_Comm /*comm*/, std::shared_ptr<MeshEvaluator> /*mesh_evaluator*/,
+      std::shared_ptr<boost::property_tree::ptree const> /*params*/,
+      std::vector<unsigned int> const & /*changed_cells*/)
+  {
+    ASSERT_THROW_NOT_IMPLEMENTED();
+  }
+
+  /**
+   * Return the product of the operator and of the transpose of the restrictor
+   * computed by the last call to build_restrictor() when "fast_ap" is set. The
+   * helpers release the product so it can only be retrieved once.
+   */
   virtual std::shared_ptr<Operator<vector_type>> fast_multiply_transpose()
   {
     ASSERT_THROW_NOT_IMPLEMENTED();
@@ -48,6 +80,19 @@ public:
     return nullptr;
   }
 
+  /**
+   * Return an operator equivalent to \p op which stores its data in single
+   * precision. This is used for the levels of a mixed-precision hierarchy.
+   */
+  virtual std::shared_ptr<Operator<vector_type>>
+  build_single_precision_operator(
+      std::shared_ptr<Operator<vector_type> const> /*op*/)
+  {
+    ASSERT_THROW_NOT_IMPLEMENTED();
+
+    return nullptr;
+  }
+
   virtual std::shared_ptr<Smoother<vector_type>>
   build_smoother(std::shared_ptr<Operator<vector_type> const> op,
                  std::shared_ptr<boost::property_tree::ptree const> params) = 0;
@@ -55,6 +100,55 @@ public:
   virtual std::shared_ptr<Solver<vector_type>> build_coarse_solver(
       std::shared_ptr<Operator<vector_type> const> op,
       std::shared_ptr<boost::property_tree::ptree const> params) = 0;
+
+  /**
+   * Write the locally owned part of \p op to files whose names start with \p
+   * filename. This is used by Hierarchy::save().
+   */
+  virtual void
+  save_operator(std::shared_ptr<Operator<vector_type> const> /*op*/,
+                std::string const & /*filename*/)
+  {
+    ASSERT_THROW_NOT_IMPLEMENTED();
+  }
+
+  /**
+   * Read an operator written by save_operator(). This is used by
+   * Hierarchy::load().
+   */
+  virtual std::shared_ptr<Operator<vector_type>>
+  load_operator(MPI_Comm /*comm*/, std::string const & /*filename*/)
+  {
+    ASSERT_THROW_NOT_IMPLEMENTED();
+
+    return nullptr;
+  }
+
+  /**
+   * Write the data of \p smoother which cannot be cheaply recomputed from the
+   * operator and the parameters, e.g., the agglomerates. Contrary to
+   * save_operator(), \p filename is specific to this processor.
+   */
+  virtual void
+  save_smoother(std::shared_ptr<Smoother<vector_type> const> /*smoother*/,
+                std::string const & /*filename*/)
+  {
+    ASSERT_THROW_NOT_IMPLEMENTED();
+  }
+
+  /**
+   * Build a smoother from \p op, \p params, and the data written by
+   * save_smoother().
+   */
+  virtual std::shared_ptr<Smoother<vector_type>>
+  load_smoother(std::shared_ptr<Operator<vector_type> const> /*op*/,
+                std::shared_ptr<boost::property_tree::ptree const> /*params*/,
+                std::string const & /*filename*/)
+  {
+    ASSERT_THROW_NOT_IMPLEMENTED();
+
+    return nullptr;
+  }
 };
 } // namespace mfmg
 
@@ -62,6 +62,21 @@
   BOOST_PP_SEQ_FOR_EACH(M_SERIALVECTORTYPE_INSTANT, CLASS_NAME_TUPLE,          \
                         SERIAL_VECTOR_TYPE)
 
+////////////////////////////////////////////////////////////////////////////
+// Instantiation of the class for every VectorType-ScalarType combination //
+////////////////////////////////////////////////////////////////////////////
+
+// The ScalarType is the type used to store the data of the class which may be
+// different from the value_type of the VectorType
+#define M_VECTORTYPE_SCALARTYPE_INSTANT(r, product)                            \
+  template class mfmg::BOOST_PP_SEQ_ELEM(0, product)<                          \
+      BOOST_PP_SEQ_ELEM(1, product), BOOST_PP_SEQ_ELEM(2, product)>;
+// CLASS_NAME_TUPLE (class_name, 0)
+#define INSTANTIATE_VECTORTYPE_SCALARTYPE(CLASS_NAME_TUPLE)                    \
+  BOOST_PP_SEQ_FOR_EACH_PRODUCT(                                               \
+      M_VECTORTYPE_SCALARTYPE_INSTANT,                                         \
+      ((BOOST_PP_TUPLE_ELEM(0, CLASS_NAME_TUPLE)))(VECTOR_TYPE)(SCALAR_TYPE))
+
 /////////////////////////////////////////////////////////////////////
 // Instantiation of the class for every dim-ScalarType combination //
 /////////////////////////////////////////////////////////////////////
@@ -193,8 +193,6 @@ Lanczos<OperatorType, VectorType>::details_solve_lanczos(
   ASSERT(maxit >= num_requested, "Lanczos max iterations is too small to "
                                  "produce required number of eigenvectors.");
 
-  int const n = op.n();
-
   std::vector<double> evals;
   std::vector<VectorType> evecs;
 
@@ -225,8 +223,10 @@ Lanczos<OperatorType, VectorType>::details_solve_lanczos(
 
     if (lanc_vectors.size() < static_cast<size_t>(it + 1))
     {
-      // Add new Lanczos vector
-      lanc_vectors.push_back(VectorType(n));
+      // Add new Lanczos vector. We copy the first Lanczos vector so that the
+      // new vector has the same parallel distribution. Its values are
+      // overwritten by the application of the operator.
+      lanc_vectors.push_back(lanc_vectors[0]);
     }
 
     // Apply operator.
@@ -486,9 +486,7 @@ std::vector<VectorType> Lanczos<OperatorType, VectorType>::details_calc_evecs(
     std::vector<VectorType> const &lanc_vectors,
     std::vector<double> const &evecs_tridiag)
 {
-  auto dim = lanc_vectors[0].size();
-
-  std::vector<VectorType> evecs(num_requested, VectorType(dim));
+  std::vector<VectorType> evecs(num_requested, lanc_vectors[0]);
 
   // Matrix-matrix product to convert tridiagonal eigenvectors to operator
   // eigenvectors
@@ -12,6 +12,7 @@
 #ifndef MFMG_LEVEL_HPP
 #define MFMG_LEVEL_HPP
 
+#include <mfmg/common/multivector.hpp>
 #include <mfmg/common/operator.hpp>
 #include <mfmg/common/smoother.hpp>
 #include <mfmg/common/solver.hpp>
@@ -69,6 +70,16 @@ public:
     return a->build_domain_vector();
   }
 
+  std::shared_ptr<MultiVector<vector_type>>
+  build_multivector(int n_vectors) const
+  {
+    std::vector<std::shared_ptr<vector_type>> vectors(n_vectors);
+    for (auto &v : vectors)
+      v = build_vector();
+
+    return std::make_shared<MultiVector<vector_type>>(vectors);
+  }
+
 private:
   std::shared_ptr<operator_type const> _operator, _restrictor;
   std::shared_ptr<Smoother<vector_type> const> _smoother;
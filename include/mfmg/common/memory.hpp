@@ -0,0 +1,69 @@
+/**************************************************************************
+ * Copyright (c) 2017-2019 by the mfmg authors                            *
+ * All rights reserved.                                                   *
+ *                                                                        *
+ * This file is part of the mfmg library. mfmg is distributed under a BSD *
+ * 3-clause license. For the licensing terms see the LICENSE file in the  *
+ * top-level directory                                                    *
+ *                                                                        *
+ * SPDX-License-Identifier: BSD-3-Clause                                  *
+ *************************************************************************/
+
+#ifndef MFMG_MEMORY_HPP
+#define MFMG_MEMORY_HPP
+
+#include <boost/property_tree/ptree.hpp>
+
+#include <mpi.h>
+
+#include <cstddef>
+
+namespace mfmg
+{
+/**
+ * Resident set size of the process and its high-water mark, in bytes.
+ */
+struct MemoryUsage
+{
+  std::size_t resident = 0;
+  std::size_t peak = 0;
+};
+
+/**
+ * Return the current memory usage of the process. Both values are zero if the
+ * operating system does not provide them.
+ */
+MemoryUsage get_memory_usage();
+
+/**
+ * Reset the high-water mark of the resident set size to the current resident
+ * set size so that the peak of a phase can be measured. This returns false if
+ * the operating system does not support it, in which case the high-water mark
+ * is the peak since the start of the process.
+ */
+bool reset_peak_memory_usage();
+
+/**
+ * Start measuring the peak resident set size of a long section of code, e.g.,
+ * a repetition of a benchmark, whose phases may themselves be measured using
+ * reset_peak_memory_usage(). This returns false if the high-water mark cannot
+ * be reset, in which case the measured peak is the peak since the start of the
+ * process.
+ */
+bool start_peak_memory_measurement();
+
+/**
+ * Return the peak resident set size, in bytes, since the last call to
+ * start_peak_memory_measurement(). The peaks discarded by the calls to
+ * reset_peak_memory_usage() made in the meantime are included.
+ */
+std::size_t get_measured_peak_memory_usage();
+
+/**
+ * Return the minimum, the maximum, the average, and the sum over the
+ * processors of \p bytes.
+ */
+boost::property_tree::ptree summarize_memory(MPI_Comm comm, std::size_t bytes);
+} // namespace mfmg
+
+#endif
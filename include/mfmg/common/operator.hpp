@@ -12,6 +12,8 @@
 #ifndef MFMG_OPERATOR_HPP
 #define MFMG_OPERATOR_HPP
 
+#include <mfmg/common/multivector.hpp>
+
 #include <memory>
 
 namespace mfmg
@@ -34,6 +36,20 @@ public:
   virtual void apply(vector_type const &x, vector_type &y,
                      OperatorMode mode = OperatorMode::NO_TRANS) const = 0;
 
+  /**
+   * Apply the operator to every vector of \p x. The default implementation
+   * applies the operator to one vector at a time. Operators which can read
+   * their data once for all the vectors should override this function.
+   */
+  virtual void
+  apply_multivector(MultiVector<vector_type> const &x,
+                    MultiVector<vector_type> &y,
+                    OperatorMode mode = OperatorMode::NO_TRANS) const
+  {
+    for (int i = 0; i < x.n_vectors(); ++i)
+      apply(*x[i], *y[i], mode);
+  }
+
   virtual std::shared_ptr<operator_type> transpose() const = 0;
 
   virtual std::shared_ptr<operator_type>
@@ -49,6 +65,12 @@ public:
   virtual size_t grid_complexity() const = 0;
 
   virtual size_t operator_complexity() const = 0;
+
+  /**
+   * Return an estimate of the memory, in bytes, used by the locally owned part
+   * of the operator.
+   */
+  virtual std::size_t memory_consumption() const = 0;
 };
 } // namespace mfmg
 
@@ -12,6 +12,7 @@
 #ifndef MFMG_SMOOTHER_HPP
 #define MFMG_SMOOTHER_HPP
 
+#include <mfmg/common/multivector.hpp>
 #include <mfmg/common/operator.hpp>
 
 #include <boost/property_tree/ptree.hpp>
@@ -32,7 +33,46 @@ public:
   {
   }
 
-  virtual void apply(vector_type const &x, vector_type &y) const = 0;
+  /**
+   * Apply the smoother to \p x, i.e., perform one smoothing step of the
+   * system A x = b. If \p zero_initial_guess is true, the caller guarantees
+   * that \p x is zero on input. This allows implementations to skip the
+   * computation of the residual (and therefore the application of the
+   * operator) on the first sweep.
+   */
+  virtual void apply(vector_type const &b, vector_type &x,
+                     bool zero_initial_guess = false) const = 0;
+
+  /**
+   * Apply the smoother to every vector of \p x. The default implementation
+   * smooths one vector at a time.
+   */
+  virtual void apply_multivector(MultiVector<vector_type> const &b,
+                                 MultiVector<vector_type> &x,
+                                 bool zero_initial_guess = false) const
+  {
+    for (int i = 0; i < b.n_vectors(); ++i)
+      apply(*b[i], *x[i], zero_initial_guess);
+  }
+
+  /**
+   * Return an estimate of the memory, in bytes, used by the smoother on this
+   * processor. The operator is not included since it is shared with the
+   * level.
+   */
+  virtual std::size_t memory_consumption() const = 0;
+
+  /**
+   * Replace the operator used to compute the residual by \p op, which must
+   * represent the same matrix, e.g., a copy stored in single precision, and
+   * return true. Smoothers that keep referencing the data of their operator
+   * return false and keep the current operator.
+   */
+  virtual bool
+  replace_operator(std::shared_ptr<Operator<vector_type> const> /*op*/)
+  {
+    return false;
+  }
 
   virtual ~Smoother() = default;
 
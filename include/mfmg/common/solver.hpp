@@ -12,6 +12,7 @@
 #ifndef MFMG_SOLVER_HPP
 #define MFMG_SOLVER_HPP
 
+#include <mfmg/common/multivector.hpp>
 #include <mfmg/common/operator.hpp>
 
 #include <boost/property_tree/ptree.hpp>
@@ -34,6 +35,30 @@ public:
 
   virtual void apply(vector_type const &x, vector_type &y) const = 0;
 
+  /**
+   * Solve the system for every vector of \p b. The default implementation
+   * solves for one right-hand side at a time.
+   */
+  virtual void apply_multivector(MultiVector<vector_type> const &b,
+                                 MultiVector<vector_type> &x) const
+  {
+    for (int i = 0; i < b.n_vectors(); ++i)
+      apply(*b[i], *x[i]);
+  }
+
+  /**
+   * Return an estimate of the memory, in bytes, used by the solver on this
+   * processor, e.g. by the factorization. The operator is not included since
+   * it is shared with the level.
+   */
+  virtual std::size_t memory_consumption() const = 0;
+
+  /**
+   * Return true if memory_consumption() is the growth of the resident set
+   * size during the setup of the solver instead of the size of its data.
+   */
+  virtual bool memory_consumption_is_rss_delta() const { return false; }
+
   virtual ~Solver() = default;
 
 protected:
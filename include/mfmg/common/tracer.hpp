@@ -0,0 +1,130 @@
+/**************************************************************************
+ * Copyright (c) 2017-2019 by the mfmg authors                            *
+ * All rights reserved.                                                   *
+ *                                                                        *
+ * This file is part of the mfmg library. mfmg is distributed under a BSD *
+ * 3-clause license. For the licensing terms see the LICENSE file in the  *
+ * top-level directory                                                    *
+ *                                                                        *
+ * SPDX-License-Identifier: BSD-3-Clause                                  *
+ *************************************************************************/
+
+#ifndef MFMG_TRACER_HPP
+#define MFMG_TRACER_HPP
+
+#include <mpi.h>
+
+#include <atomic>
+#include <initializer_list>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mfmg
+{
+/**
+ * Payload attached to a trace event, e.g., the id of an agglomerate or the
+ * level of the hierarchy. The key must be a string literal.
+ */
+using TraceArgument = std::pair<char const *, double>;
+
+/**
+ * Record timestamped begin/end events on every processor and every thread and
+ * write them in the Chrome trace-event JSON format. The traces can be loaded
+ * in chrome://tracing or in Perfetto to look at the load imbalance between
+ * threads and processors. When the tracer is disabled, recording an event
+ * costs a single relaxed atomic load.
+ *
+ * Events are stored in per-thread buffers so that the threads of a WorkStream
+ * do not contend. Each buffer is guarded by its own mutex so that clear() and
+ * write_chrome_trace() can be called while traced work is running. The events
+ * recorded concurrently with these calls may or may not be included.
+ */
+class Tracer
+{
+public:
+  /**
+   * Start recording events. The processors of \p comm are synchronized so
+   * that the timestamps of all the processors share the same origin.
+   */
+  static void enable(MPI_Comm comm);
+
+  /**
+   * Stop recording events. The events already recorded are kept.
+   */
+  static void disable();
+
+  static bool is_enabled() { return _enabled.load(std::memory_order_relaxed); }
+
+  /**
+   * Remove all the recorded events.
+   */
+  static void clear();
+
+  /**
+   * Open an event named \p name on the calling thread.
+   */
+  static void begin(std::string const &name,
+                    std::initializer_list<TraceArgument> arguments = {});
+
+  /**
+   * Close the last event opened on the calling thread. \p arguments are merged
+   * with the arguments given to begin() by the trace viewers, this is useful
+   * for quantities only known at the end, e.g., a number of iterations.
+   */
+  static void end(std::vector<TraceArgument> const &arguments = {});
+
+  /**
+   * Write the events of all the processors of \p comm to \p filename. The
+   * process id of an event is the rank of the processor and the thread id is
+   * the index of the thread on that processor. This function is collective
+   * and the first processor writes the traces of the other ones as they are
+   * received.
+   */
+  static void write_chrome_trace(std::string const &filename, MPI_Comm comm);
+
+private:
+  static std::atomic<bool> _enabled;
+};
+
+/**
+ * Open an event when constructed and close it when destroyed. Nothing is
+ * recorded if the Tracer was disabled at construction.
+ */
+class TraceScope
+{
+public:
+  TraceScope(char const *name,
+             std::initializer_list<TraceArgument> arguments = {})
+      : _enabled(Tracer::is_enabled())
+  {
+    if (_enabled)
+      Tracer::begin(name, arguments);
+  }
+
+  TraceScope(TraceScope const &) = delete;
+
+  TraceScope &operator=(TraceScope const &) = delete;
+
+  ~TraceScope()
+  {
+    if (_enabled)
+      Tracer::end(_end_arguments);
+  }
+
+  /**
+   * Add an argument to the end event.
+   */
+  void add_argument(char const *key, double value)
+  {
+    if (_enabled)
+      _end_arguments.emplace_back(key, value);
+  }
+
+private:
+  bool const _enabled;
+  std::vector<TraceArgument> _end_arguments;
+};
+} // namespace mfmg
+
+#endif
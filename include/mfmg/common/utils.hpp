@@ -14,6 +14,8 @@
 
 #include <mfmg/common/exceptions.hpp>
 
+#include <deal.II/base/mpi.h>
+#include <deal.II/base/point.h>
 #include <deal.II/lac/la_parallel_vector.h>
 #include <deal.II/lac/trilinos_sparse_matrix.h>
 #include <deal.II/lac/trilinos_sparsity_pattern.h>
@@ -23,7 +25,12 @@
 #include <boost/property_tree/ptree.hpp>
 
 #include <algorithm>
+#include <array>
+#include <cstdint>
+#include <exception>
 #include <numeric>
+#include <string>
+#include <utility>
 #include <vector>
 
 namespace mfmg
@@ -31,6 +38,29 @@ namespace mfmg
 void ptree2plist(boost::property_tree::ptree const &ptree,
                  Teuchos::ParameterList &plist);
 
+/**
+ * Call \p local_function, which must not communicate, on every processor of
+ * \p comm and throw on all of them if it throws on any of them. The message
+ * of the exception is kept on the processors where it was thrown. This must be
+ * used for the checks that are followed by collective operations, otherwise
+ * the processors which passed the check deadlock.
+ */
+template <typename Function>
+void collective_check(MPI_Comm comm, Function const &local_function)
+{
+  std::string error;
+  try
+  {
+    local_function();
+  }
+  catch (std::exception const &exception)
+  {
+    error = exception.what();
+  }
+  if (dealii::Utilities::MPI::max(error.empty() ? 0 : 1, comm) > 0)
+    ASSERT_THROW(false, error.empty() ? "Error on another processor" : error);
+}
+
 template <typename T>
 std::vector<unsigned int> sort_permutation(std::vector<T> const &vec_1,
                                            std::vector<T> const &vec_2)
@@ -78,6 +108,122 @@ void apply_permutation_in_place(std::vector<unsigned int> const &permutation,
   }
 }
 
+/**
+ * Return the position along the Morton (Z-order) curve of the point of integer
+ * coordinates \p x. Only the \p n_bits lowest bits of each coordinate are
+ * used and dim * n_bits cannot be larger than 64.
+ */
+template <int dim>
+std::uint64_t morton_key(std::array<std::uint32_t, dim> const &x,
+                         unsigned int const n_bits)
+{
+  ASSERT(dim * n_bits <= 64, "The key does not fit in 64 bits");
+  std::uint64_t key = 0;
+  for (int bit = n_bits - 1; bit >= 0; --bit)
+    for (int d = 0; d < dim; ++d)
+      key = (key << 1) | ((x[d] >> bit) & 1);
+
+  return key;
+}
+
+/**
+ * Return the position along the Hilbert curve of the point of integer
+ * coordinates \p x. Consecutive points along the curve are neighbors so that
+ * the pieces of the curve are more compact than with morton_key(). This uses
+ * the algorithm of J. Skilling, "Programming the Hilbert curve", AIP Conference
+ * Proceedings 707, 2004.
+ */
+template <int dim>
+std::uint64_t hilbert_key(std::array<std::uint32_t, dim> x,
+                          unsigned int const n_bits)
+{
+  // Transform the coordinates in place: undo the excess work
+  std::uint32_t const m = 1u << (n_bits - 1);
+  for (std::uint32_t q = m; q > 1; q >>= 1)
+  {
+    std::uint32_t const p = q - 1;
+    for (int d = 0; d < dim; ++d)
+    {
+      if (x[d] & q)
+        x[0] ^= p;
+      else
+      {
+        std::uint32_t const t = (x[0] ^ x[d]) & p;
+        x[0] ^= t;
+        x[d] ^= t;
+      }
+    }
+  }
+
+  // Gray encode
+  for (int d = 1; d < dim; ++d)
+    x[d] ^= x[d - 1];
+  std::uint32_t t = 0;
+  for (std::uint32_t q = m; q > 1; q >>= 1)
+    if (x[dim - 1] & q)
+      t ^= q - 1;
+  for (int d = 0; d < dim; ++d)
+    x[d] ^= t;
+
+  // The transformed coordinates are interleaved like for the Morton curve
+  return morton_key<dim>(x, n_bits);
+}
+
+/**
+ * Return the indices of the \p points sorted by position along the
+ * space-filling curve \p curve_type, hilbert or morton. The points are mapped
+ * to integer coordinates using the same scaling in every direction so that the
+ * pieces of the curve are not stretched.
+ */
+template <int dim>
+std::vector<unsigned int>
+space_filling_curve_order(std::string const &curve_type,
+                          std::vector<dealii::Point<dim>> const &points)
+{
+  ASSERT_THROW((curve_type == "hilbert") || (curve_type == "morton"),
+               curve_type + " is not a valid space-filling curve. The "
+                            "acceptable values are hilbert and morton.");
+  unsigned int const n_points = points.size();
+  if (n_points == 0)
+    return std::vector<unsigned int>();
+
+  dealii::Point<dim> lower = points[0];
+  dealii::Point<dim> upper = points[0];
+  for (auto const &point : points)
+    for (unsigned int d = 0; d < dim; ++d)
+    {
+      lower[d] = std::min(lower[d], point[d]);
+      upper[d] = std::max(upper[d], point[d]);
+    }
+  double extent = 0.;
+  for (unsigned int d = 0; d < dim; ++d)
+    extent = std::max(extent, upper[d] - lower[d]);
+  unsigned int constexpr n_bits = (dim == 2) ? 32 : 21;
+  double const scaling =
+      extent > 0. ? static_cast<double>((std::uint64_t(1) << n_bits) - 1) /
+                        extent
+                  : 0.;
+
+  bool const hilbert = (curve_type == "hilbert");
+  std::vector<std::pair<std::uint64_t, unsigned int>> keys(n_points);
+  for (unsigned int i = 0; i < n_points; ++i)
+  {
+    std::array<std::uint32_t, dim> x;
+    for (unsigned int d = 0; d < dim; ++d)
+      x[d] = static_cast<std::uint32_t>((points[i][d] - lower[d]) * scaling);
+    keys[i] = std::make_pair(hilbert ? hilbert_key<dim>(x, n_bits)
+                                     : morton_key<dim>(x, n_bits),
+                             i);
+  }
+  std::sort(keys.begin(), keys.end());
+
+  std::vector<unsigned int> order(n_points);
+  for (unsigned int i = 0; i < n_points; ++i)
+    order[i] = keys[i].second;
+
+  return order;
+}
+
 template <typename ScalarType>
 void check_restriction_matrix(
     MPI_Comm comm, std::vector<dealii::Vector<ScalarType>> const &eigenvectors,
@@ -64,6 +64,8 @@ public:
 
   virtual size_t operator_complexity() const override;
 
+  virtual std::size_t memory_consumption() const override;
+
   std::shared_ptr<dealii::DiagonalMatrix<VectorType>>
   get_diagonal_inverse() const;
 
@@ -50,6 +50,12 @@ public:
 
   size_t operator_complexity() const override final;
 
+  /**
+   * Return the device memory used by the matrix and by its transpose if it has
+   * been computed.
+   */
+  std::size_t memory_consumption() const override final;
+
   std::shared_ptr<SparseMatrixDevice<value_type>> get_matrix() const;
 
 private:
@@ -31,7 +31,10 @@ public:
   CudaSmoother(std::shared_ptr<Operator<vector_type> const> op,
                std::shared_ptr<boost::property_tree::ptree const> params);
 
-  void apply(vector_type const &x, vector_type &y) const final;
+  void apply(vector_type const &b, vector_type &x,
+             bool zero_initial_guess = false) const final;
+
+  std::size_t memory_consumption() const final;
 
 private:
   SparseMatrixDevice<value_type> _smoother;
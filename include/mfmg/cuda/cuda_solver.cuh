@@ -42,6 +42,12 @@ public:
 
   void apply(vector_type const &b, vector_type &x) const final;
 
+  /**
+   * The libraries used by the solver do not report the memory they allocate
+   * on the device so only the host data is counted.
+   */
+  std::size_t memory_consumption() const final;
+
 private:
   CudaHandle const &_cuda_handle;
   std::string _solver;
@@ -70,6 +70,15 @@ public:
 
   unsigned int n_nonzero_elements() const { return _nnz; }
 
+  /**
+   * Return the device memory, in bytes, used by the locally owned rows.
+   */
+  std::size_t memory_consumption() const
+  {
+    return _local_nnz * (sizeof(ScalarType) + sizeof(int)) +
+           (n_local_rows() + 1) * sizeof(int);
+  }
+
   dealii::IndexSet locally_owned_domain_indices() const;
 
   dealii::IndexSet locally_owned_range_indices() const;
@@ -0,0 +1,83 @@
+/**************************************************************************
+ * Copyright (c) 2017-2019 by the mfmg authors                            *
+ * All rights reserved.                                                   *
+ *                                                                        *
+ * This file is part of the mfmg library. mfmg is distributed under a BSD *
+ * 3-clause license. For the licensing terms see the LICENSE file in the  *
+ * top-level directory                                                    *
+ *                                                                        *
+ * SPDX-License-Identifier: BSD-3-Clause                                  *
+ **************************************************************************/
+
+#ifndef MFMG_ALGEBRAIC_HIERARCHY_HELPERS_HPP
+#define MFMG_ALGEBRAIC_HIERARCHY_HELPERS_HPP
+
+#include <mfmg/common/hierarchy_helpers.hpp>
+#include <mfmg/dealii/algebraic_mesh_evaluator.hpp>
+#include <mfmg/dealii/dealii_hierarchy_helpers.hpp>
+
+namespace mfmg
+{
+/**
+ * Helpers associated with AlgebraicMeshEvaluator. The agglomerates are grown
+ * by breadth-first search on the element graph, where two elements are
+ * connected if they share a degree of freedom, or on the graph of the matrix
+ * if the evaluator has no element. The size of the agglomerates is given by
+ * the parameter "agglomeration.size" which is a number of elements,
+ * respectively a number of rows. The eigenvectors of the local matrices are
+ * then computed and assembled like in AMGe_host.
+ */
+template <typename VectorType>
+class AlgebraicHierarchyHelpers : public HierarchyHelpers<VectorType>
+{
+public:
+  using vector_type = VectorType;
+
+  virtual ~AlgebraicHierarchyHelpers() override = default;
+
+  std::shared_ptr<Operator<vector_type>> get_global_operator(
+      std::shared_ptr<MeshEvaluator> mesh_evaluator) override final;
+
+  std::shared_ptr<Operator<vector_type>> build_restrictor(
+      MPI_Comm comm, std::shared_ptr<MeshEvaluator> mesh_evaluator,
+      std::shared_ptr<boost::property_tree::ptree const> params) override final;
+
+  boost::property_tree::ptree get_restrictor_statistics() const override final;
+
+  std::shared_ptr<Operator<vector_type>> build_single_precision_operator(
+      std::shared_ptr<Operator<vector_type> const> op) override final;
+
+  std::shared_ptr<Smoother<vector_type>> build_smoother(
+      std::shared_ptr<Operator<vector_type> const> op,
+      std::shared_ptr<boost::property_tree::ptree const> params) override final;
+
+  std::shared_ptr<Solver<vector_type>> build_coarse_solver(
+      std::shared_ptr<Operator<vector_type> const> op,
+      std::shared_ptr<boost::property_tree::ptree const> params) override final;
+
+  void save_operator(std::shared_ptr<Operator<vector_type> const> op,
+                     std::string const &filename) override final;
+
+  std::shared_ptr<Operator<vector_type>>
+  load_operator(MPI_Comm comm, std::string const &filename) override final;
+
+  void save_smoother(std::shared_ptr<Smoother<vector_type> const> smoother,
+                     std::string const &filename) override final;
+
+  std::shared_ptr<Smoother<vector_type>> load_smoother(
+      std::shared_ptr<Operator<vector_type> const> op,
+      std::shared_ptr<boost::property_tree::ptree const> params,
+      std::string const &filename) override final;
+
+private:
+  /**
+   * The smoothers, the coarse solvers, and the operators only depend on the
+   * matrices, not on the mesh, so they are shared with the deal.II helpers.
+   * The dimension is not used.
+   */
+  DealIIHierarchyHelpers<2, VectorType> _dealii_helpers;
+  boost::property_tree::ptree _restrictor_statistics;
+};
+} // namespace mfmg
+
+#endif
@@ -0,0 +1,101 @@
+/**************************************************************************
+ * Copyright (c) 2017-2019 by the mfmg authors                            *
+ * All rights reserved.                                                   *
+ *                                                                        *
+ * This file is part of the mfmg library. mfmg is distributed under a BSD *
+ * 3-clause license. For the licensing terms see the LICENSE file in the  *
+ * top-level directory                                                    *
+ *                                                                        *
+ * SPDX-License-Identifier: BSD-3-Clause                                  *
+ **************************************************************************/
+
+#ifndef MFMG_ALGEBRAIC_MESH_EVALUATOR_HPP
+#define MFMG_ALGEBRAIC_MESH_EVALUATOR_HPP
+
+#include <mfmg/common/mesh_evaluator.hpp>
+
+#include <deal.II/base/index_set.h>
+#include <deal.II/lac/full_matrix.h>
+#include <deal.II/lac/la_parallel_vector.h>
+#include <deal.II/lac/trilinos_sparse_matrix.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mfmg
+{
+/**
+ * Mesh evaluator for applications that do not use deal.II to discretize their
+ * problem. The only required input is the assembled matrix. The agglomerates
+ * are then built from the graph of the matrix and their local matrices are
+ * the diagonal blocks of the matrix, where the couplings to the outside of the
+ * agglomerate are lumped on the diagonal. If the application can provide the
+ * unassembled matrices of its locally owned elements, the agglomerates are
+ * built from the element graph instead and the local Neumann matrices are the
+ * sums of the element matrices, like for the other evaluators.
+ */
+class AlgebraicMeshEvaluator : public MeshEvaluator
+{
+public:
+  /**
+   * Build the agglomerates from the graph of \p matrix. The eigenvectors
+   * associated with \p constrained_dofs, e.g. Dirichlet boundary conditions,
+   * are not used.
+   */
+  AlgebraicMeshEvaluator(
+      std::shared_ptr<dealii::TrilinosWrappers::SparseMatrix> matrix,
+      dealii::IndexSet const &constrained_dofs = dealii::IndexSet());
+
+  /**
+   * Build the agglomerates from the elements. \p element_dofs[e] are the
+   * global indices of the degrees of freedom of the e-th locally owned element
+   * and \p element_matrices[e] is its unassembled matrix. The degrees of
+   * freedom of an element do not need to be locally owned.
+   */
+  AlgebraicMeshEvaluator(
+      std::shared_ptr<dealii::TrilinosWrappers::SparseMatrix> matrix,
+      std::vector<std::vector<dealii::types::global_dof_index>> element_dofs,
+      std::vector<dealii::FullMatrix<double>> element_matrices,
+      dealii::IndexSet const &constrained_dofs = dealii::IndexSet());
+
+  virtual ~AlgebraicMeshEvaluator() override = default;
+
+  /**
+   * There is no geometry associated with this evaluator so this function
+   * returns zero.
+   */
+  virtual int get_dim() const override final;
+
+  std::string get_mesh_evaluator_type() const override final;
+
+  std::shared_ptr<dealii::TrilinosWrappers::SparseMatrix> get_matrix() const;
+
+  /**
+   * Return true if the element matrices were provided.
+   */
+  bool has_elements() const;
+
+  std::vector<std::vector<dealii::types::global_dof_index>> const &
+  get_element_dofs() const;
+
+  std::vector<dealii::FullMatrix<double>> const &get_element_matrices() const;
+
+  dealii::IndexSet const &get_constrained_dofs() const;
+
+  /**
+   * Return the diagonal of the matrix. The vector stores the locally owned
+   * entries and, as ghosts, the entries of the degrees of freedom of the
+   * locally owned elements.
+   */
+  dealii::LinearAlgebra::distributed::Vector<double> get_diagonal() const;
+
+private:
+  std::shared_ptr<dealii::TrilinosWrappers::SparseMatrix> _matrix;
+  std::vector<std::vector<dealii::types::global_dof_index>> _element_dofs;
+  std::vector<dealii::FullMatrix<double>> _element_matrices;
+  dealii::IndexSet _constrained_dofs;
+};
+} // namespace mfmg
+
+#endif
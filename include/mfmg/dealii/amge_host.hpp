@@ -13,8 +13,11 @@
 #define AMGE_HOST_HPP
 
 #include <mfmg/common/amge.hpp>
+#include <mfmg/common/eigensolver_statistics.hpp>
 #include <mfmg/dealii/dealii_matrix_free_mesh_evaluator.hpp>
 
+#include <functional>
+
 namespace mfmg
 {
 /**
@@ -25,6 +28,43 @@ struct LobpcgScratchData
   std::vector<dealii::Vector<double>> lobpcg_init_guess;
 };
 
+/**
+ * Compute the \p n_eigenvectors eigenpairs of smallest magnitude of the matrix
+ * of an agglomerate using the eigensolver described by \p eigensolver_params.
+ * The rows listed in \p constrained_dofs are shifted so that the corresponding
+ * eigenvectors are not computed. \p agglomerate_system_matrix is modified by
+ * this function. This is shared by all the evaluators that can assemble the
+ * matrix of an agglomerate.
+ */
+template <typename ScalarType>
+std::tuple<std::vector<std::complex<double>>,
+           std::vector<dealii::Vector<double>>>
+compute_agglomerate_eigenpairs(
+    unsigned int n_eigenvectors, double tolerance,
+    boost::property_tree::ptree const &eigensolver_params,
+    dealii::SparseMatrix<ScalarType> &agglomerate_system_matrix,
+    std::vector<unsigned int> const &constrained_dofs,
+    dealii::Vector<double> const &initial_vector,
+    LobpcgScratchData const &scratch_data,
+    AgglomerateStatistics *statistics = nullptr);
+
+/**
+ * Select the eigenpairs that an agglomerate keeps. By default, all the
+ * computed eigenpairs are kept and this function does nothing. If
+ * "eigenvalue threshold" is set in \p eigensolver_params, the eigenpairs whose
+ * eigenvalue is larger than the threshold times \p diagonal_scale, the
+ * average diagonal entry of the agglomerate matrix, are dropped. If
+ * "eigenvalue gap" is set, the eigenpairs above the first gap between
+ * consecutive eigenvalues larger than the gap times \p diagonal_scale are
+ * dropped. At least "min number of eigenvectors" eigenpairs, one by default,
+ * are kept so "number of eigenvectors" acts as the maximum. The selected
+ * eigenpairs are sorted by increasing eigenvalue.
+ */
+void select_agglomerate_eigenpairs(
+    boost::property_tree::ptree const &eigensolver_params,
+    double diagonal_scale, std::vector<std::complex<double>> &eigenvalues,
+    std::vector<dealii::Vector<double>> &eigenvectors);
+
 template <int dim, typename MeshEvaluator, typename VectorType>
 class AMGe_host : public AMGe<dim, VectorType>
 {
@@ -46,11 +86,20 @@ public:
    *    AffineConstraints<double>, and the local system sparse matrix with its
    *    sparsity pattern.
    *  - an object that contains initial guesses for LOBPCG
+   *  - optionally, a structure where the number of iterations, the number of
+   *    operator applications, and the residual of the eigensolve are stored
    *
    * The function returns the complex eigenvalues, the associated eigenvectors,
    * the diagonal elements of the local system matrix, and a vector that maps
    * the dof indices from the local problem to the global problem.
    *
+   * If the mesh evaluator is not matrix-free, the DoFs of the local problem can
+   * be renumbered after the assembly by setting "dof_renumbering" in the
+   * eigensolver parameters to "cuthill_mckee", which reduces the bandwidth of
+   * the local matrix, or to "global", which orders the DoFs by global index.
+   * The eigenvectors, the diagonal elements, and the map use the new numbering.
+   * The default is "none".
+   *
    * NOTE: MeshEvaluator is a template argument of the AMGe_host and therefore
    * cannot be used to provide separate specializations depending on whether
    * the mesh evaluator is matrix-free or not. The Triangulation template
@@ -70,6 +119,7 @@ public:
                typename dealii::DoFHandler<dim>::active_cell_iterator> const
           &patch_to_global_map,
       MeshEvaluator const &evaluator, LobpcgScratchData const &scratch_data,
+      AgglomerateStatistics *statistics = nullptr,
       typename std::enable_if_t<is_matrix_free<MeshEvaluator>::value &&
                                     std::is_class<Triangulation>::value,
                                 int> = 0) const;
@@ -85,12 +135,26 @@ public:
                typename dealii::DoFHandler<dim>::active_cell_iterator> const
           &patch_to_global_map,
       MeshEvaluator const &evaluator, LobpcgScratchData const &scratch_data,
+      AgglomerateStatistics *statistics = nullptr,
       typename std::enable_if_t<!is_matrix_free<MeshEvaluator>::value &&
                                     std::is_class<Triangulation>::value,
                                 int> = 0) const;
 
   /**
    *  Build the agglomerates and their associated triangulations.
+   *
+   *  If "streaming" is set to true in \p params, the eigenvectors of each
+   *  agglomerate are written to the rows of the restriction matrix as soon as
+   *  they are computed instead of being stored until all the agglomerates have
+   *  been processed. The rows are preallocated using the number of DoFs of
+   *  the agglomerates, so the peak memory stays close to the size of the
+   *  output. In this mode, the sum of the agglomerate diagonals is not
+   *  checked against the global diagonal in debug mode.
+   *
+   *  The agglomerates are processed by decreasing number of DoFs unless
+   *  "schedule" is set to "natural" in \p params, in which case they are
+   *  processed in the order of their ids. The rows of the restriction matrix
+   *  are always ordered by agglomerate id.
    */
   void setup_restrictor(
       boost::property_tree::ptree const &params,
@@ -114,10 +178,59 @@ public:
           &delta_eigenvector_matrix,
       std::vector<double> &eigenvalues);
 
+  /**
+   * Update in place a restriction matrix built by setup_restrictor() after the
+   * matrix changed on the locally owned cells whose active cell indices are
+   * listed in \p changed_cells. The mesh, the DoFs, and the agglomerates must
+   * be unchanged: \p agglomerate_ids is the output of get_agglomerates() when
+   * the restriction matrix was built and \p n_local_eigenvectors is the
+   * number of rows of each agglomerate.
+   *
+   * Only the local matrices of the agglomerates that contain a changed cell
+   * are different so only these agglomerates are solved again and their rows
+   * are overwritten. The weights of the other rows only depend on the global
+   * diagonal, given before and after the change by \p
+   * old_locally_relevant_global_diag and \p locally_relevant_global_diag, so
+   * their columns are rescaled. The sparsity pattern is kept, which requires
+   * the agglomerates to keep the same number of eigenvectors. This function
+   * returns the number of agglomerates which have been solved again.
+   */
+  unsigned int update_restrictor(
+      boost::property_tree::ptree const &params,
+      std::vector<unsigned int> const &agglomerate_ids,
+      std::vector<unsigned int> const &changed_cells,
+      std::vector<unsigned int> const &n_local_eigenvectors,
+      unsigned int const n_eigenvectors, double const tolerance,
+      MeshEvaluator const &evaluator,
+      dealii::LinearAlgebra::distributed::Vector<
+          typename VectorType::value_type> const
+          &old_locally_relevant_global_diag,
+      dealii::LinearAlgebra::distributed::Vector<
+          typename VectorType::value_type> const &locally_relevant_global_diag,
+      dealii::TrilinosWrappers::SparseMatrix &restriction_sparse_matrix);
+
+  /**
+   * Return the statistics of the eigensolves of the agglomerates processed by
+   * the last call to setup_restrictor() or update_restrictor().
+   */
+  std::vector<AgglomerateStatistics> const &get_agglomerate_statistics() const
+  {
+    return _agglomerate_statistics;
+  }
+
+  /**
+   * Return how busy the threads were during the eigensolves of the last call
+   * to setup_restrictor() or update_restrictor().
+   */
+  ThreadUtilization const &get_thread_utilization() const
+  {
+    return _thread_utilization;
+  }
+
 private:
   /**
    * Structure which encapsulates the data that needs to be copied at the end
-   * of WorkStream.
+   * of the eigensolve of an agglomerate.
    */
   struct CopyData
   {
@@ -125,8 +238,32 @@ private:
     std::vector<dealii::Vector<double>> local_eigenvectors;
     std::vector<ScalarType> diag_elements;
     std::vector<dealii::types::global_dof_index> local_dof_indices_map;
+    AgglomerateStatistics statistics;
   };
 
+  /**
+   * Compute the eigenvectors of all the agglomerates using all the threads
+   * and pass the result of each agglomerate to \p copier. \p copier is called
+   * concurrently by different threads.
+   */
+  void compute_agglomerate_eigenvectors(
+      boost::property_tree::ptree const &agglomerate_ptree,
+      unsigned int const n_agglomerates, unsigned int const n_eigenvectors,
+      double const tolerance, MeshEvaluator const &evaluator,
+      std::function<void(CopyData &)> const &copier);
+
+  /**
+   * Same as above but only the agglomerates in \p agglomerate_ids, a subset of
+   * the \p n_agglomerates local agglomerates, are processed.
+   */
+  void compute_agglomerate_eigenvectors(
+      boost::property_tree::ptree const &agglomerate_ptree,
+      unsigned int const n_agglomerates,
+      std::vector<unsigned int> agglomerate_ids,
+      unsigned int const n_eigenvectors, double const tolerance,
+      MeshEvaluator const &evaluator,
+      std::function<void(CopyData &)> const &copier);
+
   /**
    * This function encapsulates the different functions that work on an
    * independent set of data.
@@ -137,28 +274,56 @@ private:
                     LobpcgScratchData &scratch_data, CopyData &copy_data);
 
   /**
-   * This function copies quantities computed in local worker to output
+   * This function moves quantities computed in local worker to output
    * variables.
    */
   void
-  copy_local_to_global(CopyData const &copy_data,
+  copy_local_to_global(CopyData &copy_data,
                        std::vector<dealii::Vector<double>> &eigenvectors,
                        std::vector<std::vector<ScalarType>> &diag_elements,
                        std::vector<std::vector<dealii::types::global_dof_index>>
                            &dof_indices_maps,
                        std::vector<unsigned int> &n_local_eigenvectors);
 
-  // Give a different name to help the compiler. Otherwise, it gets confused
-  // when calling WorkStream
+  /**
+   * Same as copy_local_to_global() but the eigenvalues are also copied.
+   */
   void copy_local_to_global_eig(
-      CopyData const &copy_data, std::vector<double> &eigenvalues,
+      CopyData &copy_data, std::vector<double> &eigenvalues,
       std::vector<dealii::Vector<double>> &eigenvectors,
       std::vector<std::vector<ScalarType>> &diag_elements,
       std::vector<std::vector<dealii::types::global_dof_index>>
           &dof_indices_maps,
       std::vector<unsigned int> &n_local_eigenvectors);
 
+  /**
+   * Return the number of DoFs of each agglomerate, i.e., the number of
+   * entries in each of the rows of the restriction matrix associated with the
+   * agglomerate.
+   */
+  std::vector<int>
+  compute_agglomerate_n_dofs(unsigned int const n_agglomerates) const;
+
+  /**
+   * Compute the eigenvectors of the agglomerates and write them directly in
+   * the restriction matrix. If \p eigenvector_sparse_matrix is not nullptr, the
+   * eigenvector matrix, the delta eigenvector matrix, and the eigenvalues used
+   * by fast_ap are filled at the same time.
+   */
+  void setup_restrictor_streaming(
+      boost::property_tree::ptree const &agglomerate_ptree,
+      unsigned int const n_agglomerates, unsigned int const n_eigenvectors,
+      double const tolerance, MeshEvaluator const &evaluator,
+      dealii::LinearAlgebra::distributed::Vector<
+          typename VectorType::value_type> const &locally_relevant_global_diag,
+      dealii::TrilinosWrappers::SparseMatrix &restriction_sparse_matrix,
+      dealii::TrilinosWrappers::SparseMatrix *eigenvector_sparse_matrix,
+      dealii::TrilinosWrappers::SparseMatrix *delta_eigenvector_matrix,
+      std::vector<double> *eigenvalues);
+
   boost::property_tree::ptree _eigensolver_params;
+  std::vector<AgglomerateStatistics> _agglomerate_statistics;
+  ThreadUtilization _thread_utilization;
 };
 } // namespace mfmg
 
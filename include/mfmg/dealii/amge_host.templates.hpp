@@ -13,21 +13,36 @@
 #define AMGE_HOST_TEMPLATES_HPP
 
 #include <mfmg/common/lanczos.templates.hpp>
+#include <mfmg/common/tracer.hpp>
 #include <mfmg/common/utils.hpp>
 #include <mfmg/dealii/amge_host.hpp>
 #include <mfmg/dealii/anasazi.templates.hpp>
 #include <mfmg/dealii/dealii_matrix_free_mesh_evaluator.hpp>
 
-#include <deal.II/base/work_stream.h>
+#include <deal.II/base/multithread_info.h>
+#include <deal.II/base/thread_management.h>
 #include <deal.II/dofs/dof_accessor.h>
+#include <deal.II/grid/filtered_iterator.h>
 #include <deal.II/lac/arpack_solver.h>
+#include <deal.II/lac/dynamic_sparsity_pattern.h>
 #include <deal.II/lac/la_parallel_vector.h>
 #include <deal.II/lac/lapack_full_matrix.h>
 #include <deal.II/lac/precondition.h>
 #include <deal.II/lac/solver_cg.h>
 #include <deal.II/lac/sparse_direct.h>
+#include <deal.II/lac/sparsity_tools.h>
+#include <deal.II/lac/trilinos_vector.h>
 
 #include <EpetraExt_MatrixMatrix.h>
+#include <Epetra_CrsMatrix.h>
+#include <Epetra_Map.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <numeric>
+#include <tuple>
 
 namespace mfmg
 {
@@ -122,6 +137,34 @@ private:
   dealii::AffineConstraints<double> &_constraints;
 };
 
+/**
+ * Wrap an operator to count the number of vectors it is applied to. This is
+ * used to collect the statistics of the eigensolvers.
+ */
+template <typename OperatorType>
+class CountingOperator
+{
+public:
+  CountingOperator(OperatorType const &op) : _op(op) {}
+
+  template <typename VectorType>
+  void vmult(VectorType &dst, VectorType const &src) const
+  {
+    ++_n_applies;
+    _op.vmult(dst, src);
+  }
+
+  auto m() const { return _op.m(); }
+
+  auto n() const { return _op.n(); }
+
+  unsigned int n_applies() const { return _n_applies; }
+
+private:
+  OperatorType const &_op;
+  mutable unsigned int _n_applies = 0;
+};
+
 template <int dim, typename MeshEvaluator, typename VectorType>
 AMGe_host<dim, MeshEvaluator, VectorType>::AMGe_host(
     MPI_Comm comm, dealii::DoFHandler<dim> const &dof_handler,
@@ -134,6 +177,26 @@ AMGe_host<dim, MeshEvaluator, VectorType>::AMGe_host(
 
 namespace Anasazi
 {
+template <typename VectorType, typename OperatorType>
+class OperatorTraits<double, mfmg::MultiVector<VectorType>,
+                     mfmg::CountingOperator<OperatorType>>
+{
+  using MultiVectorType = mfmg::MultiVector<VectorType>;
+
+public:
+  static void Apply(mfmg::CountingOperator<OperatorType> const &op,
+                    MultiVectorType const &x, MultiVectorType &y)
+  {
+    auto n_vectors = x.n_vectors();
+
+    ASSERT(x.size() == y.size(), "");
+    ASSERT(y.n_vectors() == n_vectors, "");
+
+    for (int i = 0; i < n_vectors; i++)
+      op.vmult(*y[i], *x[i]);
+  }
+};
+
 template <typename VectorType, typename MeshEvaluator>
 class OperatorTraits<double, mfmg::MultiVector<VectorType>,
                      mfmg::MatrixFreeAgglomerateOperator<MeshEvaluator>>
@@ -214,7 +277,8 @@ void anasazi_compute_eigenvalues_and_eigenvectors(
     dealii::Vector<double> const &initial_guess,
     std::vector<dealii::Vector<double>> const &lobpcg_vectors,
     std::vector<std::complex<double>> &eigenvalues,
-    std::vector<dealii::Vector<double>> &eigenvectors)
+    std::vector<dealii::Vector<double>> &eigenvectors,
+    unsigned int &n_iterations)
 {
   AnasaziSolver<AgglomerateOperator, dealii::Vector<double>> solver(
       agglomerate_operator);
@@ -268,13 +332,235 @@ void anasazi_compute_eigenvalues_and_eigenvectors(
       solver.solve(eigensolver_params, lobpcg_initial_guess);
   ASSERT(n_eigenvectors == eigenvectors.size(),
          "Wrong number of computed eigenpairs");
+  n_iterations = solver.n_iterations();
 
   // Copy real eigenvalues to complex
   std::copy(real_eigenvalues.begin(), real_eigenvalues.end(),
             eigenvalues.begin());
 }
+
+// Return the largest residual norm ||A v - lambda v|| / ||v|| of the eigenpairs
+template <typename AgglomerateOperator>
+double compute_max_residual(
+    AgglomerateOperator const &agglomerate_operator,
+    std::vector<std::complex<double>> const &eigenvalues,
+    std::vector<dealii::Vector<double>> const &eigenvectors)
+{
+  double max_residual = 0.;
+  dealii::Vector<double> residual(agglomerate_operator.m());
+  for (unsigned int i = 0; i < eigenvectors.size(); ++i)
+  {
+    agglomerate_operator.vmult(residual, eigenvectors[i]);
+    residual.add(-eigenvalues[i].real(), eigenvectors[i]);
+    double const norm = eigenvectors[i].l2_norm();
+    if (norm > 0.)
+      max_residual = std::max(max_residual, residual.l2_norm() / norm);
+  }
+
+  return max_residual;
+}
+
+// Return the permutation new_indices[old] = new of the DoFs of an agglomerate.
+// "cuthill_mckee" reduces the bandwidth of the local matrix and "global"
+// orders the DoFs by global index, which keeps the locality of the global
+// numbering and sorts the columns of the rows of the restrictor.
+std::vector<dealii::types::global_dof_index> compute_agglomerate_renumbering(
+    std::string const &dof_renumbering,
+    dealii::SparsityPattern const &sparsity_pattern,
+    std::vector<dealii::types::global_dof_index> const &dof_indices_map)
+{
+  unsigned int const n_dofs = dof_indices_map.size();
+  std::vector<dealii::types::global_dof_index> new_indices(n_dofs);
+  if (dof_renumbering == "cuthill_mckee")
+  {
+    dealii::DynamicSparsityPattern dsp(n_dofs);
+    for (auto const &entry : sparsity_pattern)
+      dsp.add(entry.row(), entry.column());
+    dealii::SparsityTools::reorder_Cuthill_McKee(dsp, new_indices);
+  }
+  else if (dof_renumbering == "global")
+  {
+    std::vector<unsigned int> old_indices(n_dofs);
+    std::iota(old_indices.begin(), old_indices.end(), 0);
+    std::sort(old_indices.begin(), old_indices.end(),
+              [&](unsigned int const a, unsigned int const b) {
+                return dof_indices_map[a] < dof_indices_map[b];
+              });
+    for (unsigned int i = 0; i < n_dofs; ++i)
+      new_indices[old_indices[i]] = i;
+  }
+  else
+    ASSERT_THROW(false, dof_renumbering +
+                            " is not a valid choice for the DoF renumbering. "
+                            "The acceptable values are none, cuthill_mckee, "
+                            "and global.");
+
+  return new_indices;
+}
+
+// Apply the permutation new_indices[old] = new to the rows and the columns of
+// the local system matrix
+template <typename ScalarType>
+void permute_agglomerate_matrix(
+    std::vector<dealii::types::global_dof_index> const &new_indices,
+    dealii::SparsityPattern &sparsity_pattern,
+    dealii::SparseMatrix<ScalarType> &system_matrix)
+{
+  unsigned int const n_dofs = new_indices.size();
+  dealii::DynamicSparsityPattern dsp(n_dofs);
+  std::vector<std::tuple<unsigned int, unsigned int, ScalarType>> entries;
+  entries.reserve(system_matrix.n_nonzero_elements());
+  for (auto const &entry : system_matrix)
+  {
+    unsigned int const row = new_indices[entry.row()];
+    unsigned int const column = new_indices[entry.column()];
+    dsp.add(row, column);
+    entries.emplace_back(row, column, entry.value());
+  }
+
+  system_matrix.clear();
+  sparsity_pattern.copy_from(dsp);
+  system_matrix.reinit(sparsity_pattern);
+  for (auto const &entry : entries)
+    system_matrix.set(std::get<0>(entry), std::get<1>(entry),
+                      std::get<2>(entry));
+}
 } // namespace
 
+template <typename ScalarType>
+std::tuple<std::vector<std::complex<double>>,
+           std::vector<dealii::Vector<double>>>
+compute_agglomerate_eigenpairs(
+    unsigned int n_eigenvectors, double tolerance,
+    boost::property_tree::ptree const &eigensolver_params,
+    dealii::SparseMatrix<ScalarType> &agglomerate_system_matrix,
+    std::vector<unsigned int> const &constrained_dofs,
+    dealii::Vector<double> const &initial_vector,
+    LobpcgScratchData const &scratch_data, AgglomerateStatistics *statistics)
+{
+  // Shift eigenvalues away from zero
+  unsigned int const n_dofs_agglomerate = agglomerate_system_matrix.m();
+  double average_diagonal = 0.;
+  for (unsigned int i = 0; i < n_dofs_agglomerate; ++i)
+    average_diagonal += agglomerate_system_matrix.diag_element(i);
+  average_diagonal /= n_dofs_agglomerate;
+  for (unsigned int i = 0; i < n_dofs_agglomerate; ++i)
+    agglomerate_system_matrix.diag_element(i) += average_diagonal;
+  // Shift diagonal entries for constrained degrees of freedom, to avoid
+  // using the corresponding eigenvectors
+  for (auto const index : constrained_dofs)
+    agglomerate_system_matrix.diag_element(index) = 200;
+
+  // Compute the eigenvalues and the eigenvectors
+  std::vector<std::complex<double>> eigenvalues(n_eigenvectors);
+  // Arpack only works with double not float
+  std::vector<dealii::Vector<double>> eigenvectors(
+      n_eigenvectors, dealii::Vector<double>(n_dofs_agglomerate));
+
+  auto const eigensolver_type =
+      eigensolver_params.get<std::string>("type", "arpack");
+  CountingOperator<dealii::SparseMatrix<ScalarType>> counting_operator(
+      agglomerate_system_matrix);
+  unsigned int n_iterations = 0;
+  unsigned int n_applies = 0;
+  {
+    TraceScope eigensolve_scope("AMGe: eigensolve",
+                                {{"n_dofs", n_dofs_agglomerate}});
+    if (eigensolver_type == "arpack")
+    {
+      // Make Identity mass matrix
+      Identity agglomerate_mass_matrix;
+
+      dealii::SparseDirectUMFPACK inv_system_matrix;
+      inv_system_matrix.initialize(agglomerate_system_matrix);
+      CountingOperator<dealii::SparseDirectUMFPACK> counting_inverse(
+          inv_system_matrix);
+
+      dealii::SolverControl solver_control(n_dofs_agglomerate, tolerance);
+      unsigned int const n_arnoldi_vectors = 2 * n_eigenvectors + 2;
+      bool const symmetric = true;
+      // We want the eigenvalues of the smallest magnitudes but we need to ask
+      // for the ones with the largest magnitudes because they are computed for
+      // the inverse of the matrix we care about.
+      auto const which_eigenvalues =
+          dealii::ArpackSolver::WhichEigenvalues::largest_magnitude;
+      dealii::ArpackSolver::AdditionalData additional_data(
+          n_arnoldi_vectors, which_eigenvalues, symmetric);
+      dealii::ArpackSolver solver(solver_control, additional_data);
+
+      // Compute the eigenvectors. Arpack outputs eigenvectors with a L2 norm of
+      // one.
+      solver.set_initial_vector(initial_vector);
+      solver.solve(agglomerate_system_matrix, agglomerate_mass_matrix,
+                   counting_inverse, eigenvalues, eigenvectors);
+      n_iterations = solver_control.last_step();
+      n_applies = counting_inverse.n_applies();
+    }
+    else if (eigensolver_type == "lanczos")
+    {
+      // Lanczos applies the operator once per iteration
+      lanczos_compute_eigenvalues_and_eigenvectors(
+          n_eigenvectors, tolerance, eigensolver_params, counting_operator,
+          initial_vector, eigenvalues, eigenvectors);
+      n_iterations = counting_operator.n_applies();
+      n_applies = n_iterations;
+    }
+    else if (eigensolver_type == "anasazi")
+    {
+      anasazi_compute_eigenvalues_and_eigenvectors(
+          n_eigenvectors, eigensolver_params, counting_operator,
+          initial_vector, scratch_data.lobpcg_init_guess, eigenvalues,
+          eigenvectors, n_iterations);
+      n_applies = counting_operator.n_applies();
+    }
+    else if (eigensolver_type == "lapack")
+    {
+      // Use Lapack to compute the eigenvalues
+      dealii::LAPACKFullMatrix<double> full_matrix;
+      full_matrix.copy_from(agglomerate_system_matrix);
+
+      double const lower_bound = -0.5;
+      double const upper_bound = 100.;
+      double const tol = 1e-12;
+      dealii::Vector<double> lapack_eigenvalues(n_dofs_agglomerate);
+      dealii::FullMatrix<double> lapack_eigenvectors;
+      full_matrix.compute_eigenvalues_symmetric(lower_bound, upper_bound, tol,
+                                                lapack_eigenvalues,
+                                                lapack_eigenvectors);
+
+      // Copy the eigenvalues and the eigenvectors in the right format
+      for (unsigned int i = 0; i < n_eigenvectors; ++i)
+        eigenvalues[i] = lapack_eigenvalues[i];
+
+      for (unsigned int i = 0; i < n_eigenvectors; ++i)
+        for (unsigned int j = 0; j < n_dofs_agglomerate; ++j)
+          eigenvectors[i][j] = lapack_eigenvectors[j][i];
+    }
+    else
+    {
+      ASSERT(false, "Unknown eigensolver type '" + eigensolver_type + "'");
+    }
+    eigensolve_scope.add_argument("iterations", n_iterations);
+  }
+
+  if (statistics != nullptr)
+  {
+    statistics->n_iterations = n_iterations;
+    statistics->n_operator_applies = n_applies;
+    statistics->residual = compute_max_residual(agglomerate_system_matrix,
+                                                eigenvalues, eigenvectors);
+  }
+
+  // Shift eigenvalues back
+  for (unsigned int i = 0; i < n_eigenvectors; ++i)
+    eigenvalues[i] -= average_diagonal;
+
+  select_agglomerate_eigenpairs(eigensolver_params, average_diagonal,
+                                eigenvalues, eigenvectors);
+
+  return std::make_tuple(eigenvalues, eigenvectors);
+}
+
 template <int dim, typename MeshEvaluator, typename VectorType>
 template <typename Triangulation>
 std::tuple<std::vector<std::complex<double>>,
@@ -288,6 +574,7 @@ AMGe_host<dim, MeshEvaluator, VectorType>::compute_local_eigenvectors(
              typename dealii::DoFHandler<dim>::active_cell_iterator> const
         &patch_to_global_map,
     MeshEvaluator const &evaluator, LobpcgScratchData const &scratch_data,
+    AgglomerateStatistics *statistics,
     typename std::enable_if_t<is_matrix_free<MeshEvaluator>::value &&
                                   std::is_class<Triangulation>::value,
                               int>) const
@@ -311,34 +598,57 @@ AMGe_host<dim, MeshEvaluator, VectorType>::compute_local_eigenvectors(
       _eigensolver_params.get<std::string>("type", "lanczos");
   dealii::Vector<double> initial_vector(n_dofs_agglomerate);
   evaluator.set_initial_guess(agglomerate_constraints, initial_vector);
-  if (eigensolver_type == "lanczos")
+  CountingOperator<AgglomerateOperator> counting_operator(agglomerate_operator);
+  unsigned int n_iterations = 0;
   {
-    lanczos_compute_eigenvalues_and_eigenvectors(
-        n_eigenvectors, tolerance, _eigensolver_params, agglomerate_operator,
-        initial_vector, eigenvalues, eigenvectors);
-  }
-  else if (eigensolver_type == "anasazi")
-  {
-    anasazi_compute_eigenvalues_and_eigenvectors(
-        n_eigenvectors, _eigensolver_params, agglomerate_operator,
-        initial_vector, scratch_data.lobpcg_init_guess, eigenvalues,
-        eigenvectors);
-  }
-  else if (eigensolver_type == "arpack")
-  {
-    throw std::runtime_error(
-        "ARPACK not available as eigensolver in matrix-free mode");
-  }
-  else if (eigensolver_type == "lapack")
-  {
-    throw std::runtime_error(
-        "LAPACK not available as eigensolver in matrix-free mode");
+    TraceScope eigensolve_scope("AMGe: eigensolve",
+                                {{"n_dofs", n_dofs_agglomerate}});
+    if (eigensolver_type == "lanczos")
+    {
+      // Lanczos applies the operator once per iteration
+      lanczos_compute_eigenvalues_and_eigenvectors(
+          n_eigenvectors, tolerance, _eigensolver_params, counting_operator,
+          initial_vector, eigenvalues, eigenvectors);
+      n_iterations = counting_operator.n_applies();
+    }
+    else if (eigensolver_type == "anasazi")
+    {
+      anasazi_compute_eigenvalues_and_eigenvectors(
+          n_eigenvectors, _eigensolver_params, counting_operator,
+          initial_vector, scratch_data.lobpcg_init_guess, eigenvalues,
+          eigenvectors, n_iterations);
+    }
+    else if (eigensolver_type == "arpack")
+    {
+      throw std::runtime_error(
+          "ARPACK not available as eigensolver in matrix-free mode");
+    }
+    else if (eigensolver_type == "lapack")
+    {
+      throw std::runtime_error(
+          "LAPACK not available as eigensolver in matrix-free mode");
+    }
+    else
+    {
+      ASSERT(false, "Unknown eigensolver type '" + eigensolver_type + "'");
+    }
+    eigensolve_scope.add_argument("iterations", n_iterations);
   }
-  else
+
+  if (statistics != nullptr)
   {
-    ASSERT(false, "Unknown eigensolver type '" + eigensolver_type + "'");
+    statistics->n_iterations = n_iterations;
+    statistics->n_operator_applies = counting_operator.n_applies();
+    statistics->residual =
+        compute_max_residual(agglomerate_operator, eigenvalues, eigenvectors);
   }
 
+  double const average_diagonal =
+      std::accumulate(diag_elements.begin(), diag_elements.end(), 0.) /
+      n_dofs_agglomerate;
+  select_agglomerate_eigenpairs(_eigensolver_params, average_diagonal,
+                                eigenvalues, eigenvectors);
+
   // Compute the map between the local and the global dof indices.
   std::vector<dealii::types::global_dof_index> dof_indices_map =
       this->compute_dof_index_map(patch_to_global_map, agglomerate_dof_handler);
@@ -360,6 +670,7 @@ AMGe_host<dim, MeshEvaluator, VectorType>::compute_local_eigenvectors(
              typename dealii::DoFHandler<dim>::active_cell_iterator> const
         &patch_to_global_map,
     MeshEvaluator const &evaluator, LobpcgScratchData const &scratch_data,
+    AgglomerateStatistics *statistics,
     typename std::enable_if_t<!is_matrix_free<MeshEvaluator>::value &&
                                   std::is_class<Triangulation>::value,
                               int>) const
@@ -371,112 +682,58 @@ AMGe_host<dim, MeshEvaluator, VectorType>::compute_local_eigenvectors(
   dealii::SparseMatrix<value_type> agglomerate_system_matrix;
 
   // Call user function to build the system matrix
-  evaluator.evaluate_agglomerate(
-      agglomerate_dof_handler, agglomerate_constraints,
-      agglomerate_sparsity_pattern, agglomerate_system_matrix);
-
-  // Get the diagonal elements
-  unsigned int const size = agglomerate_system_matrix.m();
-  std::vector<ScalarType> diag_elements(size);
-  for (unsigned int i = 0; i < size; ++i)
-    diag_elements[i] = agglomerate_system_matrix.diag_element(i);
-
-  // Shift eigenvalues away from zero
-  double const average_diagonal =
-      std::accumulate(diag_elements.begin(), diag_elements.end(), 0.) / size;
-  for (unsigned int i = 0; i < size; ++i)
-    agglomerate_system_matrix.diag_element(i) += average_diagonal;
-  // Shift diagonal entries for constrained degrees of freedom, to avoid
-  // using the corresponding eigenvectors
-  for (auto const constraint : agglomerate_constraints.get_lines())
   {
-    agglomerate_system_matrix.diag_element(constraint.index) = 200;
+    TraceScope evaluate_scope("AMGe: evaluate agglomerate");
+    evaluator.evaluate_agglomerate(
+        agglomerate_dof_handler, agglomerate_constraints,
+        agglomerate_sparsity_pattern, agglomerate_system_matrix);
   }
 
-  // Compute the eigenvalues and the eigenvectors
-  unsigned int const n_dofs_agglomerate = agglomerate_system_matrix.m();
-  std::vector<std::complex<double>> eigenvalues(n_eigenvectors);
-  // Arpack only works with double not float
-  std::vector<dealii::Vector<double>> eigenvectors(
-      n_eigenvectors, dealii::Vector<double>(n_dofs_agglomerate));
+  // Compute the map between the local and the global dof indices.
+  std::vector<dealii::types::global_dof_index> dof_indices_map =
+      this->compute_dof_index_map(patch_to_global_map, agglomerate_dof_handler);
 
-  dealii::Vector<double> initial_vector(n_dofs_agglomerate);
+  unsigned int const size = agglomerate_system_matrix.m();
+  std::vector<unsigned int> constrained_dofs;
+  for (auto const constraint : agglomerate_constraints.get_lines())
+    constrained_dofs.push_back(constraint.index);
+  dealii::Vector<double> initial_vector(size);
   evaluator.set_initial_guess(agglomerate_constraints, initial_vector);
-  auto const eigensolver_type =
-      _eigensolver_params.get<std::string>("type", "arpack");
-  if (eigensolver_type == "arpack")
-  {
-    // Make Identity mass matrix
-    Identity agglomerate_mass_matrix;
-
-    dealii::SparseDirectUMFPACK inv_system_matrix;
-    inv_system_matrix.initialize(agglomerate_system_matrix);
-
-    dealii::SolverControl solver_control(n_dofs_agglomerate, tolerance);
-    unsigned int const n_arnoldi_vectors = 2 * n_eigenvectors + 2;
-    bool const symmetric = true;
-    // We want the eigenvalues of the smallest magnitudes but we need to ask
-    // for the ones with the largest magnitudes because they are computed for
-    // the inverse of the matrix we care about.
-    auto const which_eigenvalues =
-        dealii::ArpackSolver::WhichEigenvalues::largest_magnitude;
-    dealii::ArpackSolver::AdditionalData additional_data(
-        n_arnoldi_vectors, which_eigenvalues, symmetric);
-    dealii::ArpackSolver solver(solver_control, additional_data);
-
-    // Compute the eigenvectors. Arpack outputs eigenvectors with a L2 norm of
-    // one.
-    solver.set_initial_vector(initial_vector);
-    solver.solve(agglomerate_system_matrix, agglomerate_mass_matrix,
-                 inv_system_matrix, eigenvalues, eigenvectors);
-  }
-  else if (eigensolver_type == "lanczos")
-  {
-    lanczos_compute_eigenvalues_and_eigenvectors(
-        n_eigenvectors, tolerance, _eigensolver_params,
-        agglomerate_system_matrix, initial_vector, eigenvalues, eigenvectors);
-  }
-  else if (eigensolver_type == "anasazi")
-  {
-    anasazi_compute_eigenvalues_and_eigenvectors(
-        n_eigenvectors, _eigensolver_params, agglomerate_system_matrix,
-        initial_vector, scratch_data.lobpcg_init_guess, eigenvalues,
-        eigenvectors);
-  }
-  else if (eigensolver_type == "lapack")
-  {
-    // Use Lapack to compute the eigenvalues
-    dealii::LAPACKFullMatrix<double> full_matrix;
-    full_matrix.copy_from(agglomerate_system_matrix);
-
-    double const lower_bound = -0.5;
-    double const upper_bound = 100.;
-    double const tol = 1e-12;
-    dealii::Vector<double> lapack_eigenvalues(size);
-    dealii::FullMatrix<double> lapack_eigenvectors;
-    full_matrix.compute_eigenvalues_symmetric(
-        lower_bound, upper_bound, tol, lapack_eigenvalues, lapack_eigenvectors);
-
-    // Copy the eigenvalues and the eigenvectors in the right format
-    for (unsigned int i = 0; i < n_eigenvectors; ++i)
-      eigenvalues[i] = lapack_eigenvalues[i];
 
-    for (unsigned int i = 0; i < n_eigenvectors; ++i)
-      for (unsigned int j = 0; j < n_dofs_agglomerate; ++j)
-        eigenvectors[i][j] = lapack_eigenvectors[j][i];
-  }
-  else
+  // The DoFs are numbered by the evaluator so the local problem is renumbered
+  // after the assembly. The constraints are not used past this point and are
+  // not renumbered.
+  std::string const dof_renumbering =
+      _eigensolver_params.get("dof_renumbering", "none");
+  if (dof_renumbering != "none")
   {
-    ASSERT(false, "Unknown eigensolver type '" + eigensolver_type + "'");
+    TraceScope renumbering_scope("AMGe: renumber agglomerate");
+    auto const new_indices = compute_agglomerate_renumbering(
+        dof_renumbering, agglomerate_sparsity_pattern, dof_indices_map);
+    permute_agglomerate_matrix(new_indices, agglomerate_sparsity_pattern,
+                               agglomerate_system_matrix);
+    auto const old_dof_indices_map = dof_indices_map;
+    dealii::Vector<double> const old_initial_vector = initial_vector;
+    for (unsigned int i = 0; i < size; ++i)
+    {
+      dof_indices_map[new_indices[i]] = old_dof_indices_map[i];
+      initial_vector[new_indices[i]] = old_initial_vector[i];
+    }
+    for (auto &dof : constrained_dofs)
+      dof = new_indices[dof];
   }
 
-  // Shift eigenvalues back
-  for (unsigned int i = 0; i < n_eigenvectors; ++i)
-    eigenvalues[i] -= average_diagonal;
+  // Get the diagonal elements
+  std::vector<ScalarType> diag_elements(size);
+  for (unsigned int i = 0; i < size; ++i)
+    diag_elements[i] = agglomerate_system_matrix.diag_element(i);
 
-  // Compute the map between the local and the global dof indices.
-  std::vector<dealii::types::global_dof_index> dof_indices_map =
-      this->compute_dof_index_map(patch_to_global_map, agglomerate_dof_handler);
+  // Compute the eigenvalues and the eigenvectors
+  std::vector<std::complex<double>> eigenvalues;
+  std::vector<dealii::Vector<double>> eigenvectors;
+  std::tie(eigenvalues, eigenvectors) = compute_agglomerate_eigenpairs(
+      n_eigenvectors, tolerance, _eigensolver_params, agglomerate_system_matrix,
+      constrained_dofs, initial_vector, scratch_data, statistics);
 
   return std::make_tuple(eigenvalues, eigenvectors, diag_elements,
                          dof_indices_map);
@@ -494,29 +751,37 @@ void AMGe_host<dim, MeshEvaluator, VectorType>::setup_restrictor(
   // Flag the cells to build agglomerates.
   unsigned int const n_agglomerates =
       this->build_agglomerates(agglomerate_ptree);
+  _agglomerate_statistics.clear();
+
+  if (agglomerate_ptree.get("streaming", false))
+  {
+    setup_restrictor_streaming(agglomerate_ptree, n_agglomerates,
+                               n_eigenvectors, tolerance, evaluator,
+                               locally_relevant_global_diag,
+                               restriction_sparse_matrix, nullptr, nullptr,
+                               nullptr);
+
+    return;
+  }
+
+  // Parallel part of the setup. The agglomerates are not processed in order so
+  // their data is stored by agglomerate id and gathered afterwards.
+  std::vector<CopyData> agglomerate_data(n_agglomerates);
+  compute_agglomerate_eigenvectors(
+      agglomerate_ptree, n_agglomerates, n_eigenvectors, tolerance, evaluator,
+      [&](CopyData &local_copy_data) {
+        agglomerate_data[local_copy_data.statistics.agglomerate_id - 1] =
+            std::move(local_copy_data);
+      });
 
-  // Parallel part of the setup.
-  std::vector<unsigned int> agglomerate_ids(n_agglomerates);
-  std::iota(agglomerate_ids.begin(), agglomerate_ids.end(), 1);
   std::vector<dealii::Vector<double>> eigenvectors;
   std::vector<std::vector<ScalarType>> diag_elements;
   std::vector<std::vector<dealii::types::global_dof_index>> dof_indices_maps;
   std::vector<unsigned int> n_local_eigenvectors;
-  LobpcgScratchData scratch_data;
-  CopyData copy_data;
-
-  dealii::WorkStream::run(
-      agglomerate_ids.begin(), agglomerate_ids.end(),
-      [&](std::vector<unsigned int>::iterator const &agg_id,
-          LobpcgScratchData &local_scratch_data, CopyData &local_copy_data) {
-        this->local_worker(n_eigenvectors, tolerance, evaluator, agg_id,
-                           local_scratch_data, local_copy_data);
-      },
-      [&](CopyData const &local_copy_data) {
-        this->copy_local_to_global(local_copy_data, eigenvectors, diag_elements,
-                                   dof_indices_maps, n_local_eigenvectors);
-      },
-      scratch_data, copy_data);
+  for (auto &local_copy_data : agglomerate_data)
+    copy_local_to_global(local_copy_data, eigenvectors, diag_elements,
+                         dof_indices_maps, n_local_eigenvectors);
+  agglomerate_data.clear();
 
   AMGe<dim, VectorType>::compute_restriction_sparse_matrix(
       eigenvectors, diag_elements, dof_indices_maps, n_local_eigenvectors,
@@ -552,30 +817,42 @@ void AMGe_host<dim, MeshEvaluator, VectorType>::setup_restrictor(
   // Flag the cells to build agglomerates.
   unsigned int const n_agglomerates =
       this->build_agglomerates(agglomerate_ptree);
+  _agglomerate_statistics.clear();
+
+  if (agglomerate_ptree.get("streaming", false))
+  {
+    eigenvector_sparse_matrix =
+        std::make_unique<dealii::TrilinosWrappers::SparseMatrix>();
+    delta_eigenvector_matrix =
+        std::make_unique<dealii::TrilinosWrappers::SparseMatrix>();
+    setup_restrictor_streaming(
+        agglomerate_ptree, n_agglomerates, n_eigenvectors, tolerance, evaluator,
+        locally_relevant_global_diag, *restriction_sparse_matrix,
+        eigenvector_sparse_matrix.get(), delta_eigenvector_matrix.get(),
+        &eigenvalues);
+
+    return;
+  }
+
+  // Parallel part of the setup. The agglomerates are not processed in order so
+  // their data is stored by agglomerate id and gathered afterwards.
+  std::vector<CopyData> agglomerate_data(n_agglomerates);
+  compute_agglomerate_eigenvectors(
+      agglomerate_ptree, n_agglomerates, n_eigenvectors, tolerance, evaluator,
+      [&](CopyData &local_copy_data) {
+        agglomerate_data[local_copy_data.statistics.agglomerate_id - 1] =
+            std::move(local_copy_data);
+      });
 
-  // Parallel part of the setup.
-  std::vector<unsigned int> agglomerate_ids(n_agglomerates);
-  std::iota(agglomerate_ids.begin(), agglomerate_ids.end(), 1);
   std::vector<dealii::Vector<double>> eigenvectors;
   std::vector<std::vector<ScalarType>> diag_elements;
   std::vector<std::vector<dealii::types::global_dof_index>> dof_indices_maps;
   std::vector<unsigned int> n_local_eigenvectors;
-  LobpcgScratchData scratch_data;
-  CopyData copy_data;
-
-  dealii::WorkStream::run(
-      agglomerate_ids.begin(), agglomerate_ids.end(),
-      [&](std::vector<unsigned int>::iterator const &agg_id,
-          LobpcgScratchData &local_scratch_data, CopyData &local_copy_data) {
-        this->local_worker(n_eigenvectors, tolerance, evaluator, agg_id,
-                           local_scratch_data, local_copy_data);
-      },
-      [&](CopyData const &local_copy_data) {
-        this->copy_local_to_global_eig(local_copy_data, eigenvalues,
-                                       eigenvectors, diag_elements,
-                                       dof_indices_maps, n_local_eigenvectors);
-      },
-      scratch_data, copy_data);
+  for (auto &local_copy_data : agglomerate_data)
+    copy_local_to_global_eig(local_copy_data, eigenvalues, eigenvectors,
+                             diag_elements, dof_indices_maps,
+                             n_local_eigenvectors);
+  agglomerate_data.clear();
 
   AMGe<dim, VectorType>::compute_restriction_sparse_matrix(
       eigenvectors, diag_elements, dof_indices_maps, n_local_eigenvectors,
@@ -583,6 +860,423 @@ void AMGe_host<dim, MeshEvaluator, VectorType>::setup_restrictor(
       eigenvector_sparse_matrix, delta_eigenvector_matrix);
 }
 
+template <int dim, typename MeshEvaluator, typename VectorType>
+unsigned int AMGe_host<dim, MeshEvaluator, VectorType>::update_restrictor(
+    boost::property_tree::ptree const &agglomerate_ptree,
+    std::vector<unsigned int> const &agglomerate_ids,
+    std::vector<unsigned int> const &changed_cells,
+    std::vector<unsigned int> const &n_local_eigenvectors,
+    unsigned int const n_eigenvectors, double const tolerance,
+    MeshEvaluator const &evaluator,
+    dealii::LinearAlgebra::distributed::Vector<
+        typename VectorType::value_type> const
+        &old_locally_relevant_global_diag,
+    dealii::LinearAlgebra::distributed::Vector<
+        typename VectorType::value_type> const &locally_relevant_global_diag,
+    dealii::TrilinosWrappers::SparseMatrix &restriction_sparse_matrix)
+{
+  TraceScope scope("AMGe: update restrictor",
+                   {{"n_changed_cells", changed_cells.size()}});
+  unsigned int const n_agglomerates = this->set_agglomerates(agglomerate_ids);
+  ASSERT_THROW(n_agglomerates == n_local_eigenvectors.size(),
+               "There are " + std::to_string(n_agglomerates) +
+                   " agglomerates but the restriction matrix was built for " +
+                   std::to_string(n_local_eigenvectors.size()));
+  std::vector<dealii::types::global_dof_index> first_rows(
+      n_agglomerates + 1, restriction_sparse_matrix.local_range().first);
+  for (unsigned int i = 0; i < n_agglomerates; ++i)
+    first_rows[i + 1] = first_rows[i] + n_local_eigenvectors[i];
+  ASSERT_THROW(first_rows.back() ==
+                   restriction_sparse_matrix.local_range().second,
+               "The rows of the restriction matrix do not match the "
+               "eigenvectors of the agglomerates");
+
+  // The local matrix of an agglomerate is assembled from its own cells so only
+  // the agglomerates that contain a changed cell have new eigenvectors.
+  std::vector<bool> is_changed(
+      this->_dof_handler.get_triangulation().n_active_cells(), false);
+  for (auto const cell_index : changed_cells)
+  {
+    ASSERT_THROW(cell_index < is_changed.size(),
+                 "Invalid active cell index " + std::to_string(cell_index));
+    is_changed[cell_index] = true;
+  }
+  std::vector<bool> is_dirty(n_agglomerates, false);
+  for (auto cell : dealii::filter_iterators(
+           this->_dof_handler.active_cell_iterators(),
+           dealii::IteratorFilters::LocallyOwnedCell()))
+    if (is_changed[cell->active_cell_index()])
+      is_dirty[cell->user_index() - 1] = true;
+  std::vector<unsigned int> dirty_agglomerates;
+  for (unsigned int i = 0; i < n_agglomerates; ++i)
+    if (is_dirty[i])
+      dirty_agglomerates.push_back(i + 1);
+  scope.add_argument("n_dirty_agglomerates", dirty_agglomerates.size());
+
+  // The other rows keep their eigenvectors but their weights, the ratios of
+  // the local and the global diagonals, change wherever the global diagonal
+  // does, i.e., on the DoFs of the changed cells of all the processors.
+  // All the columns are rescaled. The rows of the dirty agglomerates are
+  // overwritten afterwards.
+  dealii::IndexSet const &locally_owned_dofs =
+      this->_dof_handler.locally_owned_dofs();
+  std::vector<dealii::types::global_dof_index> dof_indices;
+  std::vector<double> diag_ratios;
+  dof_indices.reserve(locally_owned_dofs.n_elements());
+  diag_ratios.reserve(locally_owned_dofs.n_elements());
+  for (auto const dof : locally_owned_dofs)
+  {
+    dof_indices.push_back(dof);
+    diag_ratios.push_back(old_locally_relevant_global_diag[dof] /
+                          locally_relevant_global_diag[dof]);
+  }
+  dealii::TrilinosWrappers::MPI::Vector vector_diag_ratios(locally_owned_dofs,
+                                                           this->_comm);
+  vector_diag_ratios.set(dof_indices, diag_ratios);
+  vector_diag_ratios.compress(dealii::VectorOperation::insert);
+  Epetra_MultiVector &diag_ratios_multi_vector =
+      vector_diag_ratios.trilinos_vector();
+  auto &restriction_matrix = const_cast<Epetra_CrsMatrix &>(
+      restriction_sparse_matrix.trilinos_matrix());
+  int const error_code =
+      restriction_matrix.RightScale(*diag_ratios_multi_vector(0));
+  if (error_code != 0)
+    ASSERT_THROW(false, "Non-zero error code (" + std::to_string(error_code) +
+                            ") returned by Epetra_CrsMatrix::RightScale()");
+
+  // The entries of the rows already exist so they are replaced. The rows are
+  // written by a single thread at a time.
+  _agglomerate_statistics.clear();
+  std::mutex set_mutex;
+  std::vector<unsigned int> resized_agglomerates;
+  std::vector<double> values;
+  compute_agglomerate_eigenvectors(
+      agglomerate_ptree, n_agglomerates, dirty_agglomerates, n_eigenvectors,
+      tolerance, evaluator, [&](CopyData &local_copy_data) {
+        TraceScope copy_scope("AMGe: copy local to global");
+        std::lock_guard<std::mutex> lock(set_mutex);
+        unsigned int const agglomerate_id =
+            local_copy_data.statistics.agglomerate_id;
+        _agglomerate_statistics.push_back(local_copy_data.statistics);
+        auto const &local_eigenvectors = local_copy_data.local_eigenvectors;
+        if (local_eigenvectors.size() !=
+            n_local_eigenvectors[agglomerate_id - 1])
+        {
+          resized_agglomerates.push_back(agglomerate_id);
+          return;
+        }
+
+        auto const &dof_indices_map = local_copy_data.local_dof_indices_map;
+        unsigned int const n_elem = dof_indices_map.size();
+        values.resize(n_elem);
+        for (unsigned int k = 0; k < local_eigenvectors.size(); ++k)
+        {
+          for (unsigned int j = 0; j < n_elem; ++j)
+            values[j] = local_copy_data.diag_elements[j] /
+                        locally_relevant_global_diag[dof_indices_map[j]] *
+                        local_eigenvectors[k][j];
+          restriction_sparse_matrix.set(first_rows[agglomerate_id - 1] + k,
+                                        n_elem, dof_indices_map.data(),
+                                        values.data(), false);
+        }
+      });
+  restriction_sparse_matrix.compress(dealii::VectorOperation::insert);
+
+  std::sort(_agglomerate_statistics.begin(), _agglomerate_statistics.end(),
+            [](AgglomerateStatistics const &a, AgglomerateStatistics const &b) {
+              return a.agglomerate_id < b.agglomerate_id;
+            });
+  if (!resized_agglomerates.empty())
+    ASSERT_THROW(false, "The number of eigenvectors of agglomerate " +
+                            std::to_string(resized_agglomerates.front()) +
+                            " changed, the restrictor needs to be rebuilt");
+
+  return dirty_agglomerates.size();
+}
+
+template <int dim, typename MeshEvaluator, typename VectorType>
+std::vector<int>
+AMGe_host<dim, MeshEvaluator, VectorType>::compute_agglomerate_n_dofs(
+    unsigned int const n_agglomerates) const
+{
+  // Store the DoF indices of the cells of each agglomerate contiguously. This
+  // requires two passes over the cells but a single allocation.
+  // The cells of an agglomerate are not necessarily locally owned if the
+  // agglomerates span several processors.
+  unsigned int const dofs_per_cell = this->_dof_handler.get_fe().dofs_per_cell;
+  auto filtered_iterators_range = filter_iterators(
+      this->_dof_handler.active_cell_iterators(),
+      [](auto const &cell) { return cell->user_index() > 0; });
+  std::vector<unsigned int> offsets(n_agglomerates + 1, 0);
+  for (auto cell : filtered_iterators_range)
+    offsets[cell->user_index()] += dofs_per_cell;
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+  std::vector<dealii::types::global_dof_index> dof_indices(offsets.back());
+  std::vector<unsigned int> positions(offsets.begin(), offsets.end() - 1);
+  std::vector<dealii::types::global_dof_index> cell_dof_indices(dofs_per_cell);
+  for (auto cell : filtered_iterators_range)
+  {
+    cell->get_dof_indices(cell_dof_indices);
+    auto &position = positions[cell->user_index() - 1];
+    std::copy(cell_dof_indices.begin(), cell_dof_indices.end(),
+              dof_indices.begin() + position);
+    position += dofs_per_cell;
+  }
+
+  std::vector<int> n_dofs(n_agglomerates);
+  for (unsigned int i = 0; i < n_agglomerates; ++i)
+  {
+    auto const begin = dof_indices.begin() + offsets[i];
+    auto const end = dof_indices.begin() + offsets[i + 1];
+    std::sort(begin, end);
+    n_dofs[i] = std::distance(begin, std::unique(begin, end));
+  }
+
+  return n_dofs;
+}
+
+template <int dim, typename MeshEvaluator, typename VectorType>
+void AMGe_host<dim, MeshEvaluator, VectorType>::setup_restrictor_streaming(
+    boost::property_tree::ptree const &agglomerate_ptree,
+    unsigned int const n_agglomerates, unsigned int const n_eigenvectors,
+    double const tolerance, MeshEvaluator const &evaluator,
+    dealii::LinearAlgebra::distributed::Vector<
+        typename VectorType::value_type> const &locally_relevant_global_diag,
+    dealii::TrilinosWrappers::SparseMatrix &restriction_sparse_matrix,
+    dealii::TrilinosWrappers::SparseMatrix *eigenvector_sparse_matrix,
+    dealii::TrilinosWrappers::SparseMatrix *delta_eigenvector_matrix,
+    std::vector<double> *eigenvalues)
+{
+  TraceScope scope("AMGe: streaming restrictor",
+                   {{"n_agglomerates", n_agglomerates}});
+  bool const adaptive =
+      _eigensolver_params.get_optional<double>("eigenvalue threshold") ||
+      _eigensolver_params.get_optional<double>("eigenvalue gap");
+  ASSERT_THROW(!adaptive, "The streaming setup requires the same number of "
+                          "eigenvectors for every agglomerate");
+
+  // Every agglomerate contributes n_eigenvectors rows so the row partition is
+  // known before any eigenvector has been computed.
+  int const n_procs = dealii::Utilities::MPI::n_mpi_processes(this->_comm);
+  int const rank = dealii::Utilities::MPI::this_mpi_process(this->_comm);
+  unsigned int const n_local_rows = n_agglomerates * n_eigenvectors;
+  std::vector<unsigned int> n_rows_per_proc(n_procs);
+  n_rows_per_proc[rank] = n_local_rows;
+  MPI_Allgather(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, &n_rows_per_proc[0], 1,
+                MPI_UNSIGNED, this->_comm);
+  dealii::types::global_dof_index const n_total_rows =
+      std::accumulate(n_rows_per_proc.begin(), n_rows_per_proc.end(),
+                      static_cast<dealii::types::global_dof_index>(0));
+  dealii::types::global_dof_index const n_rows_before =
+      std::accumulate(n_rows_per_proc.begin(), n_rows_per_proc.begin() + rank,
+                      static_cast<dealii::types::global_dof_index>(0));
+  dealii::IndexSet row_indexset(n_total_rows);
+  row_indexset.add_range(n_rows_before, n_rows_before + n_local_rows);
+  row_indexset.compress();
+  Epetra_Map const row_map = row_indexset.make_trilinos_map(this->_comm, false);
+  Epetra_Map const domain_map =
+      this->_dof_handler.locally_owned_dofs().make_trilinos_map(this->_comm,
+                                                                false);
+
+  // The rows associated with an agglomerate have as many entries as the
+  // agglomerate has DoFs. The profile is not static so that a row can still
+  // grow if the estimate turns out to be too small.
+  bool const static_profile = false;
+  bool const fast_ap = (eigenvector_sparse_matrix != nullptr);
+  std::unique_ptr<Epetra_CrsMatrix> restriction_matrix;
+  std::unique_ptr<Epetra_CrsMatrix> eigenvector_matrix;
+  std::unique_ptr<Epetra_CrsMatrix> delta_matrix;
+  {
+    std::vector<int> const agglomerate_n_dofs =
+        compute_agglomerate_n_dofs(n_agglomerates);
+    std::vector<int> n_entries_per_row(n_local_rows);
+    for (unsigned int i = 0; i < n_agglomerates; ++i)
+      std::fill_n(n_entries_per_row.begin() + i * n_eigenvectors,
+                  n_eigenvectors, agglomerate_n_dofs[i]);
+    restriction_matrix.reset(new Epetra_CrsMatrix(
+        Copy, row_map, n_entries_per_row.data(), static_profile));
+    if (fast_ap)
+    {
+      eigenvector_matrix.reset(new Epetra_CrsMatrix(
+          Copy, row_map, n_entries_per_row.data(), static_profile));
+      delta_matrix.reset(new Epetra_CrsMatrix(
+          Copy, row_map, n_entries_per_row.data(), static_profile));
+      eigenvalues->assign(n_local_rows, 0.);
+    }
+  }
+  _agglomerate_statistics.resize(n_agglomerates);
+
+  // The matrices are shared by all the threads so a single agglomerate is
+  // written at a time. The buffers are reused for every row.
+  std::mutex insert_mutex;
+  std::vector<int> columns;
+  std::vector<double> weights;
+  std::vector<double> values;
+  auto insert_row = [&](Epetra_CrsMatrix &matrix, int const row) {
+    // A positive error code is only a warning that the row had to grow
+    int const error_code = matrix.InsertGlobalValues(
+        row, columns.size(), values.data(), columns.data());
+    if (error_code < 0)
+      ASSERT_THROW(false, "Negative error code (" +
+                              std::to_string(error_code) +
+                              ") returned by "
+                              "Epetra_CrsMatrix::InsertGlobalValues()");
+  };
+
+  // Every thread writes the eigenvectors of an agglomerate in the matrices as
+  // soon as they have been computed, so there are at most as many agglomerates
+  // in memory as there are threads.
+  compute_agglomerate_eigenvectors(
+      agglomerate_ptree, n_agglomerates, n_eigenvectors, tolerance, evaluator,
+      [&](CopyData &local_copy_data) {
+        TraceScope copy_scope("AMGe: copy local to global");
+        std::lock_guard<std::mutex> lock(insert_mutex);
+        auto const &local_eigenvectors = local_copy_data.local_eigenvectors;
+        auto const &dof_indices_map = local_copy_data.local_dof_indices_map;
+        ASSERT(local_eigenvectors.size() == n_eigenvectors,
+               "Wrong number of eigenvectors: " +
+                   std::to_string(local_eigenvectors.size()) +
+                   " instead of " + std::to_string(n_eigenvectors));
+        unsigned int const n_elem = dof_indices_map.size();
+        columns.assign(dof_indices_map.begin(), dof_indices_map.end());
+        weights.resize(n_elem);
+        for (unsigned int j = 0; j < n_elem; ++j)
+          weights[j] = local_copy_data.diag_elements[j] /
+                       locally_relevant_global_diag[dof_indices_map[j]];
+        values.resize(n_elem);
+
+        unsigned int const agglomerate_id =
+            local_copy_data.statistics.agglomerate_id;
+        unsigned int const first_local_row =
+            (agglomerate_id - 1) * n_eigenvectors;
+        unsigned int const first_row = n_rows_before + first_local_row;
+        for (unsigned int k = 0; k < n_eigenvectors; ++k)
+        {
+          auto const &eigenvector = local_eigenvectors[k];
+          ASSERT(eigenvector.size() == n_elem,
+                 "dof_indices_map has the wrong size: " +
+                     std::to_string(n_elem) + " instead of " +
+                     std::to_string(eigenvector.size()));
+          for (unsigned int j = 0; j < n_elem; ++j)
+            values[j] = weights[j] * eigenvector[j];
+          insert_row(*restriction_matrix, first_row + k);
+          if (fast_ap)
+          {
+            std::copy(eigenvector.begin(), eigenvector.end(), values.begin());
+            insert_row(*eigenvector_matrix, first_row + k);
+            for (unsigned int j = 0; j < n_elem; ++j)
+              values[j] = (weights[j] - 1.) * eigenvector[j];
+            insert_row(*delta_matrix, first_row + k);
+            (*eigenvalues)[first_local_row + k] =
+                local_copy_data.local_eigenvalues[k].real();
+          }
+        }
+        _agglomerate_statistics[agglomerate_id - 1] =
+            local_copy_data.statistics;
+      });
+
+  // Wrap the Epetra matrices one at a time so that a single matrix is
+  // duplicated at any given time.
+  auto wrap_matrix = [&](std::unique_ptr<Epetra_CrsMatrix> &epetra_matrix,
+                         dealii::TrilinosWrappers::SparseMatrix &matrix) {
+    int const error_code = epetra_matrix->FillComplete(domain_map, row_map);
+    if (error_code != 0)
+      ASSERT_THROW(false, "Non-zero error code (" +
+                              std::to_string(error_code) +
+                              ") returned by Epetra_CrsMatrix::FillComplete()");
+    matrix.reinit(*epetra_matrix);
+    epetra_matrix.reset();
+  };
+  wrap_matrix(restriction_matrix, restriction_sparse_matrix);
+  if (fast_ap)
+  {
+    wrap_matrix(eigenvector_matrix, *eigenvector_sparse_matrix);
+    wrap_matrix(delta_matrix, *delta_eigenvector_matrix);
+  }
+}
+
+template <int dim, typename MeshEvaluator, typename VectorType>
+void AMGe_host<dim, MeshEvaluator, VectorType>::
+    compute_agglomerate_eigenvectors(
+        boost::property_tree::ptree const &agglomerate_ptree,
+        unsigned int const n_agglomerates, unsigned int const n_eigenvectors,
+        double const tolerance, MeshEvaluator const &evaluator,
+        std::function<void(CopyData &)> const &copier)
+{
+  std::vector<unsigned int> agglomerate_ids(n_agglomerates);
+  std::iota(agglomerate_ids.begin(), agglomerate_ids.end(), 1);
+  compute_agglomerate_eigenvectors(
+      agglomerate_ptree, n_agglomerates, std::move(agglomerate_ids),
+      n_eigenvectors, tolerance, evaluator, copier);
+}
+
+template <int dim, typename MeshEvaluator, typename VectorType>
+void AMGe_host<dim, MeshEvaluator, VectorType>::
+    compute_agglomerate_eigenvectors(
+        boost::property_tree::ptree const &agglomerate_ptree,
+        unsigned int const n_agglomerates,
+        std::vector<unsigned int> agglomerate_ids,
+        unsigned int const n_eigenvectors, double const tolerance,
+        MeshEvaluator const &evaluator,
+        std::function<void(CopyData &)> const &copier)
+{
+  // The cost of an eigensolve grows faster than the size of the agglomerate.
+  // If the largest agglomerates come last, all the threads but one end up
+  // waiting for them, so we start with the largest ones.
+  std::string const schedule =
+      agglomerate_ptree.get<std::string>("schedule", "largest first");
+  if (schedule == "largest first")
+  {
+    std::vector<int> const n_dofs = compute_agglomerate_n_dofs(n_agglomerates);
+    std::stable_sort(agglomerate_ids.begin(), agglomerate_ids.end(),
+                     [&](unsigned int const a, unsigned int const b) {
+                       return n_dofs[a - 1] > n_dofs[b - 1];
+                     });
+  }
+  else
+  {
+    ASSERT_THROW(schedule == "natural", "Unknown schedule '" + schedule + "'");
+  }
+
+  // Each thread takes the next agglomerate of the list as soon as it is done
+  // with the previous one. An agglomerate is solved by a single thread so the
+  // largest agglomerate bounds the wall time of the eigensolves.
+  unsigned int const n_ids = agglomerate_ids.size();
+  unsigned int const n_threads =
+      std::max(std::min(dealii::MultithreadInfo::n_threads(), n_ids), 1u);
+  std::atomic<unsigned int> next_agglomerate(0);
+  std::vector<double> busy_times(n_threads, 0.);
+  auto const start = std::chrono::steady_clock::now();
+  dealii::Threads::TaskGroup<void> tasks;
+  for (unsigned int t = 0; t < n_threads; ++t)
+    tasks += dealii::Threads::new_task([&, t]() {
+      LobpcgScratchData scratch_data;
+      CopyData copy_data;
+      for (unsigned int i = next_agglomerate++; i < n_ids;
+           i = next_agglomerate++)
+      {
+        auto const agglomerate_start = std::chrono::steady_clock::now();
+        auto const agg_id = agglomerate_ids.begin() + i;
+        this->local_worker(n_eigenvectors, tolerance, evaluator, agg_id,
+                           scratch_data, copy_data);
+        copier(copy_data);
+        busy_times[t] += std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() -
+                             agglomerate_start)
+                             .count();
+      }
+    });
+  tasks.join_all();
+
+  _thread_utilization.n_threads = n_threads;
+  _thread_utilization.wall_time =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+  _thread_utilization.busy_time =
+      std::accumulate(busy_times.begin(), busy_times.end(), 0.);
+}
+
 template <int dim, typename MeshEvaluator, typename VectorType>
 void AMGe_host<dim, MeshEvaluator, VectorType>::local_worker(
     unsigned int const n_eigenvectors, double const tolerance,
@@ -590,19 +1284,46 @@ void AMGe_host<dim, MeshEvaluator, VectorType>::local_worker(
     std::vector<unsigned int>::iterator const &agg_id,
     LobpcgScratchData &scratch_data, CopyData &copy_data)
 {
+  TraceScope agglomerate_scope("AMGe: agglomerate", {{"agglomerate", *agg_id}});
+  auto const start = std::chrono::steady_clock::now();
   dealii::Triangulation<dim> agglomerate_triangulation;
   std::map<typename dealii::Triangulation<dim>::active_cell_iterator,
            typename dealii::DoFHandler<dim>::active_cell_iterator>
       agglomerate_to_global_tria_map;
 
-  this->build_agglomerate_triangulation(*agg_id, agglomerate_triangulation,
-                                        agglomerate_to_global_tria_map);
+  {
+    TraceScope build_scope("AMGe: build agglomerate triangulation");
+    this->build_agglomerate_triangulation(*agg_id, agglomerate_triangulation,
+                                          agglomerate_to_global_tria_map);
+    build_scope.add_argument("n_cells",
+                             agglomerate_triangulation.n_active_cells());
+  }
 
   std::tie(copy_data.local_eigenvalues, copy_data.local_eigenvectors,
            copy_data.diag_elements, copy_data.local_dof_indices_map) =
-      compute_local_eigenvectors(
-          n_eigenvectors, tolerance, agglomerate_triangulation,
-          agglomerate_to_global_tria_map, evaluator, scratch_data);
+      compute_local_eigenvectors(n_eigenvectors, tolerance,
+                                 agglomerate_triangulation,
+                                 agglomerate_to_global_tria_map, evaluator,
+                                 scratch_data, &copy_data.statistics);
+  agglomerate_scope.add_argument("n_dofs", copy_data.diag_elements.size());
+
+  auto &statistics = copy_data.statistics;
+  statistics.agglomerate_id = *agg_id;
+  statistics.n_dofs = copy_data.diag_elements.size();
+  statistics.n_eigenvectors = copy_data.local_eigenvectors.size();
+  auto const minmax_eigenvalues = std::minmax_element(
+      copy_data.local_eigenvalues.begin(), copy_data.local_eigenvalues.end(),
+      [](std::complex<double> const &a, std::complex<double> const &b) {
+        return a.real() < b.real();
+      });
+  if (minmax_eigenvalues.first != copy_data.local_eigenvalues.end())
+  {
+    statistics.min_eigenvalue = minmax_eigenvalues.first->real();
+    statistics.max_eigenvalue = minmax_eigenvalues.second->real();
+  }
+  statistics.wall_time = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
 
   if (_eigensolver_params.get("type", "lanczos") == "anasazi")
   {
@@ -616,37 +1337,43 @@ void AMGe_host<dim, MeshEvaluator, VectorType>::local_worker(
 
 template <int dim, typename MeshEvaluator, typename VectorType>
 void AMGe_host<dim, MeshEvaluator, VectorType>::copy_local_to_global(
-    CopyData const &copy_data,
+    CopyData &copy_data,
     std::vector<dealii::Vector<double>> &eigenvectors,
     std::vector<std::vector<typename VectorType::value_type>> &diag_elements,
     std::vector<std::vector<dealii::types::global_dof_index>> &dof_indices_maps,
     std::vector<unsigned int> &n_local_eigenvectors)
 {
-  eigenvectors.insert(eigenvectors.end(), copy_data.local_eigenvectors.begin(),
-                      copy_data.local_eigenvectors.end());
+  TraceScope scope("AMGe: copy local to global");
+  n_local_eigenvectors.push_back(copy_data.local_eigenvectors.size());
 
-  diag_elements.push_back(copy_data.diag_elements);
+  eigenvectors.insert(
+      eigenvectors.end(),
+      std::make_move_iterator(copy_data.local_eigenvectors.begin()),
+      std::make_move_iterator(copy_data.local_eigenvectors.end()));
+  copy_data.local_eigenvectors.clear();
 
-  dof_indices_maps.push_back(copy_data.local_dof_indices_map);
+  diag_elements.push_back(std::move(copy_data.diag_elements));
 
-  n_local_eigenvectors.push_back(copy_data.local_eigenvectors.size());
+  dof_indices_maps.push_back(std::move(copy_data.local_dof_indices_map));
+
+  _agglomerate_statistics.push_back(copy_data.statistics);
 }
 
 template <int dim, typename MeshEvaluator, typename VectorType>
 void AMGe_host<dim, MeshEvaluator, VectorType>::copy_local_to_global_eig(
-    CopyData const &copy_data, std::vector<double> &eigenvalues,
+    CopyData &copy_data, std::vector<double> &eigenvalues,
     std::vector<dealii::Vector<double>> &eigenvectors,
     std::vector<std::vector<typename VectorType::value_type>> &diag_elements,
     std::vector<std::vector<dealii::types::global_dof_index>> &dof_indices_maps,
     std::vector<unsigned int> &n_local_eigenvectors)
 {
-  copy_local_to_global(copy_data, eigenvectors, diag_elements, dof_indices_maps,
-                       n_local_eigenvectors);
-
   std::transform(copy_data.local_eigenvalues.begin(),
                  copy_data.local_eigenvalues.end(),
                  std::back_inserter(eigenvalues),
                  [](std::complex<double> const &z) { return z.real(); });
+
+  copy_local_to_global(copy_data, eigenvectors, diag_elements, dof_indices_maps,
+                       n_local_eigenvectors);
 }
 } // namespace mfmg
 
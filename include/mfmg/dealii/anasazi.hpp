@@ -36,8 +36,12 @@ public:
   solve(boost::property_tree::ptree const &params,
         std::vector<std::shared_ptr<VectorType>> const &initial_guess) const;
 
+  // Number of iterations of the last solve
+  int n_iterations() const { return _n_iterations; }
+
 private:
   OperatorType const &_op; // reference to operator object to use
+  mutable int _n_iterations = 0;
 };
 
 } // namespace mfmg
@@ -79,10 +79,11 @@ AnasaziSolver<OperatorType, VectorType>::solve(
   Anasazi::Eigensolution<double, MultiVectorType> solution =
       solver->getProblem().getSolution();
 
+  _n_iterations = solver->getNumIters();
   int const verbosity = params.get("verbosity", 0);
   if (verbosity > 0)
   {
-    std::cout << "n iterations: " << solver->getNumIters() << std::endl;
+    std::cout << "n iterations: " << _n_iterations << std::endl;
   }
 
   int a_n_eigenvectors = solution.numVecs;
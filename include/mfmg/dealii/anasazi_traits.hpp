@@ -13,7 +13,7 @@
 #define MFMG_ANASAZI_TRAITS_HPP
 
 #include <mfmg/common/exceptions.hpp>
-#include <mfmg/dealii/multivector.hpp>
+#include <mfmg/common/multivector.hpp>
 
 #include <deal.II/lac/sparse_matrix.h>
 
@@ -13,7 +13,7 @@
 #define MFMG_BELOS_TRAITS_HPP
 
 #include <mfmg/common/exceptions.hpp>
-#include <mfmg/dealii/multivector.hpp>
+#include <mfmg/common/multivector.hpp>
 
 #include <BelosMultiVecTraits.hpp>
 
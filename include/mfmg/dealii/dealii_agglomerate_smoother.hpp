@@ -0,0 +1,113 @@
+/**************************************************************************
+ * Copyright (c) 2017-2019 by the mfmg authors                            *
+ * All rights reserved.                                                   *
+ *                                                                        *
+ * This file is part of the mfmg library. mfmg is distributed under a BSD *
+ * 3-clause license. For the licensing terms see the LICENSE file in the  *
+ * top-level directory                                                    *
+ *                                                                        *
+ * SPDX-License-Identifier: BSD-3-Clause                                  *
+ *************************************************************************/
+
+#ifndef MFMG_DEALII_AGGLOMERATE_SMOOTHER_HPP
+#define MFMG_DEALII_AGGLOMERATE_SMOOTHER_HPP
+
+#include <mfmg/common/operator.hpp>
+#include <mfmg/common/smoother.hpp>
+
+#include <deal.II/base/types.h>
+
+#include <boost/property_tree/ptree.hpp>
+
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+namespace mfmg
+{
+/**
+ * Block Jacobi smoother for DealIITrilinosMatrixOperator where the blocks are
+ * given by the agglomerates. The diagonal block of the matrix associated with
+ * each agglomerate is factorized (dense Cholesky) during the setup and all the
+ * factors are stored contiguously. During a sweep, the blocks are solved
+ * concurrently.
+ *
+ * Each DoF is owned by the first block that contains it. If "smoother.overlap"
+ * is false (default), the blocks are restricted to the DoFs they own and the
+ * smoother is a standard block Jacobi. Otherwise, the blocks are used as given
+ * but only the owned DoFs are updated (restricted additive Schwarz).
+ *
+ * The factorization is computed in double precision and the factors are stored
+ * using StorageType. The block solves are performed in StorageType.
+ */
+template <typename VectorType,
+          typename StorageType = typename VectorType::value_type>
+class DealIIAgglomerateSmoother final : public Smoother<VectorType>
+{
+public:
+  using vector_type = VectorType;
+  using value_type = typename VectorType::value_type;
+  using storage_type = StorageType;
+
+  /**
+   * Constructor. \p blocks contains for each block the sorted global indices
+   * of the DoFs in the block. All the DoFs must be locally owned.
+   */
+  DealIIAgglomerateSmoother(
+      std::shared_ptr<Operator<vector_type> const> op,
+      std::shared_ptr<boost::property_tree::ptree const> params,
+      std::vector<std::vector<dealii::types::global_dof_index>> const &blocks);
+
+  /**
+   * Constructor. The blocks and their factors are read from \p in, where they
+   * were written by save(), instead of being computed.
+   */
+  DealIIAgglomerateSmoother(
+      std::shared_ptr<Operator<vector_type> const> op,
+      std::shared_ptr<boost::property_tree::ptree const> params,
+      std::istream &in);
+
+  virtual ~DealIIAgglomerateSmoother() override = default;
+
+  void apply(vector_type const &b, vector_type &x,
+             bool zero_initial_guess = false) const override;
+
+  std::size_t memory_consumption() const override;
+
+  /**
+   * The smoother copies the data it needs from the matrix at setup so the
+   * operator can always be replaced.
+   */
+  bool replace_operator(
+      std::shared_ptr<Operator<vector_type> const> op) override;
+
+  /**
+   * Return the number of blocks.
+   */
+  unsigned int n_blocks() const;
+
+  /**
+   * Write the blocks and their factors to \p out.
+   */
+  void save(std::ostream &out) const;
+
+private:
+  /**
+   * The local indices of the DoFs of block i are stored in
+   * _block_indices[_block_offsets[i]] to _block_indices[_block_offsets[i+1]].
+   * _is_owned has the same layout and is true for the DoFs owned by the block.
+   */
+  std::vector<unsigned int> _block_offsets;
+  std::vector<unsigned int> _block_indices;
+  std::vector<char> _is_owned;
+  /**
+   * The Cholesky factor of block i is stored in column-major order starting at
+   * _factors[_factor_offsets[i]].
+   */
+  std::vector<std::size_t> _factor_offsets;
+  std::vector<StorageType> _factors;
+};
+} // namespace mfmg
+
+#endif
@@ -0,0 +1,96 @@
+/**************************************************************************
+ * Copyright (c) 2017-2019 by the mfmg authors                            *
+ * All rights reserved.                                                   *
+ *                                                                        *
+ * This file is part of the mfmg library. mfmg is distributed under a BSD *
+ * 3-clause license. For the licensing terms see the LICENSE file in the  *
+ * top-level directory                                                    *
+ *                                                                        *
+ * SPDX-License-Identifier: BSD-3-Clause                                  *
+ *************************************************************************/
+
+#ifndef MFMG_DEALII_CHEBYSHEV_SMOOTHER_HPP
+#define MFMG_DEALII_CHEBYSHEV_SMOOTHER_HPP
+
+#include <mfmg/common/operator.hpp>
+#include <mfmg/common/smoother.hpp>
+
+#include <deal.II/lac/diagonal_matrix.h>
+#include <deal.II/lac/precondition.h>
+#include <deal.II/lac/trilinos_sparse_matrix.h>
+
+#include <boost/property_tree/ptree.hpp>
+
+#include <memory>
+
+namespace mfmg
+{
+/**
+ * Chebyshev smoother for DealIITrilinosMatrixOperator. The smoother only
+ * requires matrix-vector products and vector updates. The largest eigenvalue
+ * of D^{-1} A, where D is the diagonal of A, is estimated once at setup using a
+ * few Lanczos iterations unless it is provided in "smoother.max_eigenvalue".
+ */
+template <typename VectorType>
+class DealIIChebyshevSmoother final : public Smoother<VectorType>
+{
+public:
+  using vector_type = VectorType;
+  using matrix_type = dealii::TrilinosWrappers::SparseMatrix;
+  using preconditioner_type = dealii::DiagonalMatrix<VectorType>;
+  using chebyshev_preconditioner =
+      dealii::PreconditionChebyshev<matrix_type, vector_type,
+                                    preconditioner_type>;
+
+  DealIIChebyshevSmoother(
+      std::shared_ptr<Operator<vector_type> const> op,
+      std::shared_ptr<boost::property_tree::ptree const> params);
+
+  /**
+   * Constructor which reuses the estimate of the largest eigenvalue
+   * \p max_eigenvalue, e.g., returned by max_eigenvalue() of a smoother
+   * previously built on the same level.
+   */
+  DealIIChebyshevSmoother(
+      std::shared_ptr<Operator<vector_type> const> op,
+      std::shared_ptr<boost::property_tree::ptree const> params,
+      double max_eigenvalue);
+
+  virtual ~DealIIChebyshevSmoother() override = default;
+
+  void apply(vector_type const &b, vector_type &x,
+             bool zero_initial_guess = false) const override;
+
+  std::size_t memory_consumption() const override;
+
+  /**
+   * Return the estimate of the largest eigenvalue of D^{-1} A.
+   */
+  double max_eigenvalue() const;
+
+private:
+  /**
+   * Estimate the largest eigenvalue of D^{-1} A using Lanczos on the
+   * symmetric matrix -D^{-1/2} A D^{-1/2}.
+   */
+  double estimate_max_eigenvalue() const;
+
+  /**
+   * Extract the matrix from the operator and compute the inverse of its
+   * diagonal.
+   */
+  void initialize_matrix();
+
+  /**
+   * Initialize the Chebyshev polynomial using _max_eigenvalue.
+   */
+  void initialize_smoother();
+
+  std::shared_ptr<matrix_type const> _matrix;
+  std::shared_ptr<preconditioner_type> _diagonal_inverse;
+  std::unique_ptr<chebyshev_preconditioner> _smoother;
+  double _max_eigenvalue;
+};
+} // namespace mfmg
+
+#endif
@@ -0,0 +1,133 @@
+/**************************************************************************
+ * Copyright (c) 2017-2019 by the mfmg authors                            *
+ * All rights reserved.                                                   *
+ *                                                                        *
+ * This file is part of the mfmg library. mfmg is distributed under a BSD *
+ * 3-clause license. For the licensing terms see the LICENSE file in the  *
+ * top-level directory                                                    *
+ *                                                                        *
+ * SPDX-License-Identifier: BSD-3-Clause                                  *
+ *************************************************************************/
+
+#ifndef MFMG_DEALII_CSR_MATRIX_OPERATOR_HPP
+#define MFMG_DEALII_CSR_MATRIX_OPERATOR_HPP
+
+#include <mfmg/common/operator.hpp>
+
+#include <deal.II/base/index_set.h>
+#include <deal.II/lac/trilinos_sparse_matrix.h>
+
+#include <memory>
+#include <vector>
+
+namespace mfmg
+{
+/**
+ * Distributed matrix whose locally owned rows are stored in a native CSR
+ * format. The entries are stored using StorageType while the vectors and the
+ * accumulation use the value_type of the VectorType. With StorageType = float,
+ * the matrix uses about two third of the memory bandwidth of the equivalent
+ * DealIITrilinosMatrixOperator which makes it a good candidate for the coarse
+ * levels of the hierarchy. The transposed operator, e.g., the prolongation,
+ * is applied using a transposed copy of the local rows which is built the
+ * first time it is needed.
+ *
+ * The operator can only be applied: it is built from a matrix at the end of
+ * the setup, so the matrix-matrix products are not implemented. The classes
+ * are only instantiated for double precision vectors: single precision
+ * vectors would need a second vector type throughout the Hierarchy.
+ */
+template <typename VectorType, typename StorageType>
+class DealIICSRMatrixOperator final : public Operator<VectorType>
+{
+public:
+  using vector_type = VectorType;
+  using value_type = typename VectorType::value_type;
+  using storage_type = StorageType;
+
+  DealIICSRMatrixOperator(
+      dealii::TrilinosWrappers::SparseMatrix const &sparse_matrix);
+
+  virtual ~DealIICSRMatrixOperator() override = default;
+
+  void apply(vector_type const &x, vector_type &y,
+             OperatorMode mode = OperatorMode::NO_TRANS) const override;
+
+  /**
+   * Apply the matrix to all the vectors at once (SpMM) so that the matrix is
+   * only read once.
+   */
+  void apply_multivector(
+      MultiVector<vector_type> const &x, MultiVector<vector_type> &y,
+      OperatorMode mode = OperatorMode::NO_TRANS) const override;
+
+  std::shared_ptr<Operator<VectorType>> transpose() const override;
+
+  std::shared_ptr<Operator<VectorType>>
+  multiply(std::shared_ptr<Operator<VectorType> const> b) const override;
+
+  std::shared_ptr<Operator<VectorType>> multiply_transpose(
+      std::shared_ptr<Operator<VectorType> const> b) const override;
+
+  std::shared_ptr<vector_type> build_domain_vector() const override;
+
+  std::shared_ptr<vector_type> build_range_vector() const override;
+
+  size_t grid_complexity() const override;
+
+  size_t operator_complexity() const override;
+
+  std::size_t memory_consumption() const override;
+
+private:
+  /**
+   * Build _transpose_row_ptr, _transpose_row_index, and _transpose_values
+   * from the locally owned rows.
+   */
+  void build_transpose() const;
+
+  /**
+   * Compute the local contributions of the transposed operator applied to
+   * the vectors \p x and store them in \p ghosted_y, including the ghost
+   * entries. Each entry of \p ghosted_y is computed from a single row of the
+   * transpose so the rows are processed in parallel.
+   */
+  void apply_transpose_local(std::vector<vector_type const *> const &x,
+                             std::vector<vector_type *> const &ghosted_y) const;
+
+  MPI_Comm _comm;
+  dealii::IndexSet _locally_owned_range_indices;
+  dealii::IndexSet _locally_owned_domain_indices;
+  size_t _m;
+  size_t _n_nonzero_elements;
+  /**
+   * The columns are numbered using the local indices of
+   * _ghosted_domain_vector, i.e., the locally owned columns come first
+   * followed by the ghost columns.
+   */
+  std::vector<unsigned int> _row_ptr;
+  std::vector<unsigned int> _column_index;
+  std::vector<StorageType> _values;
+  /**
+   * Vector used to import the ghost entries of x in apply() and to export the
+   * contributions to the ghost entries of y when the operator is transposed.
+   */
+  mutable vector_type _ghosted_domain_vector;
+  /**
+   * Same as _ghosted_domain_vector but for apply_multivector().
+   */
+  mutable std::vector<vector_type> _ghosted_domain_multivector;
+  /**
+   * Transpose of the locally owned rows in CSR format. The rows are numbered
+   * like the columns of _row_ptr, including the ghost columns, and the
+   * entries of a row are the local indices of the rows of the operator. The
+   * transpose is only built by the first transposed apply because most
+   * operators, e.g., the level operators, are never transposed.
+   */
+  mutable std::vector<unsigned int> _transpose_row_ptr;
+  mutable std::vector<unsigned int> _transpose_row_index;
+  mutable std::vector<StorageType> _transpose_values;
+};
+} // namespace mfmg
+
+#endif
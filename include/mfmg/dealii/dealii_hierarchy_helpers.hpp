@@ -16,6 +16,10 @@
 #include <mfmg/dealii/amge_host.hpp>
 #include <mfmg/dealii/dealii_mesh_evaluator.hpp>
 
+#include <memory>
+#include <utility>
+#include <vector>
+
 namespace mfmg
 {
 template <int dim, typename VectorType>
@@ -34,9 +38,19 @@ public:
       MPI_Comm comm, std::shared_ptr<MeshEvaluator> mesh_evaluator,
       std::shared_ptr<boost::property_tree::ptree const> params) override final;
 
+  boost::property_tree::ptree get_restrictor_statistics() const override final;
+
+  void update_restrictor(
+      MPI_Comm comm, std::shared_ptr<MeshEvaluator> mesh_evaluator,
+      std::shared_ptr<boost::property_tree::ptree const> params,
+      std::vector<unsigned int> const &changed_cells) override final;
+
   std::shared_ptr<Operator<vector_type>>
   fast_multiply_transpose() override final;
 
+  std::shared_ptr<Operator<vector_type>> build_single_precision_operator(
+      std::shared_ptr<Operator<vector_type> const> op) override final;
+
   std::shared_ptr<Smoother<vector_type>> build_smoother(
       std::shared_ptr<Operator<vector_type> const> op,
       std::shared_ptr<boost::property_tree::ptree const> params) override final;
@@ -45,8 +59,49 @@ public:
       std::shared_ptr<Operator<vector_type> const> op,
       std::shared_ptr<boost::property_tree::ptree const> params) override final;
 
+  void save_operator(std::shared_ptr<Operator<vector_type> const> op,
+                     std::string const &filename) override final;
+
+  std::shared_ptr<Operator<vector_type>>
+  load_operator(MPI_Comm comm, std::string const &filename) override final;
+
+  void save_smoother(std::shared_ptr<Smoother<vector_type> const> smoother,
+                     std::string const &filename) override final;
+
+  std::shared_ptr<Smoother<vector_type>> load_smoother(
+      std::shared_ptr<Operator<vector_type> const> op,
+      std::shared_ptr<boost::property_tree::ptree const> params,
+      std::string const &filename) override final;
+
 private:
   std::shared_ptr<Operator<vector_type>> _ap_operator;
+  boost::property_tree::ptree _restrictor_statistics;
+  /**
+   * DoFs of the agglomerates built by the last call to build_restrictor() or
+   * update_restrictor(). They are used by the agglomerate block Jacobi
+   * smoother.
+   */
+  std::vector<std::vector<dealii::types::global_dof_index>>
+      _agglomerate_dof_indices;
+  dealii::types::global_dof_index _agglomerate_n_dofs = 0;
+  /**
+   * Data of the last call to build_restrictor() needed by update_restrictor()
+   * to patch the restriction matrix in place.
+   */
+  std::shared_ptr<dealii::TrilinosWrappers::SparseMatrix> _restrictor_matrix;
+  std::vector<unsigned int> _agglomerate_ids;
+  std::vector<unsigned int> _n_local_eigenvectors;
+  dealii::LinearAlgebra::distributed::Vector<double>
+      _locally_relevant_global_diag;
+  /**
+   * Largest eigenvalues estimated by the Chebyshev smoothers built so far
+   * together with their matrix. The estimate is reused when a smoother is
+   * rebuilt on the same matrix.
+   */
+  std::vector<
+      std::pair<std::weak_ptr<dealii::TrilinosWrappers::SparseMatrix const>,
+                double>>
+      _chebyshev_max_eigenvalues;
 };
 } // namespace mfmg
 
@@ -40,11 +40,14 @@ public:
       std::shared_ptr<Operator<vector_type> const> op,
       std::shared_ptr<boost::property_tree::ptree const> params) override final;
 
+  boost::property_tree::ptree get_restrictor_statistics() const override final;
+
   std::shared_ptr<Operator<vector_type>>
   fast_multiply_transpose() override final;
 
 private:
   std::shared_ptr<Operator<vector_type>> _ap_operator;
+  boost::property_tree::ptree _restrictor_statistics;
 };
 } // namespace mfmg
 
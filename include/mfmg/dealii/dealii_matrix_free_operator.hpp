@@ -65,6 +65,12 @@ public:
 
   size_t operator_complexity() const override final;
 
+  /**
+   * The matrix-free data is owned by the mesh evaluator so only the operator
+   * itself is counted.
+   */
+  std::size_t memory_consumption() const override final;
+
   std::shared_ptr<dealii::DiagonalMatrix<vector_type>>
   get_diagonal_inverse() const;
 
@@ -41,10 +41,14 @@ public:
 
   virtual ~DealIIMatrixFreeSmoother() override = default;
 
-  void apply(vector_type const &b, vector_type &x) const override;
+  void apply(vector_type const &b, vector_type &x,
+             bool zero_initial_guess = false) const override;
+
+  std::size_t memory_consumption() const override;
 
 private:
   std::unique_ptr<chebyshev_preconditioner> _smoother;
+  std::size_t _memory_consumption = 0;
 };
 } // namespace mfmg
 
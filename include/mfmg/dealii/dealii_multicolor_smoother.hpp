@@ -0,0 +1,118 @@
+/**************************************************************************
+ * Copyright (c) 2017-2019 by the mfmg authors                            *
+ * All rights reserved.                                                   *
+ *                                                                        *
+ * This file is part of the mfmg library. mfmg is distributed under a BSD *
+ * 3-clause license. For the licensing terms see the LICENSE file in the  *
+ * top-level directory                                                    *
+ *                                                                        *
+ * SPDX-License-Identifier: BSD-3-Clause                                  *
+ *************************************************************************/
+
+#ifndef MFMG_DEALII_MULTICOLOR_SMOOTHER_HPP
+#define MFMG_DEALII_MULTICOLOR_SMOOTHER_HPP
+
+#include <mfmg/common/operator.hpp>
+#include <mfmg/common/smoother.hpp>
+
+#include <boost/property_tree/ptree.hpp>
+
+#include <memory>
+#include <vector>
+
+namespace mfmg
+{
+/**
+ * Gauss-Seidel smoother for DealIITrilinosMatrixOperator which can use all
+ * the threads of a processor. The locally owned rows of the matrix are
+ * colored such that two rows of the same color are not coupled. The rows of a
+ * given color are then updated concurrently. The coupling with the rows owned
+ * by other processors is treated Jacobi-style, i.e., the ghost values are
+ * updated once at the beginning of each sweep.
+ *
+ * The type of sweep is selected using "smoother.type":
+ *  - "multicolor gauss-seidel": forward sweep
+ *  - "multicolor backward gauss-seidel": backward sweep
+ *  - "multicolor symmetric gauss-seidel": forward sweep followed by a backward
+ *    sweep. The ghost values are only updated once so that the smoother is
+ *    symmetric.
+ *
+ * The entries of the matrix are stored using StorageType. Using float halves
+ * the memory traffic of the matrix entries while the vectors and the
+ * accumulation stay in the precision of the VectorType.
+ */
+template <typename VectorType,
+          typename StorageType = typename VectorType::value_type>
+class DealIIMulticolorSmoother : public Smoother<VectorType>
+{
+public:
+  using vector_type = VectorType;
+  using value_type = typename VectorType::value_type;
+  using storage_type = StorageType;
+
+  DealIIMulticolorSmoother(
+      std::shared_ptr<Operator<vector_type> const> op,
+      std::shared_ptr<boost::property_tree::ptree const> params);
+
+  virtual ~DealIIMulticolorSmoother() override = default;
+
+  void apply(vector_type const &b, vector_type &x,
+             bool zero_initial_guess = false) const override final;
+
+  std::size_t memory_consumption() const override final;
+
+  /**
+   * The smoother copies the data it needs from the matrix at setup so the
+   * operator can always be replaced.
+   */
+  bool replace_operator(
+      std::shared_ptr<Operator<vector_type> const> op) override final;
+
+  /**
+   * Return the number of colors used for the locally owned rows.
+   */
+  unsigned int n_colors() const;
+
+private:
+  /**
+   * Compute b - A_ghost x_ghost and store the result in _rhs. The ghost
+   * values of \p x are communicated first.
+   */
+  void compute_local_rhs(vector_type const &b, vector_type const &x) const;
+
+  /**
+   * Update all the rows of \p color using the current values of \p x.
+   */
+  void relax_color(unsigned int color, value_type const *rhs,
+                   value_type *x) const;
+
+  bool _forward_sweep;
+  bool _backward_sweep;
+  /**
+   * Rows sorted by color. The rows of color c are stored in
+   * _color_rows[_color_offsets[c]] to _color_rows[_color_offsets[c+1]].
+   */
+  std::vector<unsigned int> _color_offsets;
+  std::vector<unsigned int> _color_rows;
+  /**
+   * Coupling between locally owned rows (CSR format, local indices). The
+   * diagonal is stored separately.
+   */
+  std::vector<unsigned int> _local_row_ptr;
+  std::vector<unsigned int> _local_column_index;
+  std::vector<StorageType> _local_values;
+  std::vector<StorageType> _inv_diagonal;
+  /**
+   * Coupling with ghost rows (CSR format). The column indices are the local
+   * indices in _ghosted_x, i.e., the ghost entries start after the locally
+   * owned entries.
+   */
+  std::vector<unsigned int> _ghost_row_ptr;
+  std::vector<unsigned int> _ghost_column_index;
+  std::vector<StorageType> _ghost_values;
+  mutable vector_type _ghosted_x;
+  mutable std::vector<value_type> _rhs;
+};
+} // namespace mfmg
+
+#endif
@@ -34,10 +34,18 @@ public:
 
   virtual ~DealIISmoother() override = default;
 
-  void apply(vector_type const &b, vector_type &x) const override final;
+  void apply(vector_type const &b, vector_type &x,
+             bool zero_initial_guess = false) const override final;
+
+  /**
+   * Ifpack does not report the memory used by the preconditioners so it is
+   * estimated from the type of smoother and the size of the matrix.
+   */
+  std::size_t memory_consumption() const override final;
 
 private:
   std::unique_ptr<dealii::TrilinosWrappers::PreconditionBase> _smoother;
+  std::size_t _memory_consumption = 0;
 };
 } // namespace mfmg
 
@@ -14,7 +14,11 @@
 
 #include <mfmg/common/solver.hpp>
 
-#include <deal.II/lac/trilinos_solver.h>
+#include <deal.II/lac/trilinos_precondition.h>
+
+#include <Amesos_BaseSolver.h>
+#include <Epetra_LinearProblem.h>
+#include <Epetra_MultiVector.h>
 
 namespace mfmg
 {
@@ -31,10 +35,37 @@ public:
 
   void apply(vector_type const &b, vector_type &x) const override;
 
+  /**
+   * When using the direct solver, the triangular solves are performed for all
+   * the right-hand sides at once.
+   */
+  void apply_multivector(MultiVector<vector_type> const &b,
+                         MultiVector<vector_type> &x) const override;
+
+  /**
+   * Amesos does not report the size of the factorization so it is estimated
+   * by the growth of the resident set size during the factorization.
+   */
+  std::size_t memory_consumption() const override;
+
+  /**
+   * Return true for the direct solver, see memory_consumption().
+   */
+  bool memory_consumption_is_rss_delta() const override;
+
 private:
-  dealii::SolverControl _solver_control;
-  std::unique_ptr<dealii::TrilinosWrappers::SolverDirect> _solver;
+  /**
+   * Solve the system for all the columns of \p b using the factorization
+   * computed in the constructor.
+   */
+  void direct_solve(Epetra_MultiVector &b, Epetra_MultiVector &x) const;
+
+  // We use Amesos directly instead of dealii::TrilinosWrappers::SolverDirect
+  // because the latter can only solve for one right-hand side at a time.
+  std::unique_ptr<Epetra_LinearProblem> _linear_problem;
+  std::unique_ptr<Amesos_BaseSolver> _direct_solver;
   std::unique_ptr<dealii::TrilinosWrappers::PreconditionBase> _smoother;
+  std::size_t _factorization_memory = 0;
 };
 } // namespace mfmg
 
@@ -32,6 +32,14 @@ public:
   void apply(vector_type const &x, vector_type &y,
              OperatorMode mode = OperatorMode::NO_TRANS) const override;
 
+  /**
+   * Apply the matrix to all the vectors at once (SpMM) so that the matrix is
+   * only read once.
+   */
+  void apply_multivector(
+      MultiVector<vector_type> const &x, MultiVector<vector_type> &y,
+      OperatorMode mode = OperatorMode::NO_TRANS) const override;
+
   std::shared_ptr<Operator<VectorType>> transpose() const override;
 
   std::shared_ptr<Operator<VectorType>>
@@ -48,6 +56,8 @@ public:
 
   size_t operator_complexity() const override;
 
+  std::size_t memory_consumption() const override;
+
   std::shared_ptr<dealii::TrilinosWrappers::SparseMatrix const>
   get_matrix() const;
 
@@ -12,11 +12,17 @@
 #ifndef MFMG_DEALII_UTILS_H
 #define MFMG_DEALII_UTILS_H
 
+#include <mfmg/common/exceptions.hpp>
+
 #include <deal.II/lac/la_parallel_vector.h>
 #include <deal.II/lac/trilinos_sparse_matrix.h>
 #include <deal.II/lac/trilinos_vector.h>
 
+#include <cstdint>
+#include <istream>
+#include <ostream>
 #include <string>
+#include <vector>
 
 namespace mfmg
 {
@@ -188,6 +194,109 @@ void matrix_market_output_file(std::string const &filename,
 void matrix_market_output_file(
     std::string const &filename,
     dealii::TrilinosWrappers::MPI::Vector const &vector);
+
+/**
+ * Locally owned rows of a distributed matrix stored in CSR format. All the
+ * indices are global.
+ */
+struct HostCSRMatrix
+{
+  /**
+   * Global number of rows and of columns.
+   */
+  std::uint64_t m = 0;
+  std::uint64_t n = 0;
+  /**
+   * Locally owned rows (range partition) and columns (domain partition).
+   */
+  std::vector<std::uint64_t> row_indices;
+  std::vector<std::uint64_t> column_indices;
+  /**
+   * The entries of row row_indices[i] are stored in columns and values from
+   * row_ptr[i] to row_ptr[i+1].
+   */
+  std::vector<std::uint64_t> row_ptr;
+  std::vector<std::uint64_t> columns;
+  std::vector<double> values;
+};
+
+/**
+ * Write \p matrix in a binary CSR format. This is much faster and more compact
+ * than matrix_market_output_file(). Every processor writes its locally owned
+ * rows to \p filename.<rank>: a 64-byte header followed by the locally owned
+ * row and column indices, the row offsets, the global column indices, and the
+ * values. All the entries are 64-bit so the arrays are aligned and the file
+ * can be memory-mapped. The first processor also writes \p filename.index
+ * which describes the partition.
+ */
+void binary_csr_output_file(
+    std::string const &filename,
+    dealii::TrilinosWrappers::SparseMatrix const &matrix);
+
+/**
+ * Read the rows written by processor \p rank in binary_csr_output_file(). This
+ * does not require the number of processors to match so the partitions of a
+ * matrix can, for instance, be replayed one at a time in serial.
+ */
+HostCSRMatrix binary_csr_input_file(std::string const &filename,
+                                    unsigned int rank);
+
+/**
+ * Read a matrix written by binary_csr_output_file(). The number of processors
+ * must be the same as when the matrix was written and every processor reads
+ * the rows it wrote, otherwise an exception is thrown.
+ */
+void binary_csr_input_file(std::string const &filename, MPI_Comm comm,
+                           dealii::TrilinosWrappers::SparseMatrix &matrix);
+
+/**
+ * Write \p vector using the same layout as binary_csr_output_file(): every
+ * processor writes the indices and the values of its locally owned entries to
+ * \p filename.<rank> and the first processor writes \p filename.index.
+ */
+void binary_vector_output_file(
+    std::string const &filename,
+    dealii::TrilinosWrappers::MPI::Vector const &vector);
+
+void binary_vector_output_file(
+    std::string const &filename,
+    dealii::LinearAlgebra::distributed::Vector<double> const &vector);
+
+/**
+ * Read a vector written by binary_vector_output_file(). The number of
+ * processors must be the same as when the vector was written.
+ */
+void binary_vector_input_file(std::string const &filename, MPI_Comm comm,
+                              dealii::TrilinosWrappers::MPI::Vector &vector);
+
+void binary_vector_input_file(
+    std::string const &filename, MPI_Comm comm,
+    dealii::LinearAlgebra::distributed::Vector<double> &vector);
+
+/**
+ * Write the size of \p data followed by its entries in binary format.
+ */
+template <typename T>
+void write_binary_vector(std::ostream &out, std::vector<T> const &data)
+{
+  std::uint64_t const size = data.size();
+  out.write(reinterpret_cast<char const *>(&size), sizeof(size));
+  out.write(reinterpret_cast<char const *>(data.data()), size * sizeof(T));
+}
+
+/**
+ * Read a vector written by write_binary_vector().
+ */
+template <typename T>
+void read_binary_vector(std::istream &in, std::vector<T> &data)
+{
+  std::uint64_t size = 0;
+  in.read(reinterpret_cast<char *>(&size), sizeof(size));
+  ASSERT_THROW(in.good(), "Error while reading binary data");
+  data.resize(size);
+  in.read(reinterpret_cast<char *>(data.data()), size * sizeof(T));
+  ASSERT_THROW(in.good(), "Error while reading binary data");
+}
 } // namespace mfmg
 
 #endif
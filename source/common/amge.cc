@@ -12,4 +12,117 @@
 #include <mfmg/common/amge.templates.hpp>
 #include <mfmg/common/instantiation.hpp>
 
+namespace mfmg
+{
+dealii::TrilinosWrappers::SparsityPattern build_restriction_sparsity_pattern(
+    MPI_Comm comm, dealii::IndexSet const &locally_owned_dofs,
+    std::vector<dealii::Vector<double>> const &eigenvectors,
+    std::vector<std::vector<dealii::types::global_dof_index>> const
+        &dof_indices_maps,
+    std::vector<unsigned int> const &n_local_eigenvectors)
+{
+  // Compute the row IndexSet
+  int const n_procs = dealii::Utilities::MPI::n_mpi_processes(comm);
+  int const rank = dealii::Utilities::MPI::this_mpi_process(comm);
+  unsigned int const n_local_rows(eigenvectors.size());
+  std::vector<unsigned int> n_rows_per_proc(n_procs);
+  n_rows_per_proc[rank] = n_local_rows;
+  MPI_Allgather(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, &n_rows_per_proc[0], 1,
+                MPI_UNSIGNED, comm);
+
+  dealii::types::global_dof_index n_total_rows =
+      std::accumulate(n_rows_per_proc.begin(), n_rows_per_proc.end(),
+                      static_cast<dealii::types::global_dof_index>(0));
+  dealii::types::global_dof_index n_rows_before =
+      std::accumulate(n_rows_per_proc.begin(), n_rows_per_proc.begin() + rank,
+                      static_cast<dealii::types::global_dof_index>(0));
+  dealii::IndexSet row_indexset(n_total_rows);
+  row_indexset.add_range(n_rows_before, n_rows_before + n_local_rows);
+  row_indexset.compress();
+
+  // Build the sparsity pattern
+  dealii::TrilinosWrappers::SparsityPattern sp(row_indexset,
+                                               locally_owned_dofs, comm);
+
+  unsigned int const n_agglomerates = n_local_eigenvectors.size();
+  unsigned int row = 0;
+  for (unsigned int i = 0; i < n_agglomerates; ++i)
+  {
+    unsigned int const n_local_eig = n_local_eigenvectors[i];
+    bool const sorted = std::is_sorted(dof_indices_maps[i].begin(),
+                                       dof_indices_maps[i].end());
+    for (unsigned int j = 0; j < n_local_eig; ++j)
+    {
+      sp.add_entries(n_rows_before + row, dof_indices_maps[i].begin(),
+                     dof_indices_maps[i].end(), sorted);
+      ++row;
+    }
+  }
+
+  sp.compress();
+
+  return sp;
+}
+
+void assemble_restriction_sparse_matrix(
+    MPI_Comm comm, dealii::IndexSet const &locally_owned_dofs,
+    std::vector<dealii::Vector<double>> const &eigenvectors,
+    std::vector<std::vector<double>> const &diag_elements,
+    std::vector<std::vector<dealii::types::global_dof_index>> const
+        &dof_indices_maps,
+    std::vector<unsigned int> const &n_local_eigenvectors,
+    dealii::LinearAlgebra::distributed::Vector<double> const
+        &locally_relevant_global_diag,
+    dealii::TrilinosWrappers::SparseMatrix &restriction_sparse_matrix)
+{
+  // Compute the sparsity pattern (Epetra_FECrsGraph)
+  dealii::TrilinosWrappers::SparsityPattern restriction_sp =
+      build_restriction_sparsity_pattern(comm, locally_owned_dofs,
+                                         eigenvectors, dof_indices_maps,
+                                         n_local_eigenvectors);
+
+  // Build the restriction sparse matrix
+  restriction_sparse_matrix.reinit(restriction_sp);
+  std::pair<dealii::types::global_dof_index,
+            dealii::types::global_dof_index> const local_range =
+      restriction_sp.local_range();
+  unsigned int const n_agglomerates = n_local_eigenvectors.size();
+  unsigned int pos = 0;
+  ASSERT(n_agglomerates == dof_indices_maps.size(),
+         "dof_indices_maps has the wrong size: " +
+             std::to_string(dof_indices_maps.size()) + " instead of " +
+             std::to_string(n_agglomerates));
+  // The rows are added at once. The columns are sorted if the DoFs of the
+  // agglomerates have been renumbered by global index.
+  std::vector<double> values;
+  for (unsigned int i = 0; i < n_agglomerates; ++i)
+  {
+    auto const &dof_indices_map = dof_indices_maps[i];
+    unsigned int const n_local_eig = n_local_eigenvectors[i];
+    bool const sorted =
+        std::is_sorted(dof_indices_map.begin(), dof_indices_map.end());
+    for (unsigned int k = 0; k < n_local_eig; ++k)
+    {
+      unsigned int const n_elem = eigenvectors[pos].size();
+      ASSERT(n_elem == dof_indices_map.size(),
+             "dof_indices_maps[i] has the wrong size: " +
+                 std::to_string(dof_indices_map.size()) + " instead of " +
+                 std::to_string(n_elem));
+      values.resize(n_elem);
+      for (unsigned int j = 0; j < n_elem; ++j)
+        values[j] = diag_elements[i][j] /
+                    locally_relevant_global_diag[dof_indices_map[j]] *
+                    eigenvectors[pos][j];
+      restriction_sparse_matrix.add(local_range.first + pos, n_elem,
+                                    dof_indices_map.data(), values.data(),
+                                    true, sorted);
+      ++pos;
+    }
+  }
+
+  // Compress the matrix
+  restriction_sparse_matrix.compress(dealii::VectorOperation::add);
+}
+} // namespace mfmg
+
 INSTANTIATE_DIM_VECTORTYPE(TUPLE(AMGe))
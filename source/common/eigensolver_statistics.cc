@@ -0,0 +1,185 @@
+/**************************************************************************
+ * Copyright (c) 2017-2019 by the mfmg authors                            *
+ * All rights reserved.                                                   *
+ *                                                                        *
+ * This file is part of the mfmg library. mfmg is distributed under a BSD *
+ * 3-clause license. For the licensing terms see the LICENSE file in the  *
+ * top-level directory                                                    *
+ *                                                                        *
+ * SPDX-License-Identifier: BSD-3-Clause                                  *
+ *************************************************************************/
+
+#include <mfmg/common/eigensolver_statistics.hpp>
+#include <mfmg/common/exceptions.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+namespace mfmg
+{
+namespace
+{
+// Number of bins of the histogram used to estimate the percentiles
+unsigned int constexpr n_percentile_bins = 1024;
+
+std::vector<unsigned long long>
+compute_histogram(MPI_Comm comm, std::vector<double> const &values,
+                  double min_value, double max_value, unsigned int n_bins)
+{
+  std::vector<unsigned long long> local_histogram(n_bins, 0);
+  double const width = (max_value - min_value) / n_bins;
+  for (double const value : values)
+  {
+    unsigned int const bin =
+        width > 0. ? std::min(static_cast<unsigned int>(
+                                  (value - min_value) / width),
+                              n_bins - 1)
+                   : 0;
+    ++local_histogram[bin];
+  }
+
+  std::vector<unsigned long long> histogram(n_bins, 0);
+  MPI_Allreduce(local_histogram.data(), histogram.data(), n_bins,
+                MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+
+  return histogram;
+}
+
+boost::property_tree::ptree summarize(MPI_Comm comm,
+                                      std::vector<double> const &values,
+                                      unsigned int n_bins)
+{
+  unsigned long long const local_count = values.size();
+  unsigned long long count = 0;
+  MPI_Allreduce(&local_count, &count, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM,
+                comm);
+
+  boost::property_tree::ptree summary;
+  summary.put("count", count);
+  if (count == 0)
+    return summary;
+
+  double local_min = std::numeric_limits<double>::max();
+  double local_max = std::numeric_limits<double>::lowest();
+  double local_sum = 0.;
+  for (double const value : values)
+  {
+    local_min = std::min(local_min, value);
+    local_max = std::max(local_max, value);
+    local_sum += value;
+  }
+  double min_value = 0.;
+  double max_value = 0.;
+  double sum = 0.;
+  MPI_Allreduce(&local_min, &min_value, 1, MPI_DOUBLE, MPI_MIN, comm);
+  MPI_Allreduce(&local_max, &max_value, 1, MPI_DOUBLE, MPI_MAX, comm);
+  MPI_Allreduce(&local_sum, &sum, 1, MPI_DOUBLE, MPI_SUM, comm);
+  summary.put("min", min_value);
+  summary.put("max", max_value);
+  summary.put("mean", sum / count);
+
+  // The percentiles are given by the upper edge of the bin which contains
+  // them
+  auto const fine_histogram =
+      compute_histogram(comm, values, min_value, max_value, n_percentile_bins);
+  double const fine_width = (max_value - min_value) / n_percentile_bins;
+  for (unsigned int const percent : {50, 90, 99})
+  {
+    unsigned long long const rank = (percent * count + 99) / 100;
+    unsigned long long cumulative_count = 0;
+    unsigned int bin = 0;
+    while (cumulative_count + fine_histogram[bin] < rank)
+      cumulative_count += fine_histogram[bin++];
+    summary.put("p" + std::to_string(percent),
+                std::min(min_value + (bin + 1) * fine_width, max_value));
+  }
+
+  auto const histogram =
+      compute_histogram(comm, values, min_value, max_value, n_bins);
+  double const width = (max_value - min_value) / n_bins;
+  for (unsigned int i = 0; i < n_bins; ++i)
+  {
+    auto &bin = summary.put_child("histogram.bin_" + std::to_string(i),
+                                  boost::property_tree::ptree());
+    bin.put("lower", min_value + i * width);
+    bin.put("upper", min_value + (i + 1) * width);
+    bin.put("count", histogram[i]);
+  }
+
+  return summary;
+}
+} // namespace
+
+boost::property_tree::ptree summarize_agglomerate_statistics(
+    MPI_Comm comm, std::string const &eigensolver_type,
+    std::vector<AgglomerateStatistics> const &statistics, unsigned int n_bins)
+{
+  ASSERT(n_bins > 0, "The histograms need at least one bin");
+
+  boost::property_tree::ptree summary;
+  summary.put("eigensolver", eigensolver_type);
+
+  std::vector<
+      std::pair<char const *, std::function<double(AgglomerateStatistics)>>>
+      quantities = {
+          {"n_dofs", [](AgglomerateStatistics s) { return s.n_dofs; }},
+          {"n_eigenvectors",
+           [](AgglomerateStatistics s) { return s.n_eigenvectors; }},
+          {"n_iterations",
+           [](AgglomerateStatistics s) { return s.n_iterations; }},
+          {"n_operator_applies",
+           [](AgglomerateStatistics s) { return s.n_operator_applies; }},
+          {"wall_time", [](AgglomerateStatistics s) { return s.wall_time; }},
+          {"residual", [](AgglomerateStatistics s) { return s.residual; }},
+          {"min_eigenvalue",
+           [](AgglomerateStatistics s) { return s.min_eigenvalue; }},
+          {"max_eigenvalue",
+           [](AgglomerateStatistics s) { return s.max_eigenvalue; }}};
+  std::vector<double> values(statistics.size());
+  for (auto const &quantity : quantities)
+  {
+    std::transform(statistics.begin(), statistics.end(), values.begin(),
+                   quantity.second);
+    summary.put_child(quantity.first, summarize(comm, values, n_bins));
+  }
+  summary.put("n_agglomerates",
+              summary.get<unsigned long long>("n_dofs.count"));
+
+  // Every processor contributes one value so the distribution shows the load
+  // imbalance between the processors
+  double processor_wall_time = 0.;
+  for (auto const &s : statistics)
+    processor_wall_time += s.wall_time;
+  summary.put_child("processor_wall_time",
+                    summarize(comm, {processor_wall_time}, n_bins));
+
+  return summary;
+}
+
+boost::property_tree::ptree
+summarize_thread_utilization(MPI_Comm comm,
+                             ThreadUtilization const &thread_utilization)
+{
+  boost::property_tree::ptree summary;
+  summary.put("n_threads", thread_utilization.n_threads);
+
+  double const available_time =
+      thread_utilization.n_threads * thread_utilization.wall_time;
+  double const utilization = available_time > 0.
+                                 ? thread_utilization.busy_time / available_time
+                                 : 1.;
+  // The histograms are not useful with one value per processor
+  unsigned int const n_bins = 1;
+  for (auto const &quantity :
+       {std::make_pair("wall_time", thread_utilization.wall_time),
+        std::make_pair("utilization", utilization)})
+  {
+    auto quantity_summary = summarize(comm, {quantity.second}, n_bins);
+    quantity_summary.erase("histogram");
+    summary.put_child(quantity.first, quantity_summary);
+  }
+
+  return summary;
+}
+} // namespace mfmg
@@ -0,0 +1,81 @@
+/**************************************************************************
+ * Copyright (c) 2017-2019 by the mfmg authors                            *
+ * All rights reserved.                                                   *
+ *                                                                        *
+ * This file is part of the mfmg library. mfmg is distributed under a BSD *
+ * 3-clause license. For the licensing terms see the LICENSE file in the  *
+ * top-level directory                                                    *
+ *                                                                        *
+ * SPDX-License-Identifier: BSD-3-Clause                                  *
+ *************************************************************************/
+
+#include <mfmg/common/memory.hpp>
+
+#include <deal.II/base/mpi.h>
+#include <deal.II/base/utilities.h>
+
+#include <algorithm>
+#include <fstream>
+
+namespace mfmg
+{
+namespace
+{
+// Largest high-water mark discarded by reset_peak_memory_usage() since the
+// last call to start_peak_memory_measurement()
+std::size_t discarded_peak = 0;
+} // namespace
+
+MemoryUsage get_memory_usage()
+{
+  // deal.II reads /proc/self/status and reports the values in kB
+  dealii::Utilities::System::MemoryStats stats;
+  dealii::Utilities::System::get_memory_stats(stats);
+
+  MemoryUsage usage;
+  usage.resident = static_cast<std::size_t>(stats.VmRSS) * 1024;
+  usage.peak = static_cast<std::size_t>(stats.VmHWM) * 1024;
+
+  return usage;
+}
+
+bool reset_peak_memory_usage()
+{
+  discarded_peak = std::max(discarded_peak, get_memory_usage().peak);
+
+  // Writing 5 to clear_refs resets VmHWM on Linux 4.0 and later
+  std::ofstream clear_refs("/proc/self/clear_refs");
+  if (!clear_refs)
+    return false;
+  clear_refs << "5";
+  clear_refs.close();
+
+  return !clear_refs.fail();
+}
+
+bool start_peak_memory_measurement()
+{
+  bool const reset = reset_peak_memory_usage();
+  discarded_peak = 0;
+
+  return reset;
+}
+
+std::size_t get_measured_peak_memory_usage()
+{
+  return std::max(discarded_peak, get_memory_usage().peak);
+}
+
+boost::property_tree::ptree summarize_memory(MPI_Comm comm, std::size_t bytes)
+{
+  auto const stats =
+      dealii::Utilities::MPI::min_max_avg(static_cast<double>(bytes), comm);
+  boost::property_tree::ptree summary;
+  summary.put("min", stats.min);
+  summary.put("max", stats.max);
+  summary.put("mean", stats.avg);
+  summary.put("total", stats.sum);
+
+  return summary;
+}
+} // namespace mfmg
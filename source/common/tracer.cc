@@ -0,0 +1,240 @@
+/**************************************************************************
+ * Copyright (c) 2017-2019 by the mfmg authors                            *
+ * All rights reserved.                                                   *
+ *                                                                        *
+ * This file is part of the mfmg library. mfmg is distributed under a BSD *
+ * 3-clause license. For the licensing terms see the LICENSE file in the  *
+ * top-level directory                                                    *
+ *                                                                        *
+ * SPDX-License-Identifier: BSD-3-Clause                                  *
+ *************************************************************************/
+
+#include <mfmg/common/exceptions.hpp>
+#include <mfmg/common/tracer.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+namespace mfmg
+{
+namespace
+{
+struct TraceEvent
+{
+  std::string name;
+  char phase;
+  double timestamp;
+  std::vector<TraceArgument> arguments;
+};
+
+// The mutex of a buffer is only contended when clear() or write_chrome_trace()
+// run concurrently with the thread that owns the buffer.
+struct ThreadBuffer
+{
+  unsigned int thread_id;
+  std::mutex mutex;
+  std::vector<TraceEvent> events;
+};
+
+// The buffers are never destroyed so that the events of a thread survive the
+// thread.
+std::mutex buffers_mutex;
+std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+
+ThreadBuffer &get_thread_buffer()
+{
+  thread_local ThreadBuffer *buffer = nullptr;
+  if (buffer == nullptr)
+  {
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    buffers.push_back(std::make_unique<ThreadBuffer>());
+    buffers.back()->thread_id = buffers.size() - 1;
+    buffer = buffers.back().get();
+  }
+
+  return *buffer;
+}
+
+double get_timestamp()
+{
+  // The trace-event format uses microseconds
+  return std::chrono::duration<double, std::micro>(
+             std::chrono::steady_clock::now() - origin)
+      .count();
+}
+
+void write_json_string(std::ostream &os, std::string const &str)
+{
+  os << '"';
+  for (char const c : str)
+  {
+    if (c == '"' || c == '\\')
+      os << '\\' << c;
+    else if (c == '\n')
+      os << "\\n";
+    else if (static_cast<unsigned char>(c) >= 0x20)
+      os << c;
+  }
+  os << '"';
+}
+
+void write_json_arguments(std::ostream &os,
+                          std::vector<TraceArgument> const &arguments)
+{
+  os << ",\"args\":{";
+  for (unsigned int i = 0; i < arguments.size(); ++i)
+  {
+    if (i > 0)
+      os << ',';
+    write_json_string(os, arguments[i].first);
+    os << ':' << arguments[i].second;
+  }
+  os << '}';
+}
+} // namespace
+
+std::atomic<bool> Tracer::_enabled(false);
+
+void Tracer::enable(MPI_Comm comm)
+{
+  MPI_Barrier(comm);
+  origin = std::chrono::steady_clock::now();
+  _enabled.store(true, std::memory_order_relaxed);
+}
+
+void Tracer::disable() { _enabled.store(false, std::memory_order_relaxed); }
+
+void Tracer::clear()
+{
+  std::lock_guard<std::mutex> lock(buffers_mutex);
+  for (auto &buffer : buffers)
+  {
+    std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+    buffer->events.clear();
+  }
+}
+
+void Tracer::begin(std::string const &name,
+                   std::initializer_list<TraceArgument> arguments)
+{
+  if (!is_enabled())
+    return;
+
+  auto &buffer = get_thread_buffer();
+  std::lock_guard<std::mutex> lock(buffer.mutex);
+  buffer.events.push_back(
+      {name, 'B', get_timestamp(), std::vector<TraceArgument>(arguments)});
+}
+
+void Tracer::end(std::vector<TraceArgument> const &arguments)
+{
+  if (!is_enabled())
+    return;
+
+  auto &buffer = get_thread_buffer();
+  std::lock_guard<std::mutex> lock(buffer.mutex);
+  buffer.events.push_back({std::string(), 'E', get_timestamp(), arguments});
+}
+
+void Tracer::write_chrome_trace(std::string const &filename, MPI_Comm comm)
+{
+  int rank = 0;
+  MPI_Comm_rank(comm, &rank);
+  int n_processes = 1;
+  MPI_Comm_size(comm, &n_processes);
+
+  // Every processor serializes its events and the first processor gathers and
+  // writes them.
+  std::ostringstream local_trace;
+  local_trace.precision(15);
+  local_trace << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << rank
+              << ",\"args\":{\"name\":\"rank " << rank << "\"}}";
+  {
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    for (auto const &buffer : buffers)
+    {
+      std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+      if (buffer->events.empty())
+        continue;
+
+      local_trace << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":"
+                  << rank << ",\"tid\":" << buffer->thread_id
+                  << ",\"args\":{\"name\":\"thread " << buffer->thread_id
+                  << "\"}}";
+      for (auto const &event : buffer->events)
+      {
+        local_trace << ",\n{";
+        if (event.phase == 'B')
+        {
+          local_trace << "\"name\":";
+          write_json_string(local_trace, event.name);
+          local_trace << ',';
+        }
+        local_trace << "\"ph\":\"" << event.phase
+                    << "\",\"ts\":" << event.timestamp << ",\"pid\":" << rank
+                    << ",\"tid\":" << buffer->thread_id;
+        if (!event.arguments.empty())
+          write_json_arguments(local_trace, event.arguments);
+        local_trace << '}';
+      }
+    }
+  }
+  std::string const local_str = local_trace.str();
+
+  // The first processor streams the traces of the other processors to the file
+  // one at a time so that it never holds more than one trace. The sizes are
+  // sent as 64-bit integers and the traces in chunks that fit in an int so
+  // that a trace can be larger than 2 GB.
+  std::ofstream file;
+  int file_is_open = 1;
+  if (rank == 0)
+  {
+    file.open(filename);
+    file_is_open = file.good() ? 1 : 0;
+  }
+  MPI_Bcast(&file_is_open, 1, MPI_INT, 0, comm);
+  ASSERT_THROW(file_is_open == 1, "Cannot open " + filename);
+
+  std::uint64_t constexpr chunk_size = 1 << 30;
+  int constexpr tag = 0;
+  if (rank == 0)
+  {
+    file << "{\"traceEvents\":[\n";
+    file << local_str;
+    std::string remote_str;
+    for (int i = 1; i < n_processes; ++i)
+    {
+      std::uint64_t remote_size = 0;
+      MPI_Recv(&remote_size, 1, MPI_UINT64_T, i, tag, comm, MPI_STATUS_IGNORE);
+      remote_str.resize(std::min(remote_size, chunk_size));
+      file << ",\n";
+      for (std::uint64_t offset = 0; offset < remote_size;
+           offset += chunk_size)
+      {
+        int const count = std::min(remote_size - offset, chunk_size);
+        MPI_Recv(&remote_str[0], count, MPI_CHAR, i, tag, comm,
+                 MPI_STATUS_IGNORE);
+        file.write(remote_str.data(), count);
+      }
+    }
+    file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    ASSERT_THROW(file.good(), "Error while writing " + filename);
+  }
+  else
+  {
+    std::uint64_t const local_size = local_str.size();
+    MPI_Send(&local_size, 1, MPI_UINT64_T, 0, tag, comm);
+    for (std::uint64_t offset = 0; offset < local_size; offset += chunk_size)
+    {
+      int const count = std::min(local_size - offset, chunk_size);
+      MPI_Send(local_str.data() + offset, count, MPI_CHAR, 0, tag, comm);
+    }
+  }
+}
+} // namespace mfmg
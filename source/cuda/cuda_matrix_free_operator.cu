@@ -164,6 +164,13 @@ size_t CudaMatrixFreeOperator<dim, VectorType>::operator_complexity() const
   return 0;
 }
 
+template <int dim, typename VectorType>
+std::size_t CudaMatrixFreeOperator<dim, VectorType>::memory_consumption() const
+{
+  // The matrix-free data is owned by the mesh evaluator
+  return sizeof(*this);
+}
+
 template <int dim, typename VectorType>
 std::shared_ptr<dealii::DiagonalMatrix<VectorType>>
 CudaMatrixFreeOperator<dim, VectorType>::get_diagonal_inverse() const
@@ -260,6 +260,16 @@ size_t CudaMatrixOperator<VectorType>::operator_complexity() const
   return _matrix->n_nonzero_elements();
 }
 
+template <typename VectorType>
+std::size_t CudaMatrixOperator<VectorType>::memory_consumption() const
+{
+  std::size_t memory = _matrix->memory_consumption();
+  if (_transposed_matrix)
+    memory += _transposed_matrix->memory_consumption();
+
+  return memory;
+}
+
 template <typename VectorType>
 std::shared_ptr<SparseMatrixDevice<typename VectorType::value_type>>
 CudaMatrixOperator<VectorType>::get_matrix() const
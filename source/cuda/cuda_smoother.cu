@@ -24,14 +24,14 @@ struct SmootherOperator
   static void
   apply(SparseMatrixDevice<typename VectorType::value_type> const &matrix,
         SparseMatrixDevice<typename VectorType::value_type> const &smoother,
-        VectorType const &b, VectorType &x);
+        VectorType const &b, VectorType &x, bool zero_initial_guess);
 };
 
 template <typename VectorType>
 void SmootherOperator<VectorType>::apply(
     SparseMatrixDevice<typename VectorType::value_type> const &matrix,
     SparseMatrixDevice<typename VectorType::value_type> const &smoother,
-    VectorType const &b, VectorType &x)
+    VectorType const &b, VectorType &x, bool zero_initial_guess)
 {
   ASSERT_THROW_NOT_IMPLEMENTED();
 }
@@ -44,8 +44,18 @@ void SmootherOperator<dealii::LinearAlgebra::distributed::Vector<
           dealii::LinearAlgebra::distributed::Vector<
               double, dealii::MemorySpace::CUDA> const &b,
           dealii::LinearAlgebra::distributed::Vector<
-              double, dealii::MemorySpace::CUDA> &x)
+              double, dealii::MemorySpace::CUDA> &x,
+          bool zero_initial_guess)
 {
+  if (zero_initial_guess)
+  {
+    // x = 0 so that x = B^{-1} b and we can skip the computation of the
+    // residual
+    smoother.vmult(x, b);
+
+    return;
+  }
+
   // r = -(b - Ax)
   dealii::LinearAlgebra::distributed::Vector<double, dealii::MemorySpace::CUDA>
       r(b);
@@ -67,15 +77,16 @@ void SmootherOperator<dealii::LinearAlgebra::distributed::Vector<
           dealii::LinearAlgebra::distributed::Vector<
               double, dealii::MemorySpace::Host> const &b,
           dealii::LinearAlgebra::distributed::Vector<
-              double, dealii::MemorySpace::Host> &x)
+              double, dealii::MemorySpace::Host> &x,
+          bool zero_initial_guess)
 {
   // Copy to the device
   auto x_dev = copy_from_host(x);
   auto b_dev = copy_from_host(b);
 
   SmootherOperator<dealii::LinearAlgebra::distributed::Vector<
-      double, dealii::MemorySpace::CUDA>>::apply(matrix, smoother, b_dev,
-                                                 x_dev);
+      double, dealii::MemorySpace::CUDA>>::apply(matrix, smoother, b_dev, x_dev,
+                                                 zero_initial_guess);
 
   // Move the data to the host
   std::vector<double> x_host(x.local_size());
@@ -162,13 +173,21 @@ CudaSmoother<VectorType>::CudaSmoother(
 }
 
 template <typename VectorType>
-void CudaSmoother<VectorType>::apply(VectorType const &b, VectorType &x) const
+void CudaSmoother<VectorType>::apply(VectorType const &b, VectorType &x,
+                                     bool zero_initial_guess) const
 {
   auto cuda_operator =
       std::dynamic_pointer_cast<CudaMatrixOperator<VectorType> const>(
           this->_operator);
   auto matrix = cuda_operator->get_matrix();
-  SmootherOperator<VectorType>::apply(*matrix, _smoother, b, x);
+  SmootherOperator<VectorType>::apply(*matrix, _smoother, b, x,
+                                      zero_initial_guess);
+}
+
+template <typename VectorType>
+std::size_t CudaSmoother<VectorType>::memory_consumption() const
+{
+  return _smoother.memory_consumption();
 }
 } // namespace mfmg
 
@@ -513,6 +513,17 @@ void CudaSolver<VectorType>::apply(VectorType const &b, VectorType &x) const
 #endif
     DirectSolver<VectorType>::apply(_cuda_handle, *matrix, _solver, b, x);
 }
+
+template <typename VectorType>
+std::size_t CudaSolver<VectorType>::memory_consumption() const
+{
+  std::size_t memory = sizeof(*this) + _solver.capacity();
+#if MFMG_WITH_AMGX
+  memory += _row_map.size() * (sizeof(int) + sizeof(int) + sizeof(void *));
+#endif
+
+  return memory;
+}
 } // namespace mfmg
 
 // Explicit Instantiation
@@ -0,0 +1,491 @@
+/**************************************************************************
+ * Copyright (c) 2017-2019 by the mfmg authors                            *
+ * All rights reserved.                                                   *
+ *                                                                        *
+ * This file is part of the mfmg library. mfmg is distributed under a BSD *
+ * 3-clause license. For the licensing terms see the LICENSE file in the  *
+ * top-level directory                                                    *
+ *                                                                        *
+ * SPDX-License-Identifier: BSD-3-Clause                                  *
+ *************************************************************************/
+
+#include <mfmg/common/amge.hpp>
+#include <mfmg/common/instantiation.hpp>
+#include <mfmg/common/tracer.hpp>
+#include <mfmg/dealii/algebraic_hierarchy_helpers.hpp>
+#include <mfmg/dealii/amge_host.hpp>
+#include <mfmg/dealii/dealii_trilinos_matrix_operator.hpp>
+
+#include <deal.II/base/multithread_info.h>
+#include <deal.II/base/thread_management.h>
+#include <deal.II/lac/dynamic_sparsity_pattern.h>
+#include <deal.II/lac/sparse_matrix.h>
+#include <deal.II/lac/sparsity_pattern.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iterator>
+#include <numeric>
+#include <queue>
+#include <random>
+
+namespace mfmg
+{
+namespace
+{
+// Group the vertices of a graph into connected agglomerates of at most
+// agglomerate_size vertices. The agglomerates are grown by breadth-first search
+// from the first vertex that has not been assigned yet.
+std::vector<std::vector<unsigned int>>
+grow_agglomerates(std::vector<std::vector<unsigned int>> const &graph,
+                  unsigned int const agglomerate_size)
+{
+  unsigned int const n_vertices = graph.size();
+  std::vector<bool> assigned(n_vertices, false);
+  std::vector<std::vector<unsigned int>> agglomerates;
+  for (unsigned int seed = 0; seed < n_vertices; ++seed)
+  {
+    if (assigned[seed])
+      continue;
+
+    std::vector<unsigned int> agglomerate;
+    std::queue<unsigned int> front;
+    front.push(seed);
+    assigned[seed] = true;
+    while (!front.empty() && (agglomerate.size() < agglomerate_size))
+    {
+      unsigned int const vertex = front.front();
+      front.pop();
+      agglomerate.push_back(vertex);
+      for (auto const neighbor : graph[vertex])
+        if (!assigned[neighbor] &&
+            (agglomerate.size() + front.size() < agglomerate_size))
+        {
+          assigned[neighbor] = true;
+          front.push(neighbor);
+        }
+    }
+    agglomerates.push_back(agglomerate);
+  }
+
+  return agglomerates;
+}
+
+// Two elements are connected if they share a degree of freedom
+std::vector<std::vector<unsigned int>> build_element_graph(
+    std::vector<std::vector<dealii::types::global_dof_index>> const
+        &element_dofs)
+{
+  std::vector<std::pair<dealii::types::global_dof_index, unsigned int>>
+      dof_to_element;
+  for (unsigned int e = 0; e < element_dofs.size(); ++e)
+    for (auto const dof : element_dofs[e])
+      dof_to_element.emplace_back(dof, e);
+  std::sort(dof_to_element.begin(), dof_to_element.end());
+
+  std::vector<std::vector<unsigned int>> graph(element_dofs.size());
+  auto begin = dof_to_element.begin();
+  while (begin != dof_to_element.end())
+  {
+    auto end = begin;
+    while ((end != dof_to_element.end()) && (end->first == begin->first))
+      ++end;
+    for (auto a = begin; a != end; ++a)
+      for (auto b = begin; b != end; ++b)
+        if (a->second != b->second)
+          graph[a->second].push_back(b->second);
+    begin = end;
+  }
+  for (auto &neighbors : graph)
+  {
+    std::sort(neighbors.begin(), neighbors.end());
+    neighbors.erase(std::unique(neighbors.begin(), neighbors.end()),
+                    neighbors.end());
+  }
+
+  return graph;
+}
+
+// The vertices are the locally owned rows of the matrix
+std::vector<std::vector<unsigned int>>
+build_matrix_graph(dealii::TrilinosWrappers::SparseMatrix const &matrix)
+{
+  dealii::IndexSet const locally_owned_rows =
+      matrix.locally_owned_range_indices();
+  std::vector<std::vector<unsigned int>> graph(
+      locally_owned_rows.n_elements());
+  unsigned int i = 0;
+  for (auto const row : locally_owned_rows)
+  {
+    for (auto entry = matrix.begin(row); entry != matrix.end(row); ++entry)
+    {
+      auto const column = entry->column();
+      if ((column != row) && locally_owned_rows.is_element(column))
+        graph[i].push_back(locally_owned_rows.index_within_set(column));
+    }
+    ++i;
+  }
+
+  return graph;
+}
+
+// Random initial guess which is zero on the constrained degrees of freedom,
+// see DealIIMeshEvaluator::set_initial_guess()
+dealii::Vector<double>
+build_initial_guess(unsigned int const n,
+                    std::vector<unsigned int> const &constrained_dofs)
+{
+  dealii::Vector<double> x(n);
+  std::default_random_engine generator;
+  std::uniform_real_distribution<double> distribution(0., 1.);
+  for (unsigned int i = 0; i < n; ++i)
+    x[i] = distribution(generator);
+  for (auto const i : constrained_dofs)
+    x[i] = 0.;
+
+  return x;
+}
+} // namespace
+
+template <typename VectorType>
+std::shared_ptr<Operator<VectorType>>
+AlgebraicHierarchyHelpers<VectorType>::get_global_operator(
+    std::shared_ptr<MeshEvaluator> mesh_evaluator)
+{
+  // Downcast to AlgebraicMeshEvaluator
+  auto algebraic_mesh_evaluator =
+      std::dynamic_pointer_cast<AlgebraicMeshEvaluator>(mesh_evaluator);
+  ASSERT_THROW(algebraic_mesh_evaluator != nullptr,
+               "The evaluator is not an AlgebraicMeshEvaluator");
+
+  return std::make_shared<DealIITrilinosMatrixOperator<VectorType>>(
+      algebraic_mesh_evaluator->get_matrix());
+}
+
+template <typename VectorType>
+std::shared_ptr<Operator<VectorType>>
+AlgebraicHierarchyHelpers<VectorType>::build_restrictor(
+    MPI_Comm comm, std::shared_ptr<MeshEvaluator> mesh_evaluator,
+    std::shared_ptr<boost::property_tree::ptree const> params)
+{
+  // Downcast to AlgebraicMeshEvaluator
+  auto algebraic_mesh_evaluator =
+      std::dynamic_pointer_cast<AlgebraicMeshEvaluator>(mesh_evaluator);
+  ASSERT_THROW(algebraic_mesh_evaluator != nullptr,
+               "The evaluator is not an AlgebraicMeshEvaluator");
+  ASSERT_THROW(!params->get("fast_ap", false),
+               "fast_ap is not supported by AlgebraicMeshEvaluator");
+
+  auto eigensolver_params = params->get_child("eigensolver");
+  unsigned int const n_eigenvectors =
+      eigensolver_params.get("number of eigenvectors", 1);
+  double const tolerance = eigensolver_params.get("tolerance", 1e-14);
+  unsigned int const agglomerate_size =
+      params->get<unsigned int>("agglomeration.size");
+  ASSERT_THROW(agglomerate_size > 0, "agglomeration.size must be positive");
+
+  auto const &matrix = *algebraic_mesh_evaluator->get_matrix();
+  auto const &constrained_dofs =
+      algebraic_mesh_evaluator->get_constrained_dofs();
+  auto const &element_dofs = algebraic_mesh_evaluator->get_element_dofs();
+  auto const &element_matrices =
+      algebraic_mesh_evaluator->get_element_matrices();
+  bool const use_elements = algebraic_mesh_evaluator->has_elements();
+  dealii::IndexSet const locally_owned_rows =
+      matrix.locally_owned_range_indices();
+
+  std::vector<std::vector<unsigned int>> agglomerates;
+  {
+    TraceScope agglomerate_scope("Algebraic: build agglomerates");
+    agglomerates = grow_agglomerates(use_elements
+                                         ? build_element_graph(element_dofs)
+                                         : build_matrix_graph(matrix),
+                                     agglomerate_size);
+  }
+
+  // The results are stored by agglomerate so that the restrictor does not
+  // depend on the order in which the threads process the agglomerates
+  unsigned int const n_agglomerates = agglomerates.size();
+  std::vector<std::vector<dealii::Vector<double>>> agglomerate_eigenvectors(
+      n_agglomerates);
+  std::vector<std::vector<double>> diag_elements(n_agglomerates);
+  std::vector<std::vector<dealii::types::global_dof_index>> dof_indices_maps(
+      n_agglomerates);
+  std::vector<unsigned int> n_local_eigenvectors(n_agglomerates);
+  std::vector<AgglomerateStatistics> agglomerate_statistics(n_agglomerates);
+  auto const solve_agglomerate = [&](unsigned int const i,
+                                     LobpcgScratchData &scratch_data) {
+    TraceScope agglomerate_scope("Algebraic: agglomerate",
+                                 {{"agglomerate", i + 1}});
+    auto const agglomerate_start = std::chrono::steady_clock::now();
+
+    // The degrees of freedom of the agglomerate, sorted by global index
+    auto &dofs = dof_indices_maps[i];
+    if (use_elements)
+    {
+      for (auto const e : agglomerates[i])
+        dofs.insert(dofs.end(), element_dofs[e].begin(), element_dofs[e].end());
+      std::sort(dofs.begin(), dofs.end());
+      dofs.erase(std::unique(dofs.begin(), dofs.end()), dofs.end());
+    }
+    else
+    {
+      for (auto const vertex : agglomerates[i])
+        dofs.push_back(locally_owned_rows.nth_index_in_set(vertex));
+      std::sort(dofs.begin(), dofs.end());
+    }
+    unsigned int const n_dofs = dofs.size();
+    auto const local_index = [&](dealii::types::global_dof_index const dof) {
+      return std::lower_bound(dofs.begin(), dofs.end(), dof) - dofs.begin();
+    };
+
+    // Build the local matrix
+    dealii::DynamicSparsityPattern agglomerate_dsp(n_dofs, n_dofs);
+    if (use_elements)
+    {
+      for (auto const e : agglomerates[i])
+        for (auto const dof_i : element_dofs[e])
+          for (auto const dof_j : element_dofs[e])
+            agglomerate_dsp.add(local_index(dof_i), local_index(dof_j));
+    }
+    else
+    {
+      for (unsigned int k = 0; k < n_dofs; ++k)
+        for (auto entry = matrix.begin(dofs[k]); entry != matrix.end(dofs[k]);
+             ++entry)
+          if (std::binary_search(dofs.begin(), dofs.end(), entry->column()))
+            agglomerate_dsp.add(k, local_index(entry->column()));
+    }
+    dealii::SparsityPattern agglomerate_sparsity_pattern;
+    agglomerate_sparsity_pattern.copy_from(agglomerate_dsp);
+    dealii::SparseMatrix<double> agglomerate_system_matrix(
+        agglomerate_sparsity_pattern);
+    diag_elements[i].resize(n_dofs);
+    if (use_elements)
+    {
+      // The local Neumann matrix is the sum of the element matrices. The sums
+      // of the local diagonals of the agglomerates sharing a degree of freedom
+      // is the global diagonal.
+      for (auto const e : agglomerates[i])
+      {
+        auto const &e_dofs = element_dofs[e];
+        for (unsigned int a = 0; a < e_dofs.size(); ++a)
+          for (unsigned int b = 0; b < e_dofs.size(); ++b)
+            agglomerate_system_matrix.add(local_index(e_dofs[a]),
+                                          local_index(e_dofs[b]),
+                                          element_matrices[e](a, b));
+      }
+      for (unsigned int k = 0; k < n_dofs; ++k)
+        diag_elements[i][k] = agglomerate_system_matrix.diag_element(k);
+    }
+    else
+    {
+      // Without the element matrices, the couplings with the outside of the
+      // agglomerate are lumped on the diagonal. For an M-matrix, this recovers
+      // the Neumann matrix of the agglomerate. The agglomerates do not overlap
+      // so the weights of the restriction are one.
+      for (unsigned int k = 0; k < n_dofs; ++k)
+      {
+        for (auto entry = matrix.begin(dofs[k]); entry != matrix.end(dofs[k]);
+             ++entry)
+        {
+          if (std::binary_search(dofs.begin(), dofs.end(), entry->column()))
+            agglomerate_system_matrix.add(k, local_index(entry->column()),
+                                          entry->value());
+          else
+            agglomerate_system_matrix.diag_element(k) += entry->value();
+        }
+        diag_elements[i][k] = matrix.diag_element(dofs[k]);
+      }
+    }
+
+    // Compute the eigenvalues and the eigenvectors
+    std::vector<unsigned int> agglomerate_constrained_dofs;
+    for (unsigned int k = 0; k < n_dofs; ++k)
+      if (constrained_dofs.is_element(dofs[k]))
+        agglomerate_constrained_dofs.push_back(k);
+    dealii::Vector<double> const initial_vector =
+        build_initial_guess(n_dofs, agglomerate_constrained_dofs);
+    // Small agglomerates can be found on the boundary of the partition
+    n_local_eigenvectors[i] = std::min(n_eigenvectors, n_dofs);
+    std::vector<std::complex<double>> local_eigenvalues;
+    std::vector<dealii::Vector<double>> local_eigenvectors;
+    std::tie(local_eigenvalues, local_eigenvectors) =
+        compute_agglomerate_eigenpairs(
+            n_local_eigenvectors[i], tolerance, eigensolver_params,
+            agglomerate_system_matrix, agglomerate_constrained_dofs,
+            initial_vector, scratch_data, &agglomerate_statistics[i]);
+    // The eigensolver parameters may select fewer eigenvectors
+    n_local_eigenvectors[i] = local_eigenvectors.size();
+    agglomerate_eigenvectors[i] = std::move(local_eigenvectors);
+
+    auto &statistics = agglomerate_statistics[i];
+    statistics.agglomerate_id = i + 1;
+    statistics.n_dofs = n_dofs;
+    statistics.n_eigenvectors = n_local_eigenvectors[i];
+    auto const minmax_eigenvalues = std::minmax_element(
+        local_eigenvalues.begin(), local_eigenvalues.end(),
+        [](std::complex<double> const &a, std::complex<double> const &b) {
+          return a.real() < b.real();
+        });
+    if (minmax_eigenvalues.first != local_eigenvalues.end())
+    {
+      statistics.min_eigenvalue = minmax_eigenvalues.first->real();
+      statistics.max_eigenvalue = minmax_eigenvalues.second->real();
+    }
+    statistics.wall_time = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() -
+                               agglomerate_start)
+                               .count();
+  };
+
+  // The agglomerates are distributed to the threads of the task pool as in
+  // AMGe_host::compute_agglomerate_eigenvectors(). The size of an agglomerate
+  // is its number of elements or of rows.
+  std::vector<unsigned int> agglomerate_order(n_agglomerates);
+  std::iota(agglomerate_order.begin(), agglomerate_order.end(), 0);
+  std::string const schedule =
+      params->get<std::string>("agglomeration.schedule", "largest first");
+  if (schedule == "largest first")
+  {
+    std::stable_sort(agglomerate_order.begin(), agglomerate_order.end(),
+                     [&](unsigned int const a, unsigned int const b) {
+                       return agglomerates[a].size() > agglomerates[b].size();
+                     });
+  }
+  else
+  {
+    ASSERT_THROW(schedule == "natural", "Unknown schedule '" + schedule + "'");
+  }
+  unsigned int const n_threads = std::max(
+      std::min(dealii::MultithreadInfo::n_threads(), n_agglomerates), 1u);
+  std::atomic<unsigned int> next_agglomerate(0);
+  std::vector<double> busy_times(n_threads, 0.);
+  auto const start = std::chrono::steady_clock::now();
+  dealii::Threads::TaskGroup<void> tasks;
+  for (unsigned int t = 0; t < n_threads; ++t)
+    tasks += dealii::Threads::new_task([&, t]() {
+      LobpcgScratchData scratch_data;
+      for (unsigned int i = next_agglomerate++; i < n_agglomerates;
+           i = next_agglomerate++)
+      {
+        auto const agglomerate_start = std::chrono::steady_clock::now();
+        solve_agglomerate(agglomerate_order[i], scratch_data);
+        busy_times[t] += std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() -
+                             agglomerate_start)
+                             .count();
+      }
+    });
+  tasks.join_all();
+  ThreadUtilization thread_utilization;
+  thread_utilization.n_threads = n_threads;
+  thread_utilization.wall_time =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+  thread_utilization.busy_time =
+      std::accumulate(busy_times.begin(), busy_times.end(), 0.);
+
+  std::vector<dealii::Vector<double>> eigenvectors;
+  for (auto &local_eigenvectors : agglomerate_eigenvectors)
+    eigenvectors.insert(eigenvectors.end(),
+                        std::make_move_iterator(local_eigenvectors.begin()),
+                        std::make_move_iterator(local_eigenvectors.end()));
+  agglomerate_eigenvectors.clear();
+
+  auto restrictor_matrix =
+      std::make_shared<dealii::TrilinosWrappers::SparseMatrix>();
+  assemble_restriction_sparse_matrix(
+      comm, locally_owned_rows, eigenvectors, diag_elements, dof_indices_maps,
+      n_local_eigenvectors, algebraic_mesh_evaluator->get_diagonal(),
+      *restrictor_matrix);
+
+  _restrictor_statistics = boost::property_tree::ptree();
+  _restrictor_statistics.put_child(
+      "eigensolver", summarize_agglomerate_statistics(
+                         comm, eigensolver_params.get("type", "arpack"),
+                         agglomerate_statistics));
+  _restrictor_statistics.put_child(
+      "threads", summarize_thread_utilization(comm, thread_utilization));
+
+  return std::make_shared<DealIITrilinosMatrixOperator<VectorType>>(
+      restrictor_matrix);
+}
+
+template <typename VectorType>
+boost::property_tree::ptree
+AlgebraicHierarchyHelpers<VectorType>::get_restrictor_statistics() const
+{
+  return _restrictor_statistics;
+}
+
+template <typename VectorType>
+std::shared_ptr<Operator<VectorType>>
+AlgebraicHierarchyHelpers<VectorType>::build_single_precision_operator(
+    std::shared_ptr<Operator<VectorType> const> op)
+{
+  return _dealii_helpers.build_single_precision_operator(op);
+}
+
+template <typename VectorType>
+std::shared_ptr<Smoother<VectorType>>
+AlgebraicHierarchyHelpers<VectorType>::build_smoother(
+    std::shared_ptr<Operator<VectorType> const> op,
+    std::shared_ptr<boost::property_tree::ptree const> params)
+{
+  std::string smoother_type = params->get("smoother.type", "");
+  std::transform(smoother_type.begin(), smoother_type.end(),
+                 smoother_type.begin(), ::tolower);
+  ASSERT_THROW(smoother_type != "block jacobi (agglomerate)",
+               "The agglomerate block Jacobi smoother is not supported by "
+               "AlgebraicMeshEvaluator");
+
+  return _dealii_helpers.build_smoother(op, params);
+}
+
+template <typename VectorType>
+std::shared_ptr<Solver<VectorType>>
+AlgebraicHierarchyHelpers<VectorType>::build_coarse_solver(
+    std::shared_ptr<Operator<VectorType> const> op,
+    std::shared_ptr<boost::property_tree::ptree const> params)
+{
+  return _dealii_helpers.build_coarse_solver(op, params);
+}
+
+template <typename VectorType>
+void AlgebraicHierarchyHelpers<VectorType>::save_operator(
+    std::shared_ptr<Operator<VectorType> const> op, std::string const &filename)
+{
+  _dealii_helpers.save_operator(op, filename);
+}
+
+template <typename VectorType>
+std::shared_ptr<Operator<VectorType>>
+AlgebraicHierarchyHelpers<VectorType>::load_operator(
+    MPI_Comm comm, std::string const &filename)
+{
+  return _dealii_helpers.load_operator(comm, filename);
+}
+
+template <typename VectorType>
+void AlgebraicHierarchyHelpers<VectorType>::save_smoother(
+    std::shared_ptr<Smoother<VectorType> const> smoother,
+    std::string const &filename)
+{
+  _dealii_helpers.save_smoother(smoother, filename);
+}
+
+template <typename VectorType>
+std::shared_ptr<Smoother<VectorType>>
+AlgebraicHierarchyHelpers<VectorType>::load_smoother(
+    std::shared_ptr<Operator<VectorType> const> op,
+    std::shared_ptr<boost::property_tree::ptree const> params,
+    std::string const &filename)
+{
+  return _dealii_helpers.load_smoother(op, params, filename);
+}
+} // namespace mfmg
+
+// Explicit Instantiation
+INSTANTIATE_VECTORTYPE(TUPLE(AlgebraicHierarchyHelpers))
@@ -0,0 +1,112 @@
+/**************************************************************************
+ * Copyright (c) 2017-2019 by the mfmg authors                            *
+ * All rights reserved.                                                   *
+ *                                                                        *
+ * This file is part of the mfmg library. mfmg is distributed under a BSD *
+ * 3-clause license. For the licensing terms see the LICENSE file in the  *
+ * top-level directory                                                    *
+ *                                                                        *
+ * SPDX-License-Identifier: BSD-3-Clause                                  *
+ *************************************************************************/
+
+#include <mfmg/common/exceptions.hpp>
+#include <mfmg/dealii/algebraic_mesh_evaluator.hpp>
+
+#include <utility>
+
+namespace mfmg
+{
+AlgebraicMeshEvaluator::AlgebraicMeshEvaluator(
+    std::shared_ptr<dealii::TrilinosWrappers::SparseMatrix> matrix,
+    dealii::IndexSet const &constrained_dofs)
+    : _matrix(matrix), _constrained_dofs(constrained_dofs)
+{
+  ASSERT_THROW(_matrix != nullptr, "The matrix is required");
+  if (_constrained_dofs.size() == 0)
+    _constrained_dofs.set_size(_matrix->m());
+}
+
+AlgebraicMeshEvaluator::AlgebraicMeshEvaluator(
+    std::shared_ptr<dealii::TrilinosWrappers::SparseMatrix> matrix,
+    std::vector<std::vector<dealii::types::global_dof_index>> element_dofs,
+    std::vector<dealii::FullMatrix<double>> element_matrices,
+    dealii::IndexSet const &constrained_dofs)
+    : AlgebraicMeshEvaluator(matrix, constrained_dofs)
+{
+  ASSERT_THROW(element_dofs.size() == element_matrices.size(),
+               "There are " + std::to_string(element_dofs.size()) +
+                   " elements but " + std::to_string(element_matrices.size()) +
+                   " element matrices");
+  for (unsigned int e = 0; e < element_dofs.size(); ++e)
+    ASSERT_THROW((element_matrices[e].m() == element_dofs[e].size()) &&
+                     (element_matrices[e].n() == element_dofs[e].size()),
+                 "The matrix of element " + std::to_string(e) +
+                     " does not match its number of degrees of freedom");
+  _element_dofs = std::move(element_dofs);
+  _element_matrices = std::move(element_matrices);
+}
+
+int AlgebraicMeshEvaluator::get_dim() const
+{
+  return 0;
+}
+
+std::string AlgebraicMeshEvaluator::get_mesh_evaluator_type() const
+{
+  return "AlgebraicMeshEvaluator";
+}
+
+std::shared_ptr<dealii::TrilinosWrappers::SparseMatrix>
+AlgebraicMeshEvaluator::get_matrix() const
+{
+  return _matrix;
+}
+
+bool AlgebraicMeshEvaluator::has_elements() const
+{
+  return !_element_dofs.empty();
+}
+
+std::vector<std::vector<dealii::types::global_dof_index>> const &
+AlgebraicMeshEvaluator::get_element_dofs() const
+{
+  return _element_dofs;
+}
+
+std::vector<dealii::FullMatrix<double>> const &
+AlgebraicMeshEvaluator::get_element_matrices() const
+{
+  return _element_matrices;
+}
+
+dealii::IndexSet const &AlgebraicMeshEvaluator::get_constrained_dofs() const
+{
+  return _constrained_dofs;
+}
+
+dealii::LinearAlgebra::distributed::Vector<double>
+AlgebraicMeshEvaluator::get_diagonal() const
+{
+  auto comm = _matrix->get_mpi_communicator();
+  dealii::IndexSet const locally_owned_dofs =
+      _matrix->locally_owned_range_indices();
+  dealii::IndexSet locally_relevant_dofs = locally_owned_dofs;
+  for (auto const &dofs : _element_dofs)
+    locally_relevant_dofs.add_indices(dofs.begin(), dofs.end());
+  locally_relevant_dofs.compress();
+
+  dealii::LinearAlgebra::distributed::Vector<double> locally_owned_global_diag(
+      locally_owned_dofs, comm);
+  for (auto const val : locally_owned_dofs)
+    locally_owned_global_diag[val] = _matrix->diag_element(val);
+  locally_owned_global_diag.compress(dealii::VectorOperation::insert);
+
+  dealii::LinearAlgebra::distributed::Vector<double>
+      locally_relevant_global_diag(locally_owned_dofs, locally_relevant_dofs,
+                                   comm);
+  locally_relevant_global_diag = locally_owned_global_diag;
+  locally_relevant_global_diag.update_ghost_values();
+
+  return locally_relevant_global_diag;
+}
+} // namespace mfmg
@@ -16,6 +16,60 @@
 #include <deal.II/distributed/tria.h>
 #include <deal.II/lac/la_parallel_vector.h>
 
+#include <algorithm>
+#include <numeric>
+
+namespace mfmg
+{
+void select_agglomerate_eigenpairs(
+    boost::property_tree::ptree const &eigensolver_params,
+    double diagonal_scale, std::vector<std::complex<double>> &eigenvalues,
+    std::vector<dealii::Vector<double>> &eigenvectors)
+{
+  auto const threshold =
+      eigensolver_params.get_optional<double>("eigenvalue threshold");
+  auto const gap = eigensolver_params.get_optional<double>("eigenvalue gap");
+  if (!threshold && !gap)
+    return;
+
+  unsigned int const min_n_eigenvectors =
+      eigensolver_params.get("min number of eigenvectors", 1u);
+  ASSERT_THROW(min_n_eigenvectors > 0,
+               "min number of eigenvectors must be positive");
+
+  // Not all the eigensolvers return the eigenvalues in increasing order
+  unsigned int const n_computed = eigenvalues.size();
+  std::vector<unsigned int> permutation(n_computed);
+  std::iota(permutation.begin(), permutation.end(), 0);
+  std::stable_sort(permutation.begin(), permutation.end(),
+                   [&](unsigned int const a, unsigned int const b) {
+                     return eigenvalues[a].real() < eigenvalues[b].real();
+                   });
+
+  unsigned int n_kept = std::min(min_n_eigenvectors, n_computed);
+  for (; n_kept < n_computed; ++n_kept)
+  {
+    double const eigenvalue = eigenvalues[permutation[n_kept]].real();
+    if (threshold && (eigenvalue > *threshold * diagonal_scale))
+      break;
+    double const previous_eigenvalue =
+        eigenvalues[permutation[n_kept - 1]].real();
+    if (gap && (eigenvalue - previous_eigenvalue > *gap * diagonal_scale))
+      break;
+  }
+
+  std::vector<std::complex<double>> kept_eigenvalues(n_kept);
+  std::vector<dealii::Vector<double>> kept_eigenvectors(n_kept);
+  for (unsigned int i = 0; i < n_kept; ++i)
+  {
+    kept_eigenvalues[i] = eigenvalues[permutation[i]];
+    kept_eigenvectors[i] = std::move(eigenvectors[permutation[i]]);
+  }
+  eigenvalues.swap(kept_eigenvalues);
+  eigenvectors.swap(kept_eigenvectors);
+}
+} // namespace mfmg
+
 template class mfmg::AMGe_host<
     2, mfmg::DealIIMeshEvaluator<2>,
     dealii::LinearAlgebra::distributed::Vector<double>>;
@@ -44,9 +98,21 @@ template class mfmg::AMGe_host<
               typename dealii::DoFHandler<DIM>::active_cell_iterator> const    \
               &patch_to_global_map,                                            \
           MESH_EVALUATOR<DIM> const &evaluator,                                \
-          mfmg::LobpcgScratchData const &, int) const;
+          mfmg::LobpcgScratchData const &, mfmg::AgglomerateStatistics *,      \
+          int) const;
 
 INSTANTIATE_COMPUTE_LOCAL_EIGENVECTORS(2, mfmg::DealIIMeshEvaluator)
 INSTANTIATE_COMPUTE_LOCAL_EIGENVECTORS(3, mfmg::DealIIMeshEvaluator)
 INSTANTIATE_COMPUTE_LOCAL_EIGENVECTORS(2, mfmg::DealIIMatrixFreeMeshEvaluator)
 INSTANTIATE_COMPUTE_LOCAL_EIGENVECTORS(3, mfmg::DealIIMatrixFreeMeshEvaluator)
+
+template std::tuple<std::vector<std::complex<double>>,
+                    std::vector<dealii::Vector<double>>>
+mfmg::compute_agglomerate_eigenpairs(
+    unsigned int n_eigenvectors, double tolerance,
+    boost::property_tree::ptree const &eigensolver_params,
+    dealii::SparseMatrix<double> &agglomerate_system_matrix,
+    std::vector<unsigned int> const &constrained_dofs,
+    dealii::Vector<double> const &initial_vector,
+    mfmg::LobpcgScratchData const &scratch_data,
+    mfmg::AgglomerateStatistics *statistics);
@@ -0,0 +1,281 @@
+/**************************************************************************
+ * Copyright (c) 2017-2019 by the mfmg authors                            *
+ * All rights reserved.                                                   *
+ *                                                                        *
+ * This file is part of the mfmg library. mfmg is distributed under a BSD *
+ * 3-clause license. For the licensing terms see the LICENSE file in the  *
+ * top-level directory                                                    *
+ *                                                                        *
+ * SPDX-License-Identifier: BSD-3-Clause                                  *
+ *************************************************************************/
+
+#include <mfmg/common/exceptions.hpp>
+#include <mfmg/common/instantiation.hpp>
+#include <mfmg/dealii/dealii_agglomerate_smoother.hpp>
+#include <mfmg/dealii/dealii_trilinos_matrix_operator.hpp>
+#include <mfmg/dealii/dealii_utils.hpp>
+
+#include <deal.II/base/memory_consumption.h>
+#include <deal.II/base/parallel.h>
+
+#include <algorithm>
+#include <complex>
+#include <limits>
+
+#define lapack_complex_float std::complex<float>
+#define lapack_complex_double std::complex<double>
+#include <lapacke.h>
+
+namespace mfmg
+{
+namespace
+{
+// Minimum number of blocks given to a thread
+unsigned int constexpr grain_size = 16;
+
+void potrs(int n, float const *factor, float *rhs)
+{
+  LAPACKE_spotrs(LAPACK_COL_MAJOR, 'L', n, 1, factor, n, rhs, n);
+}
+
+void potrs(int n, double const *factor, double *rhs)
+{
+  LAPACKE_dpotrs(LAPACK_COL_MAJOR, 'L', n, 1, factor, n, rhs, n);
+}
+} // namespace
+
+template <typename VectorType, typename StorageType>
+DealIIAgglomerateSmoother<VectorType, StorageType>::DealIIAgglomerateSmoother(
+    std::shared_ptr<Operator<vector_type> const> op,
+    std::shared_ptr<boost::property_tree::ptree const> params,
+    std::vector<std::vector<dealii::types::global_dof_index>> const &blocks)
+    : Smoother<VectorType>(op, params)
+{
+  std::string prec_name =
+      this->_params->get("smoother.type", "Block Jacobi (Agglomerate)");
+  std::transform(prec_name.begin(), prec_name.end(), prec_name.begin(),
+                 ::tolower);
+  ASSERT_THROW(prec_name == "block jacobi (agglomerate)",
+               "Unknown smoother name: \"" + prec_name + "\"");
+  bool const overlap = this->_params->get("smoother.overlap", false);
+
+  auto trilinos_operator =
+      std::dynamic_pointer_cast<DealIITrilinosMatrixOperator<VectorType> const>(
+          this->_operator);
+  ASSERT_THROW(trilinos_operator != nullptr,
+               "DealIIAgglomerateSmoother must be constructed from a "
+               "DealIITrilinosMatrixOperator");
+  auto sparse_matrix = trilinos_operator->get_matrix();
+  auto const &epetra_matrix = sparse_matrix->trilinos_matrix();
+  dealii::IndexSet const locally_owned_dofs =
+      sparse_matrix->locally_owned_range_indices();
+  unsigned int const n_local_rows = locally_owned_dofs.n_elements();
+
+  // Each DoF is owned by the first block that contains it. The DoFs which are
+  // not in any block are put in their own block so that every row is relaxed.
+  unsigned int constexpr no_owner = std::numeric_limits<unsigned int>::max();
+  std::vector<unsigned int> owner(n_local_rows, no_owner);
+  std::vector<std::vector<unsigned int>> local_blocks;
+  local_blocks.reserve(blocks.size());
+  for (auto const &block : blocks)
+  {
+    unsigned int const block_id = local_blocks.size();
+    std::vector<unsigned int> local_block;
+    for (auto const dof : block)
+    {
+      ASSERT(locally_owned_dofs.is_element(dof),
+             "DoF " + std::to_string(dof) + " is not locally owned");
+      auto const i = locally_owned_dofs.index_within_set(dof);
+      if (owner[i] == no_owner)
+        owner[i] = block_id;
+      if (overlap || (owner[i] == block_id))
+        local_block.push_back(i);
+    }
+    if (local_block.size() > 0)
+      local_blocks.push_back(std::move(local_block));
+  }
+  for (unsigned int i = 0; i < n_local_rows; ++i)
+    if (owner[i] == no_owner)
+    {
+      owner[i] = local_blocks.size();
+      local_blocks.push_back({i});
+    }
+
+  // Compute the layout of the blocks and of the arena
+  unsigned int const n_blocks = local_blocks.size();
+  _block_offsets.resize(n_blocks + 1, 0);
+  _factor_offsets.resize(n_blocks + 1, 0);
+  for (unsigned int k = 0; k < n_blocks; ++k)
+  {
+    std::size_t const block_size = local_blocks[k].size();
+    _block_offsets[k + 1] = _block_offsets[k] + block_size;
+    _factor_offsets[k + 1] = _factor_offsets[k] + block_size * block_size;
+  }
+  _block_indices.reserve(_block_offsets.back());
+  _is_owned.reserve(_block_offsets.back());
+  for (unsigned int k = 0; k < n_blocks; ++k)
+    for (auto const i : local_blocks[k])
+    {
+      _block_indices.push_back(i);
+      _is_owned.push_back(owner[i] == k);
+    }
+  _factors.resize(_factor_offsets.back());
+
+  // Extract the diagonal blocks of the matrix and factorize them. The blocks
+  // are independent so this is done in parallel.
+  dealii::parallel::apply_to_subranges(
+      0U, n_blocks,
+      [&](unsigned int const begin, unsigned int const end) {
+        std::vector<double> factor;
+        for (unsigned int k = begin; k < end; ++k)
+        {
+          auto const block_begin = _block_indices.begin() + _block_offsets[k];
+          auto const block_end = _block_indices.begin() + _block_offsets[k + 1];
+          int const block_size = std::distance(block_begin, block_end);
+          factor.assign(block_size * block_size, 0.);
+          for (int row = 0; row < block_size; ++row)
+          {
+            int const local_row = epetra_matrix.LRID(static_cast<int>(
+                locally_owned_dofs.nth_index_in_set(*(block_begin + row))));
+            int n_entries = 0;
+            double *values = nullptr;
+            int *indices = nullptr;
+            epetra_matrix.ExtractMyRowView(local_row, n_entries, values,
+                                           indices);
+            for (int l = 0; l < n_entries; ++l)
+            {
+              auto const global_column = epetra_matrix.GCID(indices[l]);
+              if (!locally_owned_dofs.is_element(global_column))
+                continue;
+              unsigned int const column =
+                  locally_owned_dofs.index_within_set(global_column);
+              auto const position =
+                  std::lower_bound(block_begin, block_end, column);
+              if ((position != block_end) && (*position == column))
+                factor[std::distance(block_begin, position) * block_size +
+                       row] = values[l];
+            }
+          }
+
+          int const info = LAPACKE_dpotrf(LAPACK_COL_MAJOR, 'L', block_size,
+                                          factor.data(), block_size);
+          if (info != 0)
+            ASSERT_THROW(false, "The diagonal block of agglomerate " +
+                                    std::to_string(k) +
+                                    " is not symmetric positive definite");
+          std::copy(factor.begin(), factor.end(),
+                    _factors.begin() + _factor_offsets[k]);
+        }
+      },
+      grain_size);
+}
+
+template <typename VectorType, typename StorageType>
+DealIIAgglomerateSmoother<VectorType, StorageType>::DealIIAgglomerateSmoother(
+    std::shared_ptr<Operator<vector_type> const> op,
+    std::shared_ptr<boost::property_tree::ptree const> params,
+    std::istream &in)
+    : Smoother<VectorType>(op, params)
+{
+  read_binary_vector(in, _block_offsets);
+  read_binary_vector(in, _block_indices);
+  read_binary_vector(in, _is_owned);
+  read_binary_vector(in, _factor_offsets);
+  read_binary_vector(in, _factors);
+  ASSERT_THROW(!_block_offsets.empty() &&
+                   _block_indices.size() == _block_offsets.back() &&
+                   _is_owned.size() == _block_offsets.back() &&
+                   _factor_offsets.size() == _block_offsets.size() &&
+                   _factors.size() == _factor_offsets.back(),
+               "Inconsistent agglomerate block Jacobi smoother data");
+  // Every locally owned DoF is owned by exactly one block
+  std::size_t const n_owned_dofs =
+      std::count(_is_owned.begin(), _is_owned.end(), true);
+  ASSERT_THROW(n_owned_dofs ==
+                   this->_operator->build_range_vector()->local_size(),
+               "The agglomerate block Jacobi smoother does not match the "
+               "partition of the operator");
+}
+
+template <typename VectorType, typename StorageType>
+void DealIIAgglomerateSmoother<VectorType, StorageType>::save(
+    std::ostream &out) const
+{
+  write_binary_vector(out, _block_offsets);
+  write_binary_vector(out, _block_indices);
+  write_binary_vector(out, _is_owned);
+  write_binary_vector(out, _factor_offsets);
+  write_binary_vector(out, _factors);
+}
+
+template <typename VectorType, typename StorageType>
+void DealIIAgglomerateSmoother<VectorType, StorageType>::apply(
+    VectorType const &b, VectorType &x, bool zero_initial_guess) const
+{
+  // r = b - Ax
+  vector_type r(b);
+  if (!zero_initial_guess)
+  {
+    this->_operator->apply(x, r);
+    r.sadd(-1., 1., b);
+  }
+  else
+  {
+    x = 0.;
+  }
+
+  // x = x + B^{-1} r. Every DoF is updated by a single block so there is no
+  // race condition.
+  dealii::parallel::apply_to_subranges(
+      0U, n_blocks(),
+      [&](unsigned int const begin, unsigned int const end) {
+        std::vector<StorageType> buffer;
+        for (unsigned int k = begin; k < end; ++k)
+        {
+          unsigned int const offset = _block_offsets[k];
+          int const block_size = _block_offsets[k + 1] - offset;
+          buffer.resize(block_size);
+          for (int i = 0; i < block_size; ++i)
+            buffer[i] = r.local_element(_block_indices[offset + i]);
+
+          potrs(block_size, _factors.data() + _factor_offsets[k],
+                buffer.data());
+
+          for (int i = 0; i < block_size; ++i)
+            if (_is_owned[offset + i])
+              x.local_element(_block_indices[offset + i]) += buffer[i];
+        }
+      },
+      grain_size);
+}
+
+template <typename VectorType, typename StorageType>
+unsigned int
+DealIIAgglomerateSmoother<VectorType, StorageType>::n_blocks() const
+{
+  return _block_offsets.size() - 1;
+}
+
+template <typename VectorType, typename StorageType>
+bool DealIIAgglomerateSmoother<VectorType, StorageType>::replace_operator(
+    std::shared_ptr<Operator<vector_type> const> op)
+{
+  this->_operator = op;
+
+  return true;
+}
+
+template <typename VectorType, typename StorageType>
+std::size_t
+DealIIAgglomerateSmoother<VectorType, StorageType>::memory_consumption() const
+{
+  using dealii::MemoryConsumption::memory_consumption;
+
+  return memory_consumption(_block_offsets) +
+         memory_consumption(_block_indices) + memory_consumption(_is_owned) +
+         memory_consumption(_factor_offsets) + memory_consumption(_factors);
+}
+} // namespace mfmg
+
+// Explicit Instantiation
+INSTANTIATE_VECTORTYPE_SCALARTYPE(TUPLE(DealIIAgglomerateSmoother))
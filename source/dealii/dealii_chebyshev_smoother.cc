@@ -0,0 +1,221 @@
+/**************************************************************************
+ * Copyright (c) 2017-2019 by the mfmg authors                            *
+ * All rights reserved.                                                   *
+ *                                                                        *
+ * This file is part of the mfmg library. mfmg is distributed under a BSD *
+ * 3-clause license. For the licensing terms see the LICENSE file in the  *
+ * top-level directory                                                    *
+ *                                                                        *
+ * SPDX-License-Identifier: BSD-3-Clause                                  *
+ *************************************************************************/
+
+#include <mfmg/common/exceptions.hpp>
+#include <mfmg/common/instantiation.hpp>
+#include <mfmg/common/lanczos.templates.hpp>
+#include <mfmg/dealii/dealii_chebyshev_smoother.hpp>
+#include <mfmg/dealii/dealii_trilinos_matrix_operator.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace mfmg
+{
+namespace
+{
+/**
+ * Operator -D^{-1/2} A D^{-1/2}. The operator is negated because Lanczos
+ * returns the smallest eigenvalues.
+ */
+template <typename VectorType>
+class NegatedScaledOperator
+{
+public:
+  NegatedScaledOperator(dealii::TrilinosWrappers::SparseMatrix const &matrix,
+                        VectorType const &sqrt_diagonal_inverse)
+      : _matrix(matrix), _sqrt_diagonal_inverse(sqrt_diagonal_inverse)
+  {
+  }
+
+  size_t m() const { return _matrix.m(); }
+
+  size_t n() const { return _matrix.n(); }
+
+  void vmult(VectorType &dst, VectorType const &src) const
+  {
+    VectorType tmp(src);
+    tmp.scale(_sqrt_diagonal_inverse);
+    _matrix.vmult(dst, tmp);
+    dst.scale(_sqrt_diagonal_inverse);
+    dst *= -1.;
+  }
+
+private:
+  dealii::TrilinosWrappers::SparseMatrix const &_matrix;
+  VectorType const &_sqrt_diagonal_inverse;
+};
+} // namespace
+
+template <typename VectorType>
+DealIIChebyshevSmoother<VectorType>::DealIIChebyshevSmoother(
+    std::shared_ptr<Operator<vector_type> const> op,
+    std::shared_ptr<boost::property_tree::ptree const> params)
+    : Smoother<VectorType>(op, params)
+{
+  initialize_matrix();
+
+  if (auto max_eigenvalue = this->_params->template get_optional<double>(
+          "smoother.max_eigenvalue"))
+    _max_eigenvalue = *max_eigenvalue;
+  else
+    _max_eigenvalue = estimate_max_eigenvalue();
+
+  initialize_smoother();
+}
+
+template <typename VectorType>
+DealIIChebyshevSmoother<VectorType>::DealIIChebyshevSmoother(
+    std::shared_ptr<Operator<vector_type> const> op,
+    std::shared_ptr<boost::property_tree::ptree const> params,
+    double max_eigenvalue)
+    : Smoother<VectorType>(op, params), _max_eigenvalue(max_eigenvalue)
+{
+  initialize_matrix();
+  initialize_smoother();
+}
+
+template <typename VectorType>
+void DealIIChebyshevSmoother<VectorType>::initialize_matrix()
+{
+  std::string prec_name = this->_params->get("smoother.type", "Chebyshev");
+  std::transform(prec_name.begin(), prec_name.end(), prec_name.begin(),
+                 ::tolower);
+  ASSERT_THROW(prec_name == "chebyshev",
+               "Unknown smoother name: \"" + prec_name + "\"");
+
+  auto trilinos_operator =
+      std::dynamic_pointer_cast<DealIITrilinosMatrixOperator<VectorType> const>(
+          this->_operator);
+  ASSERT_THROW(trilinos_operator != nullptr,
+               "DealIIChebyshevSmoother must be constructed from a "
+               "DealIITrilinosMatrixOperator");
+  _matrix = trilinos_operator->get_matrix();
+
+  _diagonal_inverse = std::make_shared<preconditioner_type>();
+  auto &diagonal_inverse = _diagonal_inverse->get_vector();
+  diagonal_inverse.reinit(_matrix->locally_owned_range_indices(),
+                          _matrix->get_mpi_communicator());
+  for (auto const i : diagonal_inverse.locally_owned_elements())
+  {
+    double const diag = _matrix->diag_element(i);
+    if (!(diag > 0.))
+      ASSERT_THROW(false, "The Chebyshev smoother requires a positive "
+                          "diagonal but row " +
+                              std::to_string(i) + " has " +
+                              std::to_string(diag));
+    diagonal_inverse[i] = 1. / diag;
+  }
+}
+
+template <typename VectorType>
+void DealIIChebyshevSmoother<VectorType>::initialize_smoother()
+{
+  typename chebyshev_preconditioner::AdditionalData data;
+  if (auto degree = this->_params->template get_optional<int>(
+          "smoother.degree"))
+  {
+    data.degree = *degree;
+  }
+  // deal.II uses the smallest eigenvalue estimated by CG if the smoothing
+  // range is not larger than one. Since we only estimate the largest
+  // eigenvalue, we need a valid default.
+  data.smoothing_range = this->_params->get("smoother.smoothing_range", 20.);
+  ASSERT(data.smoothing_range > 1.,
+         "The smoothing range must be larger than one");
+  // The Ritz value underestimates the largest eigenvalue so we use the same
+  // safety factor as deal.II does with its own estimate. Setting the number of
+  // CG iterations to zero tells deal.II to use the eigenvalue that we provide.
+  data.max_eigenvalue = 1.2 * _max_eigenvalue;
+  data.eig_cg_n_iterations = 0;
+  data.preconditioner = _diagonal_inverse;
+
+  _smoother.reset(new chebyshev_preconditioner());
+  _smoother->initialize(*_matrix, data);
+}
+
+template <typename VectorType>
+double DealIIChebyshevSmoother<VectorType>::estimate_max_eigenvalue() const
+{
+  VectorType sqrt_diagonal_inverse(_diagonal_inverse->get_vector());
+  for (auto &v : sqrt_diagonal_inverse)
+    v = std::sqrt(v);
+
+  NegatedScaledOperator<VectorType> scaled_operator(*_matrix,
+                                                    sqrt_diagonal_inverse);
+
+  // We only need a rough estimate so a few iterations are enough
+  unsigned int const n_iterations = std::min<size_t>(
+      this->_params->get("smoother.eigenvalue_iterations", 10),
+      _matrix->m());
+  boost::property_tree::ptree lanczos_params;
+  lanczos_params.put("num_eigenpairs", 1);
+  lanczos_params.put("max_iterations", n_iterations);
+  lanczos_params.put("tolerance", 1e-2);
+
+  VectorType initial_guess(sqrt_diagonal_inverse);
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<double> dist(0, 1);
+  for (auto &v : initial_guess)
+    v = 1. + dist(gen);
+
+  Lanczos<NegatedScaledOperator<VectorType>, VectorType> lanczos(
+      scaled_operator);
+  std::vector<double> evals;
+  std::vector<VectorType> evecs;
+  std::tie(evals, evecs) = lanczos.solve(lanczos_params, initial_guess);
+
+  return -evals[0];
+}
+
+template <typename VectorType>
+void DealIIChebyshevSmoother<VectorType>::apply(VectorType const &b,
+                                                VectorType &x,
+                                                bool zero_initial_guess) const
+{
+  if (zero_initial_guess)
+  {
+    // x = 0 so that x = B^{-1} b and we can skip the computation of the
+    // residual
+    _smoother->vmult(x, b);
+
+    return;
+  }
+
+  // r = -(b - Ax)
+  vector_type r(b);
+  this->_operator->apply(x, r);
+  r.add(-1., b);
+
+  // x = x + B^{-1} (-r)
+  vector_type tmp(x);
+  _smoother->vmult(tmp, r);
+  x.add(-1., tmp);
+}
+
+template <typename VectorType>
+std::size_t DealIIChebyshevSmoother<VectorType>::memory_consumption() const
+{
+  // The Chebyshev iteration stores three temporary vectors with the same
+  // layout as the diagonal
+  return 4 * _diagonal_inverse->memory_consumption();
+}
+
+template <typename VectorType>
+double DealIIChebyshevSmoother<VectorType>::max_eigenvalue() const
+{
+  return _max_eigenvalue;
+}
+} // namespace mfmg
+
+// Explicit Instantiation
+INSTANTIATE_VECTORTYPE(TUPLE(DealIIChebyshevSmoother))
@@ -0,0 +1,330 @@
+/**************************************************************************
+ * Copyright (c) 2017-2019 by the mfmg authors                            *
+ * All rights reserved.                                                   *
+ *                                                                        *
+ * This file is part of the mfmg library. mfmg is distributed under a BSD *
+ * 3-clause license. For the licensing terms see the LICENSE file in the  *
+ * top-level directory                                                    *
+ *                                                                        *
+ * SPDX-License-Identifier: BSD-3-Clause                                  *
+ *************************************************************************/
+
+#include <mfmg/common/exceptions.hpp>
+#include <mfmg/common/instantiation.hpp>
+#include <mfmg/dealii/dealii_csr_matrix_operator.hpp>
+
+#include <deal.II/base/memory_consumption.h>
+#include <deal.II/base/parallel.h>
+
+#include <algorithm>
+#include <numeric>
+
+namespace mfmg
+{
+namespace
+{
+// Minimum number of rows given to a thread
+unsigned int constexpr grain_size = 256;
+} // namespace
+
+template <typename VectorType, typename StorageType>
+DealIICSRMatrixOperator<VectorType, StorageType>::DealIICSRMatrixOperator(
+    dealii::TrilinosWrappers::SparseMatrix const &sparse_matrix)
+    : _comm(sparse_matrix.get_mpi_communicator()),
+      _locally_owned_range_indices(
+          sparse_matrix.locally_owned_range_indices()),
+      _locally_owned_domain_indices(
+          sparse_matrix.locally_owned_domain_indices()),
+      _m(sparse_matrix.m()),
+      _n_nonzero_elements(sparse_matrix.n_nonzero_elements())
+{
+  auto const &epetra_matrix = sparse_matrix.trilinos_matrix();
+  ASSERT(epetra_matrix.IndicesAreLocal(), "Indices are not local");
+  unsigned int const n_local_rows = _locally_owned_range_indices.n_elements();
+  unsigned int const n_local_columns =
+      _locally_owned_domain_indices.n_elements();
+
+  // Find the ghost indices, i.e., the columns owned by other processors
+  dealii::IndexSet ghost_indices(_locally_owned_domain_indices.size());
+  for (unsigned int i = 0; i < n_local_rows; ++i)
+  {
+    int const row = epetra_matrix.LRID(
+        static_cast<int>(_locally_owned_range_indices.nth_index_in_set(i)));
+    int n_entries = 0;
+    double *values = nullptr;
+    int *indices = nullptr;
+    epetra_matrix.ExtractMyRowView(row, n_entries, values, indices);
+    for (int k = 0; k < n_entries; ++k)
+    {
+      auto const global_index = epetra_matrix.GCID(indices[k]);
+      if (!_locally_owned_domain_indices.is_element(global_index))
+        ghost_indices.add_index(global_index);
+    }
+  }
+  ghost_indices.compress();
+  _ghosted_domain_vector.reinit(_locally_owned_domain_indices, ghost_indices,
+                                _comm);
+
+  // Copy the locally owned rows
+  _row_ptr.resize(n_local_rows + 1, 0);
+  for (unsigned int i = 0; i < n_local_rows; ++i)
+  {
+    int const row = epetra_matrix.LRID(
+        static_cast<int>(_locally_owned_range_indices.nth_index_in_set(i)));
+    int n_entries = 0;
+    double *values = nullptr;
+    int *indices = nullptr;
+    epetra_matrix.ExtractMyRowView(row, n_entries, values, indices);
+    for (int k = 0; k < n_entries; ++k)
+    {
+      auto const global_index = epetra_matrix.GCID(indices[k]);
+      _column_index.push_back(
+          _locally_owned_domain_indices.is_element(global_index)
+              ? _locally_owned_domain_indices.index_within_set(global_index)
+              : n_local_columns + ghost_indices.index_within_set(global_index));
+      _values.push_back(static_cast<StorageType>(values[k]));
+    }
+    _row_ptr[i + 1] = _column_index.size();
+  }
+}
+
+template <typename VectorType, typename StorageType>
+void DealIICSRMatrixOperator<VectorType, StorageType>::apply(
+    VectorType const &x, VectorType &y, OperatorMode mode) const
+{
+  unsigned int const n_local_rows = _row_ptr.size() - 1;
+  if (mode == OperatorMode::NO_TRANS)
+  {
+    _ghosted_domain_vector.zero_out_ghosts();
+    std::copy(x.begin(), x.end(), _ghosted_domain_vector.begin());
+    _ghosted_domain_vector.update_ghost_values();
+
+    dealii::parallel::apply_to_subranges(
+        0U, n_local_rows,
+        [&](unsigned int const begin, unsigned int const end) {
+          for (unsigned int i = begin; i < end; ++i)
+          {
+            value_type sum = 0.;
+            for (unsigned int k = _row_ptr[i]; k < _row_ptr[i + 1]; ++k)
+              sum += static_cast<value_type>(_values[k]) *
+                     _ghosted_domain_vector.local_element(_column_index[k]);
+            y.local_element(i) = sum;
+          }
+        },
+        grain_size);
+  }
+  else
+  {
+    _ghosted_domain_vector.zero_out_ghosts();
+    apply_transpose_local({&x}, {&_ghosted_domain_vector});
+    _ghosted_domain_vector.compress(dealii::VectorOperation::add);
+    std::copy(_ghosted_domain_vector.begin(), _ghosted_domain_vector.end(),
+              y.begin());
+  }
+}
+
+template <typename VectorType, typename StorageType>
+void DealIICSRMatrixOperator<VectorType, StorageType>::apply_multivector(
+    MultiVector<VectorType> const &x, MultiVector<VectorType> &y,
+    OperatorMode mode) const
+{
+  unsigned int const n_local_rows = _row_ptr.size() - 1;
+  int const n_vectors = x.n_vectors();
+  if (static_cast<int>(_ghosted_domain_multivector.size()) != n_vectors)
+  {
+    _ghosted_domain_multivector.resize(n_vectors);
+    for (auto &ghosted_vector : _ghosted_domain_multivector)
+      ghosted_vector.reinit(_ghosted_domain_vector);
+  }
+
+  if (mode == OperatorMode::NO_TRANS)
+  {
+    // Start all the communications before waiting for any of them
+    for (int v = 0; v < n_vectors; ++v)
+    {
+      auto &ghosted_x = _ghosted_domain_multivector[v];
+      ghosted_x.zero_out_ghosts();
+      std::copy(x[v]->begin(), x[v]->end(), ghosted_x.begin());
+      ghosted_x.update_ghost_values_start(v);
+    }
+    for (auto &ghosted_x : _ghosted_domain_multivector)
+      ghosted_x.update_ghost_values_finish();
+
+    // Each entry of the matrix is loaded once and used for all the vectors
+    dealii::parallel::apply_to_subranges(
+        0U, n_local_rows,
+        [&](unsigned int const begin, unsigned int const end) {
+          std::vector<value_type> sums(n_vectors);
+          for (unsigned int i = begin; i < end; ++i)
+          {
+            std::fill(sums.begin(), sums.end(), 0.);
+            for (unsigned int k = _row_ptr[i]; k < _row_ptr[i + 1]; ++k)
+            {
+              value_type const value = _values[k];
+              unsigned int const j = _column_index[k];
+              for (int v = 0; v < n_vectors; ++v)
+                sums[v] +=
+                    value * _ghosted_domain_multivector[v].local_element(j);
+            }
+            for (int v = 0; v < n_vectors; ++v)
+              y[v]->local_element(i) = sums[v];
+          }
+        },
+        grain_size);
+  }
+  else
+  {
+    std::vector<VectorType const *> x_vectors(n_vectors);
+    std::vector<VectorType *> ghosted_y_vectors(n_vectors);
+    for (int v = 0; v < n_vectors; ++v)
+    {
+      x_vectors[v] = x[v].get();
+      ghosted_y_vectors[v] = &_ghosted_domain_multivector[v];
+      ghosted_y_vectors[v]->zero_out_ghosts();
+    }
+    apply_transpose_local(x_vectors, ghosted_y_vectors);
+    for (int v = 0; v < n_vectors; ++v)
+      _ghosted_domain_multivector[v].compress_start(
+          v, dealii::VectorOperation::add);
+    for (int v = 0; v < n_vectors; ++v)
+    {
+      auto &ghosted_y = _ghosted_domain_multivector[v];
+      ghosted_y.compress_finish(dealii::VectorOperation::add);
+      std::copy(ghosted_y.begin(), ghosted_y.end(), y[v]->begin());
+    }
+  }
+}
+
+template <typename VectorType, typename StorageType>
+void DealIICSRMatrixOperator<VectorType, StorageType>::build_transpose() const
+{
+  unsigned int const n_local_rows = _row_ptr.size() - 1;
+  unsigned int const n_columns = _ghosted_domain_vector.local_size() +
+                                 _ghosted_domain_vector.n_ghost_entries();
+
+  // Count the entries of each column, then fill the columns in the order of
+  // the rows so that the rows of the transpose are sorted
+  _transpose_row_ptr.assign(n_columns + 1, 0);
+  for (auto const j : _column_index)
+    ++_transpose_row_ptr[j + 1];
+  std::partial_sum(_transpose_row_ptr.begin(), _transpose_row_ptr.end(),
+                   _transpose_row_ptr.begin());
+  _transpose_row_index.resize(_column_index.size());
+  _transpose_values.resize(_values.size());
+  std::vector<unsigned int> position(_transpose_row_ptr.begin(),
+                                     _transpose_row_ptr.end() - 1);
+  for (unsigned int i = 0; i < n_local_rows; ++i)
+    for (unsigned int k = _row_ptr[i]; k < _row_ptr[i + 1]; ++k)
+    {
+      unsigned int const pos = position[_column_index[k]]++;
+      _transpose_row_index[pos] = i;
+      _transpose_values[pos] = _values[k];
+    }
+}
+
+template <typename VectorType, typename StorageType>
+void DealIICSRMatrixOperator<VectorType, StorageType>::apply_transpose_local(
+    std::vector<VectorType const *> const &x,
+    std::vector<VectorType *> const &ghosted_y) const
+{
+  if (_transpose_row_ptr.empty())
+    build_transpose();
+
+  unsigned int const n_columns = _transpose_row_ptr.size() - 1;
+  unsigned int const n_vectors = x.size();
+  dealii::parallel::apply_to_subranges(
+      0U, n_columns,
+      [&](unsigned int const begin, unsigned int const end) {
+        std::vector<value_type> sums(n_vectors);
+        for (unsigned int j = begin; j < end; ++j)
+        {
+          std::fill(sums.begin(), sums.end(), 0.);
+          for (unsigned int k = _transpose_row_ptr[j];
+               k < _transpose_row_ptr[j + 1]; ++k)
+          {
+            value_type const value = _transpose_values[k];
+            unsigned int const i = _transpose_row_index[k];
+            for (unsigned int v = 0; v < n_vectors; ++v)
+              sums[v] += value * x[v]->local_element(i);
+          }
+          for (unsigned int v = 0; v < n_vectors; ++v)
+            ghosted_y[v]->local_element(j) = sums[v];
+        }
+      },
+      grain_size);
+}
+
+template <typename VectorType, typename StorageType>
+std::shared_ptr<Operator<VectorType>>
+DealIICSRMatrixOperator<VectorType, StorageType>::transpose() const
+{
+  ASSERT_THROW_NOT_IMPLEMENTED();
+
+  return nullptr;
+}
+
+template <typename VectorType, typename StorageType>
+std::shared_ptr<Operator<VectorType>>
+DealIICSRMatrixOperator<VectorType, StorageType>::multiply(
+    std::shared_ptr<Operator<VectorType> const> /*b*/) const
+{
+  ASSERT_THROW_NOT_IMPLEMENTED();
+
+  return nullptr;
+}
+
+template <typename VectorType, typename StorageType>
+std::shared_ptr<Operator<VectorType>>
+DealIICSRMatrixOperator<VectorType, StorageType>::multiply_transpose(
+    std::shared_ptr<Operator<VectorType> const> /*b*/) const
+{
+  ASSERT_THROW_NOT_IMPLEMENTED();
+
+  return nullptr;
+}
+
+template <typename VectorType, typename StorageType>
+std::shared_ptr<VectorType>
+DealIICSRMatrixOperator<VectorType, StorageType>::build_domain_vector() const
+{
+  return std::make_shared<vector_type>(_locally_owned_domain_indices, _comm);
+}
+
+template <typename VectorType, typename StorageType>
+std::shared_ptr<VectorType>
+DealIICSRMatrixOperator<VectorType, StorageType>::build_range_vector() const
+{
+  return std::make_shared<vector_type>(_locally_owned_range_indices, _comm);
+}
+
+template <typename VectorType, typename StorageType>
+size_t DealIICSRMatrixOperator<VectorType, StorageType>::grid_complexity() const
+{
+  return _m;
+}
+
+template <typename VectorType, typename StorageType>
+size_t
+DealIICSRMatrixOperator<VectorType, StorageType>::operator_complexity() const
+{
+  return _n_nonzero_elements;
+}
+
+template <typename VectorType, typename StorageType>
+std::size_t
+DealIICSRMatrixOperator<VectorType, StorageType>::memory_consumption() const
+{
+  return dealii::MemoryConsumption::memory_consumption(_row_ptr) +
+         dealii::MemoryConsumption::memory_consumption(_column_index) +
+         dealii::MemoryConsumption::memory_consumption(_values) +
+         _ghosted_domain_vector.memory_consumption() +
+         dealii::MemoryConsumption::memory_consumption(
+             _ghosted_domain_multivector) +
+         dealii::MemoryConsumption::memory_consumption(_transpose_row_ptr) +
+         dealii::MemoryConsumption::memory_consumption(_transpose_row_index) +
+         dealii::MemoryConsumption::memory_consumption(_transpose_values);
+}
+} // namespace mfmg
+
+// Explicit Instantiation
+INSTANTIATE_VECTORTYPE_SCALARTYPE(TUPLE(DealIICSRMatrixOperator))
@@ -10,13 +10,19 @@
  *************************************************************************/
 
 #include <mfmg/common/instantiation.hpp>
+#include <mfmg/common/memory.hpp>
 #include <mfmg/common/operator.hpp>
+#include <mfmg/dealii/dealii_agglomerate_smoother.hpp>
+#include <mfmg/dealii/dealii_chebyshev_smoother.hpp>
+#include <mfmg/dealii/dealii_csr_matrix_operator.hpp>
 #include <mfmg/dealii/dealii_hierarchy_helpers.hpp>
+#include <mfmg/dealii/dealii_multicolor_smoother.hpp>
 #include <mfmg/dealii/dealii_smoother.hpp>
 #include <mfmg/dealii/dealii_solver.hpp>
 #include <mfmg/dealii/dealii_trilinos_matrix_operator.hpp>
 #include <mfmg/dealii/dealii_utils.hpp>
 
+#include <deal.II/base/mpi.h>
 #include <deal.II/base/work_stream.h>
 #include <deal.II/dofs/dof_accessor.h>
 
@@ -26,7 +32,10 @@
 #include <boost/container_hash/hash.hpp>
 #include <boost/smart_ptr/make_unique.hpp>
 
+#include <algorithm>
+#include <fstream>
 #include <unordered_map>
+#include <utility>
 
 namespace mfmg
 {
@@ -74,6 +83,20 @@ DealIIHierarchyHelpers<dim, VectorType>::build_restrictor(
 
   bool fast_ap = params->get("fast_ap", false);
   auto agglomerate_params = params->get_child("agglomeration");
+
+  // The agglomerate block Jacobi smoother reuses the agglomerates so we save
+  // their DoFs for build_smoother()
+  std::string smoother_type = params->get("smoother.type", "");
+  std::transform(smoother_type.begin(), smoother_type.end(),
+                 smoother_type.begin(), ::tolower);
+  bool const agglomerate_smoother =
+      (smoother_type == "block jacobi (agglomerate)");
+  bool const overlap = params->get("smoother.overlap", false);
+  _agglomerate_dof_indices.clear();
+  _agglomerate_n_dofs = dealii_mesh_evaluator->get_dof_handler().n_dofs();
+  std::vector<AgglomerateStatistics> agglomerate_statistics;
+  ThreadUtilization thread_utilization;
+  boost::property_tree::ptree memory_statistics;
   if (fast_ap)
   {
     AMGe_host<dim, DealIIMeshEvaluator<dim>, VectorType> amge(
@@ -89,6 +112,9 @@ DealIIHierarchyHelpers<dim, VectorType>::build_restrictor(
                           *dealii_mesh_evaluator, locally_relevant_global_diag,
                           restrictor_matrix, eigenvector_matrix,
                           delta_eigenvector_matrix, eigenvalues);
+    agglomerate_statistics = amge.get_agglomerate_statistics();
+    thread_utilization = amge.get_thread_utilization();
+    _agglomerate_ids = amge.get_agglomerates();
 
     dealii::TrilinosWrappers::SparseMatrix delta_correction_matrix(
         eigenvector_matrix->locally_owned_range_indices(),
@@ -100,19 +126,29 @@ DealIIHierarchyHelpers<dim, VectorType>::build_restrictor(
     std::vector<std::vector<unsigned int>> halo_agglomerates;
     std::tie(interior_agglomerates, halo_agglomerates) =
         amge.build_boundary_agglomerates();
+    if (agglomerate_smoother)
+      _agglomerate_dof_indices = amge.compute_agglomerate_dof_indices(
+          overlap ? halo_agglomerates
+                  : std::vector<std::vector<unsigned int>>());
     std::unordered_map<std::pair<unsigned int, unsigned int>, double,
                        boost::hash<std::pair<unsigned int, unsigned int>>>
         delta_correction_acc;
     bool is_halo_agglomerate = false;
 
-    // In case there are no patches we own, we still need to construct the
-    // restriction operators. We set the number of eigenvalues to zero instead
-    // of returning early and duplicating the setup.
-    unsigned int const n_local_eigenvectors =
-        interior_agglomerates.empty()
-            ? 0
-            : eigenvector_matrix->locally_owned_range_indices().n_elements() /
-                  interior_agglomerates.size();
+    // The agglomerates do not necessarily keep the same number of
+    // eigenvectors. The statistics are ordered by agglomerate so the rows of
+    // the i-th agglomerate start at first_local_rows[i]. In case there are no
+    // patches we own, we still need to construct the restriction operators so
+    // we do not return early.
+    unsigned int const n_interior_agglomerates = interior_agglomerates.size();
+    ASSERT(agglomerate_statistics.size() == n_interior_agglomerates,
+           "There are " + std::to_string(agglomerate_statistics.size()) +
+               " agglomerate statistics for " +
+               std::to_string(n_interior_agglomerates) + " agglomerates");
+    std::vector<unsigned int> first_local_rows(n_interior_agglomerates + 1, 0);
+    for (unsigned int i = 0; i < n_interior_agglomerates; ++i)
+      first_local_rows[i + 1] =
+          first_local_rows[i] + agglomerate_statistics[i].n_eigenvectors;
 
     for (auto const &agglomerates_vector :
          {interior_agglomerates, halo_agglomerates})
@@ -155,6 +191,10 @@ DealIIHierarchyHelpers<dim, VectorType>::build_restrictor(
                 agglomerate_dof_handler, agglomerate_constraints,
                 agglomerate_sparsity_pattern, agglomerate_system_matrix);
 
+            unsigned int const i = agglomerate_it - agglomerates_vector.begin();
+            unsigned int const n_local_eigenvectors =
+                first_local_rows[i + 1] - first_local_rows[i];
+
             // Put the result in the matrix
             // Compute the map between the local and the global dof indices.
             local_copy_data.rows.resize(n_local_eigenvectors);
@@ -172,11 +212,9 @@ DealIIHierarchyHelpers<dim, VectorType>::build_restrictor(
                       local_copy_data.values_per_row.end(),
                       std::vector<dealii::TrilinosScalar>(n_elem));
 
-            unsigned int const i = agglomerate_it - agglomerates_vector.begin();
-
             for (unsigned int j = 0; j < n_local_eigenvectors; ++j)
             {
-              unsigned int const local_row = i * n_local_eigenvectors + j;
+              unsigned int const local_row = first_local_rows[i] + j;
               unsigned int const global_row =
                   eigenvector_matrix->locally_owned_range_indices()
                       .nth_index_in_set(local_row);
@@ -284,6 +322,20 @@ DealIIHierarchyHelpers<dim, VectorType>::build_restrictor(
     dealii_ap->reinit(*ap);
     delete ap;
 
+    // These matrices only live during the setup but they often dominate its
+    // peak memory
+    memory_statistics.put_child(
+        "eigenvector_matrix",
+        summarize_memory(comm, eigenvector_matrix->memory_consumption()));
+    memory_statistics.put_child(
+        "delta_eigenvector_matrix",
+        summarize_memory(comm, delta_eigenvector_matrix->memory_consumption()));
+    memory_statistics.put_child(
+        "delta_correction_matrix",
+        summarize_memory(comm, delta_correction_matrix.memory_consumption()));
+    memory_statistics.put_child(
+        "ap", summarize_memory(comm, dealii_ap->memory_consumption()));
+
     _ap_operator.reset(new DealIITrilinosMatrixOperator<VectorType>(dealii_ap));
   }
   else
@@ -294,20 +346,132 @@ DealIIHierarchyHelpers<dim, VectorType>::build_restrictor(
     amge.setup_restrictor(agglomerate_params, n_eigenvectors, tolerance,
                           *dealii_mesh_evaluator, locally_relevant_global_diag,
                           *restrictor_matrix);
+    agglomerate_statistics = amge.get_agglomerate_statistics();
+    thread_utilization = amge.get_thread_utilization();
+    _agglomerate_ids = amge.get_agglomerates();
+
+    if (agglomerate_smoother)
+    {
+      std::vector<std::vector<unsigned int>> halo_agglomerates;
+      if (overlap)
+        halo_agglomerates = std::get<1>(amge.build_boundary_agglomerates());
+      _agglomerate_dof_indices =
+          amge.compute_agglomerate_dof_indices(halo_agglomerates);
+    }
   }
 
+  // Keep what update_restrictor() needs to patch the restriction matrix
+  _restrictor_matrix = restrictor_matrix;
+  _n_local_eigenvectors.resize(agglomerate_statistics.size());
+  std::transform(
+      agglomerate_statistics.begin(), agglomerate_statistics.end(),
+      _n_local_eigenvectors.begin(),
+      [](AgglomerateStatistics const &s) { return s.n_eigenvectors; });
+  _locally_relevant_global_diag = std::move(locally_relevant_global_diag);
+
+  _restrictor_statistics = boost::property_tree::ptree();
+  _restrictor_statistics.put_child(
+      "eigensolver", summarize_agglomerate_statistics(
+                         comm, eigensolver_params.get("type", "arpack"),
+                         agglomerate_statistics));
+  _restrictor_statistics.put_child(
+      "threads", summarize_thread_utilization(comm, thread_utilization));
+  if (!memory_statistics.empty())
+    _restrictor_statistics.put_child("memory", memory_statistics);
+
   std::shared_ptr<Operator<VectorType>> op(
       new DealIITrilinosMatrixOperator<VectorType>(restrictor_matrix));
 
   return op;
 }
 
+template <int dim, typename VectorType>
+std::shared_ptr<Operator<VectorType>>
+DealIIHierarchyHelpers<dim, VectorType>::build_single_precision_operator(
+    std::shared_ptr<Operator<VectorType> const> op)
+{
+  auto trilinos_operator =
+      std::dynamic_pointer_cast<DealIITrilinosMatrixOperator<VectorType> const>(
+          op);
+  ASSERT_THROW(trilinos_operator != nullptr,
+               "Only DealIITrilinosMatrixOperator can be converted to single "
+               "precision");
+
+  return std::make_shared<DealIICSRMatrixOperator<VectorType, float>>(
+      *trilinos_operator->get_matrix());
+}
+
 template <int dim, typename VectorType>
 std::shared_ptr<Smoother<VectorType>>
 DealIIHierarchyHelpers<dim, VectorType>::build_smoother(
     std::shared_ptr<Operator<VectorType> const> op,
     std::shared_ptr<boost::property_tree::ptree const> params)
 {
+  std::string smoother_type =
+      params->get("smoother.type", "Symmetric Gauss-Seidel");
+  std::transform(smoother_type.begin(), smoother_type.end(),
+                 smoother_type.begin(), ::tolower);
+  // Only the multicolor and the agglomerate block Jacobi smoothers can store
+  // their data in single precision. The other smoothers ignore this parameter.
+  bool const single_precision =
+      params->get("smoother.precision", "double") == "single";
+  // The multicolor, the Chebyshev, and the agglomerate block Jacobi smoothers
+  // are implemented natively, the other ones are provided by Trilinos
+  if (smoother_type.compare(0, 10, "multicolor") == 0)
+  {
+    if (single_precision)
+      return std::make_shared<DealIIMulticolorSmoother<VectorType, float>>(
+          op, params);
+    return std::make_shared<DealIIMulticolorSmoother<VectorType>>(op, params);
+  }
+  if (smoother_type == "chebyshev")
+  {
+    // Reuse the estimate of the largest eigenvalue if the smoother was already
+    // built on this matrix, e.g., when the hierarchy is updated
+    auto trilinos_operator = std::dynamic_pointer_cast<
+        DealIITrilinosMatrixOperator<VectorType> const>(op);
+    ASSERT_THROW(trilinos_operator != nullptr,
+                 "DealIIChebyshevSmoother must be constructed from a "
+                 "DealIITrilinosMatrixOperator");
+    auto matrix = trilinos_operator->get_matrix();
+    _chebyshev_max_eigenvalues.erase(
+        std::remove_if(_chebyshev_max_eigenvalues.begin(),
+                       _chebyshev_max_eigenvalues.end(),
+                       [](auto const &entry) { return entry.first.expired(); }),
+        _chebyshev_max_eigenvalues.end());
+    auto cached = std::find_if(
+        _chebyshev_max_eigenvalues.begin(), _chebyshev_max_eigenvalues.end(),
+        [&](auto const &entry) { return entry.first.lock() == matrix; });
+    if (cached != _chebyshev_max_eigenvalues.end())
+      return std::make_shared<DealIIChebyshevSmoother<VectorType>>(
+          op, params, cached->second);
+
+    auto smoother =
+        std::make_shared<DealIIChebyshevSmoother<VectorType>>(op, params);
+    _chebyshev_max_eigenvalues.emplace_back(matrix,
+                                            smoother->max_eigenvalue());
+
+    return smoother;
+  }
+  if (smoother_type == "block jacobi (agglomerate)")
+  {
+    // The blocks are the agglomerates built by build_restrictor() on the mesh
+    // so they only match the operator of the finest level
+    ASSERT_THROW(op->build_range_vector()->size() == _agglomerate_n_dofs,
+                 "The agglomerate block Jacobi smoother is only supported on "
+                 "the finest level");
+    std::shared_ptr<Smoother<VectorType>> smoother;
+    if (single_precision)
+      smoother = std::make_shared<DealIIAgglomerateSmoother<VectorType, float>>(
+          op, params, _agglomerate_dof_indices);
+    else
+      smoother = std::make_shared<DealIIAgglomerateSmoother<VectorType>>(
+          op, params, _agglomerate_dof_indices);
+    _agglomerate_dof_indices.clear();
+
+    return smoother;
+  }
+
   return std::make_shared<DealIISmoother<VectorType>>(op, params);
 }
 
@@ -320,11 +484,166 @@ DealIIHierarchyHelpers<dim, VectorType>::build_coarse_solver(
   return std::make_shared<DealIISolver<VectorType>>(op, params);
 }
 
+template <int dim, typename VectorType>
+boost::property_tree::ptree
+DealIIHierarchyHelpers<dim, VectorType>::get_restrictor_statistics() const
+{
+  return _restrictor_statistics;
+}
+
+template <int dim, typename VectorType>
+void DealIIHierarchyHelpers<dim, VectorType>::update_restrictor(
+    MPI_Comm comm, std::shared_ptr<MeshEvaluator> mesh_evaluator,
+    std::shared_ptr<boost::property_tree::ptree const> params,
+    std::vector<unsigned int> const &changed_cells)
+{
+  ASSERT_THROW(_restrictor_matrix != nullptr,
+               "build_restrictor() needs to be called first");
+  // The cells of an agglomerate across ranks are not all locally owned so the
+  // agglomerates cannot be restored from the locally owned cells
+  ASSERT_THROW(params->get("agglomeration.across_ranks", false) == false,
+               "Agglomerates across ranks cannot be updated");
+
+  // Downcast to DealIIMeshEvaluator
+  auto dealii_mesh_evaluator =
+      std::dynamic_pointer_cast<DealIIMeshEvaluator<dim>>(mesh_evaluator);
+
+  auto eigensolver_params = params->get_child("eigensolver");
+  int n_eigenvectors = eigensolver_params.get("number of eigenvectors", 1);
+  double tolerance = eigensolver_params.get("tolerance", 1e-14);
+
+  auto locally_relevant_global_diag = dealii_mesh_evaluator->get_diagonal();
+
+  AMGe_host<dim, DealIIMeshEvaluator<dim>, VectorType> amge(
+      comm, dealii_mesh_evaluator->get_dof_handler(), eigensolver_params);
+  unsigned int const n_updated_agglomerates = amge.update_restrictor(
+      params->get_child("agglomeration"), _agglomerate_ids, changed_cells,
+      _n_local_eigenvectors, n_eigenvectors, tolerance, *dealii_mesh_evaluator,
+      _locally_relevant_global_diag, locally_relevant_global_diag,
+      *_restrictor_matrix);
+  _locally_relevant_global_diag = std::move(locally_relevant_global_diag);
+
+  // build_smoother() consumed the DoFs of the agglomerates so they are
+  // computed again for the smoother rebuilt by Hierarchy::rebuild()
+  std::string smoother_type = params->get("smoother.type", "");
+  std::transform(smoother_type.begin(), smoother_type.end(),
+                 smoother_type.begin(), ::tolower);
+  if (smoother_type == "block jacobi (agglomerate)")
+  {
+    std::vector<std::vector<unsigned int>> halo_agglomerates;
+    if (params->get("smoother.overlap", false))
+      halo_agglomerates = std::get<1>(amge.build_boundary_agglomerates());
+    _agglomerate_dof_indices =
+        amge.compute_agglomerate_dof_indices(halo_agglomerates);
+  }
+
+  _restrictor_statistics = boost::property_tree::ptree();
+  _restrictor_statistics.put(
+      "n_updated_agglomerates",
+      dealii::Utilities::MPI::sum(n_updated_agglomerates, comm));
+  _restrictor_statistics.put_child(
+      "eigensolver", summarize_agglomerate_statistics(
+                         comm, eigensolver_params.get("type", "arpack"),
+                         amge.get_agglomerate_statistics()));
+  _restrictor_statistics.put_child(
+      "threads",
+      summarize_thread_utilization(comm, amge.get_thread_utilization()));
+}
+
 template <int dim, typename VectorType>
 std::shared_ptr<Operator<VectorType>>
 DealIIHierarchyHelpers<dim, VectorType>::fast_multiply_transpose()
 {
-  return _ap_operator;
+  // The hierarchy keeps the helpers so we do not hold on to the product
+  return std::move(_ap_operator);
+}
+
+template <int dim, typename VectorType>
+void DealIIHierarchyHelpers<dim, VectorType>::save_operator(
+    std::shared_ptr<Operator<VectorType> const> op, std::string const &filename)
+{
+  auto trilinos_operator =
+      std::dynamic_pointer_cast<DealIITrilinosMatrixOperator<VectorType> const>(
+          op);
+  ASSERT_THROW(trilinos_operator != nullptr,
+               "Only DealIITrilinosMatrixOperator can be saved");
+  binary_csr_output_file(filename, *trilinos_operator->get_matrix());
+}
+
+template <int dim, typename VectorType>
+std::shared_ptr<Operator<VectorType>>
+DealIIHierarchyHelpers<dim, VectorType>::load_operator(
+    MPI_Comm comm, std::string const &filename)
+{
+  auto matrix = std::make_shared<dealii::TrilinosWrappers::SparseMatrix>();
+  binary_csr_input_file(filename, comm, *matrix);
+
+  return std::make_shared<DealIITrilinosMatrixOperator<VectorType>>(matrix);
+}
+
+template <int dim, typename VectorType>
+void DealIIHierarchyHelpers<dim, VectorType>::save_smoother(
+    std::shared_ptr<Smoother<VectorType> const> smoother,
+    std::string const &filename)
+{
+  std::ofstream out(filename, std::ios::binary);
+  ASSERT_THROW(out.good(), "Cannot open file " + filename);
+  // The other smoothers are rebuilt from the operator and the parameters so
+  // their file is empty
+  if (auto chebyshev_smoother = std::dynamic_pointer_cast<
+          DealIIChebyshevSmoother<VectorType> const>(smoother))
+  {
+    double const max_eigenvalue = chebyshev_smoother->max_eigenvalue();
+    out.write(reinterpret_cast<char const *>(&max_eigenvalue),
+              sizeof(max_eigenvalue));
+  }
+  else if (auto agglomerate_smoother = std::dynamic_pointer_cast<
+               DealIIAgglomerateSmoother<VectorType> const>(smoother))
+  {
+    agglomerate_smoother->save(out);
+  }
+  else if (auto single_agglomerate_smoother = std::dynamic_pointer_cast<
+               DealIIAgglomerateSmoother<VectorType, float> const>(smoother))
+  {
+    single_agglomerate_smoother->save(out);
+  }
+  ASSERT_THROW(out.good(), "Error while writing file " + filename);
+}
+
+template <int dim, typename VectorType>
+std::shared_ptr<Smoother<VectorType>>
+DealIIHierarchyHelpers<dim, VectorType>::load_smoother(
+    std::shared_ptr<Operator<VectorType> const> op,
+    std::shared_ptr<boost::property_tree::ptree const> params,
+    std::string const &filename)
+{
+  std::string smoother_type =
+      params->get("smoother.type", "Symmetric Gauss-Seidel");
+  std::transform(smoother_type.begin(), smoother_type.end(),
+                 smoother_type.begin(), ::tolower);
+  if ((smoother_type != "chebyshev") &&
+      (smoother_type != "block jacobi (agglomerate)"))
+    return build_smoother(op, params);
+
+  std::ifstream in(filename, std::ios::binary);
+  ASSERT_THROW(in.good(), "Cannot open file " + filename);
+  if (smoother_type == "chebyshev")
+  {
+    // Skip the estimation of the largest eigenvalue
+    double max_eigenvalue = 0.;
+    in.read(reinterpret_cast<char *>(&max_eigenvalue), sizeof(max_eigenvalue));
+    ASSERT_THROW(in.good(), "Error while reading file " + filename);
+
+    return std::make_shared<DealIIChebyshevSmoother<VectorType>>(
+        op, params, max_eigenvalue);
+  }
+
+  // Skip the factorization of the blocks
+  if (params->get("smoother.precision", "double") == "single")
+    return std::make_shared<DealIIAgglomerateSmoother<VectorType, float>>(
+        op, params, in);
+  return std::make_shared<DealIIAgglomerateSmoother<VectorType>>(op, params,
+                                                                 in);
 }
 
 } // namespace mfmg
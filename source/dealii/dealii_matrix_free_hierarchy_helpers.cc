@@ -10,6 +10,7 @@
  *************************************************************************/
 
 #include <mfmg/common/instantiation.hpp>
+#include <mfmg/common/memory.hpp>
 #include <mfmg/common/operator.hpp>
 #include <mfmg/dealii/amge_host.hpp>
 // Needed for MatrixFreeAgglomerateOperator, the definition should be moved
@@ -29,6 +30,7 @@
 #include <EpetraExt_MatrixMatrix.h>
 
 #include <unordered_map>
+#include <utility>
 
 namespace mfmg
 {
@@ -75,6 +77,9 @@ DealIIMatrixFreeHierarchyHelpers<dim, VectorType>::build_restrictor(
   auto locally_relevant_global_diag = dealii_mesh_evaluator->get_diagonal();
 
   bool fast_ap = params->get("fast_ap", false);
+  std::vector<AgglomerateStatistics> agglomerate_statistics;
+  ThreadUtilization thread_utilization;
+  boost::property_tree::ptree memory_statistics;
   if (fast_ap)
   {
     AMGe_host<dim, DealIIMatrixFreeMeshEvaluator<dim>, VectorType> amge(
@@ -91,6 +96,8 @@ DealIIMatrixFreeHierarchyHelpers<dim, VectorType>::build_restrictor(
                           *dealii_mesh_evaluator, locally_relevant_global_diag,
                           restrictor_matrix, eigenvector_matrix,
                           delta_eigenvector_matrix, eigenvalues);
+    agglomerate_statistics = amge.get_agglomerate_statistics();
+    thread_utilization = amge.get_thread_utilization();
 
     dealii::TrilinosWrappers::SparseMatrix delta_correction_matrix(
         eigenvector_matrix->locally_owned_range_indices(),
@@ -107,14 +114,20 @@ DealIIMatrixFreeHierarchyHelpers<dim, VectorType>::build_restrictor(
         delta_correction_acc;
     bool is_halo_agglomerate = false;
 
-    // In case there are no patches we own, we still need to construct the
-    // restriction operators. We set the number of eigenvalues to zero instead
-    // of returning early and duplicating the setup.
-    unsigned int const n_local_eigenvectors =
-        interior_agglomerates.empty()
-            ? 0
-            : eigenvector_matrix->locally_owned_range_indices().n_elements() /
-                  interior_agglomerates.size();
+    // The agglomerates do not necessarily keep the same number of
+    // eigenvectors. The statistics are ordered by agglomerate so the rows of
+    // the i-th agglomerate start at first_local_rows[i]. In case there are no
+    // patches we own, we still need to construct the restriction operators so
+    // we do not return early.
+    unsigned int const n_interior_agglomerates = interior_agglomerates.size();
+    ASSERT(agglomerate_statistics.size() == n_interior_agglomerates,
+           "There are " + std::to_string(agglomerate_statistics.size()) +
+               " agglomerate statistics for " +
+               std::to_string(n_interior_agglomerates) + " agglomerates");
+    std::vector<unsigned int> first_local_rows(n_interior_agglomerates + 1, 0);
+    for (unsigned int i = 0; i < n_interior_agglomerates; ++i)
+      first_local_rows[i + 1] =
+          first_local_rows[i] + agglomerate_statistics[i].n_eigenvectors;
 
     for (auto const &agglomerates_vector :
          {interior_agglomerates, halo_agglomerates})
@@ -150,6 +163,10 @@ DealIIMatrixFreeHierarchyHelpers<dim, VectorType>::build_restrictor(
         agglomerate_dof_handler.distribute_dofs(
             dealii_mesh_evaluator->get_dof_handler().get_fe());
 
+        unsigned int const i = agglomerate_it - agglomerates_vector.begin();
+        unsigned int const n_local_eigenvectors =
+            first_local_rows[i + 1] - first_local_rows[i];
+
         // Put the result in the matrix
         // Compute the map between the local and the global dof indices.
         local_copy_data.rows.resize(n_local_eigenvectors);
@@ -167,11 +184,9 @@ DealIIMatrixFreeHierarchyHelpers<dim, VectorType>::build_restrictor(
                   local_copy_data.values_per_row.end(),
                   std::vector<dealii::TrilinosScalar>(n_elem));
 
-        unsigned int const i = agglomerate_it - agglomerates_vector.begin();
-
         for (unsigned int j = 0; j < n_local_eigenvectors; ++j)
         {
-          unsigned int const local_row = i * n_local_eigenvectors + j;
+          unsigned int const local_row = first_local_rows[i] + j;
           unsigned int const global_row =
               eigenvector_matrix->locally_owned_range_indices()
                   .nth_index_in_set(local_row);
@@ -284,6 +299,20 @@ DealIIMatrixFreeHierarchyHelpers<dim, VectorType>::build_restrictor(
     dealii_ap->reinit(*ap);
     delete ap;
 
+    // These matrices only live during the setup but they often dominate its
+    // peak memory
+    memory_statistics.put_child(
+        "eigenvector_matrix",
+        summarize_memory(comm, eigenvector_matrix->memory_consumption()));
+    memory_statistics.put_child(
+        "delta_eigenvector_matrix",
+        summarize_memory(comm, delta_eigenvector_matrix->memory_consumption()));
+    memory_statistics.put_child(
+        "delta_correction_matrix",
+        summarize_memory(comm, delta_correction_matrix.memory_consumption()));
+    memory_statistics.put_child(
+        "ap", summarize_memory(comm, dealii_ap->memory_consumption()));
+
     _ap_operator.reset(new DealIITrilinosMatrixOperator<VectorType>(dealii_ap));
   }
   else
@@ -294,8 +323,20 @@ DealIIMatrixFreeHierarchyHelpers<dim, VectorType>::build_restrictor(
     amge.setup_restrictor(agglomerate_params, n_eigenvectors, tolerance,
                           *dealii_mesh_evaluator, locally_relevant_global_diag,
                           *restrictor_matrix);
+    agglomerate_statistics = amge.get_agglomerate_statistics();
+    thread_utilization = amge.get_thread_utilization();
   }
 
+  _restrictor_statistics = boost::property_tree::ptree();
+  _restrictor_statistics.put_child(
+      "eigensolver", summarize_agglomerate_statistics(
+                         comm, eigensolver_params.get("type", "lanczos"),
+                         agglomerate_statistics));
+  _restrictor_statistics.put_child(
+      "threads", summarize_thread_utilization(comm, thread_utilization));
+  if (!memory_statistics.empty())
+    _restrictor_statistics.put_child("memory", memory_statistics);
+
   std::shared_ptr<Operator<VectorType>> op(
       new DealIITrilinosMatrixOperator<VectorType>(restrictor_matrix));
 
@@ -321,11 +362,19 @@ DealIIMatrixFreeHierarchyHelpers<dim, VectorType>::build_coarse_solver(
   return std::make_shared<DealIISolver<VectorType>>(op, params);
 }
 
+template <int dim, typename VectorType>
+boost::property_tree::ptree DealIIMatrixFreeHierarchyHelpers<
+    dim, VectorType>::get_restrictor_statistics() const
+{
+  return _restrictor_statistics;
+}
+
 template <int dim, typename VectorType>
 std::shared_ptr<Operator<VectorType>>
 DealIIMatrixFreeHierarchyHelpers<dim, VectorType>::fast_multiply_transpose()
 {
-  return _ap_operator;
+  // The hierarchy keeps the helpers so we do not hold on to the product
+  return std::move(_ap_operator);
 }
 
 } // namespace mfmg
@@ -142,6 +142,13 @@ size_t DealIIMatrixFreeOperator<dim, VectorType>::operator_complexity() const
   return -1;
 }
 
+template <int dim, typename VectorType>
+std::size_t
+DealIIMatrixFreeOperator<dim, VectorType>::memory_consumption() const
+{
+  return sizeof(*this);
+}
+
 template <int dim, typename VectorType>
 std::shared_ptr<dealii::DiagonalMatrix<VectorType>>
 DealIIMatrixFreeOperator<dim, VectorType>::get_diagonal_inverse() const
@@ -53,6 +53,10 @@ DealIIMatrixFreeSmoother<dim, VectorType>::DealIIMatrixFreeSmoother(
     data.preconditioner = matrix_free_operator->get_diagonal_inverse();
 
     _smoother->initialize(*matrix_free_operator, data);
+
+    // The Chebyshev iteration stores the diagonal and three temporary vectors
+    // with the same layout
+    _memory_consumption = 4 * data.preconditioner->memory_consumption();
   }
   else
   {
@@ -61,9 +65,18 @@ DealIIMatrixFreeSmoother<dim, VectorType>::DealIIMatrixFreeSmoother(
 }
 
 template <int dim, typename VectorType>
-void DealIIMatrixFreeSmoother<dim, VectorType>::apply(VectorType const &b,
-                                                      VectorType &x) const
+void DealIIMatrixFreeSmoother<dim, VectorType>::apply(
+    VectorType const &b, VectorType &x, bool zero_initial_guess) const
 {
+  if (zero_initial_guess)
+  {
+    // x = 0 so that x = B^{-1} b and we can skip the computation of the
+    // residual
+    _smoother->vmult(x, b);
+
+    return;
+  }
+
   // r = -(b - Ax)
   vector_type r(b);
   this->_operator->apply(x, r);
@@ -75,6 +88,13 @@ void DealIIMatrixFreeSmoother<dim, VectorType>::apply(VectorType const &b,
   x.add(-1., tmp);
 }
 
+template <int dim, typename VectorType>
+std::size_t
+DealIIMatrixFreeSmoother<dim, VectorType>::memory_consumption() const
+{
+  return _memory_consumption;
+}
+
 } // namespace mfmg
 
 // Explicit Instantiation
@@ -0,0 +1,293 @@
+/**************************************************************************
+ * Copyright (c) 2017-2019 by the mfmg authors                            *
+ * All rights reserved.                                                   *
+ *                                                                        *
+ * This file is part of the mfmg library. mfmg is distributed under a BSD *
+ * 3-clause license. For the licensing terms see the LICENSE file in the  *
+ * top-level directory                                                    *
+ *                                                                        *
+ * SPDX-License-Identifier: BSD-3-Clause                                  *
+ *************************************************************************/
+
+#include <mfmg/common/exceptions.hpp>
+#include <mfmg/common/instantiation.hpp>
+#include <mfmg/dealii/dealii_multicolor_smoother.hpp>
+#include <mfmg/dealii/dealii_trilinos_matrix_operator.hpp>
+
+#include <deal.II/base/memory_consumption.h>
+#include <deal.II/base/parallel.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace mfmg
+{
+namespace
+{
+// Minimum number of rows given to a thread
+unsigned int constexpr grain_size = 256;
+} // namespace
+
+template <typename VectorType, typename StorageType>
+DealIIMulticolorSmoother<VectorType, StorageType>::DealIIMulticolorSmoother(
+    std::shared_ptr<Operator<vector_type> const> op,
+    std::shared_ptr<boost::property_tree::ptree const> params)
+    : Smoother<VectorType>(op, params)
+{
+  std::string prec_name = this->_params->get(
+      "smoother.type", "Multicolor Symmetric Gauss-Seidel");
+  std::transform(prec_name.begin(), prec_name.end(), prec_name.begin(),
+                 ::tolower);
+  if (prec_name == "multicolor symmetric gauss-seidel")
+  {
+    _forward_sweep = true;
+    _backward_sweep = true;
+  }
+  else if (prec_name == "multicolor gauss-seidel")
+  {
+    _forward_sweep = true;
+    _backward_sweep = false;
+  }
+  else if (prec_name == "multicolor backward gauss-seidel")
+  {
+    _forward_sweep = false;
+    _backward_sweep = true;
+  }
+  else
+  {
+    ASSERT_THROW(false, "Unknown smoother name: \"" + prec_name + "\"");
+  }
+
+  auto trilinos_operator =
+      std::dynamic_pointer_cast<DealIITrilinosMatrixOperator<VectorType> const>(
+          this->_operator);
+  ASSERT_THROW(trilinos_operator != nullptr,
+               "DealIIMulticolorSmoother must be constructed from a "
+               "DealIITrilinosMatrixOperator");
+  auto sparse_matrix = trilinos_operator->get_matrix();
+  auto const &epetra_matrix = sparse_matrix->trilinos_matrix();
+  ASSERT_THROW(epetra_matrix.IndicesAreLocal(), "Indices are not local");
+
+  dealii::IndexSet const locally_owned_dofs =
+      sparse_matrix->locally_owned_range_indices();
+  ASSERT(locally_owned_dofs == sparse_matrix->locally_owned_domain_indices(),
+         "The range and the domain of the matrix must be distributed "
+         "identically");
+  unsigned int const n_local_rows = locally_owned_dofs.n_elements();
+
+  // Find the ghost indices, i.e., the columns owned by other processors
+  dealii::IndexSet ghost_indices(locally_owned_dofs.size());
+  for (unsigned int i = 0; i < n_local_rows; ++i)
+  {
+    int const row = epetra_matrix.LRID(
+        static_cast<int>(locally_owned_dofs.nth_index_in_set(i)));
+    int n_entries = 0;
+    double *values = nullptr;
+    int *indices = nullptr;
+    epetra_matrix.ExtractMyRowView(row, n_entries, values, indices);
+    for (int k = 0; k < n_entries; ++k)
+    {
+      auto const global_index = epetra_matrix.GCID(indices[k]);
+      if (!locally_owned_dofs.is_element(global_index))
+        ghost_indices.add_index(global_index);
+    }
+  }
+  ghost_indices.compress();
+  _ghosted_x.reinit(locally_owned_dofs, ghost_indices,
+                    sparse_matrix->get_mpi_communicator());
+  _rhs.resize(n_local_rows);
+
+  // Split the locally owned rows in the coupling with the other locally owned
+  // rows, the diagonal, and the coupling with the ghost rows.
+  _local_row_ptr.resize(n_local_rows + 1, 0);
+  _ghost_row_ptr.resize(n_local_rows + 1, 0);
+  _inv_diagonal.resize(n_local_rows, 0.);
+  for (unsigned int i = 0; i < n_local_rows; ++i)
+  {
+    auto const global_row = locally_owned_dofs.nth_index_in_set(i);
+    int const row = epetra_matrix.LRID(static_cast<int>(global_row));
+    int n_entries = 0;
+    double *values = nullptr;
+    int *indices = nullptr;
+    epetra_matrix.ExtractMyRowView(row, n_entries, values, indices);
+    double diagonal = 0.;
+    for (int k = 0; k < n_entries; ++k)
+    {
+      auto const global_index = epetra_matrix.GCID(indices[k]);
+      if (global_index == static_cast<int>(global_row))
+      {
+        diagonal = values[k];
+      }
+      else if (locally_owned_dofs.is_element(global_index))
+      {
+        _local_column_index.push_back(
+            locally_owned_dofs.index_within_set(global_index));
+        _local_values.push_back(values[k]);
+      }
+      else
+      {
+        _ghost_column_index.push_back(
+            n_local_rows + ghost_indices.index_within_set(global_index));
+        _ghost_values.push_back(values[k]);
+      }
+    }
+    _local_row_ptr[i + 1] = _local_column_index.size();
+    _ghost_row_ptr[i + 1] = _ghost_column_index.size();
+
+    if (diagonal == 0.)
+      ASSERT_THROW(false,
+                   "Zero on the diagonal of row " + std::to_string(global_row));
+    // Invert in double precision before rounding to the storage type
+    _inv_diagonal[i] = 1. / diagonal;
+  }
+
+  // Color the rows using a greedy algorithm. The matrix may not be
+  // structurally symmetric so we need to color the graph of A + A^T.
+  std::vector<std::vector<unsigned int>> adjacency(n_local_rows);
+  for (unsigned int i = 0; i < n_local_rows; ++i)
+    for (unsigned int k = _local_row_ptr[i]; k < _local_row_ptr[i + 1]; ++k)
+    {
+      adjacency[i].push_back(_local_column_index[k]);
+      adjacency[_local_column_index[k]].push_back(i);
+    }
+
+  unsigned int constexpr uncolored = std::numeric_limits<unsigned int>::max();
+  std::vector<unsigned int> row_color(n_local_rows, uncolored);
+  // forbidden_colors[c] == i if one of the neighbors of row i has color c
+  std::vector<unsigned int> forbidden_colors;
+  for (unsigned int i = 0; i < n_local_rows; ++i)
+  {
+    for (auto const j : adjacency[i])
+      if (row_color[j] != uncolored)
+        forbidden_colors[row_color[j]] = i;
+
+    unsigned int color = 0;
+    while ((color < forbidden_colors.size()) && (forbidden_colors[color] == i))
+      ++color;
+    if (color == forbidden_colors.size())
+      forbidden_colors.push_back(uncolored);
+    row_color[i] = color;
+  }
+
+  // Sort the rows by color. Inside a color, the rows are sorted by increasing
+  // index.
+  unsigned int const n_colors = forbidden_colors.size();
+  _color_offsets.resize(n_colors + 1, 0);
+  for (auto const color : row_color)
+    ++_color_offsets[color + 1];
+  for (unsigned int c = 0; c < n_colors; ++c)
+    _color_offsets[c + 1] += _color_offsets[c];
+  _color_rows.resize(n_local_rows);
+  std::vector<unsigned int> position(_color_offsets.begin(),
+                                     _color_offsets.end() - 1);
+  for (unsigned int i = 0; i < n_local_rows; ++i)
+    _color_rows[position[row_color[i]]++] = i;
+}
+
+template <typename VectorType, typename StorageType>
+void DealIIMulticolorSmoother<VectorType, StorageType>::apply(
+    VectorType const &b, VectorType &x, bool zero_initial_guess) const
+{
+  if (zero_initial_guess)
+  {
+    // x = 0 so the ghost values are zero and we can skip the communication
+    std::copy(b.begin(), b.end(), _rhs.begin());
+  }
+  else
+  {
+    compute_local_rhs(b, x);
+  }
+
+  // The ghost values are frozen during the whole apply so that the symmetric
+  // sweep gives a symmetric smoother.
+  unsigned int const n_colors = this->n_colors();
+  if (_forward_sweep)
+    for (unsigned int c = 0; c < n_colors; ++c)
+      relax_color(c, _rhs.data(), x.begin());
+  if (_backward_sweep)
+    for (unsigned int c = n_colors; c > 0; --c)
+      relax_color(c - 1, _rhs.data(), x.begin());
+}
+
+template <typename VectorType, typename StorageType>
+unsigned int
+DealIIMulticolorSmoother<VectorType, StorageType>::n_colors() const
+{
+  return _color_offsets.size() - 1;
+}
+
+template <typename VectorType, typename StorageType>
+bool DealIIMulticolorSmoother<VectorType, StorageType>::replace_operator(
+    std::shared_ptr<Operator<vector_type> const> op)
+{
+  this->_operator = op;
+
+  return true;
+}
+
+template <typename VectorType, typename StorageType>
+std::size_t
+DealIIMulticolorSmoother<VectorType, StorageType>::memory_consumption() const
+{
+  using dealii::MemoryConsumption::memory_consumption;
+
+  return memory_consumption(_color_offsets) + memory_consumption(_color_rows) +
+         memory_consumption(_local_row_ptr) +
+         memory_consumption(_local_column_index) +
+         memory_consumption(_local_values) + memory_consumption(_inv_diagonal) +
+         memory_consumption(_ghost_row_ptr) +
+         memory_consumption(_ghost_column_index) +
+         memory_consumption(_ghost_values) + _ghosted_x.memory_consumption() +
+         memory_consumption(_rhs);
+}
+
+template <typename VectorType, typename StorageType>
+void DealIIMulticolorSmoother<VectorType, StorageType>::compute_local_rhs(
+    VectorType const &b, VectorType const &x) const
+{
+  _ghosted_x.zero_out_ghosts();
+  std::copy(x.begin(), x.end(), _ghosted_x.begin());
+  _ghosted_x.update_ghost_values();
+
+  // rhs = b - A_ghost x_ghost
+  dealii::parallel::apply_to_subranges(
+      0U, static_cast<unsigned int>(_rhs.size()),
+      [&](unsigned int const begin, unsigned int const end) {
+        for (unsigned int i = begin; i < end; ++i)
+        {
+          value_type sum = b.local_element(i);
+          for (unsigned int k = _ghost_row_ptr[i]; k < _ghost_row_ptr[i + 1];
+               ++k)
+            sum -= _ghost_values[k] *
+                   _ghosted_x.local_element(_ghost_column_index[k]);
+          _rhs[i] = sum;
+        }
+      },
+      grain_size);
+}
+
+template <typename VectorType, typename StorageType>
+void DealIIMulticolorSmoother<VectorType, StorageType>::relax_color(
+    unsigned int color, value_type const *rhs, value_type *x) const
+{
+  // The rows of a given color are not coupled, so they can be updated in any
+  // order.
+  dealii::parallel::apply_to_subranges(
+      _color_offsets[color], _color_offsets[color + 1],
+      [&](unsigned int const begin, unsigned int const end) {
+        for (unsigned int k = begin; k < end; ++k)
+        {
+          unsigned int const i = _color_rows[k];
+          value_type sum = rhs[i];
+          for (unsigned int l = _local_row_ptr[i]; l < _local_row_ptr[i + 1];
+               ++l)
+            sum -= _local_values[l] * x[_local_column_index[l]];
+          x[i] = sum * _inv_diagonal[i];
+        }
+      },
+      grain_size);
+}
+} // namespace mfmg
+
+// Explicit Instantiation
+INSTANTIATE_VECTORTYPE_SCALARTYPE(TUPLE(DealIIMulticolorSmoother))
@@ -64,11 +64,29 @@ DealIISmoother<VectorType>::DealIISmoother(
   {
     ASSERT_THROW(false, "Unknown smoother name: \"" + prec_name + "\"");
   }
+
+  // The point relaxations store the inverse of the diagonal while ILU(0)
+  // stores factors with the same sparsity pattern as the matrix
+  _memory_consumption =
+      (prec_name == "ilu")
+          ? sparse_matrix->memory_consumption()
+          : sparse_matrix->locally_owned_range_indices().n_elements() *
+                sizeof(double);
 }
 
 template <typename VectorType>
-void DealIISmoother<VectorType>::apply(VectorType const &b, VectorType &x) const
+void DealIISmoother<VectorType>::apply(VectorType const &b, VectorType &x,
+                                       bool zero_initial_guess) const
 {
+  if (zero_initial_guess)
+  {
+    // x = 0 so that x = B^{-1} b and we can skip the computation of the
+    // residual
+    _smoother->vmult(x, b);
+
+    return;
+  }
+
   // r = -(b - Ax)
   vector_type r(b);
   this->_operator->apply(x, r);
@@ -80,6 +98,12 @@ void DealIISmoother<VectorType>::apply(VectorType const &b, VectorType &x) const
   x.add(-1., tmp);
 }
 
+template <typename VectorType>
+std::size_t DealIISmoother<VectorType>::memory_consumption() const
+{
+  return _memory_consumption;
+}
+
 } // namespace mfmg
 
 // Explicit Instantiation
@@ -10,16 +10,19 @@
  *************************************************************************/
 
 #include <mfmg/common/instantiation.hpp>
+#include <mfmg/common/memory.hpp>
 #include <mfmg/common/utils.hpp>
 #include <mfmg/dealii/dealii_solver.hpp>
 #include <mfmg/dealii/dealii_trilinos_matrix_operator.hpp>
 
 #include <deal.II/lac/trilinos_precondition.h>
-#include <deal.II/lac/trilinos_solver.h>
 
+#include <Amesos.h>
 #include <ml_MultiLevelPreconditioner.h>
 #include <ml_Preconditioner.h>
 
+#include <algorithm>
+
 namespace mfmg
 {
 template <typename VectorType>
@@ -42,8 +45,22 @@ DealIISolver<VectorType>::DealIISolver(
 
   if (coarse_type_lower == "direct")
   {
-    _solver.reset(new dealii::TrilinosWrappers::SolverDirect(_solver_control));
-    _solver->initialize(*sparse_matrix);
+    // Same solver as the default of dealii::TrilinosWrappers::SolverDirect
+    _linear_problem.reset(new Epetra_LinearProblem());
+    _linear_problem->SetOperator(
+        const_cast<Epetra_CrsMatrix *>(&sparse_matrix->trilinos_matrix()));
+    Amesos factory;
+    _direct_solver.reset(factory.Create("Amesos_Klu", *_linear_problem));
+    ASSERT_THROW(_direct_solver != nullptr, "Amesos_Klu is not available");
+    std::size_t const resident_before = get_memory_usage().resident;
+    int error_code = _direct_solver->SymbolicFactorization();
+    ASSERT_THROW(error_code == 0, "Amesos symbolic factorization failed");
+    error_code = _direct_solver->NumericFactorization();
+    ASSERT_THROW(error_code == 0, "Amesos numeric factorization failed");
+    std::size_t const resident_after = get_memory_usage().resident;
+    _factorization_memory = resident_after > resident_before
+                                ? resident_after - resident_before
+                                : 0;
   }
   else
   {
@@ -76,15 +93,76 @@ DealIISolver<VectorType>::DealIISolver(
 template <typename VectorType>
 void DealIISolver<VectorType>::apply(VectorType const &b, VectorType &x) const
 {
-  if (_solver)
+  if (_direct_solver)
   {
-    _solver->solve(x, b);
+    // Wrap the vectors without copying them
+    auto const &epetra_matrix = *_linear_problem->GetMatrix();
+    Epetra_MultiVector epetra_b(View, epetra_matrix.OperatorRangeMap(),
+                                const_cast<double *>(b.begin()),
+                                b.local_size(), 1);
+    Epetra_MultiVector epetra_x(View, epetra_matrix.OperatorDomainMap(),
+                                x.begin(), x.local_size(), 1);
+    direct_solve(epetra_b, epetra_x);
   }
   else
   {
     _smoother->vmult(x, b);
   }
 }
+
+template <typename VectorType>
+void DealIISolver<VectorType>::apply_multivector(
+    MultiVector<VectorType> const &b, MultiVector<VectorType> &x) const
+{
+  if (!_direct_solver)
+  {
+    Solver<VectorType>::apply_multivector(b, x);
+
+    return;
+  }
+
+  // Amesos requires the vectors to be stored contiguously
+  auto const &epetra_matrix = *_linear_problem->GetMatrix();
+  int const n_vectors = b.n_vectors();
+  Epetra_MultiVector epetra_b(epetra_matrix.OperatorRangeMap(), n_vectors,
+                              false);
+  Epetra_MultiVector epetra_x(epetra_matrix.OperatorDomainMap(), n_vectors,
+                              false);
+  for (int i = 0; i < n_vectors; ++i)
+    std::copy(b[i]->begin(), b[i]->end(), epetra_b[i]);
+
+  direct_solve(epetra_b, epetra_x);
+
+  for (int i = 0; i < n_vectors; ++i)
+    std::copy(epetra_x[i], epetra_x[i] + epetra_x.MyLength(), x[i]->begin());
+}
+
+template <typename VectorType>
+std::size_t DealIISolver<VectorType>::memory_consumption() const
+{
+  if (_direct_solver)
+    return _factorization_memory;
+
+  return static_cast<dealii::TrilinosWrappers::PreconditionAMG *>(
+             _smoother.get())
+      ->memory_consumption();
+}
+
+template <typename VectorType>
+bool DealIISolver<VectorType>::memory_consumption_is_rss_delta() const
+{
+  return _direct_solver != nullptr;
+}
+
+template <typename VectorType>
+void DealIISolver<VectorType>::direct_solve(Epetra_MultiVector &b,
+                                            Epetra_MultiVector &x) const
+{
+  _linear_problem->SetRHS(&b);
+  _linear_problem->SetLHS(&x);
+  int const error_code = _direct_solver->Solve();
+  ASSERT_THROW(error_code == 0, "Amesos solve failed");
+}
 } // namespace mfmg
 
 // Explicit Instantiation
@@ -15,6 +15,9 @@
 
 #include <EpetraExt_MatrixMatrix.h>
 #include <EpetraExt_Transpose_RowMatrix.h>
+#include <Epetra_MultiVector.h>
+
+#include <algorithm>
 
 namespace mfmg
 {
@@ -34,6 +37,34 @@ void DealIITrilinosMatrixOperator<VectorType>::apply(VectorType const &x,
                                   : _sparse_matrix->Tvmult(y, x));
 }
 
+template <typename VectorType>
+void DealIITrilinosMatrixOperator<VectorType>::apply_multivector(
+    MultiVector<VectorType> const &x, MultiVector<VectorType> &y,
+    OperatorMode mode) const
+{
+  auto const &epetra_matrix = _sparse_matrix->trilinos_matrix();
+  bool const transpose = (mode == OperatorMode::TRANS);
+  Epetra_Map const &x_map =
+      transpose ? epetra_matrix.RangeMap() : epetra_matrix.DomainMap();
+  Epetra_Map const &y_map =
+      transpose ? epetra_matrix.DomainMap() : epetra_matrix.RangeMap();
+
+  // Epetra requires the vectors to be stored contiguously
+  int const n_vectors = x.n_vectors();
+  Epetra_MultiVector epetra_x(x_map, n_vectors, false);
+  Epetra_MultiVector epetra_y(y_map, n_vectors, false);
+  for (int i = 0; i < n_vectors; ++i)
+    std::copy(x[i]->begin(), x[i]->end(), epetra_x[i]);
+
+  int const error_code = epetra_matrix.Multiply(transpose, epetra_x, epetra_y);
+  ASSERT(error_code == 0, "Epetra_CrsMatrix::Multiply() returned non-zero "
+                          "error code in "
+                          "DealIITrilinosMatrixOperator::apply_multivector()");
+
+  for (int i = 0; i < n_vectors; ++i)
+    std::copy(epetra_y[i], epetra_y[i] + epetra_y.MyLength(), y[i]->begin());
+}
+
 template <typename VectorType>
 std::shared_ptr<Operator<VectorType>>
 DealIITrilinosMatrixOperator<VectorType>::transpose() const
@@ -125,6 +156,12 @@ size_t DealIITrilinosMatrixOperator<VectorType>::operator_complexity() const
   return _sparse_matrix->n_nonzero_elements();
 }
 
+template <typename VectorType>
+std::size_t DealIITrilinosMatrixOperator<VectorType>::memory_consumption() const
+{
+  return _sparse_matrix->memory_consumption();
+}
+
 template <typename VectorType>
 std::shared_ptr<dealii::TrilinosWrappers::SparseMatrix const>
 DealIITrilinosMatrixOperator<VectorType>::get_matrix() const
@@ -10,13 +10,232 @@
  **************************************************************************/
 
 #include <mfmg/common/exceptions.hpp>
+#include <mfmg/common/utils.hpp>
 #include <mfmg/dealii/dealii_utils.hpp>
 
+#include <deal.II/base/mpi.h>
+#include <deal.II/lac/trilinos_sparsity_pattern.h>
+
 #include <EpetraExt_MultiVectorOut.h>
 #include <EpetraExt_RowMatrixOut.h>
+#include <Epetra_CrsMatrix.h>
+
+#include <boost/property_tree/info_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include <cstring>
+#include <fstream>
 
 namespace mfmg
 {
+namespace
+{
+/**
+ * Header of the files written by binary_csr_output_file() and
+ * binary_vector_output_file(). The size of the header is a multiple of 8 bytes
+ * so that the arrays which follow it are aligned.
+ */
+struct BinaryHeader
+{
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t n_processes;
+  std::uint32_t rank;
+  std::uint32_t padding;
+  std::uint64_t m;
+  std::uint64_t n;
+  std::uint64_t n_local_rows;
+  std::uint64_t n_local_columns;
+  std::uint64_t n_local_nonzero_elements;
+};
+static_assert(sizeof(BinaryHeader) == 64,
+              "The size of the binary header must be 64 bytes");
+
+char const binary_csr_magic[8] = {'M', 'F', 'M', 'G', 'C', 'S', 'R', '\0'};
+char const binary_vector_magic[8] = {'M', 'F', 'M', 'G', 'V', 'E', 'C', '\0'};
+std::uint32_t constexpr binary_version = 1;
+
+BinaryHeader make_binary_header(char const *magic, MPI_Comm comm,
+                                std::uint64_t m, std::uint64_t n,
+                                std::uint64_t n_local_rows,
+                                std::uint64_t n_local_columns,
+                                std::uint64_t n_local_nonzero_elements)
+{
+  BinaryHeader header;
+  std::memcpy(header.magic, magic, sizeof(header.magic));
+  header.version = binary_version;
+  header.n_processes = dealii::Utilities::MPI::n_mpi_processes(comm);
+  header.rank = dealii::Utilities::MPI::this_mpi_process(comm);
+  header.padding = 0;
+  header.m = m;
+  header.n = n;
+  header.n_local_rows = n_local_rows;
+  header.n_local_columns = n_local_columns;
+  header.n_local_nonzero_elements = n_local_nonzero_elements;
+
+  return header;
+}
+
+template <typename T>
+void write_binary_array(std::ostream &out, std::vector<T> const &data)
+{
+  out.write(reinterpret_cast<char const *>(data.data()),
+            data.size() * sizeof(T));
+}
+
+template <typename T>
+void read_binary_array(std::istream &in, std::string const &filename,
+                       std::vector<T> &data, std::uint64_t size)
+{
+  data.resize(size);
+  in.read(reinterpret_cast<char *>(data.data()), size * sizeof(T));
+  ASSERT_THROW(in.good(), "File " + filename + " is truncated");
+}
+
+/**
+ * Gather the sizes of the local parts on the first processor which writes
+ * them to the index file. This is the only collective operation of the
+ * writers.
+ */
+void write_binary_index(std::string const &filename, MPI_Comm comm,
+                        BinaryHeader const &header)
+{
+  std::uint64_t const local_sizes[3] = {header.n_local_rows,
+                                        header.n_local_columns,
+                                        header.n_local_nonzero_elements};
+  std::vector<std::uint64_t> sizes(header.rank == 0 ? 3 * header.n_processes
+                                                    : 0);
+  MPI_Gather(local_sizes, 3, MPI_UINT64_T, sizes.data(), 3, MPI_UINT64_T, 0,
+             comm);
+  if (header.rank == 0)
+  {
+    boost::property_tree::ptree index;
+    index.put("format", std::string(header.magic));
+    index.put("version", header.version);
+    index.put("n_processes", header.n_processes);
+    index.put("m", header.m);
+    index.put("n", header.n);
+    for (unsigned int i = 0; i < header.n_processes; ++i)
+    {
+      std::string const rank = "rank_" + std::to_string(i);
+      index.put(rank + ".n_local_rows", sizes[3 * i]);
+      index.put(rank + ".n_local_columns", sizes[3 * i + 1]);
+      index.put(rank + ".n_local_nonzero_elements", sizes[3 * i + 2]);
+    }
+    boost::property_tree::info_parser::write_info(filename + ".index", index);
+  }
+}
+
+/**
+ * Read the index file and check that it can be read by the processors of
+ * \p comm. This does not require any communication so that it can be called
+ * inside collective_check().
+ */
+boost::property_tree::ptree read_binary_index(std::string const &filename,
+                                              char const *magic, MPI_Comm comm)
+{
+  boost::property_tree::ptree index;
+  boost::property_tree::info_parser::read_info(filename + ".index", index);
+  ASSERT_THROW(index.get<std::string>("format") == magic,
+               filename + ".index does not describe a " + magic + " file");
+  unsigned int const n_processes =
+      dealii::Utilities::MPI::n_mpi_processes(comm);
+  ASSERT_THROW(index.get<unsigned int>("n_processes") == n_processes,
+               filename + " was written using " +
+                   index.get<std::string>("n_processes") +
+                   " processors but it is read using " +
+                   std::to_string(n_processes));
+
+  return index;
+}
+
+BinaryHeader read_binary_header(std::istream &in,
+                                std::string const &rank_filename,
+                                char const *magic, unsigned int rank)
+{
+  BinaryHeader header;
+  in.read(reinterpret_cast<char *>(&header), sizeof(header));
+  ASSERT_THROW(in.good() && (std::memcmp(header.magic, magic,
+                                         sizeof(header.magic)) == 0),
+               rank_filename + " is not a " + magic + " file");
+  ASSERT_THROW(header.version == binary_version,
+               "Unsupported version of the binary format in " + rank_filename);
+  ASSERT_THROW(header.rank == rank, rank_filename + " was written by rank " +
+                                        std::to_string(header.rank));
+
+  return header;
+}
+
+template <typename VectorType>
+void write_binary_vector_file(std::string const &filename, MPI_Comm comm,
+                              VectorType const &vector)
+{
+  auto const locally_owned_elements = vector.locally_owned_elements();
+  std::uint64_t const n_local_elements = locally_owned_elements.n_elements();
+  auto const header =
+      make_binary_header(binary_vector_magic, comm, vector.size(), 1,
+                         n_local_elements, 0, n_local_elements);
+  std::vector<std::uint64_t> indices;
+  std::vector<double> values;
+  indices.reserve(n_local_elements);
+  values.reserve(n_local_elements);
+  for (auto const i : locally_owned_elements)
+  {
+    indices.push_back(i);
+    values.push_back(vector[i]);
+  }
+
+  collective_check(comm, [&]() {
+    std::string const rank_filename =
+        filename + "." + std::to_string(header.rank);
+    std::ofstream out(rank_filename, std::ios::binary);
+    ASSERT_THROW(out.good(), "Cannot open file " + rank_filename);
+    out.write(reinterpret_cast<char const *>(&header), sizeof(header));
+    write_binary_array(out, indices);
+    write_binary_array(out, values);
+    ASSERT_THROW(out.good(), "Error while writing file " + rank_filename);
+  });
+
+  write_binary_index(filename, comm, header);
+}
+
+template <typename VectorType>
+void read_binary_vector_file(std::string const &filename, MPI_Comm comm,
+                             VectorType &vector)
+{
+  unsigned int const rank = dealii::Utilities::MPI::this_mpi_process(comm);
+  BinaryHeader header;
+  std::vector<std::uint64_t> indices;
+  std::vector<double> values;
+  collective_check(comm, [&]() {
+    auto const index = read_binary_index(filename, binary_vector_magic, comm);
+    std::string const rank_filename = filename + "." + std::to_string(rank);
+    std::ifstream in(rank_filename, std::ios::binary);
+    ASSERT_THROW(in.good(), "Cannot open file " + rank_filename);
+    header = read_binary_header(in, rank_filename, binary_vector_magic, rank);
+    ASSERT_THROW(header.n_local_rows ==
+                     index.get<std::uint64_t>("rank_" + std::to_string(rank) +
+                                              ".n_local_rows"),
+                 rank_filename + " does not match " + filename + ".index");
+    read_binary_array(in, rank_filename, indices, header.n_local_rows);
+    read_binary_array(in, rank_filename, values, header.n_local_rows);
+  });
+  // The files of all the processors must describe the same partition
+  ASSERT_THROW(dealii::Utilities::MPI::sum(header.n_local_rows, comm) ==
+                   header.m,
+               "The files " + filename +
+                   ".* do not describe a partition of the vector");
+
+  dealii::IndexSet locally_owned_elements(header.m);
+  locally_owned_elements.add_indices(indices.begin(), indices.end());
+  locally_owned_elements.compress();
+  vector.reinit(locally_owned_elements, comm);
+  for (std::uint64_t i = 0; i < header.n_local_rows; ++i)
+    vector[indices[i]] = values[i];
+  vector.compress(dealii::VectorOperation::insert);
+}
+} // namespace
+
 dealii::LinearAlgebra::distributed::Vector<double>
 extract_row(dealii::TrilinosWrappers::SparseMatrix const &matrix,
             dealii::types::global_dof_index global_j)
@@ -89,4 +308,188 @@ void matrix_market_output_file(
   ASSERT(rv == 0, "EpetraExt::RowMatrixToMatrixMarketFile return value is " +
                       std::to_string(rv));
 }
+
+void binary_csr_output_file(
+    std::string const &filename,
+    dealii::TrilinosWrappers::SparseMatrix const &matrix)
+{
+  MPI_Comm comm = matrix.get_mpi_communicator();
+  auto const &epetra_matrix = matrix.trilinos_matrix();
+  auto const &locally_owned_rows = matrix.locally_owned_range_indices();
+  auto const &locally_owned_columns = matrix.locally_owned_domain_indices();
+
+  auto const header = make_binary_header(
+      binary_csr_magic, comm, matrix.m(), matrix.n(),
+      locally_owned_rows.n_elements(), locally_owned_columns.n_elements(),
+      epetra_matrix.NumMyNonzeros());
+
+  std::vector<std::uint64_t> row_indices;
+  row_indices.reserve(header.n_local_rows);
+  for (auto const row : locally_owned_rows)
+    row_indices.push_back(row);
+  std::vector<std::uint64_t> column_indices;
+  column_indices.reserve(header.n_local_columns);
+  for (auto const column : locally_owned_columns)
+    column_indices.push_back(column);
+
+  std::vector<std::uint64_t> row_ptr(header.n_local_rows + 1, 0);
+  std::vector<std::uint64_t> columns;
+  std::vector<double> values;
+  columns.reserve(header.n_local_nonzero_elements);
+  values.reserve(header.n_local_nonzero_elements);
+  for (std::uint64_t i = 0; i < header.n_local_rows; ++i)
+  {
+    int const local_row =
+        epetra_matrix.LRID(static_cast<int>(row_indices[i]));
+    int n_entries = 0;
+    double *row_values = nullptr;
+    int *local_columns = nullptr;
+    int const error_code = epetra_matrix.ExtractMyRowView(
+        local_row, n_entries, row_values, local_columns);
+    ASSERT(error_code == 0,
+           "Non-zero error code (" + std::to_string(error_code) +
+               ") returned by Epetra_CrsMatrix::ExtractMyRowView()");
+    for (int k = 0; k < n_entries; ++k)
+    {
+      columns.push_back(epetra_matrix.GCID(local_columns[k]));
+      values.push_back(row_values[k]);
+    }
+    row_ptr[i + 1] = columns.size();
+  }
+
+  collective_check(comm, [&]() {
+    std::string const rank_filename =
+        filename + "." + std::to_string(header.rank);
+    std::ofstream out(rank_filename, std::ios::binary);
+    ASSERT_THROW(out.good(), "Cannot open file " + rank_filename);
+    out.write(reinterpret_cast<char const *>(&header), sizeof(header));
+    write_binary_array(out, row_indices);
+    write_binary_array(out, column_indices);
+    write_binary_array(out, row_ptr);
+    write_binary_array(out, columns);
+    write_binary_array(out, values);
+    ASSERT_THROW(out.good(), "Error while writing file " + rank_filename);
+  });
+
+  write_binary_index(filename, comm, header);
+}
+
+HostCSRMatrix binary_csr_input_file(std::string const &filename,
+                                    unsigned int rank)
+{
+  std::string const rank_filename = filename + "." + std::to_string(rank);
+  std::ifstream in(rank_filename, std::ios::binary);
+  ASSERT_THROW(in.good(), "Cannot open file " + rank_filename);
+  auto const header =
+      read_binary_header(in, rank_filename, binary_csr_magic, rank);
+
+  HostCSRMatrix matrix;
+  matrix.m = header.m;
+  matrix.n = header.n;
+  read_binary_array(in, rank_filename, matrix.row_indices,
+                    header.n_local_rows);
+  read_binary_array(in, rank_filename, matrix.column_indices,
+                    header.n_local_columns);
+  read_binary_array(in, rank_filename, matrix.row_ptr, header.n_local_rows + 1);
+  read_binary_array(in, rank_filename, matrix.columns,
+                    header.n_local_nonzero_elements);
+  read_binary_array(in, rank_filename, matrix.values,
+                    header.n_local_nonzero_elements);
+
+  return matrix;
+}
+
+void binary_csr_input_file(std::string const &filename, MPI_Comm comm,
+                           dealii::TrilinosWrappers::SparseMatrix &matrix)
+{
+  unsigned int const rank = dealii::Utilities::MPI::this_mpi_process(comm);
+  HostCSRMatrix host_matrix;
+  collective_check(comm, [&]() {
+    auto const index = read_binary_index(filename, binary_csr_magic, comm);
+    host_matrix = binary_csr_input_file(filename, rank);
+    std::string const rank_index = "rank_" + std::to_string(rank);
+    ASSERT_THROW(
+        host_matrix.row_indices.size() ==
+                index.get<std::uint64_t>(rank_index + ".n_local_rows") &&
+            host_matrix.column_indices.size() ==
+                index.get<std::uint64_t>(rank_index + ".n_local_columns"),
+        filename + "." + std::to_string(rank) + " does not match " +
+            filename + ".index");
+  });
+  // The files of all the processors must describe the same partition
+  std::uint64_t const n_local_rows = host_matrix.row_indices.size();
+  std::uint64_t const n_local_columns = host_matrix.column_indices.size();
+  ASSERT_THROW(
+      dealii::Utilities::MPI::sum(n_local_rows, comm) == host_matrix.m &&
+          dealii::Utilities::MPI::sum(n_local_columns, comm) == host_matrix.n,
+      "The files " + filename + ".* do not describe a partition of the matrix");
+
+  dealii::IndexSet locally_owned_rows(host_matrix.m);
+  locally_owned_rows.add_indices(host_matrix.row_indices.begin(),
+                                 host_matrix.row_indices.end());
+  locally_owned_rows.compress();
+  dealii::IndexSet locally_owned_columns(host_matrix.n);
+  locally_owned_columns.add_indices(host_matrix.column_indices.begin(),
+                                    host_matrix.column_indices.end());
+  locally_owned_columns.compress();
+
+  // The sparsity pattern is known from the file so the matrix is built once
+  // and its entries are only copied from the file
+  std::vector<dealii::types::global_dof_index> n_entries_per_row(n_local_rows);
+  for (std::size_t i = 0; i < n_local_rows; ++i)
+    n_entries_per_row[i] = host_matrix.row_ptr[i + 1] - host_matrix.row_ptr[i];
+  // The columns are converted to the index type of Trilinos row by row
+  std::vector<dealii::types::global_dof_index> row_columns;
+  auto const extract_row_columns = [&](std::size_t const i) {
+    auto const columns_begin = host_matrix.columns.begin();
+    row_columns.assign(columns_begin + host_matrix.row_ptr[i],
+                       columns_begin + host_matrix.row_ptr[i + 1]);
+  };
+  dealii::TrilinosWrappers::SparsityPattern sparsity_pattern(
+      locally_owned_rows, locally_owned_columns, comm, n_entries_per_row);
+  for (std::size_t i = 0; i < n_local_rows; ++i)
+  {
+    extract_row_columns(i);
+    sparsity_pattern.add_entries(host_matrix.row_indices[i],
+                                 row_columns.begin(), row_columns.end());
+  }
+  sparsity_pattern.compress();
+
+  matrix.reinit(sparsity_pattern);
+  for (std::size_t i = 0; i < n_local_rows; ++i)
+  {
+    extract_row_columns(i);
+    matrix.set(host_matrix.row_indices[i], row_columns.size(),
+               row_columns.data(),
+               host_matrix.values.data() + host_matrix.row_ptr[i], false);
+  }
+  matrix.compress(dealii::VectorOperation::insert);
+}
+
+void binary_vector_output_file(
+    std::string const &filename,
+    dealii::TrilinosWrappers::MPI::Vector const &vector)
+{
+  write_binary_vector_file(filename, vector.get_mpi_communicator(), vector);
+}
+
+void binary_vector_output_file(
+    std::string const &filename,
+    dealii::LinearAlgebra::distributed::Vector<double> const &vector)
+{
+  write_binary_vector_file(filename, vector.get_mpi_communicator(), vector);
+}
+
+void binary_vector_input_file(std::string const &filename, MPI_Comm comm,
+                              dealii::TrilinosWrappers::MPI::Vector &vector)
+{
+  read_binary_vector_file(filename, comm, vector);
+}
+
+void binary_vector_input_file(
+    std::string const &filename, MPI_Comm comm,
+    dealii::LinearAlgebra::distributed::Vector<double> &vector)
+{
+  read_binary_vector_file(filename, comm, vector);
+}
 } // namespace mfmg
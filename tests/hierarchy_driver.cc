@@ -10,15 +10,44 @@
  *************************************************************************/
 
 #include <mfmg/common/exceptions.hpp>
+#include <mfmg/common/memory.hpp>
+#include <mfmg/common/tracer.hpp>
 
 #include <deal.II/base/timer.h>
+#include <deal.II/base/utilities.h>
 
 #include <boost/program_options.hpp>
 
+#include <fstream>
+#include <sstream>
+
 #include "test_hierarchy_helpers.hpp"
 
+// Quantities measured during one run of the driver. The times are read from
+// the TimerOutput given to the run.
+struct RunResult
+{
+  dealii::types::global_dof_index n_dofs = 0;
+  unsigned int n_iterations = 0;
+};
+
+// Write the statistics collected during the setup of the hierarchy if the
+// user asked for them
+template <typename HierarchyType>
+void write_statistics(HierarchyType const &hierarchy,
+                      boost::property_tree::ptree const &params)
+{
+  auto const filename = params.get("statistics file", "");
+  if (!filename.empty() &&
+      dealii::Utilities::MPI::this_mpi_process(MPI_COMM_WORLD) == 0)
+    boost::property_tree::info_parser::write_info(filename,
+                                                  hierarchy.get_statistics());
+}
+
 template <int dim, int fe_degree>
-void matrix_free_two_grids(std::shared_ptr<boost::property_tree::ptree> params)
+RunResult
+matrix_free_two_grids(std::shared_ptr<boost::property_tree::ptree> params,
+                      std::shared_ptr<dealii::TimerOutput> timer)
 {
   // In case the operator was configured to act as a solver, i.e.
   // "is preconditioner" is false, we perform a set number of V-cycles and
@@ -34,11 +63,6 @@ void matrix_free_two_grids(std::shared_ptr<boost::property_tree::ptree> params)
   dealii::ConditionalOStream pcout(
       std::cout, dealii::Utilities::MPI::this_mpi_process(comm) == 0);
 
-  // Print a table with the timings when the destructor is called
-  auto timer = std::make_shared<dealii::TimerOutput>(
-      comm, pcout, dealii::TimerOutput::summary,
-      dealii::TimerOutput::wall_times);
-
   auto material_property =
       MaterialPropertyFactory<dim>::create_material_property(
           params->get<std::string>("material_property.type"));
@@ -71,7 +95,11 @@ void matrix_free_two_grids(std::shared_ptr<boost::property_tree::ptree> params)
           mf_laplace._laplace_operator, material_property);
 
   mfmg::Hierarchy<DVector> hierarchy(comm, evaluator, params, timer);
+  write_statistics(hierarchy, *params);
 
+  RunResult result;
+  result.n_dofs = solution.size();
+  mfmg::timer_enter_subsection(timer, "Solve");
   if (!test_preconditioner)
   {
     // We want to do 20 V-cycle iterations. The rhs of is zero.
@@ -96,6 +124,7 @@ void matrix_free_two_grids(std::shared_ptr<boost::property_tree::ptree> params)
       res[i + 1] = rel_residual;
     }
 
+    result.n_iterations = n_cycles;
     double const conv_rate = res[n_cycles] / res[n_cycles - 1];
     pcout << "Convergence rate: " << std::fixed << std::setprecision(2)
           << conv_rate << std::endl;
@@ -111,13 +140,19 @@ void matrix_free_two_grids(std::shared_ptr<boost::property_tree::ptree> params)
     solver.solve(mf_laplace._laplace_operator, solution, rhs,
                  //                 dealii::PreconditionIdentity()
                  hierarchy);
+    result.n_iterations = solver_control.last_step();
     pcout << "Converging after " << solver_control.last_step()
           << " iterations.\n";
   }
+  mfmg::timer_leave_subsection(timer);
+
+  return result;
 }
 
 template <int dim>
-void matrix_based_two_grids(std::shared_ptr<boost::property_tree::ptree> params)
+RunResult
+matrix_based_two_grids(std::shared_ptr<boost::property_tree::ptree> params,
+                       std::shared_ptr<dealii::TimerOutput> timer)
 {
   bool const test_preconditioner = params->get<bool>("is preconditioner");
 
@@ -129,11 +164,6 @@ void matrix_based_two_grids(std::shared_ptr<boost::property_tree::ptree> params)
   dealii::ConditionalOStream pcout(
       std::cout, dealii::Utilities::MPI::this_mpi_process(comm) == 0);
 
-  // Print a table with the timings when the destructor is called
-  auto timer = std::make_shared<dealii::TimerOutput>(
-      comm, pcout, dealii::TimerOutput::summary,
-      dealii::TimerOutput::wall_times);
-
   auto material_property =
       MaterialPropertyFactory<dim>::create_material_property(
           params->get<std::string>("material_property.type"));
@@ -168,7 +198,11 @@ void matrix_based_two_grids(std::shared_ptr<boost::property_tree::ptree> params)
           laplace._dof_handler, laplace._constraints, fe_degree, a,
           material_property));
   mfmg::Hierarchy<DVector> hierarchy(comm, evaluator, params, timer);
+  write_statistics(hierarchy, *params);
 
+  RunResult result;
+  result.n_dofs = solution.size();
+  mfmg::timer_enter_subsection(timer, "Solve");
   if (!test_preconditioner)
   {
     // We want to do 20 V-cycle iterations. The rhs of is zero.
@@ -193,6 +227,7 @@ void matrix_based_two_grids(std::shared_ptr<boost::property_tree::ptree> params)
       res[i + 1] = rel_residual;
     }
 
+    result.n_iterations = n_cycles;
     double const conv_rate = res[n_cycles] / res[n_cycles - 1];
     pcout << "Convergence rate: " << std::fixed << std::setprecision(2)
           << conv_rate << std::endl;
@@ -208,9 +243,136 @@ void matrix_based_two_grids(std::shared_ptr<boost::property_tree::ptree> params)
     solver.solve(a, solution, rhs,
                  //                 dealii::PreconditionIdentity()
                  hierarchy);
+    result.n_iterations = solver_control.last_step();
     pcout << "Converging after " << solver_control.last_step()
           << " iterations.\n";
   }
+  mfmg::timer_leave_subsection(timer);
+
+  return result;
+}
+
+// Write the results of one repetition of the benchmark mode. Every quantity is
+// reduced over the processors and written as one CSV row with its minimum,
+// maximum, and average. The memory high-water mark is the peak resident set
+// size during this repetition if \p peak_memory_reset is true and since the
+// start of the process otherwise.
+void write_benchmark_results(std::ostream &out, unsigned int n_refinements,
+                             unsigned int repetition, RunResult const &result,
+                             dealii::TimerOutput const &timer,
+                             bool peak_memory_reset)
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+
+  auto const phase_times =
+      timer.get_summary_data(dealii::TimerOutput::total_wall_time);
+  double const setup_time = phase_times.at("Setup");
+  double const solve_time = phase_times.at("Solve");
+
+  // The sections are entered collectively so every processor has the same
+  // phases in the same order
+  std::vector<std::pair<std::string, double>> quantities(phase_times.begin(),
+                                                         phase_times.end());
+  quantities.emplace_back("iterations", result.n_iterations);
+  quantities.emplace_back("time per iteration",
+                          result.n_iterations > 0
+                              ? solve_time / result.n_iterations
+                              : 0.);
+  quantities.emplace_back("setup DoFs/s", result.n_dofs / setup_time);
+  quantities.emplace_back("solve DoFs/s", result.n_dofs / solve_time);
+  quantities.emplace_back(peak_memory_reset
+                              ? "memory high-water mark (MB)"
+                              : "process memory high-water mark (MB)",
+                          mfmg::get_measured_peak_memory_usage() /
+                              (1024. * 1024.));
+
+  for (auto const &quantity : quantities)
+  {
+    auto const stats =
+        dealii::Utilities::MPI::min_max_avg(quantity.second, comm);
+    if (dealii::Utilities::MPI::this_mpi_process(comm) == 0)
+      out << dealii::Utilities::MPI::n_mpi_processes(comm) << ","
+          << dealii::MultithreadInfo::n_threads() << "," << n_refinements
+          << "," << result.n_dofs << "," << repetition << ",\""
+          << quantity.first << "\"," << stats.min << "," << stats.max << ","
+          << stats.avg << std::endl;
+  }
+}
+
+// Run the driver once with the timings collected by timer
+RunResult run_two_grids(int dim, bool matrix_free,
+                        std::shared_ptr<boost::property_tree::ptree> params,
+                        std::shared_ptr<dealii::TimerOutput> timer)
+{
+  if (matrix_free)
+  {
+    int const fe_degree = params->get<unsigned int>("laplace.fe_degree", 4);
+    if (dim == 2)
+    {
+      switch (fe_degree)
+      {
+      case 1:
+        return matrix_free_two_grids<2, 1>(params, timer);
+      case 2:
+        return matrix_free_two_grids<2, 2>(params, timer);
+      case 3:
+        return matrix_free_two_grids<2, 3>(params, timer);
+      case 4:
+        return matrix_free_two_grids<2, 4>(params, timer);
+      case 5:
+        return matrix_free_two_grids<2, 5>(params, timer);
+      case 6:
+        return matrix_free_two_grids<2, 6>(params, timer);
+      case 7:
+        return matrix_free_two_grids<2, 7>(params, timer);
+      case 8:
+        return matrix_free_two_grids<2, 8>(params, timer);
+      case 9:
+        return matrix_free_two_grids<2, 9>(params, timer);
+      case 10:
+        return matrix_free_two_grids<2, 10>(params, timer);
+      default:
+        mfmg::ASSERT(false, "The fe_degree should be between 1 and 10");
+      }
+    }
+    else
+    {
+      switch (fe_degree)
+      {
+      case 1:
+        return matrix_free_two_grids<3, 1>(params, timer);
+      case 2:
+        return matrix_free_two_grids<3, 2>(params, timer);
+      case 3:
+        return matrix_free_two_grids<3, 3>(params, timer);
+      case 4:
+        return matrix_free_two_grids<3, 4>(params, timer);
+      case 5:
+        return matrix_free_two_grids<3, 5>(params, timer);
+      case 6:
+        return matrix_free_two_grids<3, 6>(params, timer);
+      case 7:
+        return matrix_free_two_grids<3, 7>(params, timer);
+      case 8:
+        return matrix_free_two_grids<3, 8>(params, timer);
+      case 9:
+        return matrix_free_two_grids<3, 9>(params, timer);
+      case 10:
+        return matrix_free_two_grids<3, 10>(params, timer);
+      default:
+        mfmg::ASSERT(false, "The fe_degree should be between 1 and 10");
+      }
+    }
+
+    return RunResult();
+  }
+  else
+  {
+    if (dim == 2)
+      return matrix_based_two_grids<2>(params, timer);
+    else
+      return matrix_based_two_grids<3>(params, timer);
+  }
 }
 
 int main(int argc, char *argv[])
@@ -228,6 +390,23 @@ int main(int argc, char *argv[])
                     "use matrix-free algorithm");
   cmd.add_options()("tolerance,t", boost_po::value<double>(),
                     "tolerance to use for the solver");
+  cmd.add_options()("statistics", boost_po::value<std::string>(),
+                    "write the statistics of the setup to file");
+  cmd.add_options()("trace", boost_po::value<std::string>(),
+                    "write a Chrome trace of the setup and the solve to file");
+  cmd.add_options()("refinements,r",
+                    boost_po::value<std::vector<unsigned int>>()->multitoken(),
+                    "numbers of global refinements to run one after the other");
+  cmd.add_options()("set,s",
+                    boost_po::value<std::vector<std::string>>()->multitoken(),
+                    "override input parameters, e.g. smoother.type=Jacobi");
+  cmd.add_options()("benchmark,b", boost_po::value<std::string>(),
+                    "repeat the setup and the solve and write the timings, "
+                    "iterations, throughput, and memory to a CSV file");
+  cmd.add_options()("warmup", boost_po::value<unsigned int>(),
+                    "number of untimed runs in benchmark mode (default: 1)");
+  cmd.add_options()("repetitions", boost_po::value<unsigned int>(),
+                    "number of timed runs in benchmark mode (default: 3)");
 
   boost_po::variables_map vm;
   boost_po::store(boost_po::parse_command_line(argc, argv, cmd), vm);
@@ -266,7 +445,6 @@ int main(int argc, char *argv[])
     }
   }
 
-  int const fe_degree = params->get<unsigned int>("laplace.fe_degree", 4);
   params->put("fast_ap", true);
   params->put("eigensolver.type", "anasazi");
   params->put("eigensolver.tolerance", 1e-3);
@@ -278,162 +456,99 @@ int main(int argc, char *argv[])
   }
   params->put("solver.tolerance", solver_tolerance);
 
-  std::cout << "input file: " << filename << ", dimension: " << dim
-            << ", matrix-free: " << matrix_free << ", fe_degree: " << fe_degree
-            << ", solver_tolerance: " << solver_tolerance << std::endl;
+  if (vm.count("statistics"))
+    params->put("statistics file", vm["statistics"].as<std::string>());
 
   if (matrix_free)
-  {
     params->put("smoother.type", "Chebyshev");
-    if (dim == 2)
-    {
-      switch (fe_degree)
-      {
-      case 1:
-      {
-        matrix_free_two_grids<2, 1>(params);
-
-        break;
-      }
-      case 2:
-      {
-        matrix_free_two_grids<2, 2>(params);
-
-        break;
-      }
-      case 3:
-      {
-        matrix_free_two_grids<2, 3>(params);
-
-        break;
-      }
-      case 4:
-      {
-        matrix_free_two_grids<2, 4>(params);
 
-        break;
-      }
-      case 5:
-      {
-        matrix_free_two_grids<2, 5>(params);
+  // The overrides are applied last so that they take precedence over the
+  // values set above
+  if (vm.count("set"))
+    for (auto const &key_value : vm["set"].as<std::vector<std::string>>())
+    {
+      auto const pos = key_value.find('=');
+      mfmg::ASSERT_THROW(pos != std::string::npos,
+                         "Overrides must be of the form key=value, not " +
+                             key_value);
+      params->put(key_value.substr(0, pos), key_value.substr(pos + 1));
+    }
 
-        break;
-      }
-      case 6:
-      {
-        matrix_free_two_grids<2, 6>(params);
+  int const fe_degree = params->get<unsigned int>("laplace.fe_degree", 4);
+  std::vector<unsigned int> refinements = {
+      params->get<unsigned int>("laplace.n_refinements")};
+  if (vm.count("refinements"))
+    refinements = vm["refinements"].as<std::vector<unsigned int>>();
 
-        break;
-      }
-      case 7:
-      {
-        matrix_free_two_grids<2, 7>(params);
+  std::cout << "input file: " << filename << ", dimension: " << dim
+            << ", matrix-free: " << matrix_free << ", fe_degree: " << fe_degree
+            << ", solver_tolerance: " << solver_tolerance << std::endl;
 
-        break;
-      }
-      case 8:
-      {
-        matrix_free_two_grids<2, 8>(params);
+  if (!matrix_free)
+    dealii::MultithreadInfo::set_thread_limit(1);
 
-        break;
-      }
-      case 9:
-      {
-        matrix_free_two_grids<2, 9>(params);
+  if (vm.count("trace"))
+    mfmg::Tracer::enable(MPI_COMM_WORLD);
 
-        break;
-      }
-      case 10:
-      {
-        matrix_free_two_grids<2, 10>(params);
+  MPI_Comm comm = MPI_COMM_WORLD;
+  bool const is_rank_zero = dealii::Utilities::MPI::this_mpi_process(comm) == 0;
+  dealii::ConditionalOStream pcout(std::cout, is_rank_zero);
 
-        break;
-      }
-      default:
-      {
-        mfmg::ASSERT(false, "The fe_degree should be between 1 and 10");
-      }
-      }
+  if (vm.count("benchmark"))
+  {
+    // Strong scaling: run with a fixed list of refinements and different
+    // numbers of processors. Weak scaling: increase the number of
+    // refinements with the number of processors.
+    unsigned int n_warmup = 1;
+    if (vm.count("warmup"))
+      n_warmup = vm["warmup"].as<unsigned int>();
+    unsigned int n_repetitions = 3;
+    if (vm.count("repetitions"))
+      n_repetitions = vm["repetitions"].as<unsigned int>();
+
+    std::ofstream benchmark_file;
+    if (is_rank_zero)
+    {
+      benchmark_file.open(vm["benchmark"].as<std::string>());
+      benchmark_file << "n_processes,n_threads,n_refinements,n_dofs,"
+                        "repetition,quantity,min,max,mean"
+                     << std::endl;
     }
-    else
+    for (auto const n_refinements : refinements)
     {
-      switch (fe_degree)
-      {
-      case 1:
-      {
-        matrix_free_two_grids<3, 1>(params);
-
-        break;
-      }
-      case 2:
-      {
-        matrix_free_two_grids<3, 2>(params);
-
-        break;
-      }
-      case 3:
-      {
-        matrix_free_two_grids<3, 3>(params);
-
-        break;
-      }
-      case 4:
-      {
-        matrix_free_two_grids<3, 4>(params);
-
-        break;
-      }
-      case 5:
+      params->put("laplace.n_refinements", n_refinements);
+      for (unsigned int i = 0; i < n_warmup + n_repetitions; ++i)
       {
-        matrix_free_two_grids<3, 5>(params);
-
-        break;
-      }
-      case 6:
-      {
-        matrix_free_two_grids<3, 6>(params);
-
-        break;
-      }
-      case 7:
-      {
-        matrix_free_two_grids<3, 7>(params);
-
-        break;
-      }
-      case 8:
-      {
-        matrix_free_two_grids<3, 8>(params);
-
-        break;
-      }
-      case 9:
-      {
-        matrix_free_two_grids<3, 9>(params);
-
-        break;
-      }
-      case 10:
-      {
-        matrix_free_two_grids<3, 10>(params);
-
-        break;
-      }
-      default:
-      {
-        mfmg::ASSERT(false, "The fe_degree should be between 1 and 10");
-      }
+        // Collect the local timings of each processor. They are reduced when
+        // the results are written.
+        std::ostringstream timer_stream;
+        auto timer = std::make_shared<dealii::TimerOutput>(
+            timer_stream, dealii::TimerOutput::never,
+            dealii::TimerOutput::wall_times);
+        bool const peak_memory_reset = mfmg::start_peak_memory_measurement();
+        auto const result = run_two_grids(dim, matrix_free, params, timer);
+        if (i >= n_warmup)
+          write_benchmark_results(benchmark_file, n_refinements, i - n_warmup,
+                                  result, *timer, peak_memory_reset);
       }
     }
   }
   else
   {
-    dealii::MultithreadInfo::set_thread_limit(1);
-    if (dim == 2)
-      matrix_based_two_grids<2>(params);
-    else
-      matrix_based_two_grids<3>(params);
+    for (auto const n_refinements : refinements)
+    {
+      params->put("laplace.n_refinements", n_refinements);
+      // Print a table with the timings when the destructor is called
+      auto timer = std::make_shared<dealii::TimerOutput>(
+          comm, pcout, dealii::TimerOutput::summary,
+          dealii::TimerOutput::wall_times);
+      run_two_grids(dim, matrix_free, params, timer);
+    }
   }
 
+  if (vm.count("trace"))
+    mfmg::Tracer::write_chrome_trace(vm["trace"].as<std::string>(),
+                                     MPI_COMM_WORLD);
+
   return 0;
 }
@@ -0,0 +1,498 @@
+/**************************************************************************
+ * Copyright (c) 2017-2019 by the mfmg authors                            *
+ * All rights reserved.                                                   *
+ *                                                                        *
+ * This file is part of the mfmg library. mfmg is distributed under a BSD *
+ * 3-clause license. For the licensing terms see the LICENSE file in the  *
+ * top-level directory                                                    *
+ *                                                                        *
+ * SPDX-License-Identifier: BSD-3-Clause                                  *
+ *************************************************************************/
+
+#include <mfmg/common/exceptions.hpp>
+#include <mfmg/dealii/amge_host.templates.hpp>
+#include <mfmg/dealii/dealii_hierarchy_helpers.hpp>
+#include <mfmg/dealii/dealii_trilinos_matrix_operator.hpp>
+
+#include <deal.II/base/multithread_info.h>
+#include <deal.II/base/parallel.h>
+
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <memory>
+#include <numeric>
+#include <sstream>
+
+#include "test_hierarchy_helpers.hpp"
+
+// Microbenchmarks of the stages of the AMGe setup. Every stage is run on the
+// same problem for a sweep over the dimension, the finite element degree, the
+// number of threads, and the size of the agglomerates. Each measurement is
+// written as one CSV row so that the results of two builds can be joined on
+// the configuration columns and compared.
+
+using DVector = dealii::LinearAlgebra::distributed::Vector<double>;
+
+struct Configuration
+{
+  int dim;
+  unsigned int fe_degree;
+  unsigned int n_threads;
+  unsigned int agglomerate_size;
+  unsigned int n_refinements;
+};
+
+class BenchmarkRunner
+{
+public:
+  BenchmarkRunner(MPI_Comm comm, unsigned int n_warmup,
+                  unsigned int n_repetitions,
+                  std::vector<std::string> const &stages,
+                  std::string const &output_filename)
+      : _comm(comm), _n_warmup(n_warmup), _n_repetitions(n_repetitions),
+        _stages(stages)
+  {
+    mfmg::ASSERT(_n_repetitions > 0, "The number of repetitions must be > 0");
+    if (dealii::Utilities::MPI::this_mpi_process(_comm) == 0)
+    {
+      if (!output_filename.empty())
+        _file.open(output_filename);
+      write_row("stage,variant,dim,fe_degree,n_threads,agglomerate_size,"
+                "n_refinements,n_processes,n_items,repetitions,min,median,"
+                "mean,max");
+    }
+  }
+
+  /**
+   * Return true if \p stage has been selected on the command line.
+   */
+  bool is_selected(std::string const &stage) const
+  {
+    return _stages.empty() ||
+           std::find(_stages.begin(), _stages.end(), stage) != _stages.end();
+  }
+
+  /**
+   * Call \p function n_warmup times and then n_repetitions times. The time of
+   * a repetition is the maximum over all the processors. \p n_items is the
+   * local number of items, e.g. agglomerates, processed by \p function.
+   */
+  void run(Configuration const &config, std::string const &stage,
+           std::string const &variant, unsigned int n_items,
+           std::function<void()> const &function)
+  {
+    if (!is_selected(stage))
+      return;
+
+    for (unsigned int i = 0; i < _n_warmup; ++i)
+      function();
+
+    std::vector<double> times(_n_repetitions);
+    for (auto &time : times)
+    {
+      MPI_Barrier(_comm);
+      auto const start = std::chrono::steady_clock::now();
+      function();
+      std::chrono::duration<double> const elapsed =
+          std::chrono::steady_clock::now() - start;
+      time = dealii::Utilities::MPI::max(elapsed.count(), _comm);
+    }
+    unsigned long long const global_n_items =
+        dealii::Utilities::MPI::sum(static_cast<unsigned long long>(n_items),
+                                    _comm);
+
+    std::sort(times.begin(), times.end());
+    double const median =
+        (times[(_n_repetitions - 1) / 2] + times[_n_repetitions / 2]) / 2.;
+    double const mean =
+        std::accumulate(times.begin(), times.end(), 0.) / _n_repetitions;
+
+    if (dealii::Utilities::MPI::this_mpi_process(_comm) == 0)
+    {
+      std::ostringstream row;
+      row << stage << "," << variant << "," << config.dim << ","
+          << config.fe_degree << "," << config.n_threads << ","
+          << config.agglomerate_size << "," << config.n_refinements << ","
+          << dealii::Utilities::MPI::n_mpi_processes(_comm) << ","
+          << global_n_items << "," << _n_repetitions << std::scientific
+          << std::setprecision(6) << "," << times.front() << "," << median
+          << "," << mean << "," << times.back();
+      write_row(row.str());
+    }
+  }
+
+private:
+  void write_row(std::string const &row)
+  {
+    std::cout << row << std::endl;
+    if (_file.is_open())
+      _file << row << std::endl;
+  }
+
+  MPI_Comm _comm;
+  unsigned int _n_warmup;
+  unsigned int _n_repetitions;
+  std::vector<std::string> _stages;
+  std::ofstream _file;
+};
+
+// Call function(i) for i in [0, n) using all the threads
+template <typename Function>
+void parallel_for(unsigned int n, Function const &function)
+{
+  dealii::parallel::apply_to_subranges(
+      0U, n,
+      [&](unsigned int const begin, unsigned int const end) {
+        for (unsigned int i = begin; i < end; ++i)
+          function(i);
+      },
+      1);
+}
+
+template <int dim>
+void benchmark_amge(Configuration const &config, BenchmarkRunner &runner,
+                    unsigned int n_eigenvectors, double tolerance)
+{
+  using MeshEvaluator = mfmg::DealIIMeshEvaluator<dim>;
+  using Map =
+      std::map<typename dealii::Triangulation<dim>::active_cell_iterator,
+               typename dealii::DoFHandler<dim>::active_cell_iterator>;
+
+  MPI_Comm comm = MPI_COMM_WORLD;
+  dealii::MultithreadInfo::set_thread_limit(config.n_threads);
+
+  auto material_property =
+      MaterialPropertyFactory<dim>::create_material_property("constant");
+  Source<dim> source;
+
+  boost::property_tree::ptree laplace_ptree;
+  laplace_ptree.put("n_refinements", config.n_refinements);
+  Laplace<dim, DVector> laplace(comm, config.fe_degree);
+  laplace.setup_system(laplace_ptree);
+  laplace.assemble_system(source, *material_property);
+
+  auto evaluator = std::make_shared<TestMeshEvaluator<MeshEvaluator>>(
+      laplace._dof_handler, laplace._constraints, config.fe_degree,
+      laplace._system_matrix, material_property);
+
+  // Agglomeration
+  boost::property_tree::ptree block_params;
+  block_params.put("partitioner", "block");
+  block_params.put("nx", config.agglomerate_size);
+  block_params.put("ny", config.agglomerate_size);
+  block_params.put("nz", config.agglomerate_size);
+
+  mfmg::AMGe_host<dim, MeshEvaluator, DVector> amge(comm,
+                                                    laplace._dof_handler);
+  unsigned int const n_agglomerates = amge.build_agglomerates(block_params);
+  unsigned int n_cells = 0;
+  for (auto const &cell : laplace._dof_handler.active_cell_iterators())
+    if (cell->is_locally_owned())
+      ++n_cells;
+
+  std::vector<std::string> partitioners = {"block"};
+#ifdef DEAL_II_WITH_METIS
+  partitioners.push_back("metis");
+#endif
+#ifdef DEAL_II_TRILINOS_WITH_ZOLTAN
+  partitioners.push_back("zoltan");
+#endif
+  for (auto const &partitioner : partitioners)
+  {
+    // The graph partitioners are asked for as many agglomerates as the block
+    // partitioner creates so that the agglomerates have similar sizes
+    boost::property_tree::ptree params = block_params;
+    if (partitioner != "block")
+    {
+      params.clear();
+      params.put("partitioner", partitioner);
+      params.put("n_agglomerates", n_agglomerates);
+    }
+    runner.run(config, "build_agglomerates", partitioner, n_cells,
+               [&]() { amge.build_agglomerates(params); });
+  }
+  // The following stages use the block agglomerates
+  amge.build_agglomerates(block_params);
+
+  runner.run(config, "build_agglomerate_triangulation", "", n_agglomerates,
+             [&]() {
+               parallel_for(n_agglomerates, [&](unsigned int i) {
+                 dealii::Triangulation<dim> agglomerate_triangulation;
+                 Map agglomerate_to_global_tria_map;
+                 amge.build_agglomerate_triangulation(
+                     i + 1, agglomerate_triangulation,
+                     agglomerate_to_global_tria_map);
+               });
+             });
+
+  // Build the triangulations once for the following stages
+  std::vector<std::unique_ptr<dealii::Triangulation<dim>>> triangulations(
+      n_agglomerates);
+  std::vector<Map> maps(n_agglomerates);
+  parallel_for(n_agglomerates, [&](unsigned int i) {
+    triangulations[i] = std::make_unique<dealii::Triangulation<dim>>();
+    amge.build_agglomerate_triangulation(i + 1, *triangulations[i], maps[i]);
+  });
+
+  runner.run(config, "evaluate_agglomerate", "", n_agglomerates, [&]() {
+    parallel_for(n_agglomerates, [&](unsigned int i) {
+      dealii::DoFHandler<dim> agglomerate_dof_handler(*triangulations[i]);
+      dealii::AffineConstraints<double> agglomerate_constraints;
+      dealii::SparsityPattern agglomerate_sparsity_pattern;
+      dealii::SparseMatrix<double> agglomerate_system_matrix;
+      evaluator->evaluate_agglomerate(
+          agglomerate_dof_handler, agglomerate_constraints,
+          agglomerate_sparsity_pattern, agglomerate_system_matrix);
+    });
+  });
+
+  // Eigensolvers
+  mfmg::LobpcgScratchData const scratch_data;
+  for (std::string const eigensolver : {"lanczos", "anasazi", "arpack",
+                                        "lapack"})
+  {
+    boost::property_tree::ptree eigensolver_params;
+    eigensolver_params.put("type", eigensolver);
+    eigensolver_params.put("number of eigenvectors", n_eigenvectors);
+    eigensolver_params.put("tolerance", tolerance);
+    mfmg::AMGe_host<dim, MeshEvaluator, DVector> eigensolver_amge(
+        comm, laplace._dof_handler, eigensolver_params);
+    runner.run(config, "eigensolver", eigensolver, n_agglomerates, [&]() {
+      parallel_for(n_agglomerates, [&](unsigned int i) {
+        eigensolver_amge.compute_local_eigenvectors(
+            n_eigenvectors, tolerance, *triangulations[i], maps[i], *evaluator,
+            scratch_data);
+      });
+    });
+  }
+
+  // Restriction matrix. The eigenvectors are computed with the default
+  // eigensolver.
+  std::vector<dealii::Vector<double>> eigenvectors;
+  std::vector<std::vector<double>> diag_elements;
+  std::vector<std::vector<dealii::types::global_dof_index>> dof_indices_maps;
+  std::vector<unsigned int> n_local_eigenvectors;
+  for (unsigned int i = 0; i < n_agglomerates; ++i)
+  {
+    std::vector<std::complex<double>> local_eigenvalues;
+    std::vector<dealii::Vector<double>> local_eigenvectors;
+    std::vector<double> local_diag_elements;
+    std::vector<dealii::types::global_dof_index> local_dof_indices_map;
+    std::tie(local_eigenvalues, local_eigenvectors, local_diag_elements,
+             local_dof_indices_map) =
+        amge.compute_local_eigenvectors(n_eigenvectors, tolerance,
+                                        *triangulations[i], maps[i],
+                                        *evaluator, scratch_data);
+    eigenvectors.insert(eigenvectors.end(), local_eigenvectors.begin(),
+                        local_eigenvectors.end());
+    diag_elements.push_back(local_diag_elements);
+    dof_indices_maps.push_back(local_dof_indices_map);
+    n_local_eigenvectors.push_back(local_eigenvectors.size());
+  }
+  auto const locally_relevant_global_diag = evaluator->get_diagonal();
+
+  runner.run(config, "compute_restriction_sparse_matrix", "", n_agglomerates,
+             [&]() {
+               dealii::TrilinosWrappers::SparseMatrix restriction_matrix;
+               amge.compute_restriction_sparse_matrix(
+                   eigenvectors, diag_elements, dof_indices_maps,
+                   n_local_eigenvectors, locally_relevant_global_diag,
+                   restriction_matrix);
+             });
+
+  // Coarse operator
+  mfmg::DealIIHierarchyHelpers<dim, DVector> hierarchy_helpers;
+  auto const a = hierarchy_helpers.get_global_operator(evaluator);
+  auto restriction_matrix =
+      std::make_shared<dealii::TrilinosWrappers::SparseMatrix>();
+  amge.compute_restriction_sparse_matrix(
+      eigenvectors, diag_elements, dof_indices_maps, n_local_eigenvectors,
+      locally_relevant_global_diag, *restriction_matrix);
+  std::shared_ptr<mfmg::Operator<DVector> const> restrictor =
+      std::make_shared<mfmg::DealIITrilinosMatrixOperator<DVector>>(
+          restriction_matrix);
+  runner.run(config, "rap", "", n_agglomerates, [&]() {
+    auto ap = a->multiply_transpose(restrictor);
+    auto a_coarse = restrictor->multiply(ap);
+  });
+
+  // fast_ap moves part of the work of the product into build_restrictor() so
+  // both variants time the restrictor and the coarse operator together.
+  for (bool const fast_ap : {false, true})
+  {
+    auto params = std::make_shared<boost::property_tree::ptree>();
+    params->put("eigensolver.number of eigenvectors", n_eigenvectors);
+    params->put("eigensolver.tolerance", tolerance);
+    params->put_child("agglomeration", block_params);
+    params->put("fast_ap", fast_ap);
+    runner.run(config, "fast_ap", fast_ap ? "fast_ap" : "standard",
+               n_agglomerates, [&]() {
+                 auto r = hierarchy_helpers.build_restrictor(comm, evaluator,
+                                                             params);
+                 auto ap = fast_ap
+                               ? hierarchy_helpers.fast_multiply_transpose()
+                               : a->multiply_transpose(r);
+                 auto a_coarse = r->multiply(ap);
+               });
+  }
+}
+
+// Time the graph partitioners on a mesh with at least n_cells locally owned
+// cells per processor, e.g. 10^6, which is too large for the other stages
+template <int dim>
+void benchmark_partitioners(BenchmarkRunner &runner, unsigned int n_cells,
+                            unsigned int agglomerate_size)
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  dealii::MultithreadInfo::set_thread_limit(1);
+
+  unsigned long long const n_global_cells =
+      static_cast<unsigned long long>(n_cells) *
+      dealii::Utilities::MPI::n_mpi_processes(comm);
+  unsigned int n_refinements = 0;
+  while ((1ULL << (dim * n_refinements)) < n_global_cells)
+    ++n_refinements;
+
+  dealii::parallel::distributed::Triangulation<dim> triangulation(comm);
+  dealii::GridGenerator::hyper_cube(triangulation);
+  triangulation.refine_global(n_refinements);
+  dealii::FE_Q<dim> fe(1);
+  dealii::DoFHandler<dim> dof_handler(triangulation);
+  dof_handler.distribute_dofs(fe);
+
+  mfmg::AMGe_host<dim, mfmg::DealIIMeshEvaluator<dim>, DVector> amge(
+      comm, dof_handler);
+  unsigned int const n_local_cells =
+      triangulation.n_locally_owned_active_cells();
+  unsigned int n_cells_per_agglomerate = 1;
+  for (int d = 0; d < dim; ++d)
+    n_cells_per_agglomerate *= agglomerate_size;
+  unsigned int const n_agglomerates =
+      std::max(n_local_cells / n_cells_per_agglomerate, 1U);
+
+  Configuration const config = {dim, 1, 1, agglomerate_size, n_refinements};
+  std::vector<std::string> partitioners;
+#ifdef DEAL_II_WITH_METIS
+  partitioners.push_back("metis");
+#endif
+#ifdef DEAL_II_TRILINOS_WITH_ZOLTAN
+  partitioners.push_back("zoltan");
+#endif
+  for (auto const &partitioner : partitioners)
+  {
+    boost::property_tree::ptree params;
+    params.put("partitioner", partitioner);
+    params.put("n_agglomerates", n_agglomerates);
+    runner.run(config, "build_agglomerates_large", partitioner, n_local_cells,
+               [&]() { amge.build_agglomerates(params); });
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  namespace boost_po = boost::program_options;
+
+  dealii::Utilities::MPI::MPI_InitFinalize mpi_init(argc, argv);
+
+  boost_po::options_description cmd("Available options");
+  cmd.add_options()("help,h", "produce help message");
+  cmd.add_options()("dim,d", boost_po::value<std::vector<int>>()->multitoken(),
+                    "dimensions (default: 2 3)");
+  cmd.add_options()("degree",
+                    boost_po::value<std::vector<unsigned int>>()->multitoken(),
+                    "finite element degrees (default: 1 2)");
+  cmd.add_options()("threads",
+                    boost_po::value<std::vector<unsigned int>>()->multitoken(),
+                    "numbers of threads (default: 1 and all the threads)");
+  cmd.add_options()("agglomerate-size",
+                    boost_po::value<std::vector<unsigned int>>()->multitoken(),
+                    "number of cells per direction in an agglomerate "
+                    "(default: 2 3 4)");
+  cmd.add_options()("refinements,r", boost_po::value<unsigned int>(),
+                    "number of global refinements (default: 4)");
+  cmd.add_options()("eigenvectors", boost_po::value<unsigned int>(),
+                    "number of eigenvectors per agglomerate (default: 2)");
+  cmd.add_options()("tolerance", boost_po::value<double>(),
+                    "tolerance of the eigensolvers (default: 1e-6)");
+  cmd.add_options()("stage",
+                    boost_po::value<std::vector<std::string>>()->multitoken(),
+                    "stages to run: build_agglomerates, "
+                    "build_agglomerate_triangulation, evaluate_agglomerate, "
+                    "eigensolver, compute_restriction_sparse_matrix, rap, "
+                    "fast_ap, build_agglomerates_large (default: all)");
+  cmd.add_options()("large-cells", boost_po::value<unsigned int>(),
+                    "number of cells per processor of the mesh used by "
+                    "build_agglomerates_large (default: 1000000)");
+  cmd.add_options()("warmup", boost_po::value<unsigned int>(),
+                    "number of untimed runs of each stage (default: 1)");
+  cmd.add_options()("repetitions", boost_po::value<unsigned int>(),
+                    "number of timed runs of each stage (default: 5)");
+  cmd.add_options()("output,o", boost_po::value<std::string>(),
+                    "CSV file where the results are written");
+
+  boost_po::variables_map vm;
+  boost_po::store(boost_po::parse_command_line(argc, argv, cmd), vm);
+  boost_po::notify(vm);
+
+  if (vm.count("help"))
+  {
+    std::cout << cmd << std::endl;
+
+    return 0;
+  }
+
+  auto const get_list = [&](std::string const &option, auto default_value) {
+    return vm.count(option) ? vm[option].as<decltype(default_value)>()
+                            : default_value;
+  };
+  auto const dims = get_list("dim", std::vector<int>{2, 3});
+  auto const degrees = get_list("degree", std::vector<unsigned int>{1, 2});
+  auto const threads = get_list(
+      "threads", std::vector<unsigned int>{
+                     1, dealii::MultithreadInfo::n_threads()});
+  auto const agglomerate_sizes =
+      get_list("agglomerate-size", std::vector<unsigned int>{2, 3, 4});
+  auto const stages = get_list("stage", std::vector<std::string>{});
+  unsigned int const n_refinements = get_list("refinements", 4U);
+  unsigned int const n_eigenvectors = get_list("eigenvectors", 2U);
+  double const tolerance = get_list("tolerance", 1e-6);
+  unsigned int const n_large_cells = get_list("large-cells", 1000000U);
+  unsigned int const n_warmup = get_list("warmup", 1U);
+  unsigned int const n_repetitions = get_list("repetitions", 5U);
+  std::string const output_filename = get_list("output", std::string());
+
+  for (int const dim : dims)
+    mfmg::ASSERT(dim == 2 || dim == 3, "Dimension must be 2 or 3");
+
+  BenchmarkRunner runner(MPI_COMM_WORLD, n_warmup, n_repetitions, stages,
+                         output_filename);
+  for (int const dim : dims)
+    for (unsigned int const fe_degree : degrees)
+      for (unsigned int const n_threads : threads)
+        for (unsigned int const agglomerate_size : agglomerate_sizes)
+        {
+          Configuration const config = {dim, fe_degree, n_threads,
+                                        agglomerate_size, n_refinements};
+          if (dim == 2)
+            benchmark_amge<2>(config, runner, n_eigenvectors, tolerance);
+          else
+            benchmark_amge<3>(config, runner, n_eigenvectors, tolerance);
+        }
+
+  if (runner.is_selected("build_agglomerates_large"))
+    for (int const dim : dims)
+      for (unsigned int const agglomerate_size : agglomerate_sizes)
+      {
+        if (dim == 2)
+          benchmark_partitioners<2>(runner, n_large_cells, agglomerate_size);
+        else
+          benchmark_partitioners<3>(runner, n_large_cells, agglomerate_size);
+      }
+
+  return 0;
+}
@@ -0,0 +1,148 @@
+/**************************************************************************
+ * Copyright (c) 2017-2019 by the mfmg authors                            *
+ * All rights reserved.                                                   *
+ *                                                                        *
+ * This file is part of the mfmg library. mfmg is distributed under a BSD *
+ * 3-clause license. For the licensing terms see the LICENSE file in the  *
+ * top-level directory                                                    *
+ *                                                                        *
+ * SPDX-License-Identifier: BSD-3-Clause                                  *
+ *************************************************************************/
+
+#include <mfmg/common/exceptions.hpp>
+#include <mfmg/common/hierarchy.hpp>
+
+#include <deal.II/base/multithread_info.h>
+#include <deal.II/base/timer.h>
+
+#include <boost/program_options.hpp>
+
+#include "test_hierarchy_helpers.hpp"
+
+// Compare the application of the hierarchy to k right-hand sides one at a time
+// with the application to the k right-hand sides at once. For each k, we
+// report the time per right-hand side of both approaches.
+template <int dim>
+void benchmark_multi_rhs(std::shared_ptr<boost::property_tree::ptree> params,
+                         unsigned int n_cycles)
+{
+  using DVector = dealii::LinearAlgebra::distributed::Vector<double>;
+  using MeshEvaluator = mfmg::DealIIMeshEvaluator<dim>;
+
+  MPI_Comm comm = MPI_COMM_WORLD;
+
+  dealii::ConditionalOStream pcout(
+      std::cout, dealii::Utilities::MPI::this_mpi_process(comm) == 0);
+
+  auto material_property =
+      MaterialPropertyFactory<dim>::create_material_property(
+          params->get<std::string>("material_property.type"));
+  Source<dim> source;
+
+  auto const &laplace_ptree = params->get_child("laplace");
+  unsigned int const fe_degree = laplace_ptree.get("fe_degree", 1);
+  Laplace<dim, DVector> laplace(comm, fe_degree);
+  laplace.setup_system(laplace_ptree);
+  laplace.assemble_system(source, *material_property);
+
+  auto evaluator = std::make_shared<TestMeshEvaluator<MeshEvaluator>>(
+      laplace._dof_handler, laplace._constraints, fe_degree,
+      laplace._system_matrix, material_property);
+  mfmg::Hierarchy<DVector> hierarchy(comm, evaluator, params);
+
+  auto const &locally_owned_dofs = laplace._locally_owned_dofs;
+  std::default_random_engine generator;
+  std::uniform_real_distribution<double> distribution(0., 1.);
+
+  pcout << "n_dofs: " << laplace._system_matrix.m()
+        << ", n_threads: " << dealii::MultithreadInfo::n_threads()
+        << ", n_cycles: " << n_cycles << std::endl;
+
+  for (int const n_vectors : {1, 4, 16})
+  {
+    std::vector<std::shared_ptr<DVector>> b_vectors(n_vectors);
+    std::vector<std::shared_ptr<DVector>> x_vectors(n_vectors);
+    for (int k = 0; k < n_vectors; ++k)
+    {
+      b_vectors[k] = std::make_shared<DVector>(locally_owned_dofs, comm);
+      x_vectors[k] = std::make_shared<DVector>(locally_owned_dofs, comm);
+      for (auto const index : locally_owned_dofs)
+        if (!laplace._constraints.is_constrained(index))
+          (*b_vectors[k])[index] = distribution(generator);
+    }
+    mfmg::MultiVector<DVector> b(b_vectors);
+    mfmg::MultiVector<DVector> x(x_vectors);
+
+    dealii::Timer timer(comm, true);
+    for (unsigned int i = 0; i < n_cycles; ++i)
+      for (int k = 0; k < n_vectors; ++k)
+        hierarchy.vmult(*x[k], *b[k]);
+    timer.stop();
+    double const single_time = timer.last_wall_time() / (n_cycles * n_vectors);
+
+    timer.restart();
+    for (unsigned int i = 0; i < n_cycles; ++i)
+      hierarchy.vmult(x, b);
+    timer.stop();
+    double const block_time = timer.last_wall_time() / (n_cycles * n_vectors);
+
+    pcout << std::scientific << std::setprecision(3) << "k = " << n_vectors
+          << ": one at a time " << single_time << " s/rhs, block "
+          << block_time << " s/rhs, speedup " << std::fixed
+          << single_time / block_time << std::endl;
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  namespace boost_po = boost::program_options;
+
+  dealii::Utilities::MPI::MPI_InitFinalize mpi_init(argc, argv);
+
+  boost_po::options_description cmd("Available options");
+  cmd.add_options()("help,h", "produce help message");
+  cmd.add_options()("filename,f", boost_po::value<std::string>()->multitoken(),
+                    "file containing input parameters");
+  cmd.add_options()("dim,d", boost_po::value<int>(), "dimension");
+  cmd.add_options()("refinements,r", boost_po::value<unsigned int>(),
+                    "number of global refinements");
+  cmd.add_options()("cycles,c", boost_po::value<unsigned int>(),
+                    "number of V-cycles");
+
+  boost_po::variables_map vm;
+  boost_po::store(boost_po::parse_command_line(argc, argv, cmd), vm);
+  boost_po::notify(vm);
+
+  if (vm.count("help"))
+  {
+    std::cout << cmd << std::endl;
+
+    return 0;
+  }
+
+  std::string filename = {"hierarchy_input.info"};
+  if (vm.count("filename"))
+    filename = vm["filename"].as<std::string>();
+
+  int dim = 2;
+  if (vm.count("dim"))
+    dim = vm["dim"].as<int>();
+  mfmg::ASSERT(dim == 2 || dim == 3, "Dimension must be 2 or 3");
+
+  auto const params = std::make_shared<boost::property_tree::ptree>();
+  boost::property_tree::info_parser::read_info(filename, *params);
+
+  if (vm.count("refinements"))
+    params->put("laplace.n_refinements", vm["refinements"].as<unsigned int>());
+
+  unsigned int n_cycles = 10;
+  if (vm.count("cycles"))
+    n_cycles = vm["cycles"].as<unsigned int>();
+
+  if (dim == 2)
+    benchmark_multi_rhs<2>(params, n_cycles);
+  else
+    benchmark_multi_rhs<3>(params, n_cycles);
+
+  return 0;
+}
@@ -0,0 +1,199 @@
+/**************************************************************************
+ * Copyright (c) 2017-2019 by the mfmg authors                            *
+ * All rights reserved.                                                   *
+ *                                                                        *
+ * This file is part of the mfmg library. mfmg is distributed under a BSD *
+ * 3-clause license. For the licensing terms see the LICENSE file in the  *
+ * top-level directory                                                    *
+ *                                                                        *
+ * SPDX-License-Identifier: BSD-3-Clause                                  *
+ *************************************************************************/
+
+#include <mfmg/common/exceptions.hpp>
+#include <mfmg/dealii/dealii_multicolor_smoother.hpp>
+#include <mfmg/dealii/dealii_smoother.hpp>
+#include <mfmg/dealii/dealii_trilinos_matrix_operator.hpp>
+#include <mfmg/dealii/dealii_utils.hpp>
+
+#include <deal.II/base/multithread_info.h>
+#include <deal.II/base/timer.h>
+
+#include <boost/program_options.hpp>
+
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+#include "test_hierarchy_helpers.hpp"
+
+using DVector = dealii::LinearAlgebra::distributed::Vector<double>;
+
+// Compare the smoothers provided by Trilinos (Ifpack) with the native
+// multicolor smoothers. For each smoother, we report the setup time, the time
+// of a single application, and the reduction of the residual.
+void benchmark_smoothers(
+    std::shared_ptr<mfmg::DealIITrilinosMatrixOperator<DVector>> op,
+    DVector const &x0, unsigned int n_sweeps)
+{
+  auto matrix = op->get_matrix();
+  MPI_Comm comm = matrix->get_mpi_communicator();
+
+  dealii::ConditionalOStream pcout(
+      std::cout, dealii::Utilities::MPI::this_mpi_process(comm) == 0);
+
+  auto b = op->build_range_vector();
+  *b = 0.;
+
+  pcout << "n_dofs: " << matrix->m()
+        << ", n_threads: " << dealii::MultithreadInfo::n_threads()
+        << ", n_sweeps: " << n_sweeps << std::endl;
+
+  for (std::string const smoother_type :
+       {"Symmetric Gauss-Seidel", "Multicolor Symmetric Gauss-Seidel",
+        "Gauss-Seidel", "Multicolor Gauss-Seidel"})
+  {
+    auto params = std::make_shared<boost::property_tree::ptree>();
+    params->put("smoother.type", smoother_type);
+
+    dealii::Timer timer(comm, true);
+    std::unique_ptr<mfmg::Smoother<DVector>> smoother;
+    if (smoother_type.find("Multicolor") == 0)
+      smoother.reset(new mfmg::DealIIMulticolorSmoother<DVector>(op, params));
+    else
+      smoother.reset(new mfmg::DealIISmoother<DVector>(op, params));
+    timer.stop();
+    double const setup_time = timer.last_wall_time();
+
+    auto x = op->build_domain_vector();
+    *x = x0;
+    auto r = op->build_range_vector();
+    op->apply(*x, *r);
+    r->sadd(-1., 1., *b);
+    double const initial_residual = r->l2_norm();
+
+    timer.restart();
+    for (unsigned int i = 0; i < n_sweeps; ++i)
+      smoother->apply(*b, *x);
+    timer.stop();
+    double const apply_time = timer.last_wall_time() / n_sweeps;
+
+    op->apply(*x, *r);
+    r->sadd(-1., 1., *b);
+    double const reduction = std::pow(r->l2_norm() / initial_residual,
+                                      1. / static_cast<double>(n_sweeps));
+
+    pcout << std::scientific << std::setprecision(3) << smoother_type
+          << ": setup " << setup_time << " s, apply " << apply_time
+          << " s, residual reduction per sweep " << std::fixed << reduction
+          << std::endl;
+  }
+}
+
+// Benchmark the smoothers on the Laplace operator
+template <int dim>
+void benchmark_laplace(unsigned int n_refinements, unsigned int fe_degree,
+                       unsigned int n_sweeps)
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+
+  boost::property_tree::ptree laplace_ptree;
+  laplace_ptree.put("n_refinements", n_refinements);
+  Laplace<dim, DVector> laplace(comm, fe_degree);
+  laplace.setup_system(laplace_ptree);
+  ConstantMaterialProperty<dim> material_property;
+  Source<dim> source;
+  laplace.assemble_system(source, material_property);
+
+  auto matrix = std::make_shared<dealii::TrilinosWrappers::SparseMatrix>();
+  matrix->copy_from(laplace._system_matrix);
+  auto op =
+      std::make_shared<mfmg::DealIITrilinosMatrixOperator<DVector>>(matrix);
+
+  std::default_random_engine generator;
+  std::uniform_real_distribution<double> distribution(0., 1.);
+  auto x0 = op->build_domain_vector();
+  for (auto const index : laplace._locally_owned_dofs)
+  {
+    if (laplace._constraints.is_constrained(index))
+      (*x0)[index] = 0.;
+    else
+      (*x0)[index] = distribution(generator);
+  }
+
+  benchmark_smoothers(op, *x0, n_sweeps);
+}
+
+// Benchmark the smoothers on a matrix written by binary_csr_output_file(),
+// e.g., an operator captured from a production run
+void benchmark_binary_csr(std::string const &filename, unsigned int n_sweeps)
+{
+  auto matrix = std::make_shared<dealii::TrilinosWrappers::SparseMatrix>();
+  mfmg::binary_csr_input_file(filename, MPI_COMM_WORLD, *matrix);
+  auto op =
+      std::make_shared<mfmg::DealIITrilinosMatrixOperator<DVector>>(matrix);
+
+  std::default_random_engine generator;
+  std::uniform_real_distribution<double> distribution(0., 1.);
+  auto x0 = op->build_domain_vector();
+  for (auto &value : *x0)
+    value = distribution(generator);
+
+  benchmark_smoothers(op, *x0, n_sweeps);
+}
+
+int main(int argc, char *argv[])
+{
+  namespace boost_po = boost::program_options;
+
+  dealii::Utilities::MPI::MPI_InitFinalize mpi_init(argc, argv);
+
+  boost_po::options_description cmd("Available options");
+  cmd.add_options()("help,h", "produce help message");
+  cmd.add_options()("dim,d", boost_po::value<int>(), "dimension");
+  cmd.add_options()("refinements,r", boost_po::value<unsigned int>(),
+                    "number of global refinements");
+  cmd.add_options()("fe_degree,p", boost_po::value<unsigned int>(),
+                    "degree of the finite elements");
+  cmd.add_options()("sweeps,s", boost_po::value<unsigned int>(),
+                    "number of smoothing sweeps");
+  cmd.add_options()("matrix,m", boost_po::value<std::string>(),
+                    "use the matrix written by binary_csr_output_file "
+                    "instead of the Laplace operator");
+
+  boost_po::variables_map vm;
+  boost_po::store(boost_po::parse_command_line(argc, argv, cmd), vm);
+  boost_po::notify(vm);
+
+  if (vm.count("help"))
+  {
+    std::cout << cmd << std::endl;
+
+    return 0;
+  }
+
+  int dim = 2;
+  if (vm.count("dim"))
+    dim = vm["dim"].as<int>();
+  mfmg::ASSERT(dim == 2 || dim == 3, "Dimension must be 2 or 3");
+
+  unsigned int n_refinements = (dim == 2) ? 8 : 5;
+  if (vm.count("refinements"))
+    n_refinements = vm["refinements"].as<unsigned int>();
+
+  unsigned int fe_degree = 1;
+  if (vm.count("fe_degree"))
+    fe_degree = vm["fe_degree"].as<unsigned int>();
+
+  unsigned int n_sweeps = 20;
+  if (vm.count("sweeps"))
+    n_sweeps = vm["sweeps"].as<unsigned int>();
+
+  if (vm.count("matrix"))
+    benchmark_binary_csr(vm["matrix"].as<std::string>(), n_sweeps);
+  else if (dim == 2)
+    benchmark_laplace<2>(n_refinements, fe_degree, n_sweeps);
+  else
+    benchmark_laplace<3>(n_refinements, fe_degree, n_sweeps);
+
+  return 0;
+}
@@ -21,10 +21,18 @@
 #include <deal.II/lac/trilinos_vector.h>
 #include <deal.II/numerics/data_out.h>
 
+#include <boost/test/data/monomorphic.hpp>
+#include <boost/test/data/test_case.hpp>
+
+#include <algorithm>
 #include <array>
+#include <cstdio>
+#include <string>
 
 #include "main.cc"
 
+namespace bdata = boost::unit_test::data;
+
 template <int dim>
 std::pair<std::vector<unsigned int>,
           std::pair<std::vector<std::vector<unsigned int>>,
@@ -291,8 +299,6 @@ BOOST_AUTO_TEST_CASE(zoltan_agglomerate_2d)
   int constexpr dim = 2;
   unsigned int world_size =
       dealii::Utilities::MPI::n_mpi_processes(MPI_COMM_WORLD);
-  unsigned int world_rank =
-      dealii::Utilities::MPI::this_mpi_process(MPI_COMM_WORLD);
   dealii::parallel::distributed::Triangulation<dim> triangulation(
       MPI_COMM_WORLD);
   dealii::FE_Q<dim> fe(1);
@@ -311,53 +317,355 @@ BOOST_AUTO_TEST_CASE(zoltan_agglomerate_2d)
   boost::property_tree::ptree partitioner_params;
   partitioner_params.put("partitioner", "zoltan");
   partitioner_params.put("n_agglomerates", 3);
-  amge.build_agglomerates(partitioner_params);
+  unsigned int const n_agglomerates =
+      amge.build_agglomerates(partitioner_params);
 
-  std::vector<unsigned int> agglomerates;
-  agglomerates.reserve(dof_handler.get_triangulation().n_active_cells());
+  if (world_size == 1)
+  {
+    std::vector<unsigned int> agglomerates;
+    agglomerates.reserve(dof_handler.get_triangulation().n_active_cells());
+    for (auto cell : dof_handler.active_cell_iterators())
+      agglomerates.push_back(cell->user_index());
+
+    std::vector<unsigned int> ref_agglomerates = {
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+        1, 1, 3, 3, 1, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+        2, 2, 3, 3, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3};
+
+    BOOST_TEST(agglomerates == ref_agglomerates);
+  }
+
+  // The connectivity graph only contains the locally owned cells so all the
+  // requested agglomerates are shared between them
+  BOOST_TEST(n_agglomerates == 3);
+  std::vector<unsigned int> agglomerate_sizes(n_agglomerates, 0);
   for (auto cell : dof_handler.active_cell_iterators())
-    agglomerates.push_back(cell->user_index());
+  {
+    if (cell->is_locally_owned())
+    {
+      BOOST_TEST(cell->user_index() > 0);
+      BOOST_TEST(cell->user_index() <= n_agglomerates);
+      ++agglomerate_sizes[cell->user_index() - 1];
+    }
+    else
+      BOOST_TEST(cell->user_index() == 0);
+  }
+  for (auto const size : agglomerate_sizes)
+    BOOST_TEST(size > 0);
+}
 
-  std::vector<unsigned int> ref_agglomerates;
-  if (world_size == 1)
+template <int dim>
+void test_partitioner_refined()
+{
+  dealii::parallel::distributed::Triangulation<dim> triangulation(
+      MPI_COMM_WORLD);
+  dealii::FE_Q<dim> fe(1);
+  dealii::DoFHandler<dim> dof_handler(triangulation);
+
+  // Refine the left half of the domain once more to create hanging faces
+  dealii::GridGenerator::hyper_cube(triangulation);
+  triangulation.refine_global(2);
+  for (auto cell : triangulation.active_cell_iterators())
+    if (cell->is_locally_owned() && (cell->center()[0] < 0.5))
+      cell->set_refine_flag();
+  triangulation.execute_coarsening_and_refinement();
+  dof_handler.distribute_dofs(fe);
+
+  using Vector = dealii::LinearAlgebra::distributed::Vector<double>;
+  using DummyMeshEvaluator = mfmg::DealIIMeshEvaluator<dim>;
+
+  mfmg::AMGe_host<dim, DummyMeshEvaluator, Vector> amge(MPI_COMM_WORLD,
+                                                        dof_handler);
+
+  boost::property_tree::ptree partitioner_params;
+  partitioner_params.put("partitioner", "zoltan");
+  partitioner_params.put("n_agglomerates", 4);
+  unsigned int const n_agglomerates =
+      amge.build_agglomerates(partitioner_params);
+
+  BOOST_TEST(n_agglomerates > 0);
+  BOOST_TEST(n_agglomerates <= 4);
+  std::vector<unsigned int> agglomerate_sizes(n_agglomerates, 0);
+  for (auto cell : dof_handler.active_cell_iterators())
   {
-    ref_agglomerates = {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-                        2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
-                        1, 1, 3, 3, 1, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
-                        2, 2, 3, 3, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3};
+    if (cell->is_locally_owned())
+    {
+      BOOST_TEST(cell->user_index() > 0);
+      BOOST_TEST(cell->user_index() <= n_agglomerates);
+      ++agglomerate_sizes[cell->user_index() - 1];
+    }
+    else
+      BOOST_TEST(cell->user_index() == 0);
   }
-  else if (world_size == 2)
+  for (auto const size : agglomerate_sizes)
+    BOOST_TEST(size > 0);
+}
+
+BOOST_AUTO_TEST_CASE(zoltan_agglomerate_refined)
+{
+  test_partitioner_refined<2>();
+  test_partitioner_refined<3>();
+}
+
+template <int dim>
+void test_space_filling_curve(std::string const &curve_type)
+{
+  dealii::parallel::distributed::Triangulation<dim> triangulation(
+      MPI_COMM_WORLD);
+  dealii::FE_Q<dim> fe(1);
+  dealii::DoFHandler<dim> dof_handler(triangulation);
+
+  dealii::GridGenerator::hyper_cube(triangulation);
+  triangulation.refine_global(3);
+  dof_handler.distribute_dofs(fe);
+
+  using Vector = dealii::LinearAlgebra::distributed::Vector<double>;
+  using DummyMeshEvaluator = mfmg::DealIIMeshEvaluator<dim>;
+
+  mfmg::AMGe_host<dim, DummyMeshEvaluator, Vector> amge(MPI_COMM_WORLD,
+                                                        dof_handler);
+
+  // Every processor owns a multiple of 2^dim cells
+  unsigned int const agglomerate_size = 1 << dim;
+  boost::property_tree::ptree partitioner_params;
+  partitioner_params.put("partitioner", curve_type);
+  partitioner_params.put("size", agglomerate_size);
+  unsigned int const n_agglomerates =
+      amge.build_agglomerates(partitioner_params);
+
+  std::vector<std::vector<dealii::Point<dim>>> agglomerate_centers(
+      n_agglomerates);
+  for (auto cell : dof_handler.active_cell_iterators())
   {
-    if (world_rank == 0)
-      ref_agglomerates = {0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 2,
-                          1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
-                          0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    if (cell->is_locally_owned())
+    {
+      BOOST_TEST(cell->user_index() > 0);
+      BOOST_TEST(cell->user_index() <= n_agglomerates);
+      agglomerate_centers[cell->user_index() - 1].push_back(cell->center());
+    }
     else
-      ref_agglomerates = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-                          0, 0, 1, 1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 2, 1, 2,
-                          2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2};
+      BOOST_TEST(cell->user_index() == 0);
   }
-  else if (world_size == 4)
+
+  for (auto const &centers : agglomerate_centers)
   {
-    if (world_rank == 0)
-      ref_agglomerates = {0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
-                          1, 1, 1, 1, 1, 1, 1, 2, 0, 0, 0, 0, 0, 0, 0,
-                          0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-    if (world_rank == 1)
-      ref_agglomerates = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-                          1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-                          2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-    if (world_rank == 2)
-      ref_agglomerates = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-                          0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-                          1, 1, 1, 1, 2, 0, 0, 0, 0, 0, 0, 0, 0};
-    if (world_rank == 3)
-      ref_agglomerates = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-                          0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1,
-                          1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2};
+    BOOST_TEST(centers.size() == agglomerate_size);
+    // On a uniform mesh, the pieces of the Hilbert curve are blocks of 2^dim
+    // cells of size 1/8
+    if (curve_type == "hilbert")
+      for (auto const &a : centers)
+        for (auto const &b : centers)
+          BOOST_TEST(a.distance(b) < 0.25);
   }
+}
 
-  BOOST_TEST(agglomerates == ref_agglomerates);
+BOOST_DATA_TEST_CASE(space_filling_curve_agglomerate,
+                     bdata::make({"hilbert", "morton"}), curve_type)
+{
+  test_space_filling_curve<2>(curve_type);
+  test_space_filling_curve<3>(curve_type);
+}
+
+template <int dim>
+void test_coarse_ordering(std::string const &curve_type)
+{
+  dealii::parallel::distributed::Triangulation<dim> triangulation(
+      MPI_COMM_WORLD);
+  dealii::FE_Q<dim> fe(1);
+  dealii::DoFHandler<dim> dof_handler(triangulation);
+
+  dealii::GridGenerator::hyper_cube(triangulation);
+  triangulation.refine_global(3);
+  dof_handler.distribute_dofs(fe);
+
+  using Vector = dealii::LinearAlgebra::distributed::Vector<double>;
+  using DummyMeshEvaluator = mfmg::DealIIMeshEvaluator<dim>;
+
+  mfmg::AMGe_host<dim, DummyMeshEvaluator, Vector> amge(MPI_COMM_WORLD,
+                                                        dof_handler);
+
+  boost::property_tree::ptree partitioner_params;
+  partitioner_params.put("partitioner", "block");
+  partitioner_params.put("nx", 2);
+  partitioner_params.put("ny", 2);
+  partitioner_params.put("nz", 2);
+  unsigned int const n_agglomerates =
+      amge.build_agglomerates(partitioner_params);
+  std::vector<unsigned int> agglomerates;
+  for (auto cell : dof_handler.active_cell_iterators())
+    agglomerates.push_back(cell->user_index());
+
+  partitioner_params.put("coarse_ordering", curve_type);
+  BOOST_TEST(amge.build_agglomerates(partitioner_params) == n_agglomerates);
+
+  // The agglomerates are the same, only their IDs change
+  std::vector<unsigned int> new_ids(n_agglomerates + 1, 0);
+  std::vector<dealii::Point<dim>> centroids(n_agglomerates);
+  std::vector<unsigned int> n_cells(n_agglomerates, 0);
+  unsigned int i = 0;
+  for (auto cell : dof_handler.active_cell_iterators())
+  {
+    unsigned int const id = cell->user_index();
+    if (agglomerates[i] == 0)
+      BOOST_TEST(id == 0);
+    else
+    {
+      BOOST_TEST(id > 0);
+      BOOST_TEST(id <= n_agglomerates);
+      if (new_ids[agglomerates[i]] == 0)
+        new_ids[agglomerates[i]] = id;
+      BOOST_TEST(new_ids[agglomerates[i]] == id);
+      centroids[id - 1] += cell->center();
+      ++n_cells[id - 1];
+    }
+    ++i;
+  }
+  std::vector<unsigned int> sorted_ids(new_ids.begin() + 1, new_ids.end());
+  std::sort(sorted_ids.begin(), sorted_ids.end());
+  for (unsigned int j = 0; j < n_agglomerates; ++j)
+    BOOST_TEST(sorted_ids[j] == j + 1);
+
+  // On a single processor, the agglomerates form a regular grid of spacing
+  // 1/4 and consecutive agglomerates along the Hilbert curve are neighbors
+  for (unsigned int j = 0; j < n_agglomerates; ++j)
+    centroids[j] /= n_cells[j];
+  if ((curve_type == "hilbert") &&
+      (dealii::Utilities::MPI::n_mpi_processes(MPI_COMM_WORLD) == 1))
+    for (unsigned int j = 1; j < n_agglomerates; ++j)
+      BOOST_TEST(centroids[j].distance(centroids[j - 1]) < 0.26);
+}
+
+BOOST_DATA_TEST_CASE(coarse_ordering, bdata::make({"hilbert", "morton"}),
+                     curve_type)
+{
+  test_coarse_ordering<2>(curve_type);
+  test_coarse_ordering<3>(curve_type);
+}
+
+BOOST_AUTO_TEST_CASE(import_export_agglomerate_2d)
+{
+  int constexpr dim = 2;
+  dealii::parallel::distributed::Triangulation<dim> triangulation(
+      MPI_COMM_WORLD);
+  dealii::FE_Q<dim> fe(1);
+  dealii::DoFHandler<dim> dof_handler(triangulation);
+
+  dealii::GridGenerator::hyper_cube(triangulation);
+  triangulation.refine_global(3);
+  dof_handler.distribute_dofs(fe);
+
+  using Vector = dealii::LinearAlgebra::distributed::Vector<double>;
+  using DummyMeshEvaluator = mfmg::DealIIMeshEvaluator<dim>;
+
+  mfmg::AMGe_host<dim, DummyMeshEvaluator, Vector> amge(MPI_COMM_WORLD,
+                                                        dof_handler);
+
+  boost::property_tree::ptree partitioner_params;
+  partitioner_params.put("partitioner", "block");
+  partitioner_params.put("nx", 2);
+  partitioner_params.put("ny", 3);
+  partitioner_params.put("export_filename", "agglomerates");
+  unsigned int const n_agglomerates =
+      amge.build_agglomerates(partitioner_params);
+  std::vector<unsigned int> const agglomerates = amge.get_agglomerates();
+  BOOST_TEST(agglomerates.size() ==
+             triangulation.n_locally_owned_active_cells());
+
+  // Reading the file gives back the same agglomerates
+  boost::property_tree::ptree file_params;
+  file_params.put("partitioner", "file");
+  file_params.put("filename", "agglomerates");
+  BOOST_TEST(amge.build_agglomerates(file_params) == n_agglomerates);
+  BOOST_TEST(amge.get_agglomerates() == agglomerates);
+
+  // The IDs given by the user are renumbered contiguously
+  std::vector<unsigned int> user_ids(agglomerates.size());
+  for (unsigned int i = 0; i < agglomerates.size(); ++i)
+    user_ids[i] = 10 * agglomerates[i] + 5;
+  BOOST_TEST(amge.set_agglomerates(user_ids) == n_agglomerates);
+  BOOST_TEST(amge.get_agglomerates() == agglomerates);
+
+  // Remove the file. Every processor throws when the file of one of them is
+  // missing.
+  unsigned int const rank =
+      dealii::Utilities::MPI::this_mpi_process(MPI_COMM_WORLD);
+  unsigned int const n_procs =
+      dealii::Utilities::MPI::n_mpi_processes(MPI_COMM_WORLD);
+  if (rank == n_procs - 1)
+    BOOST_TEST(std::remove(("agglomerates." + std::to_string(rank)).c_str()) ==
+               0);
+  MPI_Barrier(MPI_COMM_WORLD);
+  BOOST_CHECK_THROW(amge.build_agglomerates(file_params), std::runtime_error);
+  if (rank != n_procs - 1)
+    BOOST_TEST(std::remove(("agglomerates." + std::to_string(rank)).c_str()) ==
+               0);
+}
+
+BOOST_AUTO_TEST_CASE(across_ranks_agglomerate_2d)
+{
+  int constexpr dim = 2;
+  dealii::parallel::distributed::Triangulation<dim> triangulation(
+      MPI_COMM_WORLD);
+  dealii::FE_Q<dim> fe(1);
+  dealii::DoFHandler<dim> dof_handler(triangulation);
+
+  dealii::GridGenerator::hyper_cube(triangulation);
+  triangulation.refine_global(3);
+  dof_handler.distribute_dofs(fe);
+
+  using Vector = dealii::LinearAlgebra::distributed::Vector<double>;
+  using DummyMeshEvaluator = mfmg::DealIIMeshEvaluator<dim>;
+
+  mfmg::AMGe_host<dim, DummyMeshEvaluator, Vector> amge(MPI_COMM_WORLD,
+                                                        dof_handler);
+
+  // The blocks do not align with the partition of the mesh so some of the
+  // agglomerates are cut by the processor boundaries
+  boost::property_tree::ptree partitioner_params;
+  partitioner_params.put("partitioner", "block");
+  partitioner_params.put("nx", 3);
+  partitioner_params.put("ny", 3);
+  partitioner_params.put("across_ranks", true);
+  unsigned int const n_agglomerates =
+      amge.build_agglomerates(partitioner_params);
+
+  // Every cell belongs to exactly one agglomerate, which may be owned by a
+  // neighboring processor
+  std::vector<unsigned int> agglomerate_sizes(n_agglomerates, 0);
+  unsigned int n_cells = 0;
+  for (auto cell : dof_handler.active_cell_iterators())
+  {
+    if (cell->user_index() > 0)
+    {
+      BOOST_TEST(!cell->is_artificial());
+      BOOST_TEST(cell->user_index() <= n_agglomerates);
+      ++agglomerate_sizes[cell->user_index() - 1];
+      ++n_cells;
+    }
+  }
+  for (auto const size : agglomerate_sizes)
+    BOOST_TEST(size > 0);
+  BOOST_TEST(dealii::Utilities::MPI::sum(n_cells, MPI_COMM_WORLD) ==
+             triangulation.n_global_active_cells());
+
+  // The small pieces of the blocks cut by the processor boundaries are merged
+  // so the cells given to another processor are received as ghost cells
+  unsigned int n_given_cells = 0;
+  unsigned int n_received_cells = 0;
+  for (auto cell : dof_handler.active_cell_iterators())
+  {
+    if (cell->is_locally_owned() && (cell->user_index() == 0))
+      ++n_given_cells;
+    if (cell->is_ghost() && (cell->user_index() > 0))
+      ++n_received_cells;
+  }
+  n_given_cells = dealii::Utilities::MPI::sum(n_given_cells, MPI_COMM_WORLD);
+  n_received_cells =
+      dealii::Utilities::MPI::sum(n_received_cells, MPI_COMM_WORLD);
+  BOOST_TEST(n_given_cells == n_received_cells);
+  if (dealii::Utilities::MPI::n_mpi_processes(MPI_COMM_WORLD) > 1)
+    BOOST_TEST(n_received_cells > 0u);
 }
 
 BOOST_AUTO_TEST_CASE(boundary_agglomerate_2d)
@@ -0,0 +1,134 @@
+/**************************************************************************
+ * Copyright (c) 2017-2019 by the mfmg authors                            *
+ * All rights reserved.                                                   *
+ *                                                                        *
+ * This file is part of the mfmg library. mfmg is distributed under a BSD *
+ * 3-clause license. For the licensing terms see the LICENSE file in the  *
+ * top-level directory                                                    *
+ *                                                                        *
+ * SPDX-License-Identifier: BSD-3-Clause                                  *
+ *************************************************************************/
+
+#define BOOST_TEST_MODULE csr_matrix_operator
+
+#include <mfmg/common/multivector.hpp>
+#include <mfmg/dealii/dealii_csr_matrix_operator.hpp>
+#include <mfmg/dealii/dealii_trilinos_matrix_operator.hpp>
+
+#include <deal.II/base/index_set.h>
+#include <deal.II/base/mpi.h>
+#include <deal.II/lac/la_parallel_vector.h>
+#include <deal.II/lac/trilinos_sparse_matrix.h>
+
+#include <cmath>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "main.cc"
+
+using DVector = dealii::LinearAlgebra::distributed::Vector<double>;
+
+// Build a rectangular matrix similar to a restrictor: each processor owns
+// n_local_rows rows and 2 * n_local_rows columns and each row couples with
+// the columns of the next processor.
+std::shared_ptr<dealii::TrilinosWrappers::SparseMatrix>
+build_matrix(MPI_Comm comm, unsigned int n_local_rows)
+{
+  unsigned int const n_procs = dealii::Utilities::MPI::n_mpi_processes(comm);
+  unsigned int const rank = dealii::Utilities::MPI::this_mpi_process(comm);
+  unsigned int const n_local_cols = 2 * n_local_rows;
+  dealii::IndexSet locally_owned_rows(n_procs * n_local_rows);
+  locally_owned_rows.add_range(rank * n_local_rows, (rank + 1) * n_local_rows);
+  dealii::IndexSet locally_owned_cols(n_procs * n_local_cols);
+  locally_owned_cols.add_range(rank * n_local_cols, (rank + 1) * n_local_cols);
+
+  auto matrix = std::make_shared<dealii::TrilinosWrappers::SparseMatrix>(
+      locally_owned_rows, locally_owned_cols, comm, 4);
+  for (auto const i : locally_owned_rows)
+  {
+    unsigned int const j = 2 * i;
+    matrix->set(i, j, 1. / 3.);
+    matrix->set(i, j + 1, std::sqrt(2.));
+    matrix->set(i, (j + n_local_cols) % (n_procs * n_local_cols), -0.1);
+    matrix->set(i, (j + n_local_cols + 1) % (n_procs * n_local_cols), M_PI);
+  }
+  matrix->compress(dealii::VectorOperation::insert);
+
+  return matrix;
+}
+
+typedef std::tuple<float, double> storage_types;
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(apply, StorageType, storage_types)
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  auto matrix = build_matrix(comm, 10);
+  mfmg::DealIITrilinosMatrixOperator<DVector> ref_op(matrix);
+  mfmg::DealIICSRMatrixOperator<DVector, StorageType> op(*matrix);
+  BOOST_TEST(op.grid_complexity() == ref_op.grid_complexity());
+  BOOST_TEST(op.operator_complexity() == ref_op.operator_complexity());
+
+  // The values are rounded to StorageType but the accumulation is done in
+  // double precision
+  double const tolerance =
+      std::is_same<StorageType, float>::value ? 1e-6 : 1e-14;
+
+  auto x = op.build_domain_vector();
+  for (auto const i : x->locally_owned_elements())
+    (*x)[i] = std::cos(static_cast<double>(i));
+  auto y = op.build_range_vector();
+  auto y_ref = ref_op.build_range_vector();
+  op.apply(*x, *y);
+  ref_op.apply(*x, *y_ref);
+  for (auto const i : y->locally_owned_elements())
+    BOOST_TEST((*y)[i] == (*y_ref)[i], boost::test_tools::tolerance(tolerance));
+
+  // Apply the transpose twice to check that the ghost entries are reset
+  auto z = op.build_domain_vector();
+  auto z_ref = ref_op.build_domain_vector();
+  for (unsigned int k = 0; k < 2; ++k)
+    op.apply(*y_ref, *z, mfmg::OperatorMode::TRANS);
+  ref_op.apply(*y_ref, *z_ref, mfmg::OperatorMode::TRANS);
+  for (auto const i : z->locally_owned_elements())
+    BOOST_TEST((*z)[i] == (*z_ref)[i], boost::test_tools::tolerance(tolerance));
+}
+
+BOOST_AUTO_TEST_CASE(transpose_multithreaded)
+{
+  // Enough columns to split the transposed product between the threads
+  MPI_Comm comm = MPI_COMM_WORLD;
+  auto matrix = build_matrix(comm, 5000);
+  mfmg::DealIITrilinosMatrixOperator<DVector> ref_op(matrix);
+  mfmg::DealIICSRMatrixOperator<DVector, double> op(*matrix);
+
+  int const n_vectors = 3;
+  std::vector<std::shared_ptr<DVector>> y_vectors;
+  std::vector<std::shared_ptr<DVector>> z_vectors;
+  for (int v = 0; v < n_vectors; ++v)
+  {
+    y_vectors.push_back(op.build_range_vector());
+    for (auto const i : y_vectors[v]->locally_owned_elements())
+      (*y_vectors[v])[i] = std::cos(static_cast<double>(i + v));
+    z_vectors.push_back(op.build_domain_vector());
+  }
+  mfmg::MultiVector<DVector> y(y_vectors);
+  mfmg::MultiVector<DVector> z(z_vectors);
+  op.apply_multivector(y, z, mfmg::OperatorMode::TRANS);
+
+  auto z_ref = ref_op.build_domain_vector();
+  auto z_single = op.build_domain_vector();
+  for (int v = 0; v < n_vectors; ++v)
+  {
+    ref_op.apply(*y[v], *z_ref, mfmg::OperatorMode::TRANS);
+    op.apply(*y[v], *z_single, mfmg::OperatorMode::TRANS);
+    for (auto const i : z_ref->locally_owned_elements())
+    {
+      BOOST_TEST((*z[v])[i] == (*z_ref)[i],
+                 boost::test_tools::tolerance(1e-14));
+      BOOST_TEST((*z_single)[i] == (*z_ref)[i],
+                 boost::test_tools::tolerance(1e-14));
+    }
+  }
+}
@@ -20,10 +20,15 @@
 #include <deal.II/grid/grid_generator.h>
 #include <deal.II/lac/trilinos_vector.h>
 
+#include <boost/test/data/monomorphic.hpp>
+#include <boost/test/data/test_case.hpp>
+
 #include <algorithm>
+#include <complex>
 
 #include "main.cc"
 
+namespace bdata = boost::unit_test::data;
 namespace tt = boost::test_tools;
 namespace ut = boost::unit_test;
 
@@ -230,3 +235,117 @@ BOOST_AUTO_TEST_CASE(diagonal_constraint, *ut::tolerance(1e-12))
       BOOST_TEST(std::abs(eigenvectors[i][j]) == ref_eigenvectors[i][j]);
   }
 }
+
+BOOST_DATA_TEST_CASE(diagonal_constraint_renumbering,
+                     bdata::make({"cuthill_mckee", "global"}),
+                     dof_renumbering)
+{
+  int const dim = 2;
+  using Vector = dealii::LinearAlgebra::distributed::Vector<double>;
+  using MeshEvaluator = mfmg::DealIIMeshEvaluator<2>;
+
+  dealii::parallel::distributed::Triangulation<2> triangulation(MPI_COMM_WORLD);
+  dealii::GridGenerator::hyper_cube(triangulation);
+  triangulation.refine_global(3);
+  dealii::FE_Q<2> fe(1);
+  dealii::DoFHandler<2> dof_handler(triangulation);
+  dof_handler.distribute_dofs(fe);
+  boost::property_tree::ptree eigensolver_params;
+  eigensolver_params.put("dof_renumbering", dof_renumbering);
+  mfmg::AMGe_host<2, MeshEvaluator, Vector> amge(MPI_COMM_WORLD, dof_handler,
+                                                 eigensolver_params);
+
+  unsigned int const n_eigenvectors = 5;
+  std::map<typename dealii::Triangulation<2>::active_cell_iterator,
+           typename dealii::DoFHandler<2>::active_cell_iterator>
+      patch_to_global_map;
+  for (auto cell : dof_handler.active_cell_iterators())
+    patch_to_global_map[cell] = cell;
+
+  dealii::AffineConstraints<double> constraints;
+  ConstrainedDiagonalTestMeshEvaluator<dim> evaluator(dof_handler, constraints);
+  std::vector<std::complex<double>> eigenvalues;
+  std::vector<dealii::Vector<double>> eigenvectors;
+  std::vector<double> diag_elements;
+  std::vector<dealii::types::global_dof_index> dof_indices_map;
+  std::tie(eigenvalues, eigenvectors, diag_elements, dof_indices_map) =
+      amge.compute_local_eigenvectors(n_eigenvectors, 1e-13, triangulation,
+                                      patch_to_global_map, evaluator,
+                                      mfmg::LobpcgScratchData());
+
+  // The DoFs of the agglomerate are the global DoFs so the diagonal entry of
+  // the global DoF i is still i+1 after the renumbering
+  unsigned int const size = dof_handler.n_dofs();
+  BOOST_TEST(dof_indices_map.size() == size);
+  std::vector<dealii::types::global_dof_index> sorted_dof_indices_map(
+      dof_indices_map);
+  std::sort(sorted_dof_indices_map.begin(), sorted_dof_indices_map.end());
+  std::vector<dealii::types::global_dof_index> ref_dof_indices_map(size);
+  std::iota(ref_dof_indices_map.begin(), ref_dof_indices_map.end(), 0);
+  BOOST_TEST(sorted_dof_indices_map == ref_dof_indices_map, tt::per_element());
+  if (std::string(dof_renumbering) == "global")
+    BOOST_TEST(dof_indices_map == ref_dof_indices_map, tt::per_element());
+  for (unsigned int j = 0; j < size; ++j)
+    BOOST_TEST(diag_elements[j] == static_cast<double>(dof_indices_map[j] + 1));
+
+  // The constrained DoF 0 is renumbered with the matrix
+  for (unsigned int i = 0; i < n_eigenvectors; ++i)
+  {
+    double const ref_eigenvalue = static_cast<double>(i + 2);
+    BOOST_TEST(eigenvalues[i].real() == ref_eigenvalue, tt::tolerance(1e-12));
+    BOOST_TEST(eigenvalues[i].imag() == 0.);
+    for (unsigned int j = 0; j < size; ++j)
+      BOOST_TEST(std::abs(eigenvectors[i][j]) ==
+                     (diag_elements[j] == ref_eigenvalue ? 1. : 0.),
+                 tt::tolerance(1e-12));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(select_eigenpairs)
+{
+  // The eigenvalues are not sorted
+  std::vector<std::complex<double>> const ref_eigenvalues = {0., 3., 1., 10.};
+  std::vector<dealii::Vector<double>> ref_eigenvectors(
+      4, dealii::Vector<double>(1));
+  for (unsigned int i = 0; i < 4; ++i)
+    ref_eigenvectors[i][0] = ref_eigenvalues[i].real();
+  double const diagonal_scale = 2.;
+
+  auto select = [&](boost::property_tree::ptree const &params) {
+    auto eigenvalues = ref_eigenvalues;
+    auto eigenvectors = ref_eigenvectors;
+    mfmg::select_agglomerate_eigenpairs(params, diagonal_scale, eigenvalues,
+                                        eigenvectors);
+    BOOST_TEST(eigenvectors.size() == eigenvalues.size());
+    std::vector<double> values;
+    for (unsigned int i = 0; i < eigenvalues.size(); ++i)
+    {
+      BOOST_TEST(eigenvectors[i][0] == eigenvalues[i].real());
+      values.push_back(eigenvalues[i].real());
+    }
+    return values;
+  };
+
+  // Without criterion, nothing changes
+  boost::property_tree::ptree params;
+  std::vector<double> ref_values = {0., 3., 1., 10.};
+  BOOST_TEST(select(params) == ref_values, tt::per_element());
+
+  // Keep the eigenvalues smaller than 2 * 2
+  params.put("eigenvalue threshold", 2.);
+  ref_values = {0., 1., 3.};
+  BOOST_TEST(select(params) == ref_values, tt::per_element());
+
+  // The minimum number of eigenvectors has precedence over the threshold
+  params.put("eigenvalue threshold", 0.1);
+  params.put("min number of eigenvectors", 2);
+  ref_values = {0., 1.};
+  BOOST_TEST(select(params) == ref_values, tt::per_element());
+
+  // The first gap larger than 1.5 * 2 is between 3 and 10
+  params.erase("eigenvalue threshold");
+  params.put("min number of eigenvectors", 1);
+  params.put("eigenvalue gap", 1.5);
+  ref_values = {0., 1., 3.};
+  BOOST_TEST(select(params) == ref_values, tt::per_element());
+}
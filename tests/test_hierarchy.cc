@@ -29,8 +29,11 @@
 #include <boost/test/data/monomorphic.hpp>
 #include <boost/test/data/test_case.hpp>
 
+#include <cctype>
 #include <random>
 
+#include <sys/stat.h>
+
 #include "laplace.hpp"
 #include "laplace_matrix_free.hpp"
 #include "main.cc"
@@ -271,6 +274,557 @@ BOOST_AUTO_TEST_CASE(raw_ml)
   BOOST_TEST(test<mfmg::DealIIMeshEvaluator<2>>(params) < 0.2);
 }
 
+BOOST_DATA_TEST_CASE(mixed_precision,
+                     bdata::make({"Gauss-Seidel", "Multicolor Gauss-Seidel"}),
+                     smoother_type)
+{
+  dealii::MultithreadInfo::set_thread_limit(1);
+
+  auto params = std::make_shared<boost::property_tree::ptree>();
+  boost::property_tree::info_parser::read_info("hierarchy_input.info", *params);
+  params->put("smoother.type", smoother_type);
+
+  double const gold_rate = test<mfmg::DealIIMeshEvaluator<2>>(params);
+
+  // Storing the restrictor in single precision should barely change the
+  // convergence since the residual on the finest level is still computed in
+  // double precision
+  params->put("mixed precision.first level", 1);
+  double const mixed_rate = test<mfmg::DealIIMeshEvaluator<2>>(params);
+  BOOST_TEST(mixed_rate == gold_rate, tt::tolerance(1e-2));
+}
+
+BOOST_AUTO_TEST_CASE(multiple_rhs)
+{
+  using DVector = dealii::LinearAlgebra::distributed::Vector<double>;
+  int constexpr dim = 2;
+  using MeshEvaluator = mfmg::DealIIMeshEvaluator<dim>;
+
+  dealii::MultithreadInfo::set_thread_limit(1);
+
+  MPI_Comm comm = MPI_COMM_WORLD;
+
+  auto params = std::make_shared<boost::property_tree::ptree>();
+  boost::property_tree::info_parser::read_info("hierarchy_input.info", *params);
+
+  auto material_property =
+      MaterialPropertyFactory<dim>::create_material_property(
+          params->get<std::string>("material_property.type"));
+  Source<dim> source;
+
+  auto laplace_ptree = params->get_child("laplace");
+  unsigned int const fe_degree = 1;
+  Laplace<dim, DVector> laplace(comm, fe_degree);
+  laplace.setup_system(laplace_ptree);
+  laplace.assemble_system(source, *material_property);
+
+  auto evaluator = std::make_shared<TestMeshEvaluator<MeshEvaluator>>(
+      laplace._dof_handler, laplace._constraints, fe_degree,
+      laplace._system_matrix, material_property);
+  mfmg::Hierarchy<DVector> hierarchy(comm, evaluator, params);
+
+  // Applying the hierarchy to all the right-hand sides at once must give the
+  // same result as applying it to each right-hand side separately
+  int const n_vectors = 3;
+  auto const locally_owned_dofs = laplace._locally_owned_dofs;
+  mfmg::MultiVector<DVector> b(n_vectors, 0);
+  mfmg::MultiVector<DVector> x(n_vectors, 0);
+  std::default_random_engine generator;
+  std::uniform_real_distribution<double> distribution(0., 1.);
+  for (int k = 0; k < n_vectors; ++k)
+  {
+    b[k] = std::make_shared<DVector>(locally_owned_dofs, comm);
+    x[k] = std::make_shared<DVector>(locally_owned_dofs, comm);
+    for (auto const index : locally_owned_dofs)
+      if (!laplace._constraints.is_constrained(index))
+        (*b[k])[index] = distribution(generator);
+  }
+
+  hierarchy.vmult(x, b);
+
+  for (int k = 0; k < n_vectors; ++k)
+  {
+    DVector x_ref(locally_owned_dofs, comm);
+    hierarchy.vmult(x_ref, *b[k]);
+    double const ref_norm = x_ref.l2_norm();
+    x_ref -= *x[k];
+    BOOST_TEST(x_ref.l2_norm() / ref_norm < 1e-12);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(memory_statistics)
+{
+  using DVector = dealii::LinearAlgebra::distributed::Vector<double>;
+  int constexpr dim = 2;
+  using MeshEvaluator = mfmg::DealIIMeshEvaluator<dim>;
+
+  dealii::MultithreadInfo::set_thread_limit(1);
+
+  MPI_Comm comm = MPI_COMM_WORLD;
+
+  auto params = std::make_shared<boost::property_tree::ptree>();
+  boost::property_tree::info_parser::read_info("hierarchy_input.info", *params);
+  params->put("max levels", 2);
+  params->put("fast_ap", true);
+
+  auto material_property =
+      MaterialPropertyFactory<dim>::create_material_property(
+          params->get<std::string>("material_property.type"));
+  Source<dim> source;
+
+  auto laplace_ptree = params->get_child("laplace");
+  unsigned int const fe_degree = 1;
+  Laplace<dim, DVector> laplace(comm, fe_degree);
+  laplace.setup_system(laplace_ptree);
+  laplace.assemble_system(source, *material_property);
+
+  auto evaluator = std::make_shared<TestMeshEvaluator<MeshEvaluator>>(
+      laplace._dof_handler, laplace._constraints, fe_degree,
+      laplace._system_matrix, material_property);
+  mfmg::Hierarchy<DVector> hierarchy(comm, evaluator, params);
+
+  auto const &statistics = hierarchy.get_statistics();
+  for (std::string const key :
+       {"level_0.memory.operator", "level_0.memory.smoother",
+        "level_1.memory.operator", "level_1.memory.restrictor",
+        "level_0.restrictor.memory.eigenvector_matrix",
+        "level_0.restrictor.memory.delta_eigenvector_matrix",
+        "level_0.peak_memory.build_restrictor",
+        "level_1.peak_memory.build_coarse_solver"})
+  {
+    auto const &summary = statistics.get_child(key);
+    BOOST_TEST(summary.get<double>("min") > 0.);
+    BOOST_TEST(summary.get<double>("min") <= summary.get<double>("mean"));
+    BOOST_TEST(summary.get<double>("mean") <= summary.get<double>("max"));
+  }
+  // The size of the factorization is estimated from the resident set size
+  // which may not grow for a small coarse problem
+  BOOST_TEST(statistics.count("peak_memory_per_phase_available") == 1u);
+  BOOST_TEST(statistics.get_child("level_1.memory").count("solver") == 0u);
+  BOOST_TEST(statistics.get<double>("level_1.memory.solver_rss_delta.min") >=
+             0.);
+}
+
+BOOST_DATA_TEST_CASE(algebraic, bdata::make({false, true}), use_elements)
+{
+  using DVector = dealii::LinearAlgebra::distributed::Vector<double>;
+  int constexpr dim = 2;
+
+  dealii::MultithreadInfo::set_thread_limit(1);
+
+  MPI_Comm comm = MPI_COMM_WORLD;
+
+  auto params = std::make_shared<boost::property_tree::ptree>();
+  boost::property_tree::info_parser::read_info("hierarchy_input.info", *params);
+  params->put("agglomeration.size", use_elements ? 4 : 9);
+
+  auto material_property =
+      MaterialPropertyFactory<dim>::create_material_property(
+          params->get<std::string>("material_property.type"));
+  Source<dim> source;
+
+  auto laplace_ptree = params->get_child("laplace");
+  unsigned int const fe_degree = 1;
+  Laplace<dim, DVector> laplace(comm, fe_degree);
+  laplace.setup_system(laplace_ptree);
+  laplace.assemble_system(source, *material_property);
+
+  // Only give the matrices to the evaluator, as an application which does not
+  // use deal.II would
+  auto matrix = std::make_shared<dealii::TrilinosWrappers::SparseMatrix>();
+  matrix->copy_from(laplace._system_matrix);
+  dealii::IndexSet constrained_dofs(laplace._dof_handler.n_dofs());
+  for (auto const &line : laplace._constraints.get_lines())
+    constrained_dofs.add_index(line.index);
+  std::shared_ptr<mfmg::AlgebraicMeshEvaluator> evaluator;
+  if (use_elements)
+  {
+    dealii::QGauss<dim> const quadrature(fe_degree + 1);
+    dealii::FEValues<dim> fe_values(laplace._fe, quadrature,
+                                    dealii::update_gradients |
+                                        dealii::update_quadrature_points |
+                                        dealii::update_JxW_values);
+    unsigned int const dofs_per_cell = laplace._fe.dofs_per_cell;
+    std::vector<std::vector<dealii::types::global_dof_index>> element_dofs;
+    std::vector<dealii::FullMatrix<double>> element_matrices;
+    for (auto cell : dealii::filter_iterators(
+             laplace._dof_handler.active_cell_iterators(),
+             dealii::IteratorFilters::LocallyOwnedCell()))
+    {
+      fe_values.reinit(cell);
+      dealii::FullMatrix<double> cell_matrix(dofs_per_cell, dofs_per_cell);
+      for (unsigned int q = 0; q < quadrature.size(); ++q)
+      {
+        double const diffusion_coefficient =
+            material_property->value(fe_values.quadrature_point(q));
+        for (unsigned int i = 0; i < dofs_per_cell; ++i)
+          for (unsigned int j = 0; j < dofs_per_cell; ++j)
+            cell_matrix(i, j) += diffusion_coefficient *
+                                 fe_values.shape_grad(i, q) *
+                                 fe_values.shape_grad(j, q) *
+                                 fe_values.JxW(q);
+      }
+      std::vector<dealii::types::global_dof_index> dof_indices(dofs_per_cell);
+      cell->get_dof_indices(dof_indices);
+      element_dofs.push_back(dof_indices);
+      element_matrices.push_back(cell_matrix);
+    }
+    evaluator = std::make_shared<mfmg::AlgebraicMeshEvaluator>(
+        matrix, element_dofs, element_matrices, constrained_dofs);
+  }
+  else
+  {
+    evaluator = std::make_shared<mfmg::AlgebraicMeshEvaluator>(
+        matrix, constrained_dofs);
+  }
+  mfmg::Hierarchy<DVector> hierarchy(comm, evaluator, params);
+
+  auto const &statistics = hierarchy.get_statistics();
+  BOOST_TEST(statistics.get<double>(
+                 "level_0.restrictor.eigensolver.n_dofs.min") > 0.);
+
+  // Do a few V-cycles with a zero right-hand side
+  auto const locally_owned_dofs = laplace._locally_owned_dofs;
+  DVector solution(locally_owned_dofs, comm);
+  DVector rhs(locally_owned_dofs, comm);
+  std::default_random_engine generator;
+  std::uniform_real_distribution<double> distribution(0., 1.);
+  for (auto const index : locally_owned_dofs)
+    if (!laplace._constraints.is_constrained(index))
+      solution[index] = distribution(generator);
+
+  DVector residual(rhs);
+  matrix->vmult(residual, solution);
+  double residual_norm = residual.l2_norm();
+  double conv_rate = 1.;
+  for (unsigned int i = 0; i < 20; ++i)
+  {
+    hierarchy.apply(rhs, solution);
+    matrix->vmult(residual, solution);
+    conv_rate = residual.l2_norm() / residual_norm;
+    residual_norm = residual.l2_norm();
+  }
+  BOOST_TEST(conv_rate < 0.8);
+}
+
+BOOST_AUTO_TEST_CASE(algebraic_multithreaded)
+{
+  using DVector = dealii::LinearAlgebra::distributed::Vector<double>;
+  int constexpr dim = 2;
+
+  MPI_Comm comm = MPI_COMM_WORLD;
+
+  auto params = std::make_shared<boost::property_tree::ptree>();
+  boost::property_tree::info_parser::read_info("hierarchy_input.info", *params);
+  params->put("agglomeration.size", 9);
+  // The eigensolver needs to be deterministic to compare the hierarchies
+  params->put("eigensolver.type", "lapack");
+
+  auto material_property =
+      MaterialPropertyFactory<dim>::create_material_property(
+          params->get<std::string>("material_property.type"));
+  Source<dim> source;
+
+  auto laplace_ptree = params->get_child("laplace");
+  unsigned int const fe_degree = 1;
+  Laplace<dim, DVector> laplace(comm, fe_degree);
+  laplace.setup_system(laplace_ptree);
+  laplace.assemble_system(source, *material_property);
+
+  auto matrix = std::make_shared<dealii::TrilinosWrappers::SparseMatrix>();
+  matrix->copy_from(laplace._system_matrix);
+  dealii::IndexSet constrained_dofs(laplace._dof_handler.n_dofs());
+  for (auto const &line : laplace._constraints.get_lines())
+    constrained_dofs.add_index(line.index);
+  auto evaluator =
+      std::make_shared<mfmg::AlgebraicMeshEvaluator>(matrix, constrained_dofs);
+
+  // The agglomerates are solved by several threads but the hierarchy must be
+  // the same as with a single thread
+  dealii::MultithreadInfo::set_thread_limit(1);
+  mfmg::Hierarchy<DVector> serial_hierarchy(comm, evaluator, params);
+  dealii::MultithreadInfo::set_thread_limit(4);
+  mfmg::Hierarchy<DVector> hierarchy(comm, evaluator, params);
+  BOOST_TEST(hierarchy.get_statistics().get<unsigned int>(
+                 "level_0.restrictor.threads.n_threads") ==
+             dealii::MultithreadInfo::n_threads());
+  dealii::MultithreadInfo::set_thread_limit(1);
+
+  auto const locally_owned_dofs = laplace._locally_owned_dofs;
+  DVector b(locally_owned_dofs, comm);
+  std::default_random_engine generator;
+  std::uniform_real_distribution<double> distribution(0., 1.);
+  for (auto const index : locally_owned_dofs)
+    if (!laplace._constraints.is_constrained(index))
+      b[index] = distribution(generator);
+  DVector x_ref(locally_owned_dofs, comm);
+  serial_hierarchy.vmult(x_ref, b);
+  DVector x(locally_owned_dofs, comm);
+  hierarchy.vmult(x, b);
+  double const ref_norm = x_ref.l2_norm();
+  x_ref -= x;
+  BOOST_TEST(x_ref.l2_norm() / ref_norm < 1e-12);
+}
+
+BOOST_AUTO_TEST_CASE(across_ranks)
+{
+  using DVector = dealii::LinearAlgebra::distributed::Vector<double>;
+  int constexpr dim = 2;
+  using MeshEvaluator = mfmg::DealIIMeshEvaluator<dim>;
+
+  dealii::MultithreadInfo::set_thread_limit(1);
+
+  auto params = std::make_shared<boost::property_tree::ptree>();
+  boost::property_tree::info_parser::read_info("hierarchy_input.info", *params);
+  params->put("is preconditioner", true);
+  // The blocks do not align with the partition of the mesh so some of them
+  // are cut by the processor boundaries
+  params->put("agglomeration.nx", 3);
+  params->put("agglomeration.ny", 3);
+  params->put("agglomeration.across_ranks", true);
+
+  auto material_property =
+      MaterialPropertyFactory<dim>::create_material_property(
+          params->get<std::string>("material_property.type"));
+  Source<dim> source;
+  auto laplace_ptree = params->get_child("laplace");
+  unsigned int const fe_degree = 1;
+
+  auto solve = [&](MPI_Comm comm) {
+    Laplace<dim, DVector> laplace(comm, fe_degree);
+    laplace.setup_system(laplace_ptree);
+    laplace.assemble_system(source, *material_property);
+    auto evaluator = std::make_shared<TestMeshEvaluator<MeshEvaluator>>(
+        laplace._dof_handler, laplace._constraints, fe_degree,
+        laplace._system_matrix, material_property);
+    mfmg::Hierarchy<DVector> hierarchy(comm, evaluator, params);
+
+    DVector solution(laplace._locally_owned_dofs, comm);
+    dealii::SolverControl solver_control(
+        solution.size(), 1e-8 * laplace._system_rhs.l2_norm());
+    dealii::SolverCG<DVector> solver(solver_control);
+    solver.solve(laplace._system_matrix, solution, laplace._system_rhs,
+                 hierarchy);
+
+    return solver_control.last_step();
+  };
+
+  // With the agglomerates merged across the processors, the number of
+  // iterations must be about the same as on a single processor, where no
+  // agglomerate is cut
+  unsigned int const n_serial_iterations = solve(MPI_COMM_SELF);
+  unsigned int const n_iterations = solve(MPI_COMM_WORLD);
+  BOOST_TEST(n_iterations <= n_serial_iterations + n_serial_iterations / 5 + 1);
+}
+
+BOOST_DATA_TEST_CASE(save_load,
+                     bdata::make({"Symmetric Gauss-Seidel", "Chebyshev",
+                                  "Block Jacobi (Agglomerate)"}),
+                     smoother_type)
+{
+  using DVector = dealii::LinearAlgebra::distributed::Vector<double>;
+  int constexpr dim = 2;
+  using MeshEvaluator = mfmg::DealIIMeshEvaluator<dim>;
+
+  dealii::MultithreadInfo::set_thread_limit(1);
+
+  MPI_Comm comm = MPI_COMM_WORLD;
+  unsigned int const n_procs = dealii::Utilities::MPI::n_mpi_processes(comm);
+  unsigned int const rank = dealii::Utilities::MPI::this_mpi_process(comm);
+
+  auto params = std::make_shared<boost::property_tree::ptree>();
+  boost::property_tree::info_parser::read_info("hierarchy_input.info", *params);
+  params->put("smoother.type", smoother_type);
+
+  auto material_property =
+      MaterialPropertyFactory<dim>::create_material_property(
+          params->get<std::string>("material_property.type"));
+  Source<dim> source;
+
+  auto laplace_ptree = params->get_child("laplace");
+  unsigned int const fe_degree = 1;
+  Laplace<dim, DVector> laplace(comm, fe_degree);
+  laplace.setup_system(laplace_ptree);
+  laplace.assemble_system(source, *material_property);
+
+  auto evaluator = std::make_shared<TestMeshEvaluator<MeshEvaluator>>(
+      laplace._dof_handler, laplace._constraints, fe_degree,
+      laplace._system_matrix, material_property);
+  mfmg::Hierarchy<DVector> hierarchy(comm, evaluator, params);
+
+  // Each configuration of the test writes to its own directory
+  std::string directory = "hierarchy_" + std::to_string(n_procs) + "_";
+  for (auto const c : smoother_type)
+    directory += std::isalnum(c) ? c : '_';
+  if (rank == 0)
+    mkdir(directory.c_str(), 0755);
+  MPI_Barrier(comm);
+
+  hierarchy.save(directory);
+  MPI_Barrier(comm);
+  auto loaded_hierarchy = mfmg::Hierarchy<DVector>::load(comm, directory);
+
+  // The loaded hierarchy must give the same result as the original one
+  auto const locally_owned_dofs = laplace._locally_owned_dofs;
+  DVector b(locally_owned_dofs, comm);
+  std::default_random_engine generator;
+  std::uniform_real_distribution<double> distribution(0., 1.);
+  for (auto const index : locally_owned_dofs)
+    if (!laplace._constraints.is_constrained(index))
+      b[index] = distribution(generator);
+  DVector x_ref(locally_owned_dofs, comm);
+  hierarchy.vmult(x_ref, b);
+  DVector x(locally_owned_dofs, comm);
+  loaded_hierarchy.vmult(x, b);
+  double const ref_norm = x_ref.l2_norm();
+  x_ref -= x;
+  BOOST_TEST(x_ref.l2_norm() / ref_norm < 1e-12);
+
+  // Loading a hierarchy saved with a different number of processors must fail
+  MPI_Barrier(comm);
+  if (rank == 0)
+  {
+    boost::property_tree::ptree info;
+    boost::property_tree::info_parser::read_info(directory + "/hierarchy.info",
+                                                 info);
+    info.put("n_processes", n_procs + 1);
+    boost::property_tree::info_parser::write_info(
+        directory + "/hierarchy.info", info);
+  }
+  MPI_Barrier(comm);
+  BOOST_CHECK_THROW(mfmg::Hierarchy<DVector>::load(comm, directory),
+                    std::runtime_error);
+}
+
+// Material property equal to 10 in the lower left corner of the domain and to
+// 1 elsewhere
+template <int dim>
+class CornerMaterialProperty final : public Coefficient<dim>
+{
+public:
+  CornerMaterialProperty() = default;
+
+  virtual ~CornerMaterialProperty() override = default;
+
+  virtual dealii::VectorizedArray<double>
+  value(dealii::Point<dim, dealii::VectorizedArray<double>> const &p,
+        unsigned int const = 0) const override
+  {
+    dealii::VectorizedArray<double> return_value;
+    for (unsigned int i = 0;
+         i < dealii::VectorizedArray<double>::n_array_elements; ++i)
+    {
+      dealii::Point<dim> point;
+      for (unsigned int d = 0; d < dim; ++d)
+        point[d] = p[d][i];
+      return_value[i] = value(point);
+    }
+
+    return return_value;
+  }
+
+  virtual double value(dealii::Point<dim> const &p,
+                       unsigned int const = 0) const override
+  {
+    for (unsigned int d = 0; d < dim; ++d)
+      if (p[d] > 0.25)
+        return 1.;
+
+    return 10.;
+  }
+};
+
+BOOST_DATA_TEST_CASE(
+    rebuild, bdata::make({"Gauss-Seidel", "Block Jacobi (Agglomerate)"}),
+    smoother_type)
+{
+  using DVector = dealii::LinearAlgebra::distributed::Vector<double>;
+  int constexpr dim = 2;
+  using MeshEvaluator = mfmg::DealIIMeshEvaluator<dim>;
+
+  dealii::MultithreadInfo::set_thread_limit(1);
+
+  MPI_Comm comm = MPI_COMM_WORLD;
+
+  auto params = std::make_shared<boost::property_tree::ptree>();
+  boost::property_tree::info_parser::read_info("hierarchy_input.info", *params);
+  // The eigensolver needs to be deterministic to compare with a new hierarchy
+  params->put("eigensolver.type", "lapack");
+  // The agglomerate block Jacobi smoother checks that the blocks are restored
+  params->put("smoother.type", smoother_type);
+
+  auto material_property =
+      MaterialPropertyFactory<dim>::create_material_property(
+          params->get<std::string>("material_property.type"));
+  Source<dim> source;
+
+  auto laplace_ptree = params->get_child("laplace");
+  unsigned int const fe_degree = 1;
+  Laplace<dim, DVector> laplace(comm, fe_degree);
+  laplace.setup_system(laplace_ptree);
+  laplace.assemble_system(source, *material_property);
+
+  auto evaluator = std::make_shared<TestMeshEvaluator<MeshEvaluator>>(
+      laplace._dof_handler, laplace._constraints, fe_degree,
+      laplace._system_matrix, material_property);
+  mfmg::Hierarchy<DVector> hierarchy(comm, evaluator, params);
+
+  // Change the material of the cells in the lower left corner
+  auto corner_material_property =
+      std::make_shared<CornerMaterialProperty<dim>>();
+  laplace._system_matrix = 0.;
+  laplace._system_rhs = 0.;
+  laplace.assemble_system(source, *corner_material_property);
+  std::vector<unsigned int> changed_cells;
+  for (auto cell : dealii::filter_iterators(
+           laplace._dof_handler.active_cell_iterators(),
+           dealii::IteratorFilters::LocallyOwnedCell()))
+  {
+    auto const center = cell->center();
+    if ((center[0] < 0.25) && (center[1] < 0.25))
+      changed_cells.push_back(cell->active_cell_index());
+  }
+
+  auto corner_evaluator = std::make_shared<TestMeshEvaluator<MeshEvaluator>>(
+      laplace._dof_handler, laplace._constraints, fe_degree,
+      laplace._system_matrix, corner_material_property);
+  hierarchy.rebuild(corner_evaluator, changed_cells);
+
+  // Only the agglomerates of the corner are solved again
+  auto const &statistics = hierarchy.get_statistics();
+  unsigned int const n_agglomerates = statistics.get<unsigned int>(
+      "level_0.restrictor.eigensolver.n_agglomerates");
+  unsigned int const n_updated_agglomerates = statistics.get<unsigned int>(
+      "level_0.restrictor_rebuild.n_updated_agglomerates");
+  BOOST_TEST(n_updated_agglomerates > 0u);
+  BOOST_TEST(n_updated_agglomerates < n_agglomerates / 4);
+
+  // The rebuilt hierarchy must give the same result as a new one
+  mfmg::Hierarchy<DVector> new_hierarchy(comm, corner_evaluator, params);
+  auto const locally_owned_dofs = laplace._locally_owned_dofs;
+  DVector b(locally_owned_dofs, comm);
+  std::default_random_engine generator;
+  std::uniform_real_distribution<double> distribution(0., 1.);
+  for (auto const index : locally_owned_dofs)
+    if (!laplace._constraints.is_constrained(index))
+      b[index] = distribution(generator);
+  DVector x_ref(locally_owned_dofs, comm);
+  new_hierarchy.vmult(x_ref, b);
+  DVector x(locally_owned_dofs, comm);
+  hierarchy.vmult(x, b);
+  double const ref_norm = x_ref.l2_norm();
+  x_ref -= x;
+  BOOST_TEST(x_ref.l2_norm() / ref_norm < 1e-10);
+
+  // Without a changed cell the hierarchy is left untouched, even if the
+  // evaluator is different
+  hierarchy.rebuild(evaluator, std::vector<unsigned int>());
+  DVector y(locally_owned_dofs, comm);
+  hierarchy.vmult(y, b);
+  y -= x;
+  BOOST_TEST(y.l2_norm() == 0.);
+}
+
 BOOST_DATA_TEST_CASE(
     hierarchy_3d,
     bdata::make({"hyper_cube", "hyper_ball"}) * bdata::make({false, true}) *
@@ -504,7 +1058,8 @@ dealii::TrilinosWrappers::SparseMatrix gimme_identity(unsigned int n_local_rows)
   return identity_matrix;
 }
 
-BOOST_AUTO_TEST_CASE(fast_multiply_transpose)
+BOOST_DATA_TEST_CASE(fast_multiply_transpose, bdata::make({false, true}),
+                     adaptive)
 {
   dealii::MultithreadInfo::set_thread_limit(
       dealii::numbers::invalid_unsigned_int);
@@ -517,6 +1072,13 @@ BOOST_AUTO_TEST_CASE(fast_multiply_transpose)
   auto params = std::make_shared<boost::property_tree::ptree>();
   boost::property_tree::info_parser::read_info("hierarchy_input.info", *params);
   params->put("eigensolver.type", "lapack");
+  // The agglomerates keep different numbers of eigenvectors so the rows of the
+  // restrictor are not distributed uniformly
+  if (adaptive)
+  {
+    params->put("eigensolver.number of eigenvectors", 4);
+    params->put("eigensolver.eigenvalue threshold", 0.1);
+  }
   auto material_property =
       MaterialPropertyFactory<dim>::create_material_property(
           params->get<std::string>("material_property.type"));
@@ -352,3 +352,86 @@ BOOST_DATA_TEST_CASE(weight_sum, bdata::make({"lapack", "lanczos"}),
     BOOST_TEST(ee.l1_norm() == 1., tt::tolerance(2e-4));
   }
 }
+
+BOOST_AUTO_TEST_CASE(streaming, *utf::tolerance(1e-14))
+{
+  // Check that the streaming setup builds the same matrices as the default one
+  // and that the agglomerates can be processed in any order
+  unsigned int constexpr dim = 2;
+  using DVector = dealii::LinearAlgebra::distributed::Vector<double>;
+  using MeshEvaluator = mfmg::DealIIMeshEvaluator<dim>;
+
+  MPI_Comm comm = MPI_COMM_WORLD;
+
+  Source<dim> source;
+
+  auto params = std::make_shared<boost::property_tree::ptree>();
+  boost::property_tree::info_parser::read_info("hierarchy_input.info", *params);
+  params->put("eigensolver.type", "lapack");
+  params->put("laplace.n_refinements", 4);
+  auto agglomerate_ptree = params->get_child("agglomeration");
+  int n_eigenvectors =
+      params->get<int>("eigensolver.number of eigenvectors", 1);
+  double tolerance = params->get<double>("eigensolver.tolerance", 1e-14);
+
+  std::shared_ptr<dealii::Function<dim>> material_property =
+      std::make_shared<ConstantMaterialProperty<dim>>();
+  auto laplace_ptree = params->get_child("laplace");
+  Laplace<dim, DVector> laplace(comm, 1);
+  laplace.setup_system(laplace_ptree);
+  laplace.assemble_system(source, *material_property);
+
+  TestMeshEvaluator<dim> evaluator(laplace._dof_handler, laplace._constraints,
+                                   laplace._system_matrix);
+  mfmg::AMGe_host<dim, MeshEvaluator, DVector> amge(
+      comm, laplace._dof_handler, params->get_child("eigensolver"));
+  auto locally_relevant_global_diag = evaluator.get_diagonal();
+
+  auto check_matrices = [](dealii::TrilinosWrappers::SparseMatrix const &ref,
+                           dealii::TrilinosWrappers::SparseMatrix const &mat) {
+    BOOST_TEST(mat.m() == ref.m());
+    BOOST_TEST(mat.n() == ref.n());
+    BOOST_TEST((mat.local_range() == ref.local_range()));
+    BOOST_TEST((mat.locally_owned_domain_indices() ==
+                ref.locally_owned_domain_indices()));
+    for (auto i = ref.local_range().first; i < ref.local_range().second; ++i)
+      for (unsigned int j = 0; j < ref.n(); ++j)
+        BOOST_TEST(mat.el(i, j) == ref.el(i, j));
+  };
+
+  std::vector<std::shared_ptr<dealii::TrilinosWrappers::SparseMatrix>>
+      restrictor_matrices;
+  std::vector<std::unique_ptr<dealii::TrilinosWrappers::SparseMatrix>>
+      eigenvector_matrices(2);
+  std::vector<std::unique_ptr<dealii::TrilinosWrappers::SparseMatrix>>
+      delta_eigenvector_matrices(2);
+  std::vector<std::vector<double>> eigenvalues(2);
+  for (bool const streaming : {false, true})
+  {
+    // The order in which the agglomerates are processed must not change the
+    // matrices
+    agglomerate_ptree.put("streaming", streaming);
+    agglomerate_ptree.put("schedule", streaming ? "largest first" : "natural");
+
+    dealii::TrilinosWrappers::SparseMatrix restrictor_matrix;
+    amge.setup_restrictor(agglomerate_ptree, n_eigenvectors, tolerance,
+                          evaluator, locally_relevant_global_diag,
+                          restrictor_matrix);
+    if (streaming)
+      check_matrices(*restrictor_matrices[0], restrictor_matrix);
+
+    restrictor_matrices.push_back(
+        std::make_shared<dealii::TrilinosWrappers::SparseMatrix>());
+    amge.setup_restrictor(
+        agglomerate_ptree, n_eigenvectors, tolerance, evaluator,
+        locally_relevant_global_diag, restrictor_matrices.back(),
+        eigenvector_matrices[streaming], delta_eigenvector_matrices[streaming],
+        eigenvalues[streaming]);
+  }
+
+  check_matrices(*restrictor_matrices[0], *restrictor_matrices[1]);
+  check_matrices(*eigenvector_matrices[0], *eigenvector_matrices[1]);
+  check_matrices(*delta_eigenvector_matrices[0],
+                 *delta_eigenvector_matrices[1]);
+  BOOST_TEST(eigenvalues[1] == eigenvalues[0], tt::per_element());
+}
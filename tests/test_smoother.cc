@@ -0,0 +1,423 @@
+/**************************************************************************
+ * Copyright (c) 2017-2019 by the mfmg authors                            *
+ * All rights reserved.                                                   *
+ *                                                                        *
+ * This file is part of the mfmg library. mfmg is distributed under a BSD *
+ * 3-clause license. For the licensing terms see the LICENSE file in the  *
+ * top-level directory                                                    *
+ *                                                                        *
+ * SPDX-License-Identifier: BSD-3-Clause                                  *
+ *************************************************************************/
+
+#define BOOST_TEST_MODULE smoother
+
+#include <mfmg/dealii/dealii_agglomerate_smoother.hpp>
+#include <mfmg/dealii/dealii_chebyshev_smoother.hpp>
+#include <mfmg/dealii/dealii_csr_matrix_operator.hpp>
+#include <mfmg/dealii/dealii_hierarchy_helpers.hpp>
+#include <mfmg/dealii/dealii_matrix_free_operator.hpp>
+#include <mfmg/dealii/dealii_matrix_free_smoother.hpp>
+#include <mfmg/dealii/dealii_multicolor_smoother.hpp>
+#include <mfmg/dealii/dealii_smoother.hpp>
+#include <mfmg/dealii/dealii_trilinos_matrix_operator.hpp>
+
+#include <deal.II/base/index_set.h>
+#include <deal.II/base/mpi.h>
+#include <deal.II/lac/la_parallel_vector.h>
+#include <deal.II/lac/trilinos_sparse_matrix.h>
+
+#include <boost/property_tree/ptree.hpp>
+#include <boost/test/data/test_case.hpp>
+
+#include <cmath>
+#include <memory>
+#include <numeric>
+
+#include "main.cc"
+#include "test_hierarchy_helpers.hpp"
+
+
+using DVector = dealii::LinearAlgebra::distributed::Vector<double>;
+
+// Build the distributed tridiagonal matrix [-1 4 -1]. If diagonal is true, the
+// off-diagonal entries are not added.
+std::shared_ptr<dealii::TrilinosWrappers::SparseMatrix>
+build_matrix(MPI_Comm comm, unsigned int n_local_rows, bool diagonal)
+{
+  unsigned int const n_procs = dealii::Utilities::MPI::n_mpi_processes(comm);
+  unsigned int const rank = dealii::Utilities::MPI::this_mpi_process(comm);
+  unsigned int const size = n_procs * n_local_rows;
+  dealii::IndexSet locally_owned(size);
+  locally_owned.add_range(rank * n_local_rows, (rank + 1) * n_local_rows);
+
+  auto matrix = std::make_shared<dealii::TrilinosWrappers::SparseMatrix>(
+      locally_owned, locally_owned, comm, 3);
+  for (auto const i : locally_owned)
+  {
+    matrix->set(i, i, 4.);
+    if (!diagonal)
+    {
+      if (i > 0)
+        matrix->set(i, i - 1, -1.);
+      if (i < size - 1)
+        matrix->set(i, i + 1, -1.);
+    }
+  }
+  matrix->compress(dealii::VectorOperation::insert);
+
+  return matrix;
+}
+
+BOOST_DATA_TEST_CASE(zero_initial_guess,
+                     bdata::make({"Gauss-Seidel", "Symmetric Gauss-Seidel",
+                                  "Jacobi", "ILU"}),
+                     smoother_type)
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  auto matrix = build_matrix(comm, 100, false);
+  auto op = std::make_shared<mfmg::DealIITrilinosMatrixOperator<DVector>>(
+      matrix);
+  auto params = std::make_shared<boost::property_tree::ptree>();
+  params->put("smoother.type", smoother_type);
+  mfmg::DealIISmoother<DVector> smoother(op, params);
+
+  auto b = op->build_range_vector();
+  for (auto const i : b->locally_owned_elements())
+    (*b)[i] = std::sin(static_cast<double>(i));
+
+  // Skipping the computation of the residual must not change the result
+  auto x = op->build_domain_vector();
+  auto x_ref = op->build_domain_vector();
+  *x = 0.;
+  *x_ref = 0.;
+  smoother.apply(*b, *x, true);
+  smoother.apply(*b, *x_ref, false);
+  for (auto const i : x->locally_owned_elements())
+    BOOST_TEST((*x)[i] == (*x_ref)[i], boost::test_tools::tolerance(1e-14));
+}
+
+BOOST_AUTO_TEST_CASE(zero_initial_guess_matrix_free)
+{
+  int constexpr dim = 2;
+  int constexpr fe_degree = 1;
+  MPI_Comm comm = MPI_COMM_WORLD;
+
+  auto material_property =
+      MaterialPropertyFactory<dim>::create_material_property("constant");
+  boost::property_tree::ptree laplace_ptree;
+  laplace_ptree.put("n_refinements", 3);
+  LaplaceMatrixFree<dim, fe_degree, double> mf_laplace(comm);
+  mf_laplace.setup_system(laplace_ptree, *material_property);
+  auto evaluator =
+      std::make_shared<TestMFMeshEvaluator<dim, fe_degree, double>>(
+          mf_laplace._dof_handler, mf_laplace._constraints,
+          mf_laplace._laplace_operator, material_property);
+  auto op = std::make_shared<mfmg::DealIIMatrixFreeOperator<dim, DVector>>(
+      evaluator);
+  auto params = std::make_shared<boost::property_tree::ptree>();
+  params->put("smoother.type", "Chebyshev");
+  mfmg::DealIIMatrixFreeSmoother<dim, DVector> smoother(op, params);
+
+  auto b = op->build_range_vector();
+  for (auto const i : b->locally_owned_elements())
+    (*b)[i] = mf_laplace._constraints.is_constrained(i)
+                  ? 0.
+                  : std::sin(static_cast<double>(i));
+
+  // Skipping the computation of the residual must not change the result
+  auto x = op->build_domain_vector();
+  auto x_ref = op->build_domain_vector();
+  *x = 0.;
+  *x_ref = 0.;
+  smoother.apply(*b, *x, true);
+  smoother.apply(*b, *x_ref, false);
+  double const x_norm = x_ref->l2_norm();
+  x->add(-1., *x_ref);
+  BOOST_TEST(x->l2_norm() < 1e-12 * x_norm);
+}
+
+BOOST_DATA_TEST_CASE(multicolor_diagonal,
+                     bdata::make({"multicolor gauss-seidel",
+                                  "multicolor backward gauss-seidel",
+                                  "multicolor symmetric gauss-seidel"}),
+                     smoother_type)
+{
+  // A single sweep solves a diagonal system
+  MPI_Comm comm = MPI_COMM_WORLD;
+  auto matrix = build_matrix(comm, 10, true);
+  auto op = std::make_shared<mfmg::DealIITrilinosMatrixOperator<DVector>>(
+      matrix);
+  auto params = std::make_shared<boost::property_tree::ptree>();
+  params->put("smoother.type", smoother_type);
+  mfmg::DealIIMulticolorSmoother<DVector> smoother(op, params);
+  BOOST_TEST(smoother.n_colors() == 1);
+
+  auto b = op->build_range_vector();
+  auto x = op->build_domain_vector();
+  for (auto const i : b->locally_owned_elements())
+    (*b)[i] = i + 1.;
+  *x = 1.;
+  smoother.apply(*b, *x);
+  for (auto const i : x->locally_owned_elements())
+    BOOST_TEST((*x)[i] == (i + 1.) / 4., boost::test_tools::tolerance(1e-14));
+}
+
+BOOST_DATA_TEST_CASE(multicolor_tridiagonal,
+                     bdata::make({"multicolor gauss-seidel",
+                                  "multicolor backward gauss-seidel",
+                                  "multicolor symmetric gauss-seidel"}),
+                     smoother_type)
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  auto matrix = build_matrix(comm, 100, false);
+  auto op = std::make_shared<mfmg::DealIITrilinosMatrixOperator<DVector>>(
+      matrix);
+  auto params = std::make_shared<boost::property_tree::ptree>();
+  params->put("smoother.type", smoother_type);
+  mfmg::DealIIMulticolorSmoother<DVector> smoother(op, params);
+  // The graph of a tridiagonal matrix is a path so two colors are enough
+  BOOST_TEST(smoother.n_colors() == 2);
+
+  auto b = op->build_range_vector();
+  for (auto const i : b->locally_owned_elements())
+    (*b)[i] = std::sin(static_cast<double>(i));
+
+  // Skipping the computation of the residual must not change the result
+  auto x = op->build_domain_vector();
+  auto x_ref = op->build_domain_vector();
+  *x = 0.;
+  *x_ref = 0.;
+  smoother.apply(*b, *x, true);
+  smoother.apply(*b, *x_ref, false);
+  for (auto const i : x->locally_owned_elements())
+    BOOST_TEST((*x)[i] == (*x_ref)[i], boost::test_tools::tolerance(1e-14));
+
+  // The matrix is strictly diagonally dominant so the smoother converges
+  auto r = op->build_range_vector();
+  op->apply(*x, *r);
+  r->sadd(-1., 1., *b);
+  double residual_norm = r->l2_norm();
+  for (unsigned int k = 0; k < 8; ++k)
+  {
+    smoother.apply(*b, *x);
+    op->apply(*x, *r);
+    r->sadd(-1., 1., *b);
+    double const new_residual_norm = r->l2_norm();
+    BOOST_TEST(new_residual_norm < residual_norm);
+    residual_norm = new_residual_norm;
+  }
+  BOOST_TEST(residual_norm < 1e-3 * b->l2_norm());
+}
+
+BOOST_AUTO_TEST_CASE(chebyshev)
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  unsigned int const n_local_rows = 100;
+  auto matrix = build_matrix(comm, n_local_rows, false);
+  auto op = std::make_shared<mfmg::DealIITrilinosMatrixOperator<DVector>>(
+      matrix);
+  auto params = std::make_shared<boost::property_tree::ptree>();
+  params->put("smoother.type", "Chebyshev");
+  params->put("smoother.degree", 4);
+  mfmg::DealIIChebyshevSmoother<DVector> smoother(op, params);
+
+  // The eigenvalues of D^{-1} A are 1 - cos(k pi / (n + 1)) / 2. The Ritz value
+  // is a lower bound of the largest eigenvalue.
+  double const n = matrix->m();
+  double const max_eigenvalue = 1. + std::cos(M_PI / (n + 1.)) / 2.;
+  BOOST_TEST(smoother.max_eigenvalue() <= max_eigenvalue * (1. + 1e-12));
+  BOOST_TEST(smoother.max_eigenvalue() > 0.9 * max_eigenvalue);
+
+  auto b = op->build_range_vector();
+  for (auto const i : b->locally_owned_elements())
+    (*b)[i] = std::sin(static_cast<double>(i));
+
+  auto x = op->build_domain_vector();
+  *x = 0.;
+  auto r = op->build_range_vector();
+  *r = *b;
+  double const initial_residual_norm = r->l2_norm();
+  for (unsigned int k = 0; k < 4; ++k)
+    smoother.apply(*b, *x, k == 0);
+  op->apply(*x, *r);
+  r->sadd(-1., 1., *b);
+  BOOST_TEST(r->l2_norm() < 0.1 * initial_residual_norm);
+
+  // Reusing the estimate of the eigenvalue gives the same smoother
+  mfmg::DealIIChebyshevSmoother<DVector> cached_smoother(
+      op, params, smoother.max_eigenvalue());
+  BOOST_TEST(cached_smoother.max_eigenvalue() == smoother.max_eigenvalue());
+  auto x_cached = op->build_domain_vector();
+  *x_cached = 0.;
+  for (unsigned int k = 0; k < 4; ++k)
+    cached_smoother.apply(*b, *x_cached, k == 0);
+  for (auto const i : x->locally_owned_elements())
+    BOOST_TEST((*x_cached)[i] == (*x)[i], boost::test_tools::tolerance(1e-14));
+}
+
+BOOST_AUTO_TEST_CASE(chebyshev_rebuild)
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  auto matrix = build_matrix(comm, 100, false);
+  auto op = std::make_shared<mfmg::DealIITrilinosMatrixOperator<DVector>>(
+      matrix);
+  auto params = std::make_shared<boost::property_tree::ptree>();
+  params->put("smoother.type", "Chebyshev");
+  mfmg::DealIIHierarchyHelpers<2, DVector> hierarchy_helpers;
+  auto smoother = std::dynamic_pointer_cast<
+      mfmg::DealIIChebyshevSmoother<DVector>>(
+      hierarchy_helpers.build_smoother(op, params));
+
+  // A single Lanczos iteration gives a different estimate so the smoother
+  // rebuilt on the same matrix must reuse the first one
+  params->put("smoother.eigenvalue_iterations", 1);
+  auto rebuilt_smoother = std::dynamic_pointer_cast<
+      mfmg::DealIIChebyshevSmoother<DVector>>(
+      hierarchy_helpers.build_smoother(op, params));
+  BOOST_TEST(rebuilt_smoother->max_eigenvalue() == smoother->max_eigenvalue());
+
+  // The estimate is not reused for another matrix
+  auto other_op =
+      std::make_shared<mfmg::DealIITrilinosMatrixOperator<DVector>>(
+          build_matrix(comm, 100, false));
+  auto other_smoother = std::dynamic_pointer_cast<
+      mfmg::DealIIChebyshevSmoother<DVector>>(
+      hierarchy_helpers.build_smoother(other_op, params));
+  BOOST_TEST(other_smoother->max_eigenvalue() != smoother->max_eigenvalue());
+}
+
+BOOST_DATA_TEST_CASE(agglomerate_block_jacobi, bdata::make({false, true}),
+                     overlap)
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  unsigned int const n_local_rows = 100;
+  auto matrix = build_matrix(comm, n_local_rows, false);
+  auto op = std::make_shared<mfmg::DealIITrilinosMatrixOperator<DVector>>(
+      matrix);
+  auto params = std::make_shared<boost::property_tree::ptree>();
+  params->put("smoother.type", "Block Jacobi (Agglomerate)");
+  params->put("smoother.overlap", overlap);
+
+  auto b = op->build_range_vector();
+  for (auto const i : b->locally_owned_elements())
+    (*b)[i] = std::sin(static_cast<double>(i));
+
+  // A single block containing all the rows solves the system exactly
+  if (dealii::Utilities::MPI::n_mpi_processes(comm) == 1)
+  {
+    std::vector<std::vector<dealii::types::global_dof_index>> blocks(1);
+    for (auto const i : b->locally_owned_elements())
+      blocks[0].push_back(i);
+    mfmg::DealIIAgglomerateSmoother<DVector> smoother(op, params, blocks);
+    BOOST_TEST(smoother.n_blocks() == 1);
+    auto x = op->build_domain_vector();
+    smoother.apply(*b, *x, true);
+    auto r = op->build_range_vector();
+    op->apply(*x, *r);
+    r->sadd(-1., 1., *b);
+    BOOST_TEST(r->l2_norm() < 1e-12 * b->l2_norm());
+  }
+
+  // Blocks of 10 rows which overlap by 5 rows. The rows which are not in any
+  // block, i.e., the first one and the last four, get their own block.
+  std::vector<std::vector<dealii::types::global_dof_index>> blocks;
+  auto const first_row = b->locally_owned_elements().nth_index_in_set(0);
+  for (unsigned int begin = 1; begin + 10 <= n_local_rows; begin += 5)
+  {
+    blocks.emplace_back(10);
+    std::iota(blocks.back().begin(), blocks.back().end(), first_row + begin);
+  }
+  mfmg::DealIIAgglomerateSmoother<DVector> smoother(op, params, blocks);
+  BOOST_TEST(smoother.n_blocks() == blocks.size() + 5);
+
+  // Skipping the computation of the residual must not change the result
+  auto x = op->build_domain_vector();
+  auto x_ref = op->build_domain_vector();
+  *x = 1.;
+  *x_ref = 0.;
+  smoother.apply(*b, *x, true);
+  smoother.apply(*b, *x_ref, false);
+  for (auto const i : x->locally_owned_elements())
+    BOOST_TEST((*x)[i] == (*x_ref)[i], boost::test_tools::tolerance(1e-14));
+
+  auto r = op->build_range_vector();
+  op->apply(*x, *r);
+  r->sadd(-1., 1., *b);
+  double residual_norm = r->l2_norm();
+  for (unsigned int k = 0; k < 8; ++k)
+  {
+    smoother.apply(*b, *x);
+    op->apply(*x, *r);
+    r->sadd(-1., 1., *b);
+    double const new_residual_norm = r->l2_norm();
+    BOOST_TEST(new_residual_norm < residual_norm);
+    residual_norm = new_residual_norm;
+  }
+  BOOST_TEST(residual_norm < 1e-3 * b->l2_norm());
+}
+
+BOOST_DATA_TEST_CASE(single_precision,
+                     bdata::make({"Multicolor Symmetric Gauss-Seidel",
+                                  "Block Jacobi (Agglomerate)"}),
+                     smoother_type)
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  auto matrix = build_matrix(comm, 100, false);
+  auto op = std::make_shared<mfmg::DealIITrilinosMatrixOperator<DVector>>(
+      matrix);
+  auto params = std::make_shared<boost::property_tree::ptree>();
+  params->put("smoother.type", smoother_type);
+  // The single precision smoother is built from its own copy of the matrix
+  // to check that it does not reference it once its operator is replaced
+  auto float_op = std::make_shared<mfmg::DealIITrilinosMatrixOperator<DVector>>(
+      build_matrix(comm, 100, false));
+
+  std::unique_ptr<mfmg::Smoother<DVector>> double_smoother;
+  std::unique_ptr<mfmg::Smoother<DVector>> float_smoother;
+  if (std::string(smoother_type).find("Multicolor") == 0)
+  {
+    double_smoother.reset(
+        new mfmg::DealIIMulticolorSmoother<DVector, double>(op, params));
+    float_smoother.reset(
+        new mfmg::DealIIMulticolorSmoother<DVector, float>(float_op, params));
+  }
+  else
+  {
+    std::vector<std::vector<dealii::types::global_dof_index>> blocks;
+    auto const locally_owned_rows = matrix->locally_owned_range_indices();
+    for (auto const i : locally_owned_rows)
+    {
+      if (i % 10 == 0)
+        blocks.emplace_back();
+      blocks.back().push_back(i);
+    }
+    double_smoother.reset(new mfmg::DealIIAgglomerateSmoother<DVector, double>(
+        op, params, blocks));
+    float_smoother.reset(new mfmg::DealIIAgglomerateSmoother<DVector, float>(
+        float_op, params, blocks));
+  }
+  std::weak_ptr<dealii::TrilinosWrappers::SparseMatrix const> float_matrix =
+      float_op->get_matrix();
+  BOOST_TEST(float_smoother->replace_operator(
+      std::make_shared<mfmg::DealIICSRMatrixOperator<DVector, float>>(
+          *float_op->get_matrix())));
+  float_op.reset();
+  BOOST_TEST(float_matrix.expired());
+
+  // The matrix, the operator used for the residual, and the factors are
+  // rounded to single precision so the results agree up to the single
+  // precision accuracy
+  auto b = op->build_range_vector();
+  for (auto const i : b->locally_owned_elements())
+    (*b)[i] = std::sin(static_cast<double>(i));
+  auto x_double = op->build_domain_vector();
+  auto x_float = op->build_domain_vector();
+  for (unsigned int k = 0; k < 3; ++k)
+  {
+    double_smoother->apply(*b, *x_double, k == 0);
+    float_smoother->apply(*b, *x_float, k == 0);
+  }
+  double const x_norm = x_double->l2_norm();
+  x_float->add(-1., *x_double);
+  BOOST_TEST(x_float->l2_norm() < 1e-5 * x_norm);
+}
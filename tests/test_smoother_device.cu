@@ -113,6 +113,16 @@ BOOST_AUTO_TEST_CASE(smoother)
   for (unsigned int i = 0; i < size; ++i)
     BOOST_CHECK_CLOSE(range_host[i], range_vector[i], 1e-12);
 
+  // The initial guess is zero, so skipping the computation of the residual
+  // must give the same result
+  std::fill(range_host.begin(), range_host.end(), 0.);
+  mfmg::cuda_mem_copy_to_dev(range_host, range_dev->get_values());
+  bool const zero_initial_guess = true;
+  smoother_operator.apply(*domain_dev, *range_dev, zero_initial_guess);
+  mfmg::cuda_mem_copy_to_host(range_dev->get_values(), range_host);
+  for (unsigned int i = 0; i < size; ++i)
+    BOOST_CHECK_CLOSE(range_host[i], range_vector[i], 1e-12);
+
   // Destroy the cusparse handle
   cusparse_error_code = cusparseDestroy(cusparse_handle);
   mfmg::ASSERT_CUSPARSE(cusparse_error_code);
@@ -11,13 +11,23 @@
 
 #define BOOST_TEST_MODULE utils
 
+#include <mfmg/common/eigensolver_statistics.hpp>
+#include <mfmg/common/tracer.hpp>
 #include <mfmg/common/utils.hpp>
+#include <mfmg/dealii/dealii_utils.hpp>
+
+#include <deal.II/lac/dynamic_sparsity_pattern.h>
 
 #include <Teuchos_ParameterList.hpp>
 
 #include <boost/property_tree/info_parser.hpp>
+#include <boost/property_tree/json_parser.hpp>
 #include <boost/property_tree/ptree.hpp>
 
+#include <cstdio>
+#include <set>
+#include <thread>
+
 #include "main.cc"
 
 BOOST_AUTO_TEST_CASE(plist2ptree)
@@ -85,3 +95,199 @@ BOOST_AUTO_TEST_CASE(sorting)
 
   BOOST_TEST(reference == vec_2);
 }
+
+BOOST_AUTO_TEST_CASE(binary_csr)
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  unsigned int const n_procs = dealii::Utilities::MPI::n_mpi_processes(comm);
+  unsigned int const rank = dealii::Utilities::MPI::this_mpi_process(comm);
+
+  // Tridiagonal matrix whose rows are distributed in contiguous blocks
+  unsigned int const n_local_rows = 10;
+  dealii::types::global_dof_index const size = n_procs * n_local_rows;
+  dealii::IndexSet locally_owned(size);
+  locally_owned.add_range(rank * n_local_rows, (rank + 1) * n_local_rows);
+  dealii::DynamicSparsityPattern dsp(size, size, locally_owned);
+  for (auto const i : locally_owned)
+    for (auto j = (i > 0 ? i - 1 : 0); j < std::min(i + 2, size); ++j)
+      dsp.add(i, j);
+  dealii::TrilinosWrappers::SparseMatrix matrix;
+  matrix.reinit(locally_owned, locally_owned, dsp, comm);
+  for (auto const i : locally_owned)
+    for (auto j = (i > 0 ? i - 1 : 0); j < std::min(i + 2, size); ++j)
+      matrix.set(i, j, (i == j) ? 2. + i : -1. / (1. + j));
+  matrix.compress(dealii::VectorOperation::insert);
+
+  std::string const matrix_filename = "matrix_" + std::to_string(n_procs);
+  mfmg::binary_csr_output_file(matrix_filename, matrix);
+  MPI_Barrier(comm);
+
+  dealii::TrilinosWrappers::SparseMatrix loaded_matrix;
+  mfmg::binary_csr_input_file(matrix_filename, comm, loaded_matrix);
+  BOOST_TEST(loaded_matrix.m() == size);
+  BOOST_TEST(loaded_matrix.n() == size);
+  BOOST_TEST(loaded_matrix.n_nonzero_elements() == matrix.n_nonzero_elements());
+  BOOST_TEST(loaded_matrix.locally_owned_range_indices() == locally_owned);
+  for (auto const i : locally_owned)
+    for (auto j = (i > 0 ? i - 1 : 0); j < std::min(i + 2, size); ++j)
+      BOOST_TEST(loaded_matrix.el(i, j) == matrix.el(i, j));
+
+  auto const host_matrix = mfmg::binary_csr_input_file(matrix_filename, rank);
+  BOOST_TEST(host_matrix.m == size);
+  BOOST_TEST(host_matrix.row_indices.size() == n_local_rows);
+  BOOST_TEST(host_matrix.row_ptr.size() == n_local_rows + 1);
+  BOOST_TEST(host_matrix.columns.size() == host_matrix.row_ptr.back());
+  BOOST_TEST(host_matrix.values.size() == host_matrix.row_ptr.back());
+
+  // A vector written from Trilinos can be read as a deal.II vector
+  dealii::TrilinosWrappers::MPI::Vector vector(locally_owned, comm);
+  for (auto const i : locally_owned)
+    vector[i] = 0.5 + i;
+  vector.compress(dealii::VectorOperation::insert);
+  std::string const vector_filename = "vector_" + std::to_string(n_procs);
+  mfmg::binary_vector_output_file(vector_filename, vector);
+  MPI_Barrier(comm);
+
+  dealii::LinearAlgebra::distributed::Vector<double> loaded_vector;
+  mfmg::binary_vector_input_file(vector_filename, comm, loaded_vector);
+  BOOST_TEST(loaded_vector.size() == size);
+  for (auto const i : locally_owned)
+    BOOST_TEST(loaded_vector[i] == vector[i]);
+
+  // The type of the file is checked
+  BOOST_CHECK_THROW(
+      mfmg::binary_vector_input_file(matrix_filename, comm, loaded_vector),
+      std::runtime_error);
+
+  // A file missing on one processor makes every processor throw instead of
+  // deadlocking in the construction of the matrix
+  if (rank == n_procs - 1)
+    std::remove((matrix_filename + "." + std::to_string(rank)).c_str());
+  MPI_Barrier(comm);
+  BOOST_CHECK_THROW(
+      mfmg::binary_csr_input_file(matrix_filename, comm, loaded_matrix),
+      std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(tracer)
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  unsigned int const rank = dealii::Utilities::MPI::this_mpi_process(comm);
+  unsigned int const n_procs = dealii::Utilities::MPI::n_mpi_processes(comm);
+
+  // Nothing is recorded while the tracer is disabled
+  {
+    mfmg::TraceScope scope("disabled");
+  }
+
+  mfmg::Tracer::enable(comm);
+  {
+    mfmg::TraceScope scope("outer", {{"level", 1}});
+    std::thread worker([]() {
+      mfmg::TraceScope inner("inner", {{"agglomerate", 3}});
+      inner.add_argument("n_dofs", 10);
+    });
+    worker.join();
+  }
+  mfmg::Tracer::disable();
+  mfmg::Tracer::write_chrome_trace("trace.json", comm);
+  mfmg::Tracer::clear();
+
+  if (rank == 0)
+  {
+    boost::property_tree::ptree trace;
+    boost::property_tree::read_json("trace.json", trace);
+    unsigned int n_begin = 0;
+    unsigned int n_end = 0;
+    std::set<std::pair<int, int>> threads;
+    for (auto const &item : trace.get_child("traceEvents"))
+    {
+      auto const &event = item.second;
+      auto const phase = event.get<std::string>("ph");
+      if (phase == "B")
+      {
+        ++n_begin;
+        auto const name = event.get<std::string>("name");
+        BOOST_TEST((name == "outer" || name == "inner"));
+        if (name == "inner")
+          BOOST_TEST(event.get<int>("args.agglomerate") == 3);
+        else
+          BOOST_TEST(event.get<int>("args.level") == 1);
+        threads.emplace(event.get<int>("pid"), event.get<int>("tid"));
+      }
+      else if (phase == "E")
+      {
+        ++n_end;
+      }
+    }
+    // Every processor recorded two events on two different threads
+    BOOST_TEST(n_begin == 2 * n_procs);
+    BOOST_TEST(n_end == 2 * n_procs);
+    BOOST_TEST(threads.size() == 2 * n_procs);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(agglomerate_statistics)
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  unsigned int const rank = dealii::Utilities::MPI::this_mpi_process(comm);
+  unsigned int const n_procs = dealii::Utilities::MPI::n_mpi_processes(comm);
+
+  // Every processor has 100 agglomerates with 1, 2, ..., 100 dofs
+  unsigned int const n_agglomerates = 100;
+  std::vector<mfmg::AgglomerateStatistics> statistics(n_agglomerates);
+  for (unsigned int i = 0; i < n_agglomerates; ++i)
+  {
+    statistics[i].agglomerate_id = i;
+    statistics[i].n_dofs = i + 1;
+    statistics[i].wall_time = rank + 1.;
+  }
+
+  unsigned int const n_bins = 4;
+  auto const summary = mfmg::summarize_agglomerate_statistics(
+      comm, "lanczos", statistics, n_bins);
+
+  BOOST_TEST(summary.get<std::string>("eigensolver") == "lanczos");
+  BOOST_TEST(summary.get<unsigned int>("n_agglomerates") ==
+             n_agglomerates * n_procs);
+  BOOST_TEST(summary.get<double>("n_dofs.min") == 1.);
+  BOOST_TEST(summary.get<double>("n_dofs.max") == 100.);
+  BOOST_TEST(summary.get<double>("n_dofs.mean") == 50.5);
+  // The percentiles are estimated up to the width of the fine histogram
+  BOOST_TEST(std::abs(summary.get<double>("n_dofs.p50") - 50.) < 0.1);
+  BOOST_TEST(std::abs(summary.get<double>("n_dofs.p90") - 90.) < 0.1);
+  BOOST_TEST(std::abs(summary.get<double>("n_dofs.p99") - 99.) < 0.1);
+  for (unsigned int i = 0; i < n_bins; ++i)
+    BOOST_TEST(summary.get<unsigned int>("n_dofs.histogram.bin_" +
+                                         std::to_string(i) + ".count") ==
+               25 * n_procs);
+
+  // The processors do not have the same amount of work
+  BOOST_TEST(summary.get<double>("processor_wall_time.min") == 100.);
+  BOOST_TEST(summary.get<double>("processor_wall_time.max") ==
+             100. * n_procs);
+}
+
+BOOST_AUTO_TEST_CASE(thread_utilization)
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  unsigned int const rank = dealii::Utilities::MPI::this_mpi_process(comm);
+  unsigned int const n_procs = dealii::Utilities::MPI::n_mpi_processes(comm);
+
+  // The four threads of the first processor are always busy while the threads
+  // of the other processors are only busy half of the time
+  mfmg::ThreadUtilization thread_utilization;
+  thread_utilization.n_threads = 4;
+  thread_utilization.wall_time = 2.;
+  thread_utilization.busy_time = rank == 0 ? 8. : 4.;
+
+  auto const summary =
+      mfmg::summarize_thread_utilization(comm, thread_utilization);
+
+  BOOST_TEST(summary.get<unsigned int>("n_threads") == 4);
+  BOOST_TEST(summary.get<double>("wall_time.max") == 2.);
+  BOOST_TEST(summary.get<double>("utilization.max") == 1.);
+  BOOST_TEST(summary.get<double>("utilization.min") ==
+             (n_procs == 1 ? 1. : 0.5));
+  BOOST_TEST(summary.get_child("utilization").count("histogram") == 0);
+}